@@ -27,9 +27,13 @@ void main() {
 	vec3 n = normalize(inNorm);
 	vec3 b = normalize(inBitangent);
 	mat3 tbn = mat3(t, b, n);
-	if (((viewUbo.opts >> 1) & 1) != 0) // use normal map
-		outNorm = tbn * normalize(texture(texNormal, inTexCoords).xyz * 2.0 - vec3(1.0));
-	else
+	if (((viewUbo.opts >> 1) & 1) != 0) { // use normal map
+		// Only use x and y, as cooked normal maps (BC5) don't store z: it's rebuilt knowing the normal is unit length.
+		vec3 tn;
+		tn.xy = texture(texNormal, inTexCoords).rg * 2.0 - vec2(1.0);
+		tn.z = sqrt(max(0.0, 1.0 - dot(tn.xy, tn.xy)));
+		outNorm = tbn * tn;
+	} else
 		outNorm = inNorm;
 
 	/*outAlbedoSpec.rg = inTexCoords;*/
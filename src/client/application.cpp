@@ -64,6 +64,8 @@ static void createLogicalDevice(Application& app)
 
 	VkPhysicalDeviceFeatures deviceFeatures = {};
 	deviceFeatures.samplerAnisotropy = VK_TRUE;
+	// Needed by the textures cooked by the server
+	deviceFeatures.textureCompressionBC = VK_TRUE;
 
 	VkDeviceCreateInfo createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
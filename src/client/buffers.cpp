@@ -188,6 +188,23 @@ void copyBufferToImage(const Application& app,
 	endSingleTimeCommands(app.device, app.queues.graphics, app.commandPool, commandBuffer);
 }
 
+void copyBufferToImage(const Application& app,
+	Buffer buffer,
+	VkImage image,
+	const std::vector<VkBufferImageCopy>& regions)
+{
+	VkCommandBuffer commandBuffer = beginSingleTimeCommands(app, app.commandPool);
+
+	vkCmdCopyBufferToImage(commandBuffer,
+		buffer.handle,
+		image,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		static_cast<uint32_t>(regions.size()),
+		regions.data());
+
+	endSingleTimeCommands(app.device, app.queues.graphics, app.commandPool, commandBuffer);
+}
+
 Buffer createStagingBuffer(const Application& app, VkDeviceSize size)
 {
 	auto buf = createBuffer(app,
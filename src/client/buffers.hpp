@@ -72,6 +72,11 @@ void copyBufferToImage(const Application& app,
 	uint32_t height,
 	VkDeviceSize bufOffset = 0,
 	uint32_t baseArrayLayer = 0);
+/** Copies all `regions` (e.g. all the mip levels of a texture) from `buffer` to `image` with a single command. */
+void copyBufferToImage(const Application& app,
+	Buffer buffer,
+	VkImage image,
+	const std::vector<VkBufferImageCopy>& regions);
 
 void destroyBuffer(VkDevice device, Buffer& buffer);
 
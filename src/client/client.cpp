@@ -6,10 +6,12 @@
 #include "frame_utils.hpp"
 #include "hashing.hpp"
 #include "logging.hpp"
+#include "lod.hpp"
 #include "multipass.hpp"
 #include "phys_device.hpp"
 #include "pipelines.hpp"
 #include "profile.hpp"
+#include "quantized_vertex.hpp"
 #include "renderpass.hpp"
 #include "shader_data.hpp"
 #include "textures.hpp"
@@ -20,6 +22,7 @@
 #include <algorithm>
 #include <future>
 #include <set>
+#include <unordered_set>
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -35,6 +38,7 @@ constexpr auto SERVER_UPDATE_TIME = std::chrono::milliseconds{ 33 };
 
 extern bool gUseCamera;
 extern bool gLimitFrameTime;
+extern bool gUseLods;
 
 VulkanClient::~VulkanClient()
 {
@@ -82,7 +86,7 @@ void VulkanClient::initVulkan()
 		texLoadTasks.emplace_back(texLoader.addTextureAsync(
 			netRsrc.defaults.specularTex, "textures/default_spec.jpg", shared::TextureFormat::GREY));
 		texLoadTasks.emplace_back(texLoader.addTextureAsync(
-			netRsrc.defaults.normalTex, "textures/default_norm.jpg", shared::TextureFormat::RGBA));
+			netRsrc.defaults.normalTex, "textures/default_norm.jpg", shared::TextureFormat::NORMAL));
 		for (auto& res : texLoadTasks) {
 			if (!res.get()) {
 				err("Failed to load texture image! Latest error: ", texLoader.getLatestError());
@@ -145,16 +149,23 @@ void VulkanClient::initVulkan()
 	prepareCamera();
 }
 
-void VulkanClient::startUdp(const char* serverIp)
+void VulkanClient::startUdp(const char* serverIp, uint16_t serverUdpPort, std::size_t maxPacketSize)
 {
+	debug("Starting active EP towards ", serverIp, ":", serverUdpPort, " ...");
+	endpoints.active = startEndpoint(serverIp, serverUdpPort, Endpoint::Type::ACTIVE, SOCK_DGRAM);
+	networkThreads.udpActive = std::make_unique<UdpActiveThread>(endpoints.active);
+
 	debug("Starting passive EP...");
 	endpoints.passive =
 		startEndpoint("0.0.0.0", cfg::UDP_SERVER_TO_CLIENT_PORT, Endpoint::Type::PASSIVE, SOCK_DGRAM);
-	networkThreads.udpPassive = std::make_unique<UdpPassiveThread>(endpoints.passive);
-
-	debug("Starting active EP towards ", serverIp, ":", cfg::UDP_CLIENT_TO_SERVER_PORT, " ...");
-	endpoints.active = startEndpoint(serverIp, cfg::UDP_CLIENT_TO_SERVER_PORT, Endpoint::Type::ACTIVE, SOCK_DGRAM);
-	networkThreads.udpActive = std::make_unique<UdpActiveThread>(endpoints.active);
+	if (!xplatIsValidSocket(endpoints.passive.socket)) {
+		// Port is probably taken by another client on this machine: let the OS choose one.
+		warn("Failed to bind port ", cfg::UDP_SERVER_TO_CLIENT_PORT, ": using any free port instead.");
+		endpoints.passive = startEndpoint("0.0.0.0", 0, Endpoint::Type::PASSIVE, SOCK_DGRAM);
+	}
+	// The passive thread answers the server's MTU probes via the active endpoint
+	networkThreads.udpPassive =
+		std::make_unique<UdpPassiveThread>(endpoints.passive, endpoints.active, maxPacketSize);
 
 	updateReqs.reserve(256);
 }
@@ -164,16 +175,18 @@ bool VulkanClient::connectToServer(const char* serverIp)
 	endpoints.reliable = startEndpoint(serverIp, cfg::RELIABLE_PORT, Endpoint::Type::ACTIVE, SOCK_STREAM);
 
 	debug(":: Performing handshake");
-	if (!tcp_performHandshake(endpoints.reliable.socket)) {
+	uint16_t serverUdpPort;
+	std::size_t maxPacketSize;
+	if (!tcp_performHandshake(endpoints.reliable.socket, serverUdpPort, maxPacketSize)) {
 		err("Failed to perform handshake.");
 		return false;
 	}
 
 	debug(":: Starting UDP endpoints...");
-	startUdp(serverIp);
+	startUdp(serverIp, serverUdpPort, maxPacketSize);
 
 	debug(":: Sending READY...");
-	if (!tcp_sendReadyAndWait(endpoints.reliable.socket)) {
+	if (!tcp_sendReadyAndWait(endpoints.reliable.socket, endpoints.passive.port)) {
 		err("Failed to send or receive READY.");
 		return false;
 	}
@@ -262,7 +275,8 @@ void VulkanClient::collectMissingTextures(const ClientTmpResources& resources)
 bool VulkanClient::loadAssets(const ClientTmpResources& resources,
 	std::vector<ModelInfo>& newModels,
 	std::vector<Material>& newMaterials,
-	std::vector<StringId>& newTextures)
+	std::vector<StringId>& newTextures,
+	std::vector<StringId>& refinedTextures)
 {
 	newModels.reserve(resources.models.size());
 	newMaterials.reserve(resources.materials.size());
@@ -333,6 +347,18 @@ bool VulkanClient::loadAssets(const ClientTmpResources& resources,
 			}
 		}
 
+		// Refine the textures received so far with their new mip levels
+		refinedTextures.reserve(resources.textureMips.size());
+		for (const auto& mip : resources.textureMips) {
+			auto it = netRsrc.textures.find(mip.name);
+			if (it == netRsrc.textures.end()) {
+				warn("Received mip level ", mip.level, " of unknown texture ", mip.name);
+				continue;
+			}
+			texLoader.addMipLevel(it->second, mip);
+			refinedTextures.emplace_back(mip.name);
+		}
+
 		texLoader.create(app);
 	}
 
@@ -351,6 +377,7 @@ void VulkanClient::mainLoop()
 {
 	FPSCounter fps;
 	fps.start();
+	drawStats.since = std::chrono::high_resolution_clock::now();
 
 	updateObjectsUniformBuffer();
 	updateViewUniformBuffer();
@@ -403,13 +430,14 @@ void VulkanClient::runFrame()
 		std::vector<ModelInfo> newModels;
 		std::vector<Material> newMaterials;
 		std::vector<StringId> newTextures;
+		std::vector<StringId> refinedTextures;
 		collectMissingTextures(*resources);
-		loadAssets(*resources, newModels, newMaterials, newTextures);
+		loadAssets(*resources, newModels, newMaterials, newTextures, refinedTextures);
 
 		networkThreads.tcpMsg->releaseResources();
 
 		// Regenerate network-dependant data structures and resources
-		recreateResources(newModels, newMaterials, newTextures);
+		recreateResources(newModels, newMaterials, newTextures, refinedTextures);
 	}
 
 	// Check for UDP messages
@@ -436,6 +464,20 @@ void VulkanClient::runFrame()
 
 	cameraCtrl->processInput(app.window);
 
+	// Let the server know what we're looking at (does not block if the mutex is not available yet)
+	auto& cameraToSend = networkThreads.udpActive->camera;
+	if (cameraToSend.mtx.try_lock()) {
+		cameraToSend.pose.x = camera.position.x;
+		cameraToSend.pose.y = camera.position.y;
+		cameraToSend.pose.z = camera.position.z;
+		cameraToSend.pose.yaw = camera.yaw;
+		cameraToSend.pose.pitch = camera.pitch;
+		cameraToSend.updated = true;
+		cameraToSend.mtx.unlock();
+	}
+
+	updateDrawCommands();
+
 	drawFrame();
 }
 
@@ -444,8 +486,16 @@ void VulkanClient::applyUpdateRequests()
 	for (const auto& req : updateReqs) {
 		switch (req.type) {
 		case UpdateReq::Type::GEOM:
-			updateModel(req.data.geom);
 			acksToSend.emplace_back(req.data.geom.serialId);
+			if (req.data.geom.dst == nullptr)
+				break;
+			updateModel(req.data.geom);
+			markGeometryReceived(geometry,
+				req.data.geom.modelId,
+				req.data.geom.dataType == GeomDataType::INDEX ||
+					req.data.geom.dataType == GeomDataType::INDEX_COMPRESSED,
+				req.data.geom.start,
+				req.data.geom.len);
 			if (receivedGeomIds.load_factor() > 0.9) {
 				receivedGeomIdsMemSize *= 2;
 				receivedGeomIdsMem = realloc(receivedGeomIdsMem, receivedGeomIdsMemSize);
@@ -484,7 +534,8 @@ void VulkanClient::calcTimeStats(FPSCounter& fps,
 
 void VulkanClient::recreateResources(const std::vector<ModelInfo>& newModels,
 	const std::vector<Material>& newMaterials,
-	const std::vector<StringId>& newTextures)
+	const std::vector<StringId>& newTextures,
+	const std::vector<StringId>& refinedTextures)
 {
 	if (newModels.size() > 0) {
 		info("Updating geometry buffers");
@@ -517,6 +568,9 @@ void VulkanClient::recreateResources(const std::vector<ModelInfo>& newModels,
 	if (newTextures.size() > 0)
 		regenMaterials(newTextures);
 
+	if (refinedTextures.size() > 0)
+		refineMaterials(refinedTextures);
+
 	vkResetCommandPool(app.device, app.commandPool, 0);
 	recordAllCommandBuffers();
 }
@@ -598,6 +652,47 @@ void VulkanClient::regenMaterials(const std::vector<StringId>& newTextures)
 	vkFreeDescriptorSets(app.device, app.descriptorPool, descSetsToFree.size(), descSetsToFree.data());
 }
 
+void VulkanClient::refineMaterials(const std::vector<StringId>& refinedTextures)
+{
+	/// Replace the views of the refined textures with ones including their new mip levels, and update
+	/// the descriptor sets using them in place, rather than recreating them.
+
+	// The old views may still be used by the frames in flight
+	VLKCHECK(vkQueueWaitIdle(app.queues.graphics));
+
+	const std::unordered_set<StringId> texNames{ refinedTextures.begin(), refinedTextures.end() };
+	std::unordered_set<StringId> matsToUpdate;
+	for (auto texName : texNames) {
+		auto& image = netRsrc.textures[texName];
+		const auto oldView = image.view;
+		image.view = createImageView(app,
+			image.handle,
+			image.format,
+			VK_IMAGE_ASPECT_COLOR_BIT,
+			image.mipLevels,
+			image.baseMipLevel);
+
+		for (auto& mat : netRsrc.materials) {
+			for (auto view : { &mat.diffuse, &mat.specular, &mat.normal }) {
+				if (*view == oldView) {
+					*view = image.view;
+					matsToUpdate.emplace(mat.name);
+				}
+			}
+		}
+
+		vkDestroyImageView(app.device, oldView, nullptr);
+	}
+
+	std::vector<Material> mats;
+	mats.reserve(matsToUpdate.size());
+	for (const auto& mat : netRsrc.materials) {
+		if (matsToUpdate.erase(mat.name) > 0)
+			mats.emplace_back(mat);
+	}
+	updateMultipassMaterialDescriptorSets(app, mats, app.texSampler);
+}
+
 void VulkanClient::recreateSwapChain()
 {
 	warn("Recreating swap chain");
@@ -728,8 +823,10 @@ void VulkanClient::updateViewUniformBuffer()
 	auto ubo = reinterpret_cast<ViewUBO*>(viewBuf->ptr);
 
 	const auto view = camera.viewMatrix();
-	auto proj = glm::perspective(
-		glm::radians(60.f), app.swapChain.extent.width / float(app.swapChain.extent.height), 0.1f, 300.f);
+	auto proj = glm::perspective(glm::radians(cfg::CAMERA_FOV_Y_DEGREES),
+		app.swapChain.extent.width / float(app.swapChain.extent.height),
+		0.1f,
+		300.f);
 	// Flip y
 	proj[1][1] *= -1;
 	ubo->viewProj = proj * view;
@@ -757,6 +854,39 @@ void VulkanClient::updateLightsUniformBuffer()
 	}
 }
 
+void VulkanClient::updateDrawCommands()
+{
+	const auto viewportHeight = static_cast<float>(app.swapChain.extent.height);
+	uint64_t nTriangles = 0;
+	for (const auto& model : netRsrc.models) {
+		unsigned lod = 0;
+		if (gUseLods) {
+			const auto objBuf = uniformBuffers.getBuffer(model.name);
+			assert(objBuf && objBuf->ptr);
+			const auto& modelMat = reinterpret_cast<const ObjectUBO*>(objBuf->ptr)->model;
+			lod = chooseLod(geometry.locations[model.name], modelMat, camera, viewportHeight);
+		}
+		nTriangles += writeDrawCommands(geometry, model, lod);
+	}
+
+	drawStats.triangles += nTriangles;
+	++drawStats.frames;
+	const auto now = std::chrono::high_resolution_clock::now();
+	const auto elapsed = std::chrono::duration<float>(now - drawStats.since).count();
+	if (elapsed >= 5) {
+		info("Drawn ",
+			drawStats.triangles / drawStats.frames,
+			" triangles per frame, ",
+			drawStats.triangles / elapsed / 1'000'000.f,
+			" M/s (LODs ",
+			gUseLods ? "on" : "off",
+			")");
+		drawStats.triangles = 0;
+		drawStats.frames = 0;
+		drawStats.since = now;
+	}
+}
+
 void VulkanClient::createPermanentBuffers(Buffer& stagingBuffer)
 {
 	{
@@ -793,13 +923,18 @@ void VulkanClient::createPermanentBuffers(Buffer& stagingBuffer)
 		32768 * sizeof(Index),
 		VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	bufAllocator.addBuffer(geometry.drawBuffer,
+		256 * sizeof(VkDrawIndexedIndirectCommand),
+		VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 
 	bufAllocator.create(app);
 
 	// Bind memory for geometry buffers
-	mapBuffersMemory(app.device, { &geometry.vertexBuffer, &geometry.indexBuffer });
+	mapBuffersMemory(app.device, { &geometry.vertexBuffer, &geometry.indexBuffer, &geometry.drawBuffer });
 	memset(geometry.vertexBuffer.ptr, 0, geometry.vertexBuffer.size);
 	memset(geometry.indexBuffer.ptr, 0, geometry.indexBuffer.size);
+	memset(geometry.drawBuffer.ptr, 0, geometry.drawBuffer.size);
 
 	// Allocate enough memory to contain all vertices and indices
 	streamingBuffer.resize(megabytes(128));
@@ -874,6 +1009,7 @@ void VulkanClient::cleanup()
 		{
 			geometry.vertexBuffer,
 			geometry.indexBuffer,
+			geometry.drawBuffer,
 		});
 	uniformBuffers.unmapAllBuffers();
 
@@ -897,6 +1033,7 @@ void VulkanClient::cleanup()
 		buffersToDestroy.emplace_back(app.screenQuadBuffer);
 		buffersToDestroy.emplace_back(geometry.vertexBuffer);
 		buffersToDestroy.emplace_back(geometry.indexBuffer);
+		buffersToDestroy.emplace_back(geometry.drawBuffer);
 		destroyAllBuffers(app.device, buffersToDestroy);
 	}
 	uniformBuffers.cleanup();
@@ -917,8 +1054,9 @@ void VulkanClient::prepareReceivedGeomHashset()
 	// Prepare the memory for the set of received geomUpdates serials.
 	// Initially use a number of elements of 2 * [(total vertices we expect) / (max vertices per chunk) +
 	//				(total indices we expect) / (max indices per chunk)]
-	constexpr auto payloadSize = UdpPacket().payload.size();
-	const auto maxVerticesPerPayload = (payloadSize - sizeof(GeomUpdateHeader)) / sizeof(Vertex);
+	// (the actual packets may be bigger, which only makes this an overestimate)
+	constexpr auto payloadSize = cfg::PACKET_SIZE_BYTES - sizeof(UdpHeader);
+	const auto maxVerticesPerPayload = (payloadSize - sizeof(GeomUpdateHeader)) / sizeof(QuantizedVertex);
 	const auto maxIndicesPerPayload = (payloadSize - sizeof(GeomUpdateHeader)) / sizeof(Index);
 	const auto expectedVertices = 300'000;
 	const auto expectedIndices = 500'000;
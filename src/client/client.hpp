@@ -12,6 +12,7 @@
 #include "geometry.hpp"
 #include "network_data.hpp"
 #include "shader_opts.hpp"
+#include <chrono>
 #include <memory>
 #include <stdexcept>
 #include <vector>
@@ -97,13 +98,20 @@ private:
 	/** Contains togglable debug options for shaders */
 	ShaderOpts shaderOpts;
 
+	/** Triangles drawn since the latest report of the triangle throughput */
+	struct {
+		uint64_t triangles = 0;
+		uint32_t frames = 0;
+		std::chrono::high_resolution_clock::time_point since;
+	} drawStats;
+
 	/** Creates all the permanent Vulkan resources.
 	 *  Those are freed by cleanup().
 	 */
 	void initVulkan();
 
 	/** Starts the UDP network endpoints */
-	void startUdp(const char* serverIp);
+	void startUdp(const char* serverIp, uint16_t serverUdpPort, std::size_t maxPacketSize);
 
 	/** Performs the initial handshake with the server and receives the one-time data */
 	bool connectToServer(const char* serverIp);
@@ -115,7 +123,8 @@ private:
 	bool loadAssets(const ClientTmpResources& resources,
 		/* out */ std::vector<ModelInfo>& newModels,
 		/* out */ std::vector<Material>& newMaterials,
-		/* out */ std::vector<StringId>& newTextures);
+		/* out */ std::vector<StringId>& newTextures,
+		/* out */ std::vector<StringId>& refinedTextures);
 
 	void prepareReceivedGeomHashset();
 	/** Creates the buffers that will stay alive until cleanup */
@@ -132,8 +141,11 @@ private:
 	void applyUpdateRequests();
 	void recreateResources(const std::vector<ModelInfo>& newModels,
 		const std::vector<Material>& newMaterials,
-		const std::vector<StringId>& newTextures);
+		const std::vector<StringId>& newTextures,
+		const std::vector<StringId>& refinedTextures);
 	void regenMaterials(const std::vector<StringId>& newTextures);
+	/** Shows the new mip levels of `refinedTextures`, updating the descriptor sets of the materials using them */
+	void refineMaterials(const std::vector<StringId>& refinedTextures);
 
 	void calcTimeStats(FPSCounter& fps, std::chrono::time_point<std::chrono::high_resolution_clock>& beginTime);
 
@@ -148,6 +160,8 @@ private:
 	void updateObjectsUniformBuffer();
 	void updateViewUniformBuffer();
 	void updateLightsUniformBuffer();
+	/** Chooses the level of detail of each model and writes the draw commands accordingly */
+	void updateDrawCommands();
 
 	void recordAllCommandBuffers();
 
@@ -8,6 +8,7 @@ using namespace logging;
 
 bool gUseCamera = true;
 bool gLimitFrameTime = true;
+bool gUseLods = true;
 
 int main(int argc, char** argv)
 {
@@ -54,8 +55,12 @@ int main(int argc, char** argv)
 			case 'n':
 				gColoredLogs = false;
 				break;
+			case 'l':
+				gUseLods = false;
+				break;
 			default:
-				std::cout << "Usage: " << argv[0] << " [-c (use camera)] [-n (no colored logs)]\n";
+				std::cout << "Usage: " << argv[0]
+					  << " [-c (use camera)] [-n (no colored logs)] [-l (no LODs)]\n";
 				break;
 			}
 		} else {
@@ -29,6 +29,8 @@ public:
 	StackAllocator allocator;
 
 	std::unordered_map<StringId, shared::Texture> textures;
+	/** Mip levels refining textures received before (in the order they were received) */
+	std::vector<shared::TextureMip> textureMips;
 	std::unordered_map<StringId, shared::SpirvShader> shaders;
 	std::vector<shared::Material> materials;
 	std::vector<ModelInfo> models;
@@ -44,6 +46,7 @@ public:
 	{
 		allocator.deallocAll();
 		textures.clear();
+		textureMips.clear();
 		shaders.clear();
 		materials.clear();
 		models.clear();
@@ -7,31 +7,94 @@
 #include "xplatform.hpp"
 #include <array>
 #include <cstddef>
+#include <cstring>
 
 using namespace logging;
 
-bool tcp_performHandshake(socket_t socket)
+bool tcp_performHandshake(socket_t socket, uint16_t& serverUdpPort, std::size_t& maxPacketSize)
 {
-	// send HELO message
-	if (!sendTCPMsg(socket, TcpMsgType::HELO))
+	// Send HELO message, telling the biggest UDP packet we can receive
+#pragma pack(push, 1)
+	struct {
+		TcpMsgType type;
+		uint16_t payload;
+	} msg;
+#pragma pack(pop)
+	msg.type = TcpMsgType::HELO;
+	msg.payload = static_cast<uint16_t>(cfg::MAX_UDP_PACKET_SIZE_BYTES);
+
+	if (!sendPacket(socket, reinterpret_cast<uint8_t*>(&msg), sizeof(msg)))
+		return false;
+
+	// HELO_ACK carries the port the server expects our UDP messages on and the max size of its packets
+	std::array<uint8_t, 1 + 2 * sizeof(uint16_t)> buffer;
+	if (!expectTCPMsg(socket, buffer.data(), buffer.size(), TcpMsgType::HELO_ACK))
 		return false;
 
-	uint8_t buffer;
-	return expectTCPMsg(socket, &buffer, 1, TcpMsgType::HELO_ACK);
+	uint16_t packetSize;
+	memcpy(&serverUdpPort, buffer.data() + 1, sizeof(uint16_t));
+	memcpy(&packetSize, buffer.data() + 1 + sizeof(uint16_t), sizeof(uint16_t));
+	if (packetSize < cfg::PACKET_SIZE_BYTES || packetSize > cfg::MAX_UDP_PACKET_SIZE_BYTES) {
+		err("Server sent an invalid max packet size: ", packetSize);
+		return false;
+	}
+	maxPacketSize = packetSize;
+
+	return true;
 }
 
-bool tcp_sendReadyAndWait(socket_t socket)
+bool tcp_sendReadyAndWait(socket_t socket, uint16_t clientUdpPort)
 {
-	if (!sendTCPMsg(socket, TcpMsgType::READY))
+	// Tell the server where to send UDP data
+#pragma pack(push, 1)
+	struct {
+		TcpMsgType type;
+		uint16_t payload;
+	} msg;
+#pragma pack(pop)
+	msg.type = TcpMsgType::READY;
+	msg.payload = clientUdpPort;
+
+	if (!sendPacket(socket, reinterpret_cast<uint8_t*>(&msg), sizeof(msg)))
 		return false;
 
 	uint8_t buf;
 	return expectTCPMsg(socket, &buf, 1, TcpMsgType::READY);
 }
 
-bool tcp_sendRsrcExchangeAck(socket_t socket)
+bool tcp_sendRsrcExchangeAck(socket_t socket, uint16_t nResources)
 {
-	return sendTCPMsg(socket, TcpMsgType::RSRC_EXCHANGE_ACK);
+#pragma pack(push, 1)
+	struct {
+		TcpMsgType type;
+		uint16_t payload;
+	} msg;
+#pragma pack(pop)
+	msg.type = TcpMsgType::RSRC_EXCHANGE_ACK;
+	msg.payload = nResources;
+
+	return sendPacket(socket, reinterpret_cast<uint8_t*>(&msg), sizeof(msg));
+}
+
+/** @return the size of the header of the resource messages of type `type`, or 1 for header-only messages */
+static std::size_t headerSize(TcpMsgType type)
+{
+	switch (type) {
+	case TcpMsgType::RSRC_TYPE_TEXTURE:
+		return sizeof(ResourcePacket<shared::TextureInfo>);
+	case TcpMsgType::RSRC_TYPE_MATERIAL:
+		return sizeof(ResourcePacket<shared::Material>);
+	case TcpMsgType::RSRC_TYPE_MODEL:
+		return sizeof(ResourcePacket<shared::Model>);
+	case TcpMsgType::RSRC_TYPE_POINT_LIGHT:
+		return sizeof(ResourcePacket<shared::PointLightInfo>);
+	case TcpMsgType::RSRC_TYPE_SHADER:
+		return sizeof(ResourcePacket<shared::SpirvShaderInfo>);
+	case TcpMsgType::RSRC_TYPE_TEXTURE_MIP:
+		return sizeof(ResourcePacket<shared::TextureMipInfo>);
+	default:
+		return 1;
+	}
 }
 
 ////////////////////
@@ -119,12 +182,17 @@ void TcpMsgThread::performResourceExchange()
 {
 	// If previous resources were there, clear them unless the client hasn't
 	// retreived them yet.
-	std::lock_guard<std::mutex> lock{ resourcesMtx };
+	std::unique_lock<std::mutex> lock{ resourcesMtx };
+
+	// Give the client the chance to retreive them first: exchanges may follow each other closely
+	// (e.g. while refining textures) and it would otherwise hardly find the resources unlocked.
+	while (resourcesAvailable && ep.connected)
+		resourcesRetreived.wait_for(lock, std::chrono::milliseconds{ 100 });
 
 	if (!resourcesAvailable)
 		resources.clear();
 
-	sendTCPMsg(ep.socket, TcpMsgType::RSRC_EXCHANGE_ACK);
+	tcp_sendRsrcExchangeAck(ep.socket, 0);
 
 	if (receiveOneTimeData()) {
 		resourcesAvailable = true;
@@ -143,20 +211,30 @@ void TcpMsgThread::releaseResources()
 {
 	resourcesAvailable = false;
 	resourcesMtx.unlock();
+	resourcesRetreived.notify_one();
 }
 
 bool TcpMsgThread::receiveOneTimeData()
 {
 	std::array<uint8_t, cfg::PACKET_SIZE_BYTES> buffer;
+	// The server doesn't wait for us to ACK each resource: we ACK them all together at the end.
+	uint16_t nReceived = 0;
 
 	// Receive data
 	while (ep.connected) {
-		auto incomingDataType = TcpMsgType::UNKNOWN;
-
-		if (!receiveTCPMsg(ep.socket, buffer.data(), buffer.size(), incomingDataType)) {
+		// Resources come back to back: read exactly their header, not to eat into the next one.
+		if (!receiveBulk(ep.socket, buffer.data(), 1)) {
 			err("Error receiving data packet.");
 			return false;
 		}
+		const auto incomingDataType = byte2tcpmsg(buffer[0]);
+		const auto hdrSize = headerSize(incomingDataType);
+		if (hdrSize > 1 && !receiveBulk(ep.socket, buffer.data() + 1, hdrSize - 1)) {
+			err("Error receiving ", incomingDataType, " header.");
+			return false;
+		}
+
+		debug("<<< Received message type: ", incomingDataType);
 
 		switch (incomingDataType) {
 
@@ -164,75 +242,58 @@ bool TcpMsgThread::receiveOneTimeData()
 			return false;
 
 		case TcpMsgType::END_RSRC_EXCHANGE:
+			if (!tcp_sendRsrcExchangeAck(ep.socket, nReceived)) {
+				err("Failed to send ACK");
+				return false;
+			}
 			return true;
 
 		case TcpMsgType::RSRC_TYPE_TEXTURE:
-
-			if (!receiveTexture(ep.socket, buffer.data(), buffer.size(), resources)) {
+			if (!receiveTexture(ep.socket, buffer.data(), hdrSize, resources)) {
 				err("Failed to receive texture.");
 				return false;
 			}
+			++nReceived;
+			break;
 
-			// All green, send ACK
-			if (!sendTCPMsg(ep.socket, TcpMsgType::RSRC_EXCHANGE_ACK)) {
-				err("Failed to send ACK");
+		case TcpMsgType::RSRC_TYPE_TEXTURE_MIP:
+			if (!receiveTextureMip(ep.socket, buffer.data(), hdrSize, resources)) {
+				err("Failed to receive texture mip level.");
 				return false;
 			}
-
+			++nReceived;
 			break;
 
 		case TcpMsgType::RSRC_TYPE_MATERIAL:
-
-			if (!receiveMaterial(buffer.data(), buffer.size(), resources)) {
+			if (!receiveMaterial(buffer.data(), hdrSize, resources)) {
 				err("Failed to receive material");
 				return false;
 			}
-
-			if (!sendTCPMsg(ep.socket, TcpMsgType::RSRC_EXCHANGE_ACK)) {
-				err("Failed to send ACK");
-				return false;
-			}
-
+			++nReceived;
 			break;
 
 		case TcpMsgType::RSRC_TYPE_MODEL:
-
-			if (!receiveModel(ep.socket, buffer.data(), buffer.size(), resources)) {
+			if (!receiveModel(ep.socket, buffer.data(), hdrSize, resources)) {
 				err("Failed to receive model");
 				return false;
 			}
-
-			if (!sendTCPMsg(ep.socket, TcpMsgType::RSRC_EXCHANGE_ACK)) {
-				err("Failed to send ACK");
-				return false;
-			}
-
+			++nReceived;
 			break;
 
 		case TcpMsgType::RSRC_TYPE_POINT_LIGHT:
-			if (!receivePointLight(buffer.data(), buffer.size(), resources)) {
+			if (!receivePointLight(buffer.data(), hdrSize, resources)) {
 				err("Failed to receive point light");
 				return false;
 			}
-
-			if (!sendTCPMsg(ep.socket, TcpMsgType::RSRC_EXCHANGE_ACK)) {
-				err("Failed to send ACK");
-				return false;
-			}
-
+			++nReceived;
 			break;
 
 		case TcpMsgType::RSRC_TYPE_SHADER:
-			if (!receiveShader(ep.socket, buffer.data(), buffer.size(), resources)) {
+			if (!receiveShader(ep.socket, buffer.data(), hdrSize, resources)) {
 				err("Failed to receive shader");
 				return false;
 			}
-
-			if (!sendTCPMsg(ep.socket, TcpMsgType::RSRC_EXCHANGE_ACK)) {
-				err("Failed to send ACK");
-				return false;
-			}
-
+			++nReceived;
 			break;
 
 		default:
@@ -7,10 +7,15 @@
 #include <mutex>
 #include <thread>
 
-bool tcp_performHandshake(socket_t sock);
+/** Performs the handshake with the server, retreiving the port of the server's UDP passive endpoint
+ *  and the max size of the UDP packets it will send us.
+ */
+bool tcp_performHandshake(socket_t sock, uint16_t& serverUdpPort, std::size_t& maxPacketSize);
 bool tcp_expectStartResourceExchange(socket_t sock);
-bool tcp_sendRsrcExchangeAck(socket_t sock);
-bool tcp_sendReadyAndWait(socket_t sock);
+/** Acknowledges the current resource exchange, telling the server how many resources we received in it. */
+bool tcp_sendRsrcExchangeAck(socket_t sock, uint16_t nResources);
+/** Sends READY (telling the server our UDP passive port) and waits for the server's READY. */
+bool tcp_sendReadyAndWait(socket_t sock, uint16_t clientUdpPort);
 
 class KeepaliveThread {
 	std::thread thread;
@@ -38,6 +43,8 @@ public:
 	ClientTmpResources resources;
 	std::mutex resourcesMtx;
 	bool resourcesAvailable = false;
+	/** Notified when the resources are retreived, so a new exchange can start */
+	std::condition_variable resourcesRetreived;
 
 	explicit TcpMsgThread(Endpoint& ep);
 	~TcpMsgThread();
@@ -1,6 +1,8 @@
 #include "client_udp.hpp"
+#include "ack_codec.hpp"
 #include "camera.hpp"
 #include "config.hpp"
+#include "fec_decoder.hpp"
 #include "frame_utils.hpp"
 #include "logging.hpp"
 #include "udp_messages.hpp"
@@ -14,11 +16,15 @@
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <limits>
+#include <vector>
 
 using namespace logging;
 using namespace std::literals::chrono_literals;
 
 static constexpr auto BUFSIZE = megabytes(128);
+/** Max number of packets received with a single syscall */
+static constexpr std::size_t PACKETS_PER_BATCH = 64;
 
 void UdpPassiveThread::udpPassiveTask()
 {
@@ -26,44 +32,126 @@ void UdpPassiveThread::udpPassiveTask()
 	// [chunk0.type|chunk0.header|chunk0.payload|chunk1.type|chunk1.header|chunk1.payload|...]
 	uint32_t packetGen = 0;
 
+	// Preallocated pool which each batch of packets is received into
+	std::vector<uint8_t> packetPool(PACKETS_PER_BATCH * maxPacketSize);
+	std::array<int, PACKETS_PER_BATCH> packetSizes;
+	// Indices of the packets of the current batch which passed validation
+	std::array<std::size_t, PACKETS_PER_BATCH> validPackets;
+	// Packets rebuilt via FEC (each received packet can rebuild at most one)
+	std::vector<UdpPacket> recoveredPackets(PACKETS_PER_BATCH);
+	FecDecoder fec{ maxPacketSize };
+	std::size_t totRecovered = 0;
+
 	// Receive datagrams and copy them into `buffer`.
 	while (ep.connected) {
-		std::array<uint8_t, cfg::PACKET_SIZE_BYTES> packetBuf = {};
-
-		if (!receivePacket(ep.socket, packetBuf.data(), packetBuf.size()))
+		const auto nPackets = receivePackets(
+			ep.socket, packetPool.data(), maxPacketSize, PACKETS_PER_BATCH, packetSizes.data());
+		if (nPackets == 0)
 			continue;
 
-		if (!validateUDPPacket(packetBuf.data(), packetGen))
-			continue;
+		// Validate the whole batch in one pass
+		std::size_t nValid = 0;
+		std::size_t nRecovered = 0;
+		std::size_t batchSize = 0;
+		unsigned nOld = 0;
+		for (std::size_t i = 0; i < nPackets; ++i) {
+			if (packetSizes[i] < static_cast<int>(sizeof(UdpHeader)))
+				continue;
 
-		const auto packet = reinterpret_cast<const UdpPacket*>(packetBuf.data());
-		packetGen = packet->header.packetGen;
+			const auto packet = reinterpret_cast<const UdpPacket*>(packetPool.data() + i * maxPacketSize);
+			const auto headerSize = udpHeaderSize(packet->header);
+			if (packetSizes[i] < static_cast<int>(headerSize))
+				continue;
 
-		const auto size = packet->header.size;
-		if (size > packet->payload.size()) {
-			err("Packet size is ", size, " > ", packet->payload.size(), "!");
-			continue;
+			// MTU probes are never FEC-protected, so the first byte of their payload is the chunk type
+			if (packet->header.flags == 0 && packet->header.size > 0 &&
+				byte2udpmsg(packet->payload[0]) == UdpMsgType::MTU_PROBE) {
+				replyToMtuProbe(*packet, packetSizes[i]);
+				continue;
+			}
+			if (packet->header.packetGen < packetGen) {
+				++nOld;
+				continue;
+			}
+			packetGen = packet->header.packetGen;
+
+			// Parity packets carry no chunks: they're only used to rebuild lost packets
+			if (!FecDecoder::isParity(*packet)) {
+				const auto size = packet->header.size;
+				if (size > packetSizes[i] - headerSize) {
+					err("Packet size is ", size, " > ", packetSizes[i] - headerSize, "!");
+					continue;
+				}
+
+				validPackets[nValid++] = i;
+				batchSize += size;
+			}
+
+			if (fec.addPacket(*packet, packetSizes[i], recoveredPackets[nRecovered])) {
+				batchSize += recoveredPackets[nRecovered].header.size;
+				++nRecovered;
+			}
+		}
+
+		if (nOld > 0)
+			verbose("Dropped ", nOld, " old packets");
+
+		if (nRecovered > 0) {
+			totRecovered += nRecovered;
+			verbose("Rebuilt ", nRecovered, " packets via FEC (", totRecovered, " total)");
 		}
 
-		// Just copy all the payload into `buffer` and let the main thread process it.
+		if (nValid == 0 && nRecovered == 0)
+			continue;
+
+		// Just copy all the payloads into `buffer` and let the main thread process them.
 		{
 			std::lock_guard<std::mutex> lock{ bufMtx };
 
-			if (usedBufSize + size >= BUFSIZE) {
+			if (usedBufSize + batchSize >= BUFSIZE) {
+				// Drop this batch: lost geometry will be resent as it's not ACKed, while
+				// other updates will be superseded by newer ones.
 				warn("Warning: buffer is being filled faster than it's consumed! Some data is being lost!");
-				usedBufSize = 0;
 				continue;
 			}
 
-			// Write packet data
-			memcpy(buffer + usedBufSize, packet->payload.data(), size);
-			usedBufSize += size;
+			// Write packets data
+			for (std::size_t i = 0; i < nValid; ++i) {
+				const auto packet = reinterpret_cast<const UdpPacket*>(
+					packetPool.data() + validPackets[i] * maxPacketSize);
+				memcpy(buffer + usedBufSize, udpChunks(*packet), packet->header.size);
+				usedBufSize += packet->header.size;
+			}
+			for (std::size_t i = 0; i < nRecovered; ++i) {
+				const auto& packet = recoveredPackets[i];
+				memcpy(buffer + usedBufSize, packet.payload.data(), packet.header.size);
+				usedBufSize += packet.header.size;
+			}
 		}
 	}
 }
 
-UdpPassiveThread::UdpPassiveThread(Endpoint& ep)
+void UdpPassiveThread::replyToMtuProbe(const UdpPacket& packet, std::size_t packetSize)
+{
+	if (packetSize < sizeof(UdpHeader) + sizeof(UdpMsgType) + sizeof(MtuProbeHeader))
+		return;
+
+	MtuProbeHeader probe;
+	memcpy(&probe, packet.payload.data() + sizeof(UdpMsgType), sizeof(MtuProbeHeader));
+	// A probe bigger than our buffer gets truncated: it must not be ACKed.
+	if (probe.probeSize != packetSize)
+		return;
+
+	MtuProbeAckPacket ack;
+	ack.msgType = UdpMsgType::MTU_PROBE_ACK;
+	ack.probeSize = probe.probeSize;
+	sendPacket(replyEp.socket, reinterpret_cast<const uint8_t*>(&ack), sizeof(MtuProbeAckPacket));
+}
+
+UdpPassiveThread::UdpPassiveThread(Endpoint& ep, Endpoint& replyEp, std::size_t maxPacketSize)
 	: ep{ ep }
+	, replyEp{ replyEp }
+	, maxPacketSize{ maxPacketSize }
 {
 	buffer = new uint8_t[BUFSIZE];
 	usedBufSize = 0;
@@ -104,34 +192,70 @@ std::size_t UdpPassiveThread::retreive(uint8_t* outBuf, std::size_t outBufSize)
 /////////////////////// Active EP
 void UdpActiveThread::udpActiveTask(Endpoint& ep)
 {
-	// Send ACKs
+	const auto cameraInterval = std::chrono::milliseconds{ cfg::CLIENT_CAMERA_SEND_INTERVAL_MS };
+	auto latestCameraSendTime = std::chrono::steady_clock::now();
+
+	// Send ACKs and camera
 	while (ep.connected) {
 		std::unique_lock<std::mutex> ulk{ acks.mtx };
 		if (acks.list.size() == 0) {
-			// Wait for ACKs to send
-			acks.cv.wait(ulk, [&]() { return !ep.connected || acks.list.size() > 0; });
+			// Wait for ACKs to send (or for the time to send the camera)
+			acks.cv.wait_for(
+				ulk, cameraInterval, [&]() { return !ep.connected || acks.list.size() > 0; });
 		}
 
-		AckPacket packet;
-		packet.msgType = UdpMsgType::ACK;
-		packet.nAcks = 0;
-
-		for (auto ack : acks.list) {
-			packet.acks[packet.nAcks] = ack;
-			packet.nAcks++;
-			if (packet.nAcks == packet.acks.size()) {
-				// Packet is full: send
-				sendPacket(ep.socket, reinterpret_cast<const uint8_t*>(&packet), sizeof(AckPacket));
-				// info("Sent ", packet.nAcks, " acks: ", listToString(acks.list));
-				packet.nAcks = 0;
+		std::vector<uint32_t> toAck;
+		toAck.swap(acks.list);
+		ulk.unlock();
+
+		if (toAck.size() > 0) {
+			// Serial ids are encoded as ranges, so sort them (and drop the ones ACKed twice)
+			std::sort(toAck.begin(), toAck.end());
+			toAck.erase(std::unique(toAck.begin(), toAck.end()), toAck.end());
+
+			std::array<uint8_t, cfg::PACKET_SIZE_BYTES> packet;
+			AckPacketHeader header;
+			header.msgType = UdpMsgType::ACK;
+
+			std::size_t nAcked = 0;
+			std::size_t bytesSent = 0;
+			while (nAcked < toAck.size()) {
+				std::size_t nRanges, nEncoded;
+				const auto payloadSize = encodeAckRanges(toAck.data() + nAcked,
+					toAck.size() - nAcked,
+					packet.data() + sizeof(AckPacketHeader),
+					packet.size() - sizeof(AckPacketHeader),
+					std::numeric_limits<decltype(header.nRanges)>::max(),
+					nRanges,
+					nEncoded);
+				header.nRanges = nRanges;
+				memcpy(packet.data(), &header, sizeof(AckPacketHeader));
+
+				sendPacket(ep.socket, packet.data(), sizeof(AckPacketHeader) + payloadSize);
+				nAcked += nEncoded;
+				bytesSent += sizeof(AckPacketHeader) + payloadSize;
 			}
-		}
-		if (packet.nAcks > 0) {
-			sendPacket(ep.socket, reinterpret_cast<const uint8_t*>(&packet), sizeof(AckPacket));
-			verbose("Sent ", packet.nAcks, " acks");
+			verbose("Sent ", nAcked, " acks (", bytesSent, " B)");
 		}
 
-		acks.list.clear();
+		const auto now = std::chrono::steady_clock::now();
+		if (now - latestCameraSendTime >= cameraInterval) {
+			CameraPacket cameraPacket;
+			cameraPacket.msgType = UdpMsgType::CAMERA;
+			bool send;
+			{
+				std::lock_guard<std::mutex> lock{ camera.mtx };
+				cameraPacket.camera = camera.pose;
+				send = camera.updated;
+				camera.updated = false;
+			}
+			if (send) {
+				sendPacket(ep.socket,
+					reinterpret_cast<const uint8_t*>(&cameraPacket),
+					sizeof(CameraPacket));
+			}
+			latestCameraSendTime = now;
+		}
 	}
 }
 
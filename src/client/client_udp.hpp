@@ -2,6 +2,7 @@
 
 #include "client_resources.hpp"
 #include "endpoint.hpp"
+#include "shared_resources.hpp"
 #include "units.hpp"
 #include "vertex.hpp"
 #include <chrono>
@@ -11,6 +12,7 @@
 
 struct Camera;
 struct PayloadHeader;
+struct UdpPacket;
 
 /** This class implements the listening thread on the client which receives
  *  geometry data from the server. It listens indefinitely on an UDP socket
@@ -21,6 +23,10 @@ class UdpPassiveThread {
 
 	std::thread thread;
 	Endpoint& ep;
+	/** Endpoint used to answer the server's MTU probes */
+	Endpoint& replyEp;
+	/** Max size of the packets we receive */
+	const std::size_t maxPacketSize;
 
 	uint8_t* buffer = nullptr;
 	std::size_t usedBufSize = 0;
@@ -29,8 +35,11 @@ class UdpPassiveThread {
 
 	void udpPassiveTask();
 
+	/** Tells the server that its MTU probe `packet`, `packetSize` bytes long, was received. */
+	void replyToMtuProbe(const UdpPacket& packet, std::size_t packetSize);
+
 public:
-	explicit UdpPassiveThread(Endpoint& ep);
+	explicit UdpPassiveThread(Endpoint& ep, Endpoint& replyEp, std::size_t maxPacketSize);
 	~UdpPassiveThread();
 
 	/* This method should be always called and verified to return true before calling `retreive`. */
@@ -58,6 +67,13 @@ public:
 		std::condition_variable cv;
 	} acks;
 
+	/** Latest camera pose, sent to the server every cfg::CLIENT_CAMERA_SEND_INTERVAL_MS */
+	struct {
+		shared::Camera pose;
+		bool updated = false;
+		std::mutex mtx;
+	} camera;
+
 	explicit UdpActiveThread(Endpoint& ep);
 	~UdpActiveThread();
 };
@@ -0,0 +1,69 @@
+#include "fec_decoder.hpp"
+#include "fec.hpp"
+#include <algorithm>
+#include <cstring>
+
+FecDecoder::FecDecoder(std::size_t maxPacketSize)
+	: groups(WINDOW)
+{
+	for (auto& group : groups)
+		group.parity.resize(maxPacketSize - udpHeaderSize(true));
+}
+
+bool FecDecoder::addPacket(const UdpPacket& packet, std::size_t packetSize, UdpPacket& recovered)
+{
+	const auto& header = packet.header;
+	const auto fecHeader = udpFecHeader(packet);
+	if (!fecHeader || fecHeader->groupSize == 0 || fecHeader->groupSize > cfg::MAX_FEC_GROUP_SIZE ||
+		fecHeader->index > fecHeader->groupSize)
+		return false;
+
+	auto& group = groups[fecHeader->groupId % WINDOW];
+	if (group.id != fecHeader->groupId) {
+		// Packet from an older group than the one in this slot: too late to be useful
+		if (group.id > fecHeader->groupId)
+			return false;
+
+		group.id = fecHeader->groupId;
+		group.size = fecHeader->groupSize;
+		group.done = false;
+		group.received.reset();
+		group.sizeXor = 0;
+		std::fill(group.parity.begin(), group.parity.end(), 0);
+	}
+
+	if (group.done || group.received[fecHeader->index] || group.size != fecHeader->groupSize)
+		return false;
+
+	const bool parity = isParity(packet);
+	const auto payloadSize = parity ? packetSize - udpHeaderSize(header) : header.size;
+	if (payloadSize > group.parity.size())
+		return false;
+
+	group.received[fecHeader->index] = true;
+	group.sizeXor ^= header.size;
+	xorBytes(group.parity.data(), udpChunks(packet), payloadSize);
+	if (parity)
+		group.packetGen = header.packetGen;
+
+	const auto nReceived = group.received.count();
+	if (nReceived < group.size)
+		return false;
+
+	group.done = true;
+	if (nReceived > group.size || !group.received[group.size]) {
+		// Got all the data packets: nothing to rebuild
+		return false;
+	}
+
+	// Only one data packet is missing, and the parity now contains its payload
+	if (group.sizeXor > recovered.payload.size())
+		return false;
+
+	recovered.header = {};
+	recovered.header.packetGen = group.packetGen;
+	recovered.header.size = group.sizeXor;
+	memcpy(recovered.payload.data(), group.parity.data(), group.sizeXor);
+
+	return true;
+}
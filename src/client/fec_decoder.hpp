@@ -0,0 +1,49 @@
+#pragma once
+
+#include "config.hpp"
+#include "udp_messages.hpp"
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/** Rebuilds packets lost from FEC-protected groups (see fec.hpp).
+ *  Only the latest WINDOW groups are tracked: packets of older groups are ignored.
+ */
+class FecDecoder {
+public:
+	static constexpr std::size_t WINDOW = 32;
+
+	/** Constructs a FecDecoder for packets up to `maxPacketSize` bytes long */
+	explicit FecDecoder(std::size_t maxPacketSize);
+
+	/** Feeds a received packet of `packetSize` bytes (headers included) to the decoder.
+	 *  The packet must be either a parity packet or a valid data packet.
+	 *  Packets without the FEC header extension are ignored.
+	 *  @return true if the packet allowed to rebuild a lost data packet, which is written into `recovered`
+	 *  (without header extensions).
+	 */
+	bool addPacket(const UdpPacket& packet, std::size_t packetSize, /* out */ UdpPacket& recovered);
+
+	/** @return whether `packet` is a FEC parity packet */
+	static bool isParity(const UdpPacket& packet)
+	{
+		const auto fecHeader = udpFecHeader(packet);
+		return fecHeader && fecHeader->groupSize > 0 && fecHeader->index == fecHeader->groupSize;
+	}
+
+private:
+	struct Group {
+		uint32_t id = 0;
+		uint8_t size = 0;
+		/** Whether the group was either rebuilt or received entirely */
+		bool done = false;
+		std::bitset<cfg::MAX_FEC_GROUP_SIZE + 1> received;
+		uint32_t packetGen = 0;
+		uint32_t sizeXor = 0;
+		/** XOR of the payloads received so far */
+		std::vector<uint8_t> parity;
+	};
+
+	std::vector<Group> groups;
+};
@@ -5,7 +5,9 @@
 #include "models.hpp"
 #include "utils.hpp"
 #include "vertex.hpp"
+#include "vulk_errors.hpp"
 #include <algorithm>
+#include <cstring>
 
 using namespace logging;
 
@@ -17,7 +19,7 @@ static std::pair<VkDeviceSize, VkDeviceSize> getFirstFreePos(const Geometry& geo
 	VkDeviceSize vFirst = 0;
 	VkDeviceSize iFirst = 0;
 
-	for (auto loc : geometry.locations) {
+	for (const auto& loc : geometry.locations) {
 		if (loc.second.vertexOff >= vFirst)
 			vFirst = loc.second.vertexOff + loc.second.vertexLen;
 		if (loc.second.indexOff >= iFirst)
@@ -46,15 +48,26 @@ static VkDeviceSize getNewSize(const Geometry& geometry, VkDeviceSize firstFreeP
 	return newSize;
 }
 
+/** @returns the first free byte of drawBuffer of `geometry`. */
+static VkDeviceSize getFirstFreeDrawPos(const Geometry& geometry)
+{
+	VkDeviceSize first = 0;
+	for (const auto& loc : geometry.locations)
+		first = std::max(first, loc.second.drawOff + loc.second.drawLen);
+	return first;
+}
+
 static void updateLocations(Geometry& geometry,
 	VkDeviceSize vFirst,
 	VkDeviceSize iFirst,
+	VkDeviceSize dFirst,
 	const std::vector<ModelInfo>& newModels)
 {
 	VkDeviceSize nextOff = vFirst;
 	for (const auto& model : newModels) {
 		geometry.locations[model.name].vertexOff = nextOff;
 		geometry.locations[model.name].vertexLen = model.nVertices * sizeof(Vertex);
+		geometry.locations[model.name].bounds = model.bounds;
 		nextOff += model.nVertices * sizeof(Vertex);
 	}
 	nextOff = iFirst;
@@ -63,6 +76,45 @@ static void updateLocations(Geometry& geometry,
 		geometry.locations[model.name].indexLen = model.nIndices * sizeof(Index);
 		nextOff += model.nIndices * sizeof(Index);
 	}
+	nextOff = dFirst;
+	for (const auto& model : newModels) {
+		auto& loc = geometry.locations[model.name];
+		loc.drawOff = nextOff;
+		loc.drawLen = model.meshes.size() * sizeof(VkDrawIndexedIndirectCommand);
+		nextOff += loc.drawLen;
+
+		loc.lods = model.lods;
+		loc.lodMissing.resize(model.lods.size());
+		for (unsigned i = 0; i < model.lods.size(); ++i)
+			loc.lodMissing[i] = model.lods[i].nVertices + model.lods[i].nIndices;
+	}
+}
+
+/** Makes sure the draw buffer of `geometry` has room for `size` bytes.
+ *  Its content is not preserved, since the draw commands are rewritten every frame anyway.
+ */
+static void reserveDrawBuffer(const Application& app, Geometry& geometry, VkDeviceSize size)
+{
+	if (size <= geometry.drawBuffer.size)
+		return;
+
+	auto newSize = std::max<VkDeviceSize>(geometry.drawBuffer.size, sizeof(VkDrawIndexedIndirectCommand));
+	while (newSize < size)
+		newSize *= 2;
+
+	info("reallocating draw buffer (size = ", newSize, " B)");
+
+	// Wait for the old buffer to not be used anymore
+	VLKCHECK(vkQueueWaitIdle(app.queues.graphics));
+	unmapBuffersMemory(app.device, { geometry.drawBuffer });
+	destroyBuffer(app.device, geometry.drawBuffer);
+
+	geometry.drawBuffer = createBuffer(app,
+		newSize,
+		VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	mapBuffersMemory(app.device, { &geometry.drawBuffer });
+	memset(geometry.drawBuffer.ptr, 0, geometry.drawBuffer.size);
 }
 
 static void copyDataToNewBuffers(const Application& app, Buffer oldV, Buffer oldI, Buffer newV, Buffer newI)
@@ -110,9 +162,12 @@ void updateGeometryBuffers(const Application& app, Geometry& geometry, const std
 	}
 
 	const auto freePos = getFirstFreePos(geometry);
+	const auto freeDrawPos = getFirstFreeDrawPos(geometry);
 
 	// Insert the new locations
-	updateLocations(geometry, freePos.first, freePos.second, newModels);
+	updateLocations(geometry, freePos.first, freePos.second, freeDrawPos, newModels);
+
+	reserveDrawBuffer(app, geometry, getFirstFreeDrawPos(geometry));
 
 	info("new locations: ", mapToString(geometry.locations, [](auto l) -> std::string {
 		std::stringstream ss;
@@ -168,3 +223,30 @@ void updateGeometryBuffers(const Application& app, Geometry& geometry, const std
 		});
 }
 
+void markGeometryReceived(Geometry& geometry, StringId modelId, bool isIndex, uint32_t start, uint32_t len)
+{
+	auto it = geometry.locations.find(modelId);
+	if (it == geometry.locations.end())
+		return;
+
+	auto& loc = it->second;
+	for (unsigned i = 0; i < loc.lods.size(); ++i) {
+		const auto& lod = loc.lods[i];
+		const auto first = isIndex ? lod.firstIndex : lod.firstVertex;
+		const auto end = first + (isIndex ? lod.nIndices : lod.nVertices);
+		// The server never puts two levels in the same chunk, but don't count on it
+		const auto overlapStart = std::max(first, start);
+		const auto overlapEnd = std::min(end, start + len);
+		if (overlapStart < overlapEnd)
+			loc.lodMissing[i] -= std::min(loc.lodMissing[i], overlapEnd - overlapStart);
+	}
+}
+
+bool isLodComplete(const Geometry::Location& loc, unsigned lod)
+{
+	for (auto i = lod; i < loc.lodMissing.size(); ++i) {
+		if (loc.lodMissing[i] > 0)
+			return false;
+	}
+	return true;
+}
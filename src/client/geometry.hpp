@@ -2,6 +2,8 @@
 
 #include "buffers.hpp"
 #include "hashing.hpp"
+#include "quantized_vertex.hpp"
+#include "shared_resources.hpp"
 #include <unordered_map>
 #include <vector>
 #include <vulkan/vulkan.h>
@@ -16,12 +18,26 @@ struct Geometry {
 	/** Single buffer containing all indices for all models */
 	Buffer indexBuffer;
 
+	/** Single host-visible buffer containing the indirect draw commands of all models' meshes.
+	 *  They're rewritten every frame to draw each model at the chosen level of detail.
+	 */
+	Buffer drawBuffer;
+
 	/** Offsets in byte of the first vertex/index inside the buffers for each model */
 	struct Location {
 		VkDeviceSize vertexOff;
 		VkDeviceSize vertexLen;
 		VkDeviceSize indexOff;
 		VkDeviceSize indexLen;
+		/** Offset in byte of the model's first draw command (one per mesh) inside drawBuffer */
+		VkDeviceSize drawOff;
+		VkDeviceSize drawLen;
+		/** Bounding box of the model's positions, needed to decode its quantized vertices */
+		QuantizationBounds bounds;
+		/** Levels of detail of the model, finest first */
+		std::vector<shared::ModelLod> lods;
+		/** Vertices plus indices of each level of detail we didn't receive yet */
+		std::vector<uint32_t> lodMissing;
 	};
 
 	/** Maps modelName => location into buffers */
@@ -33,3 +49,13 @@ struct Geometry {
  *  Locations of already present models are unchanged by this operation.
  */
 void updateGeometryBuffers(const Application& app, Geometry& geometry, const std::vector<ModelInfo>& models);
+
+/** Records that the `len` vertices (or indices, if `isIndex`) of model `modelId` starting from `start` were
+ *  received, to keep track of which levels of detail are complete.
+ */
+void markGeometryReceived(Geometry& geometry, StringId modelId, bool isIndex, uint32_t start, uint32_t len);
+
+/** @return whether the level of detail `lod` of the model at `loc` can be drawn, i.e. whether we received
+ *  all of its data and the data of the coarser levels.
+ */
+bool isLodComplete(const Geometry::Location& loc, unsigned lod);
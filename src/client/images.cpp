@@ -18,7 +18,8 @@ void ImageAllocator::addImage(Image& image,
 	VkImageUsageFlags usage,
 	VkMemoryPropertyFlags properties,
 	VkImageCreateFlags flags,
-	uint32_t arrayLayers)
+	uint32_t arrayLayers,
+	uint32_t mipLevels)
 {
 	VkImageCreateInfo imageInfo = {};
 	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -26,7 +27,7 @@ void ImageAllocator::addImage(Image& image,
 	imageInfo.extent.width = width;
 	imageInfo.extent.height = height;
 	imageInfo.extent.depth = 1;
-	imageInfo.mipLevels = 1;
+	imageInfo.mipLevels = mipLevels;
 	imageInfo.arrayLayers = arrayLayers;
 	imageInfo.format = format;
 	imageInfo.tiling = tiling;
@@ -40,6 +41,7 @@ void ImageAllocator::addImage(Image& image,
 	this->properties.emplace_back(properties);
 
 	image.format = format;
+	image.mipLevels = mipLevels;
 	images.emplace_back(&image);
 }
 
@@ -154,7 +156,12 @@ Image createImage(const Application& app,
 	return image;
 }
 
-VkImageView createImageView(const Application& app, VkImage image, VkFormat format, VkImageAspectFlags aspectFlags)
+VkImageView createImageView(const Application& app,
+	VkImage image,
+	VkFormat format,
+	VkImageAspectFlags aspectFlags,
+	uint32_t mipLevels,
+	uint32_t baseMipLevel)
 {
 	VkImageViewCreateInfo createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -162,8 +169,8 @@ VkImageView createImageView(const Application& app, VkImage image, VkFormat form
 	createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
 	createInfo.format = format;
 	createInfo.subresourceRange.aspectMask = aspectFlags;
-	createInfo.subresourceRange.baseMipLevel = 0;
-	createInfo.subresourceRange.levelCount = 1;
+	createInfo.subresourceRange.baseMipLevel = baseMipLevel;
+	createInfo.subresourceRange.levelCount = mipLevels - baseMipLevel;
 	createInfo.subresourceRange.baseArrayLayer = 0;
 	createInfo.subresourceRange.layerCount = 1;
 
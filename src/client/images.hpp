@@ -12,6 +12,9 @@ struct Image {
 	VkDeviceSize offset;   // offset into underlying device memory
 	VkImageView view = VK_NULL_HANDLE;
 	VkFormat format;
+	uint32_t mipLevels = 1;
+	/** The most detailed mip level which has content (and is shown by `view`) */
+	uint32_t baseMipLevel = 0;
 };
 
 /** Use this class to allocate a bunch of images at once.
@@ -33,13 +36,20 @@ public:
 		VkImageUsageFlags usage,
 		VkMemoryPropertyFlags properties,
 		VkImageCreateFlags flags = 0,
-		uint32_t arrayLayers = 1);
+		uint32_t arrayLayers = 1,
+		uint32_t mipLevels = 1);
 
 	/** Creates the scheduled buffers and allocates their memory. */
 	void create(const Application& app);
 };
 
-VkImageView createImageView(const Application& app, VkImage image, VkFormat format, VkImageAspectFlags aspectFlags);
+/** Creates a view of the mip levels of `image` from `baseMipLevel` to `mipLevels - 1` */
+VkImageView createImageView(const Application& app,
+	VkImage image,
+	VkFormat format,
+	VkImageAspectFlags aspectFlags,
+	uint32_t mipLevels = 1,
+	uint32_t baseMipLevel = 0);
 VkImageView createImageCubeView(const Application& app, VkImage image, VkFormat format, VkImageAspectFlags aspectFlags);
 
 /** Creates a new image. The returned Image will NOT have a view attached.
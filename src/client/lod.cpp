@@ -0,0 +1,69 @@
+#include "lod.hpp"
+#include "camera.hpp"
+#include "config.hpp"
+#include "models.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+unsigned chooseLod(const Geometry::Location& loc,
+	const glm::mat4& modelMat,
+	const Camera& camera,
+	float viewportHeight)
+{
+	if (loc.lods.size() <= 1)
+		return 0;
+
+	// Distance from the camera to the model's bounding sphere
+	const auto center = glm::vec3{ modelMat * glm::vec4{ loc.bounds.min + loc.bounds.extent * 0.5f, 1.f } };
+	const auto scale = std::max(glm::length(glm::vec3{ modelMat[0] }),
+		std::max(glm::length(glm::vec3{ modelMat[1] }), glm::length(glm::vec3{ modelMat[2] })));
+	const auto radius = glm::length(loc.bounds.extent) * 0.5f * scale;
+	const auto dist = glm::length(center - camera.position) - radius;
+
+	// Pixels spanned by a segment of unit length, facing the camera at unit distance
+	const auto pixelsPerUnit =
+		viewportHeight / (2.f * std::tan(glm::radians(cfg::CAMERA_FOV_Y_DEGREES) * 0.5f));
+
+	unsigned lod = 0;
+	if (dist > 0) {
+		// The error grows with the level: find the coarsest one which still looks the same as the full detail
+		for (auto i = static_cast<unsigned>(loc.lods.size()) - 1; i > 0; --i) {
+			if (loc.lods[i].error * scale / dist * pixelsPerUnit <= cfg::CLIENT_LOD_MAX_ERROR_PIXELS) {
+				lod = i;
+				break;
+			}
+		}
+	}
+
+	// The coarser levels arrive first: fall back to them until this one is complete. If none is complete
+	// yet, we draw the coarsest one while it streams in.
+	while (lod + 1 < loc.lods.size() && !isLodComplete(loc, lod))
+		++lod;
+
+	return lod;
+}
+
+uint32_t writeDrawCommands(const Geometry& geometry, const ModelInfo& model, unsigned lod)
+{
+	const auto it = geometry.locations.find(model.name);
+	assert(it != geometry.locations.end());
+	const auto& loc = it->second;
+
+	const auto& meshes = lod == 0 || lod > model.lodMeshes.size() ? model.meshes : model.lodMeshes[lod - 1];
+	assert(meshes.size() * sizeof(VkDrawIndexedIndirectCommand) == loc.drawLen);
+
+	auto cmds = reinterpret_cast<VkDrawIndexedIndirectCommand*>(
+		reinterpret_cast<uint8_t*>(geometry.drawBuffer.ptr) + loc.drawOff);
+	uint32_t nTriangles = 0;
+	for (unsigned i = 0; i < meshes.size(); ++i) {
+		cmds[i].indexCount = meshes[i].len;
+		cmds[i].instanceCount = 1;
+		cmds[i].firstIndex = meshes[i].offset;
+		cmds[i].vertexOffset = 0;
+		cmds[i].firstInstance = 0;
+		nTriangles += meshes[i].len / 3;
+	}
+
+	return nTriangles;
+}
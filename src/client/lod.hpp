@@ -0,0 +1,23 @@
+#pragma once
+
+#include "geometry.hpp"
+#include <cstdint>
+#include <glm/glm.hpp>
+
+struct Camera;
+struct ModelInfo;
+
+/** @return the level of detail to draw the model at `loc` with, when it has transform `modelMat` and is seen
+ *  from `camera` through a viewport `viewportHeight` pixels high.
+ *  That's the coarsest level whose error is at most cfg::CLIENT_LOD_MAX_ERROR_PIXELS on screen or, while that
+ *  level is still being received, the finest complete one.
+ */
+unsigned chooseLod(const Geometry::Location& loc,
+	const glm::mat4& modelMat,
+	const Camera& camera,
+	float viewportHeight);
+
+/** Writes the draw commands of `model`'s meshes at level of detail `lod` into `geometry.drawBuffer`.
+ *  @return the number of triangles they draw.
+ */
+uint32_t writeDrawCommands(const Geometry& geometry, const ModelInfo& model, unsigned lod);
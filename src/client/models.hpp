@@ -1,13 +1,21 @@
 #pragma once
 
 #include "hashing.hpp"
+#include "quantized_vertex.hpp"
 #include "shared_resources.hpp"
 #include <vector>
 
 struct ModelInfo {
 	std::vector<StringId> materials;
+	/** Meshes of the full detail level */
 	std::vector<shared::Mesh> meshes;
+	/** Meshes of the coarser levels of detail: lodMeshes[i - 1] holds those of level i, same order as `meshes` */
+	std::vector<std::vector<shared::Mesh>> lodMeshes;
+	/** Levels of detail, finest first */
+	std::vector<shared::ModelLod> lods;
 	StringId name;
 	uint32_t nVertices;
 	uint32_t nIndices;
+	/** Needed to decode quantized vertices */
+	QuantizationBounds bounds;
 };
@@ -62,7 +62,9 @@ inline static void recordDrawModels(const Application& app,
 			1,
 			&dynOff);
 
-		for (const auto& mesh : model.meshes) {
+		// Draw each mesh indirectly, so its level of detail can be changed without recording the commands again
+		for (unsigned i = 0; i < model.meshes.size(); ++i) {
+			const auto& mesh = model.meshes[i];
 			const auto& matName = mesh.materialId >= 0 ? model.materials[mesh.materialId] : SID_NONE;
 
 			// Bind material descriptor set
@@ -75,7 +77,11 @@ inline static void recordDrawModels(const Application& app,
 				0,
 				nullptr);
 
-			vkCmdDrawIndexed(cmdBuf, mesh.len, 1, mesh.offset, 0, 0);
+			vkCmdDrawIndexedIndirect(cmdBuf,
+				geometry.drawBuffer.handle,
+				loc_it->second.drawOff + i * sizeof(VkDrawIndexedIndirectCommand),
+				1,
+				sizeof(VkDrawIndexedIndirectCommand));
 		}
 	}
 }
@@ -490,6 +496,40 @@ std::vector<VkDescriptorSet> createMultipassPermanentDescriptorSets(const Applic
 	return descriptorSets;
 }
 
+/** Appends to `descriptorWrites` the writes of the textures of each of `materials` into `descriptorSets[i]`.
+ *  `imageInfos` must hold 3 elements per material, and outlive the writes.
+ */
+static void writeMaterialDescriptors(const std::vector<Material>& materials,
+	const VkDescriptorSet* descriptorSets,
+	VkSampler texSampler,
+	std::vector<VkDescriptorImageInfo>& imageInfos,
+	std::vector<VkWriteDescriptorSet>& descriptorWrites)
+{
+	assert(imageInfos.size() >= 3 * materials.size());
+
+	for (unsigned i = 0; i < materials.size(); ++i) {
+		// Bindings 0, 1 and 2 are the diffuse, specular and normal textures
+		const VkImageView views[] = { materials[i].diffuse, materials[i].specular, materials[i].normal };
+		for (unsigned binding = 0; binding < 3; ++binding) {
+			auto& imageInfo = imageInfos[3 * i + binding];
+			imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			imageInfo.sampler = texSampler;
+			imageInfo.imageView = views[binding];
+
+			VkWriteDescriptorSet descriptorWrite = {};
+			descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptorWrite.dstSet = descriptorSets[i];
+			descriptorWrite.dstBinding = binding;
+			descriptorWrite.dstArrayElement = 0;
+			descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			descriptorWrite.descriptorCount = 1;
+			descriptorWrite.pImageInfo = &imageInfo;
+
+			descriptorWrites.emplace_back(descriptorWrite);
+		}
+	}
+}
+
 std::vector<VkDescriptorSet> createMultipassTransitoryDescriptorSets(const Application& app,
 	const BufferArray& uniformBuffers,
 	const std::vector<Material>& materials,
@@ -524,62 +564,8 @@ std::vector<VkDescriptorSet> createMultipassTransitoryDescriptorSets(const Appli
 	descriptorWrites.reserve(layouts.size());
 
 	//// Sets #0-#materials.size()+1: material resources
-	std::vector<VkDescriptorImageInfo> diffuseInfos(materials.size());
-	std::vector<VkDescriptorImageInfo> specularInfos(materials.size());
-	std::vector<VkDescriptorImageInfo> normalInfos(materials.size());
-
-	for (unsigned i = 0; i < materials.size(); ++i) {
-		{
-			diffuseInfos[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			diffuseInfos[i].sampler = texSampler;
-			diffuseInfos[i].imageView = materials[i].diffuse;
-
-			VkWriteDescriptorSet descriptorWrite = {};
-			descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			descriptorWrite.dstSet = descriptorSets[i];
-			descriptorWrite.dstBinding = 0;
-			descriptorWrite.dstArrayElement = 0;
-			descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-			descriptorWrite.descriptorCount = 1;
-			descriptorWrite.pImageInfo = &diffuseInfos[i];
-
-			descriptorWrites.emplace_back(descriptorWrite);
-		}
-
-		{
-			specularInfos[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			specularInfos[i].sampler = texSampler;
-			specularInfos[i].imageView = materials[i].specular;
-
-			VkWriteDescriptorSet descriptorWrite = {};
-			descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			descriptorWrite.dstSet = descriptorSets[i];
-			descriptorWrite.dstBinding = 1;
-			descriptorWrite.dstArrayElement = 0;
-			descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-			descriptorWrite.descriptorCount = 1;
-			descriptorWrite.pImageInfo = &specularInfos[i];
-
-			descriptorWrites.emplace_back(descriptorWrite);
-		}
-
-		{
-			normalInfos[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			normalInfos[i].sampler = texSampler;
-			normalInfos[i].imageView = materials[i].normal;
-
-			VkWriteDescriptorSet descriptorWrite = {};
-			descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			descriptorWrite.dstSet = descriptorSets[i];
-			descriptorWrite.dstBinding = 2;
-			descriptorWrite.dstArrayElement = 0;
-			descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-			descriptorWrite.descriptorCount = 1;
-			descriptorWrite.pImageInfo = &normalInfos[i];
-
-			descriptorWrites.emplace_back(descriptorWrite);
-		}
-	}
+	std::vector<VkDescriptorImageInfo> imageInfos(3 * materials.size());
+	writeMaterialDescriptors(materials, descriptorSets.data(), texSampler, imageInfos, descriptorWrites);
 
 	//// Sets #materials.size() - ...: object resources
 	for (unsigned i = 0; i < models.size(); ++i) {
@@ -609,6 +595,22 @@ std::vector<VkDescriptorSet> createMultipassTransitoryDescriptorSets(const Appli
 	return descriptorSets;
 }
 
+void updateMultipassMaterialDescriptorSets(const Application& app,
+	const std::vector<Material>& materials,
+	VkSampler texSampler)
+{
+	std::vector<VkDescriptorSet> descriptorSets(materials.size());
+	for (unsigned i = 0; i < materials.size(); ++i)
+		descriptorSets[i] = app.res.descriptorSets->get(materials[i].name);
+
+	std::vector<VkWriteDescriptorSet> descriptorWrites;
+	descriptorWrites.reserve(3 * materials.size());
+	std::vector<VkDescriptorImageInfo> imageInfos(3 * materials.size());
+	writeMaterialDescriptors(materials, descriptorSets.data(), texSampler, imageInfos, descriptorWrites);
+
+	vkUpdateDescriptorSets(app.device, descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
+}
+
 // Skybox
 /*{
 	VkDescriptorImageInfo skyboxInfo = {};
@@ -37,3 +37,10 @@ std::vector<VkDescriptorSet> createMultipassTransitoryDescriptorSets(const Appli
 	const std::vector<Material>& materials,
 	const std::vector<ModelInfo>& models,
 	VkSampler texSampler);
+
+/** Updates in place the descriptor sets of `materials` (created by createMultipassTransitoryDescriptorSets)
+ *  with their current textures. The descriptor sets must not be in use by the device.
+ */
+void updateMultipassMaterialDescriptorSets(const Application& app,
+	const std::vector<Material>& materials,
+	VkSampler texSampler);
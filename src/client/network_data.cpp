@@ -2,13 +2,16 @@
 #include "client_resources.hpp"
 #include "client_udp.hpp"
 #include "geometry.hpp"
+#include "index_codec.hpp"
 #include "logging.hpp"
+#include "quantized_transform.hpp"
 #include "shared_resources.hpp"
 #include "udp_messages.hpp"
 #include "utils.hpp"
 #include "vertex.hpp"
 #include <algorithm>
 #include <cassert>
+#include <cstring>
 
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/string_cast.hpp>
@@ -39,19 +42,47 @@ static std::size_t readGeomUpdateChunk(const uint8_t* ptr,
 	req.type = UpdateReq::Type::GEOM;
 	req.data.geom.serialId = header->serialId;
 	req.data.geom.modelId = header->modelId;
+	req.data.geom.dataType = header->dataType;
+	req.data.geom.start = header->start;
+	req.data.geom.len = header->len;
 
+	// Size of each element in our buffers, and in the chunk (which may be different if the data is encoded)
 	std::size_t dataSize = 0;
+	std::size_t wireDataSize = 0;
+	// Only used by variable-sized chunks
+	std::size_t payloadSize = 0;
 	switch (header->dataType) {
 	case GeomDataType::VERTEX:
 		dataSize = sizeof(Vertex);
+		wireDataSize = sizeof(Vertex);
+		req.data.geom.src = ptr + sizeof(GeomUpdateHeader);
+		req.data.geom.dst = geometry.vertexBuffer.ptr;
+		break;
+	case GeomDataType::VERTEX_QUANTIZED:
+		dataSize = sizeof(Vertex);
+		wireDataSize = sizeof(QuantizedVertex);
 		req.data.geom.src = ptr + sizeof(GeomUpdateHeader);
 		req.data.geom.dst = geometry.vertexBuffer.ptr;
 		break;
 	case GeomDataType::INDEX:
 		dataSize = sizeof(Index);
+		wireDataSize = sizeof(Index);
 		req.data.geom.src = ptr + sizeof(GeomUpdateHeader);
 		req.data.geom.dst = geometry.indexBuffer.ptr;
 		break;
+	case GeomDataType::INDEX_COMPRESSED: {
+		if (maxBytesToRead < sizeof(GeomUpdateHeader) + sizeof(uint16_t)) {
+			err("Buffer given to readGeomUpdateChunk has not enough room for a compressed index payload!");
+			return maxBytesToRead;
+		}
+		uint16_t size;
+		memcpy(&size, ptr + sizeof(GeomUpdateHeader), sizeof(uint16_t));
+		dataSize = sizeof(Index);
+		payloadSize = sizeof(uint16_t) + size;
+		req.data.geom.src = ptr + sizeof(GeomUpdateHeader) + sizeof(uint16_t);
+		req.data.geom.srcSize = size;
+		req.data.geom.dst = geometry.indexBuffer.ptr;
+	} break;
 	default:
 		err("Invalid data type ", int(header->dataType), " in GeomUpdate Chunk!");
 		return maxBytesToRead;
@@ -59,7 +90,12 @@ static std::size_t readGeomUpdateChunk(const uint8_t* ptr,
 
 	assert(dataSize != 0);
 
-	const auto chunkSize = sizeof(GeomUpdateHeader) + dataSize * header->len;
+	if (wireDataSize != 0) {
+		payloadSize = wireDataSize * header->len;
+		req.data.geom.srcSize = payloadSize;
+	}
+
+	const auto chunkSize = sizeof(GeomUpdateHeader) + payloadSize;
 
 	if (req.data.geom.dst == nullptr) {
 		warn("Received geom update for unknown model ", header->modelId);
@@ -74,6 +110,9 @@ static std::size_t readGeomUpdateChunk(const uint8_t* ptr,
 	}
 	if (serialsToIgnore.has(header->serialId, header->serialId) != 0) {
 		// warn("Already read chunk ", header->serialId);
+		// The server resent it, so our ACK was probably lost: ACK it again without applying it.
+		req.data.geom.dst = nullptr;
+		updateReqs.emplace_back(req);
 		return chunkSize;
 	}
 
@@ -89,19 +128,19 @@ static std::size_t readGeomUpdateChunk(const uint8_t* ptr,
 	}
 
 	auto& loc = it->second;
+	const bool isVertex =
+		header->dataType == GeomDataType::VERTEX || header->dataType == GeomDataType::VERTEX_QUANTIZED;
+	req.data.geom.bounds = loc.bounds;
 	// Use the correct offset into the vertex/index buffer
-	const auto baseOffset = header->dataType == GeomDataType::VERTEX ? loc.vertexOff : loc.indexOff;
+	const auto baseOffset = isVertex ? loc.vertexOff : loc.indexOff;
 	req.data.geom.dst = reinterpret_cast<uint8_t*>(req.data.geom.dst) + baseOffset;
 	req.data.geom.dst = reinterpret_cast<uint8_t*>(req.data.geom.dst) + header->start * dataSize;
 
 	{   // Ensure we don't write past the buffers area
 		const auto ptrStart = reinterpret_cast<uintptr_t>(req.data.geom.dst);
-		const auto actualPtrStart = reinterpret_cast<uintptr_t>(header->dataType == GeomDataType::VERTEX
-										? geometry.vertexBuffer.ptr
-										: geometry.indexBuffer.ptr);
-		const auto ptrLen =
-			actualPtrStart + (header->dataType == GeomDataType::VERTEX ? geometry.vertexBuffer.size
-										   : geometry.indexBuffer.size);
+		const auto actualPtrStart =
+			reinterpret_cast<uintptr_t>(isVertex ? geometry.vertexBuffer.ptr : geometry.indexBuffer.ptr);
+		const auto ptrLen = actualPtrStart + (isVertex ? geometry.vertexBuffer.size : geometry.indexBuffer.size);
 		verbose("writing at offset ", std::hex, ptrStart, " / ", actualPtrStart, " / ", ptrLen);
 		assert(actualPtrStart <= ptrStart && ptrStart <= ptrLen - dataSize * header->len);
 	}
@@ -159,9 +198,9 @@ static std::size_t
 static std::size_t
 	readTransformUpdateChunk(const uint8_t* ptr, std::size_t maxBytesToRead, std::vector<UpdateReq>& updateReqs)
 {
-	if (maxBytesToRead < sizeof(TransformUpdateHeader)) {
+	if (maxBytesToRead <= sizeof(TransformUpdateHeader)) {
 		err("Buffer given to readTransformUpdateChunk has not enough room for a Header + Payload! ",
-			"(needed: ",
+			"(needed: more than ",
 			sizeof(TransformUpdateHeader),
 			", got: ",
 			maxBytesToRead,
@@ -169,19 +208,24 @@ static std::size_t
 		return maxBytesToRead;
 	}
 
-	//// Read header (which is the entire chunk)
+	//// Read header
 	const auto header = reinterpret_cast<const TransformUpdateHeader*>(ptr);
-	const auto chunkSize = sizeof(TransformUpdateHeader);
-
-	if (chunkSize > maxBytesToRead) {
-		err("readTransformUpdateChunk would read past the allowed memory area!");
-		return maxBytesToRead;
-	}
 
 	UpdateReq req;
 	req.type = UpdateReq::Type::TRANSFORM;
 	req.data.transform.objectId = header->objectId;
-	req.data.transform.transform = header->transform;
+
+	//// Read payload
+	const auto payloadSize = decodeTransform(ptr + sizeof(TransformUpdateHeader),
+		maxBytesToRead - sizeof(TransformUpdateHeader),
+		req.data.transform.position,
+		req.data.transform.rotation,
+		req.data.transform.scale);
+	if (payloadSize == 0) {
+		err("readTransformUpdateChunk would read past the allowed memory area!");
+		return maxBytesToRead;
+	}
+	const auto chunkSize = sizeof(TransformUpdateHeader) + payloadSize;
 
 	assert(req.type == UpdateReq::Type::TRANSFORM);
 	assert(req.data.transform.objectId != SID_NONE);
@@ -277,7 +321,26 @@ void updateModel(const UpdateReqGeom& req)
 		")");
 
 	// Do the actual update
-	memcpy(req.dst, req.src, req.nBytes);
+	switch (req.dataType) {
+	case GeomDataType::VERTEX_QUANTIZED:
+		dequantizeVertices(reinterpret_cast<const QuantizedVertex*>(req.src),
+			req.nBytes / sizeof(Vertex),
+			req.bounds,
+			reinterpret_cast<Vertex*>(req.dst));
+		break;
+	case GeomDataType::INDEX_COMPRESSED: {
+		// Decode straight into the index buffer
+		const auto bytesRead = decodeIndices(reinterpret_cast<const uint8_t*>(req.src),
+			req.srcSize,
+			req.nBytes / sizeof(Index),
+			reinterpret_cast<Index*>(req.dst));
+		if (bytesRead != req.srcSize)
+			err("Failed to decode indices of chunk ", req.serialId);
+	} break;
+	default:
+		memcpy(req.dst, req.src, req.nBytes);
+		break;
+	}
 }
 
 void updatePointLight(const UpdateReqPointLight& req, NetworkResources& netRsrc)
@@ -307,5 +370,10 @@ void updateTransform(const UpdateReqTransform& req, ObjectTransforms& transforms
 	}
 
 	//// Update the transform
-	it->second = req.transform;
+	Transform transform;
+	transform.position = req.position;
+	transform.rotation = req.rotation;
+	transform.scale = req.scale;
+	transform._update();
+	it->second = transform.getMatrix();
 }
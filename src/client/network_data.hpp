@@ -3,9 +3,12 @@
 #include "cf_hashset.hpp"
 #include "client_resources.hpp"
 #include "hashing.hpp"
+#include "quantized_vertex.hpp"
+#include "udp_messages.hpp"
 #include <cstddef>
 #include <cstdint>
 #include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
 #include <vector>
 
 class UdpPassiveThread;
@@ -18,9 +21,23 @@ struct UpdateReqGeom {
 	/** Not strictly needed, but useful to keep here */
 	StringId modelId;
 
+	/** Format of the data at `src` */
+	GeomDataType dataType;
+
+	/** First vertex/index updated and their amount */
+	uint32_t start;
+	uint32_t len;
+
 	const void* src;
+	/** Null if the update was already applied and must only be ACKed */
 	void* dst;
+	/** Amount of bytes to read from `src` */
+	std::size_t srcSize;
+	/** Amount of bytes to write to `dst` */
 	std::size_t nBytes;
+
+	/** Only used by VERTEX_QUANTIZED updates */
+	QuantizationBounds bounds;
 };
 
 struct UpdateReqPointLight {
@@ -31,7 +48,9 @@ struct UpdateReqPointLight {
 
 struct UpdateReqTransform {
 	StringId objectId;
-	glm::mat4 transform;
+	glm::vec3 position;
+	glm::quat rotation;
+	glm::vec3 scale;
 };
 
 struct UpdateReq {
@@ -78,7 +78,8 @@ bool isDeviceSuitable(VkPhysicalDevice physDevice, VkSurfaceKHR surface)
 	VkPhysicalDeviceFeatures supportedFeatures;
 	vkGetPhysicalDeviceFeatures(physDevice, &supportedFeatures);
 
-	return indices.isComplete() && extensionsSupported && swapChainAdequate && supportedFeatures.samplerAnisotropy;
+	return indices.isComplete() && extensionsSupported && swapChainAdequate &&
+	       supportedFeatures.samplerAnisotropy && supportedFeatures.textureCompressionBC;
 }
 
 bool checkDeviceExtensionSupport(VkPhysicalDevice physDevice)
@@ -18,7 +18,7 @@ bool receiveTexture(socket_t socket,
 	// Parse header
 
 	const auto header = *reinterpret_cast<const ResourcePacket<shared::TextureInfo>*>(buffer);
-	constexpr auto sizeOfHeader = sizeof(ResourcePacket<shared::TextureInfo>);
+	assert(bufsize >= sizeof(ResourcePacket<shared::TextureInfo>));
 	const auto expectedSize = header.res.size;
 
 	if (expectedSize > cfg::MAX_TEXTURE_SIZE) {
@@ -37,30 +37,10 @@ bool receiveTexture(socket_t socket,
 	if (!texdata)
 		return false;
 
-	// Copy the first texture data embedded in the header packet into the texture memory area
-	auto len = std::min(bufsize - sizeOfHeader, expectedSize);
-	memcpy(texdata, buffer + sizeOfHeader, len);
-
-	// Receive remaining texture data as raw data packets (if needed)
-	auto processedSize = len;
-	while (processedSize < expectedSize) {
-		const auto remainingSize = expectedSize - processedSize;
-		assert(remainingSize > 0);
-
-		len = std::min(remainingSize, bufsize);
-
-		int bytesRead;
-		// Receive the data directly into the texture memory area (avoids a memcpy from the buffer)
-		if (!receivePacket(socket, reinterpret_cast<uint8_t*>(texdata) + processedSize, len, &bytesRead)) {
-			resources.allocator.deallocLatest();
-			return false;
-		}
-
-		processedSize += bytesRead;
-	}
-
-	if (processedSize != expectedSize) {
-		warn("Processed more bytes than expected!");
+	// Receive the texture data directly into the texture memory area
+	if (!receiveBulk(socket, reinterpret_cast<uint8_t*>(texdata), expectedSize)) {
+		resources.allocator.deallocLatest();
+		return false;
 	}
 
 	shared::Texture texture;
@@ -83,6 +63,43 @@ bool receiveTexture(socket_t socket,
 	return true;
 }
 
+bool receiveTextureMip(socket_t socket,
+	const uint8_t* buffer,
+	std::size_t bufsize,
+	/* out */ ClientTmpResources& resources)
+{
+	assert(bufsize >= sizeof(ResourcePacket<shared::TextureMipInfo>));
+	const auto header = *reinterpret_cast<const ResourcePacket<shared::TextureMipInfo>*>(buffer);
+
+	if (header.res.size > cfg::MAX_TEXTURE_SIZE) {
+		err("Texture mip level server sent is too big! (", header.res.size / 1024 / 1024., " MiB)");
+		return false;
+	}
+
+	void* mipdata = resources.allocator.alloc(header.res.size);
+	if (!mipdata)
+		return false;
+
+	// Receive the level's data directly into its memory area
+	if (!receiveBulk(socket, reinterpret_cast<uint8_t*>(mipdata), header.res.size)) {
+		resources.allocator.deallocLatest();
+		return false;
+	}
+
+	shared::TextureMip mip;
+	mip.name = header.res.name;
+	mip.level = header.res.level;
+	mip.width = header.res.width;
+	mip.height = header.res.height;
+	mip.size = header.res.size;
+	mip.data = mipdata;
+	resources.textureMips.emplace_back(mip);
+
+	info("Received mip level ", mip.level, " of texture ", mip.name, ": ", mip.size, " B");
+
+	return true;
+}
+
 bool receiveMaterial(const uint8_t* buffer,
 	std::size_t bufsize,
 	/* out */ ClientTmpResources& resources)
@@ -125,59 +142,52 @@ bool receiveModel(socket_t socket,
 
 	// Parse header
 	const auto header = *reinterpret_cast<const ResourcePacket<shared::Model>*>(buffer);
-	constexpr auto sizeOfHeader = sizeof(ResourcePacket<shared::Model>);
-	const auto expectedSize = header.res.nMaterials * sizeof(StringId) + header.res.nMeshes * sizeof(shared::Mesh);
+	if (header.res.nLods == 0) {
+		err("Model server sent has no levels of detail!");
+		return false;
+	}
+	const auto lodMeshSize = header.res.nMeshes * sizeof(shared::Mesh);
+	const auto expectedSize = header.res.nMaterials * sizeof(StringId) + header.res.nLods * lodMeshSize +
+				  header.res.nLods * sizeof(shared::ModelLod);
 
 	if (expectedSize > cfg::MAX_MODEL_INFO_SIZE) {
 		err("Model server sent is too big! (", expectedSize / 1024 / 1024., " MiB)");
 		return false;
 	}
 
-	// Retreive payload [materials | meshes]
+	// Retreive payload [materials | meshes | lods]
 
 	void* payload = resources.allocator.alloc(expectedSize);
 	if (!payload)
 		return false;
 
-	// Copy the first texture data embedded in the header packet into the texture memory area
-	auto len = std::min(bufsize - sizeOfHeader, expectedSize);
-	memcpy(payload, buffer + sizeOfHeader, len);
-
-	// Receive remaining model information as raw data packets (if needed)
-	auto processedSize = len;
-	while (processedSize < expectedSize) {
-		const auto remainingSize = expectedSize - processedSize;
-		assert(remainingSize > 0);
-
-		len = std::min(remainingSize, bufsize);
-
-		if (!receivePacket(socket, reinterpret_cast<uint8_t*>(payload) + processedSize, len)) {
-			resources.allocator.deallocLatest();
-			return false;
-		}
-
-		processedSize += len;
-	}
-
-	if (processedSize != expectedSize) {
-		warn("Processed more bytes than expected!");
+	if (!receiveBulk(socket, reinterpret_cast<uint8_t*>(payload), expectedSize)) {
+		resources.allocator.deallocLatest();
+		return false;
 	}
 
 	ModelInfo model;
 	model.name = header.res.name;
 	model.nVertices = header.res.nVertices;
 	model.nIndices = header.res.nIndices;
+	model.bounds.min = header.res.boundsMin;
+	model.bounds.extent = header.res.boundsExtent;
 
 	model.materials.reserve(header.res.nMaterials);
 	const auto materials = reinterpret_cast<const StringId*>(payload);
 	for (unsigned i = 0; i < header.res.nMaterials; ++i)
 		model.materials.emplace_back(materials[i]);
 
-	model.meshes.reserve(header.res.nMeshes);
 	const auto meshes = reinterpret_cast<const shared::Mesh*>(
 		reinterpret_cast<uint8_t*>(payload) + header.res.nMaterials * sizeof(StringId));
-	for (unsigned i = 0; i < header.res.nMeshes; ++i)
-		model.meshes.emplace_back(meshes[i]);
+	model.meshes.assign(meshes, meshes + header.res.nMeshes);
+	for (unsigned i = 1; i < header.res.nLods; ++i) {
+		const auto lodMeshes = meshes + i * header.res.nMeshes;
+		model.lodMeshes.emplace_back(lodMeshes, lodMeshes + header.res.nMeshes);
+	}
+
+	const auto lods = reinterpret_cast<const shared::ModelLod*>(meshes + header.res.nLods * header.res.nMeshes);
+	model.lods.assign(lods, lods + header.res.nLods);
 
 	if (std::find_if(resources.models.begin(), resources.models.end(), [name = model.name](const auto& m) {
 		    return m.name == name;
@@ -204,6 +214,20 @@ bool receiveModel(socket_t socket,
 				mesh.materialId >= 0 ? model.materials[mesh.materialId] : SID_NONE,
 				") }");
 		}
+
+		for (const auto& lod : model.lods) {
+			debug("lod { vertices = ",
+				lod.firstVertex,
+				"+",
+				lod.nVertices,
+				", indices = ",
+				lod.firstIndex,
+				"+",
+				lod.nIndices,
+				", error = ",
+				lod.error,
+				" }");
+		}
 	}
 
 	return true;
@@ -251,7 +275,7 @@ bool receiveShader(socket_t socket,
 {
 	// Parse header
 	const auto header = *reinterpret_cast<const ResourcePacket<shared::SpirvShaderInfo>*>(buffer);
-	constexpr auto sizeOfHeader = sizeof(ResourcePacket<shared::SpirvShaderInfo>);
+	assert(bufsize >= sizeof(ResourcePacket<shared::SpirvShaderInfo>));
 	const auto expectedSize = header.res.codeSizeInBytes;
 
 	if (expectedSize > cfg::MAX_SHADER_SIZE) {
@@ -270,30 +294,10 @@ bool receiveShader(socket_t socket,
 	if (!shadCode)
 		return false;
 
-	// Copy the first shader data embedded in the header packet into the shader memory area
-	auto len = std::min(bufsize - sizeOfHeader, expectedSize);
-	memcpy(shadCode, buffer + sizeOfHeader, len);
-
-	// Receive remaining shader data as raw data packets (if needed)
-	auto processedSize = len;
-	while (processedSize < expectedSize) {
-		const auto remainingSize = expectedSize - processedSize;
-		assert(remainingSize > 0);
-
-		len = std::min(remainingSize, bufsize);
-
-		int bytesRead;
-		// Receive the data directly into the shader memory area (avoids a memcpy from the buffer)
-		if (!receivePacket(socket, reinterpret_cast<uint8_t*>(shadCode) + processedSize, len, &bytesRead)) {
-			resources.allocator.deallocLatest();
-			return false;
-		}
-
-		processedSize += bytesRead;
-	}
-
-	if (processedSize != expectedSize) {
-		warn("Processed more bytes than expected!");
+	// Receive the shader code directly into the shader memory area
+	if (!receiveBulk(socket, reinterpret_cast<uint8_t*>(shadCode), expectedSize)) {
+		resources.allocator.deallocLatest();
+		return false;
 	}
 
 	shared::SpirvShader shader;
@@ -4,8 +4,7 @@
 
 class ClientTmpResources;
 
-/** Reads header data from `buffer` and starts reading a texture. If more packets
- *  need to be read for the texture, receive them from `socket` until completion.
+/** Reads header data from `buffer`, then receives the texture data from `socket`.
  *  Texture received is stored into `resources`.
  */
 bool receiveTexture(socket_t socket,
@@ -13,13 +12,20 @@ bool receiveTexture(socket_t socket,
 	std::size_t bufsize,
 	/* out */ ClientTmpResources& resources);
 
+/** Reads header data from `buffer`, then receives the texture mip level data from `socket`.
+ *  The mip level received is stored into `resources`.
+ */
+bool receiveTextureMip(socket_t socket,
+	const uint8_t* buffer,
+	std::size_t bufsize,
+	/* out */ ClientTmpResources& resources);
+
 /** Reads a material out of `buffer` and store it in `resources` */
 bool receiveMaterial(const uint8_t* buffer,
 	std::size_t bufsize,
 	/* out */ ClientTmpResources& resources);
 
-/** Reads header data out of `buffer` and starts reading model info. If more packets
- *  need to be read for the model info, receive them from `socket` until completion.
+/** Reads header data out of `buffer`, then receives the model info from `socket`.
  *  Model received is stored into `resources`.
  */
 bool receiveModel(socket_t socket,
@@ -31,8 +37,7 @@ bool receivePointLight(const uint8_t* buffer,
 	std::size_t bufsize,
 	/* out */ ClientTmpResources& resources);
 
-/** Reads header data from `buffer` and starts reading a shader. If more packets
- *  need to be read for the shader, receive them from `socket` until completion.
+/** Reads header data from `buffer`, then receives the shader code from `socket`.
  *  Shader received is stored into `resources`.
  */
 bool receiveShader(socket_t socket,
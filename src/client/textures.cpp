@@ -19,6 +19,45 @@
 using namespace logging;
 using shared::TextureFormat;
 
+static VkFormat cookedVkFormat(CookedFormat format)
+{
+	switch (format) {
+	case CookedFormat::BC1:
+		return VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+	case CookedFormat::BC3:
+		return VK_FORMAT_BC3_UNORM_BLOCK;
+	case CookedFormat::BC4:
+		return VK_FORMAT_BC4_UNORM_BLOCK;
+	case CookedFormat::BC5:
+		return VK_FORMAT_BC5_UNORM_BLOCK;
+	default:
+		return VK_FORMAT_UNDEFINED;
+	}
+}
+
+static VkBufferImageCopy mipRegion(uint32_t mipLevel, uint32_t width, uint32_t height, VkDeviceSize bufOffset)
+{
+	VkBufferImageCopy region = {};
+	region.bufferOffset = bufOffset;
+	region.bufferRowLength = 0;
+	region.bufferImageHeight = 0;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = mipLevel;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 1;
+	region.imageOffset = { 0, 0, 0 };
+	region.imageExtent = { width, height, 1 };
+	return region;
+}
+
+std::size_t TextureLoader::reserveStaging(std::size_t size)
+{
+	// Copies from the buffer must start at a multiple of the texel (or block) size: 16 fits all our formats.
+	const auto offset = (stagingBufferOffset + 15) & ~std::size_t(15);
+	stagingBufferOffset = offset + size;
+	return offset;
+}
+
 void TextureLoader::saveImageInfo(Image& image,
 	stbi_uc* pixels,
 	int texWidth,
@@ -29,21 +68,59 @@ void TextureLoader::saveImageInfo(Image& image,
 	debug("Loaded texture with width = ", texWidth, ", height = ", texHeight, " chans = ", texChannels);
 
 	const auto imageSize =
-		static_cast<VkDeviceSize>(texWidth) * texHeight * (format == TextureFormat::RGBA ? 4 : 1);
+		static_cast<VkDeviceSize>(texWidth) * texHeight * (format == TextureFormat::GREY ? 1 : 4);
 	assert(imageSize > 0);
 
 	ImageInfo info;
-	info.format = format == TextureFormat::RGBA ? VK_FORMAT_R8G8B8A8_UNORM : VK_FORMAT_R8_UNORM;
+	info.format = format == TextureFormat::GREY ? VK_FORMAT_R8_UNORM : VK_FORMAT_R8G8B8A8_UNORM;
 	info.width = texWidth;
 	info.height = texHeight;
 	{
 		std::lock_guard<std::mutex> lock{ mtx };
 
 		// Save pixel data in the staging buffer
-		memcpy(reinterpret_cast<uint8_t*>(stagingBuffer.ptr) + stagingBufferOffset, pixels, imageSize);
+		const auto offset = reserveStaging(imageSize);
+		memcpy(reinterpret_cast<uint8_t*>(stagingBuffer.ptr) + offset, pixels, imageSize);
 		stbi_image_free(pixels);
 
-		stagingBufferOffset += imageSize;
+		info.regions.emplace_back(mipRegion(0, info.width, info.height, offset));
+		imageInfos.emplace_back(info);
+		images.emplace_back(&image);
+	}
+}
+
+void TextureLoader::saveCookedImageInfo(Image& image, const CookedTextureHeader& header, const uint8_t* data)
+{
+	debug("Loaded cooked texture with width = ",
+		header.width,
+		", height = ",
+		header.height,
+		", mips = ",
+		header.mipLevels,
+		", format = ",
+		int(header.format));
+
+	const auto dataSize = cookedDataSize(header);
+
+	ImageInfo info;
+	info.format = cookedVkFormat(header.format);
+	info.width = header.width;
+	info.height = header.height;
+	info.mipLevels = header.mipLevels;
+	info.firstLevel = header.firstLevel;
+	{
+		std::lock_guard<std::mutex> lock{ mtx };
+
+		// The mip levels are already laid out as the GPU wants them: copy them as they are
+		auto offset = reserveStaging(dataSize);
+		memcpy(reinterpret_cast<uint8_t*>(stagingBuffer.ptr) + offset, data, dataSize);
+
+		for (uint32_t i = header.firstLevel; i < header.mipLevels; ++i) {
+			const auto width = std::max(1u, header.width >> i);
+			const auto height = std::max(1u, header.height >> i);
+			info.regions.emplace_back(mipRegion(i, width, height, offset));
+			offset += cookedMipSize(header.format, width, height);
+		}
 		imageInfos.emplace_back(info);
 		images.emplace_back(&image);
 	}
@@ -56,6 +133,12 @@ bool TextureLoader::addTexture(Image& image, const shared::Texture& texture)
 	verbose("texture.data = ", texture.data);
 	dumpBytes(texture.data, texture.size, 50, LOGLV_VERBOSE);
 
+	// Textures cooked by the server need no decoding
+	if (const auto header = parseCookedTexture(texture.data, texture.size)) {
+		saveCookedImageInfo(image, *header, reinterpret_cast<const uint8_t*>(header + 1));
+		return true;
+	}
+
 	stbi_uc* pixels = nullptr;
 	measure_ms("Load Texture", LOGLV_DEBUG, [&]() {
 		pixels = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(texture.data),
@@ -63,7 +146,7 @@ bool TextureLoader::addTexture(Image& image, const shared::Texture& texture)
 			&texWidth,
 			&texHeight,
 			&texChannels,
-			texture.format == TextureFormat::RGBA ? STBI_rgb_alpha : STBI_grey);
+			texture.format == TextureFormat::GREY ? STBI_grey : STBI_rgb_alpha);
 	});
 
 	if (!pixels) {
@@ -95,7 +178,7 @@ bool TextureLoader::addTexture(Image& image, const std::string& texturePath, Tex
 			&texWidth,
 			&texHeight,
 			&texChannels,
-			format == TextureFormat::RGBA ? STBI_rgb_alpha : STBI_grey);
+			format == TextureFormat::GREY ? STBI_grey : STBI_rgb_alpha);
 	});
 
 	if (!pixels) {
@@ -117,6 +200,16 @@ std::future<bool> TextureLoader::addTextureAsync(Image& image, const std::string
 		[this, &image, texturePath, format]() { return addTexture(image, texturePath, format); });
 }
 
+void TextureLoader::addMipLevel(Image& image, const shared::TextureMip& mip)
+{
+	std::lock_guard<std::mutex> lock{ mtx };
+
+	const auto offset = reserveStaging(mip.size);
+	memcpy(reinterpret_cast<uint8_t*>(stagingBuffer.ptr) + offset, mip.data, mip.size);
+
+	mips.emplace_back(MipInfo{ &image, mipRegion(mip.level, mip.width, mip.height, offset) });
+}
+
 void TextureLoader::create(const Application& app)
 {
 	// Create the needed images
@@ -129,20 +222,21 @@ void TextureLoader::create(const Application& app)
 			info.format,
 			VK_IMAGE_TILING_OPTIMAL,
 			VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			0,
+			1,
+			info.mipLevels);
 	}
 	imgAlloc.create(app);
 
 	// Fill the images with pixel data from the staging buffer and create image views
 	VkImageSubresourceRange subresourceRange = {};
-	subresourceRange.levelCount = 1;
 	subresourceRange.layerCount = 1;
 
-	VkDeviceSize bufOffset = 0;
 	for (unsigned i = 0; i < images.size(); ++i) {
 		const auto& info = imageInfos[i];
-		const auto imageSize = info.width * info.height * (info.format == VK_FORMAT_R8G8B8A8_UNORM ? 4 : 1);
 		auto& textureImage = images[i];
+		subresourceRange.levelCount = info.mipLevels;
 
 		transitionImageLayout(app,
 			textureImage->handle,
@@ -151,8 +245,7 @@ void TextureLoader::create(const Application& app)
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 			subresourceRange);
 
-		copyBufferToImage(app, stagingBuffer, textureImage->handle, info.width, info.height, bufOffset);
-		bufOffset += imageSize;
+		copyBufferToImage(app, stagingBuffer, textureImage->handle, info.regions);
 
 		transitionImageLayout(app,
 			textureImage->handle,
@@ -161,8 +254,49 @@ void TextureLoader::create(const Application& app)
 			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
 			subresourceRange);
 
-		textureImage->view =
-			createImageView(app, textureImage->handle, textureImage->format, VK_IMAGE_ASPECT_COLOR_BIT);
+		textureImage->baseMipLevel = info.firstLevel;
+		textureImage->view = createImageView(app,
+			textureImage->handle,
+			textureImage->format,
+			VK_IMAGE_ASPECT_COLOR_BIT,
+			info.mipLevels,
+			info.firstLevel);
+	}
+
+	// Add the new mip levels to their images. The other levels may be in use meanwhile, so only touch the new one.
+	for (const auto& mip : mips) {
+		auto& textureImage = mip.image;
+		const auto level = mip.region.imageSubresource.mipLevel;
+		if (textureImage->handle == VK_NULL_HANDLE || level + 1 != textureImage->baseMipLevel) {
+			warn("Ignoring mip level ",
+				level,
+				": the image's most detailed level is ",
+				textureImage->baseMipLevel);
+			continue;
+		}
+
+		VkImageSubresourceRange mipRange = {};
+		mipRange.baseMipLevel = level;
+		mipRange.levelCount = 1;
+		mipRange.layerCount = 1;
+
+		transitionImageLayout(app,
+			textureImage->handle,
+			textureImage->format,
+			VK_IMAGE_LAYOUT_UNDEFINED,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			mipRange);
+
+		copyBufferToImage(app, stagingBuffer, textureImage->handle, { mip.region });
+
+		transitionImageLayout(app,
+			textureImage->handle,
+			textureImage->format,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			mipRange);
+
+		textureImage->baseMipLevel = level;
 	}
 }
 
@@ -182,6 +316,9 @@ VkSampler createTextureSampler(const Application& app)
 	samplerInfo.compareEnable = VK_FALSE;
 	samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
 	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+	samplerInfo.minLod = 0.f;
+	// Use all the mip levels of cooked textures
+	samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
 
 	VkSampler sampler;
 	VLKCHECK(vkCreateSampler(app.device, &samplerInfo, nullptr, &sampler));
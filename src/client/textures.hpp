@@ -1,5 +1,6 @@
 #pragma once
 
+#include "cooked_texture.hpp"
 #include "images.hpp"
 #include "shared_resources.hpp"
 #include "third_party/stb_image.h"
@@ -27,6 +28,17 @@ class TextureLoader final {
 		VkFormat format;
 		uint32_t width;
 		uint32_t height;
+		uint32_t mipLevels = 1;
+		/** The most detailed mip level received: the ones before are added later with `addMipLevel` */
+		uint32_t firstLevel = 0;
+		/** Where each mip level lies in the staging buffer */
+		std::vector<VkBufferImageCopy> regions;
+	};
+
+	/** A mip level to add to an existing image */
+	struct MipInfo {
+		Image* image;
+		VkBufferImageCopy region;
 	};
 
 	Buffer& stagingBuffer;
@@ -37,6 +49,7 @@ class TextureLoader final {
 
 	std::vector<ImageInfo> imageInfos;
 	std::vector<Image*> images;
+	std::vector<MipInfo> mips;
 
 	/** Holds the latest error message */
 	std::string latestError = "";
@@ -47,13 +60,20 @@ class TextureLoader final {
 		int texHeight,
 		int texChannels,
 		shared::TextureFormat format);
+	/** Like saveImageInfo, but for a texture cooked by the server, whose mip levels are at `data` */
+	void saveCookedImageInfo(Image& image, const CookedTextureHeader& header, const uint8_t* data);
+
+	/** Reserves `size` bytes in the staging buffer. Must be called with `mtx` locked.
+	 *  @return the offset of the reserved bytes.
+	 */
+	std::size_t reserveStaging(std::size_t size);
 
 public:
 	explicit TextureLoader(Buffer& stagingBuffer)
 		: stagingBuffer{ stagingBuffer }
 	{}
 
-	/** Load a texture from raw data pointed by `texture` */
+	/** Load a texture from raw data pointed by `texture`, which is either an encoded image or a cooked texture */
 	bool addTexture(Image& image, const shared::Texture& texture);
 	/** Load a texture from file with given format.  */
 	bool addTexture(Image& image, const std::string& texturePath, shared::TextureFormat format);
@@ -66,6 +86,12 @@ public:
 	/** @see addTextureAsync */
 	std::future<bool> addTextureAsync(Image& image, const std::string& texturePath, shared::TextureFormat format);
 
+	/** Adds the mip level `mip` to `image`, which must be a cooked texture (created by this or a previous
+	 *  TextureLoader) whose most detailed level is `mip.level + 1`. Once created, the image's `baseMipLevel`
+	 *  is updated, but its view is not.
+	 */
+	void addMipLevel(Image& image, const shared::TextureMip& mip);
+
 	void create(const Application& app);
 
 	std::string getLatestError() const
@@ -6,6 +6,7 @@
 #include "validation.hpp"
 
 extern bool gLimitFrameTime;
+extern bool gUseLods;
 
 GLFWwindow* initWindow()
 {
@@ -75,6 +76,9 @@ void cbKeyPressed(GLFWwindow* window, int key, int /*scancode*/, int action, int
 	case GLFW_KEY_T:
 		gLimitFrameTime = !gLimitFrameTime;
 		break;
+	case GLFW_KEY_L:
+		gUseLods = !gUseLods;
+		break;
 	case GLFW_KEY_KP_ADD:
 		appl->cameraCtrl->cameraSpeed += 10;
 		break;
@@ -0,0 +1,92 @@
+#include "ack_codec.hpp"
+
+static std::size_t writeVarint(uint32_t x, uint8_t* dst)
+{
+	std::size_t written = 0;
+	while (x >= 0x80) {
+		dst[written++] = static_cast<uint8_t>(x | 0x80);
+		x >>= 7;
+	}
+	dst[written++] = static_cast<uint8_t>(x);
+	return written;
+}
+
+/** @return the number of bytes read, or 0 if `src` does not contain a valid varint. */
+static std::size_t readVarint(const uint8_t* src, std::size_t srcSize, uint32_t& x)
+{
+	x = 0;
+	for (std::size_t i = 0; i < srcSize && i < 5; ++i) {
+		x |= static_cast<uint32_t>(src[i] & 0x7f) << (7 * i);
+		if ((src[i] & 0x80) == 0)
+			return i + 1;
+	}
+	return 0;
+}
+
+std::size_t encodeAckRanges(const uint32_t* serials,
+	std::size_t nSerials,
+	uint8_t* dst,
+	std::size_t dstSize,
+	std::size_t maxRanges,
+	std::size_t& nRanges,
+	std::size_t& nEncoded)
+{
+	std::size_t written = 0;
+	uint32_t prevEnd = 0;
+	nRanges = 0;
+	nEncoded = 0;
+
+	while (nEncoded < nSerials && nRanges < maxRanges && written + MAX_ENCODED_ACK_RANGE_SIZE <= dstSize) {
+		const auto start = serials[nEncoded];
+		uint32_t len = 1;
+		while (nEncoded + len < nSerials && len < MAX_ACK_RANGE_LEN && serials[nEncoded + len] == start + len)
+			++len;
+
+		written += writeVarint(start - prevEnd, dst + written);
+		written += writeVarint(len - 1, dst + written);
+
+		prevEnd = start + len;
+		nEncoded += len;
+		++nRanges;
+	}
+
+	return written;
+}
+
+std::size_t decodeAckRanges(const uint8_t* src,
+	std::size_t srcSize,
+	std::size_t nRanges,
+	std::vector<uint32_t>& serials)
+{
+	const auto oldSize = serials.size();
+	const auto fail = [&]() -> std::size_t {
+		serials.resize(oldSize);
+		return 0;
+	};
+
+	std::size_t read = 0;
+	uint64_t prevEnd = 0;
+
+	for (std::size_t i = 0; i < nRanges; ++i) {
+		uint32_t gap, lenMinusOne;
+		auto n = readVarint(src + read, srcSize - read, gap);
+		if (n == 0)
+			return fail();
+		read += n;
+		n = readVarint(src + read, srcSize - read, lenMinusOne);
+		if (n == 0)
+			return fail();
+		read += n;
+
+		const auto start = prevEnd + gap;
+		const auto len = uint64_t(lenMinusOne) + 1;
+		if (len > MAX_ACK_RANGE_LEN || start + len > uint64_t(UINT32_MAX) + 1)
+			return fail();
+
+		for (auto id = start; id < start + len; ++id)
+			serials.emplace_back(static_cast<uint32_t>(id));
+		prevEnd = start + len;
+	}
+
+	return read;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/** Compact encoding of ACKed serial ids, used by the client to ACK UDP updates.
+ *  Serial ids are sent as ranges of consecutive ids, each one written as two varints
+ *  (7 bits per byte, the highest bit tells whether more bytes follow):
+ *  [start - end of the previous range (0 for the first one)] [range length - 1]
+ *  Geometry serial ids are assigned sequentially, so they're usually ACKed in long runs.
+ */
+
+/** Upper bound to the size of an encoded range */
+constexpr std::size_t MAX_ENCODED_ACK_RANGE_SIZE = 10;
+
+/** Ranges longer than this are considered bogus by the decoder */
+constexpr uint32_t MAX_ACK_RANGE_LEN = 1 << 16;
+
+/** Encodes the first `nSerials` ids in `serials`, which must be sorted and without duplicates, as ranges
+ *  into `dst`. Stops when `dstSize` bytes are not enough for the next range, or `maxRanges` were written.
+ *  @return the number of bytes written. `nRanges` and `nEncoded` are set to the number of ranges written
+ *  and to the number of serial ids they contain.
+ */
+std::size_t encodeAckRanges(const uint32_t* serials,
+	std::size_t nSerials,
+	uint8_t* dst,
+	std::size_t dstSize,
+	std::size_t maxRanges,
+	/* out */ std::size_t& nRanges,
+	/* out */ std::size_t& nEncoded);
+
+/** Decodes `nRanges` ranges from `src`, reading at most `srcSize` bytes, and appends their ids to `serials`.
+ *  @return the number of bytes read, or 0 if `src` does not contain `nRanges` valid ranges
+ *  (in which case `serials` is left untouched).
+ */
+std::size_t decodeAckRanges(const uint8_t* src,
+	std::size_t srcSize,
+	std::size_t nRanges,
+	/* out */ std::vector<uint32_t>& serials);
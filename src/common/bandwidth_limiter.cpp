@@ -1,80 +1,106 @@
 #include "bandwidth_limiter.hpp"
-#include "endpoint.hpp"
 #include "logging.hpp"
-#include "xplatform.hpp"
-#include <cstring>
+#include <algorithm>
 #include <exception>
-#include <functional>
+#include <stdexcept>
 
 using namespace logging;
 
+static int64_t nowNs()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(BandwidthLimiter::Clock::now().time_since_epoch())
+		.count();
+}
+
+BandwidthLimiter::BandwidthLimiter()
+{
+	weights[static_cast<std::size_t>(TrafficClass::TRANSITORY)] = 0;
+	weights[static_cast<std::size_t>(TrafficClass::GEOMETRY)] = cfg::TRAFFIC_WEIGHT_GEOMETRY;
+	weights[static_cast<std::size_t>(TrafficClass::TEXTURE)] = cfg::TRAFFIC_WEIGHT_TEXTURE;
+	weights[static_cast<std::size_t>(TrafficClass::OTHER)] = cfg::TRAFFIC_WEIGHT_OTHER;
+	for (auto& next : nextDeparture)
+		next = 0;
+}
+
 void BandwidthLimiter::setSendLimit(float bytesPerSecond)
 {
 	if (bytesPerSecond < 0)
 		throw std::invalid_argument("BandwidthLimiter::setSendLimit: bytesPerSecond must be >= 0!");
 
-	std::lock_guard<std::mutex> lock{ mtx };
-	tokenRate = bytesPerSecond;
+	nsPerByte = 1e9 / std::max(bytesPerSecond, 1.f);
 }
 
-void BandwidthLimiter::start()
+void BandwidthLimiter::setWeight(TrafficClass trafficClass, float weight)
 {
-	stop();
+	if (weight <= 0)
+		throw std::invalid_argument("BandwidthLimiter::setWeight: weight must be > 0!");
+	if (trafficClass == TrafficClass::TRANSITORY)
+		throw std::invalid_argument("BandwidthLimiter::setWeight: transitory traffic has no weight!");
 
-	operating = true;
-	tokens = 0;
+	weights[static_cast<std::size_t>(trafficClass)] = weight;
+}
+
+void BandwidthLimiter::setMaxBurst(std::chrono::microseconds maxBurst)
+{
+	maxBurstNs = std::chrono::duration_cast<std::chrono::nanoseconds>(maxBurst).count();
+}
 
-	refillThread = std::thread(std::bind(&BandwidthLimiter::refillTask, std::ref(*this)));
-	xplatSetThreadName(refillThread, "BandwidthLimiter");
-	info("BandwidthLimiter: started with maxTokens = ", maxTokens, ", tokenRate = ", tokenRate);
+void BandwidthLimiter::start()
+{
+	const auto now = nowNs();
+	for (auto& next : nextDeparture)
+		next = now;
+	operating = true;
+	info("BandwidthLimiter: started with rate = ", 1e9 / nsPerByte, " B/s, max burst = ", maxBurstNs / 1000, " us");
 }
 
 void BandwidthLimiter::stop()
 {
 	operating = false;
-
-	cv.notify_all();
-
-	if (refillThread.joinable()) {
-		info("Joining refillThread...");
-		refillThread.join();
-	}
 }
 
-bool BandwidthLimiter::requestTokens(int n)
+BandwidthLimiter::Clock::time_point BandwidthLimiter::reserve(std::size_t n, TrafficClass trafficClass)
 {
+	const auto now = nowNs();
 	if (!operating)
-		return true;
-
-	std::lock_guard<std::mutex> lock{ mtx };
-
-	if (n < tokens) {
-		tokens -= n;
-		return true;
+		return Clock::time_point{ std::chrono::nanoseconds{ now } };
+
+	const auto cls = static_cast<std::size_t>(trafficClass);
+	const auto transitory = static_cast<std::size_t>(TrafficClass::TRANSITORY);
+	const auto fullRateSlot = static_cast<int64_t>(n * nsPerByte.load(std::memory_order_relaxed));
+
+	int64_t slot;
+	if (cls == transitory) {
+		// Strict priority: never wait behind the other classes, but make the queued ones yield the time we take
+		slot = fullRateSlot;
+		for (std::size_t i = 0; i < N_CLASSES; ++i) {
+			if (i == transitory)
+				continue;
+			auto next = nextDeparture[i].load(std::memory_order_relaxed);
+			while (next > now &&
+				!nextDeparture[i].compare_exchange_weak(next, next + slot, std::memory_order_relaxed)) {
+			}
+		}
+	} else {
+		// Our share of the rate depends on which other classes have sends queued. Transitory traffic
+		// is not counted, as it already pushed our timeline back.
+		const auto weight = weights[cls].load(std::memory_order_relaxed);
+		auto activeWeight = weight;
+		for (std::size_t i = 0; i < N_CLASSES; ++i) {
+			if (i != cls && i != transitory && nextDeparture[i].load(std::memory_order_relaxed) > now)
+				activeWeight += weights[i].load(std::memory_order_relaxed);
+		}
+		slot = static_cast<int64_t>(fullRateSlot * activeWeight / weight);
 	}
 
-	return false;
-}
-
-void BandwidthLimiter::refillTask()
-{
-	using namespace std::chrono;
+	const auto minDeparture = now - maxBurstNs.load(std::memory_order_relaxed);
 
-	while (operating) {
-		auto beginTime = high_resolution_clock::now();
-		{
-			std::lock_guard<std::mutex> lock{ mtx };
+	auto& timeline = nextDeparture[cls];
+	auto prev = timeline.load(std::memory_order_relaxed);
+	int64_t departure;
+	do {
+		departure = std::max(prev, minDeparture);
+	} while (!timeline.compare_exchange_weak(prev, departure + slot, std::memory_order_relaxed));
 
-			auto nTokensToRefill = static_cast<int>(tokenRate * updateInterval.count());
-			tokens = std::min(maxTokens, tokens + nTokensToRefill);
-			verbose("tokens available: ", tokens);
-		}
-		cv.notify_all();
-
-		// Sleep
-		const auto delay = high_resolution_clock::now() - beginTime;
-		std::this_thread::sleep_for(updateInterval - delay);
-	}
-	info("refillThread terminated.");
+	return Clock::time_point{ std::chrono::duration_cast<Clock::duration>(std::chrono::nanoseconds{ departure }) };
 }
-
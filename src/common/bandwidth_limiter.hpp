@@ -1,70 +1,84 @@
 #pragma once
 
 #include "config.hpp"
+#include <array>
+#include <atomic>
 #include <chrono>
-#include <condition_variable>
 #include <cstddef>
-#include <mutex>
-#include <thread>
+#include <cstdint>
+
+/** Classes of traffic sharing the bandwidth */
+enum class TrafficClass : uint8_t {
+	/** Transform and light updates: small and latency-sensitive */
+	TRANSITORY,
+	/** Geometry updates */
+	GEOMETRY,
+	/** Textures sent via TCP */
+	TEXTURE,
+	/** Everything else (control messages, model info...) */
+	OTHER,
+	COUNT
+};
 
-/** A bandwidth limiter using the token bucket algorithm.
- *  Runs in its own thread.
+/** A lock-free pacer limiting the bandwidth used by all sockets.
+ *  Every send reserves a slot on a timeline: its intended departure time is the end of the previous
+ *  reservation, and its slot lasts as long as its bytes take to be sent at the allowed rate.
+ *  Tokens are therefore computed lazily from timestamps: no refill thread is needed and sends are spread
+ *  evenly instead of being released in bursts.
+ *  An idle limiter only accumulates credit for `maxBurst`, so sends after a pause aren't delayed.
+ *  The bandwidth is shared between traffic classes according to their weights: each class has its own
+ *  timeline, running at the fraction of the rate given by its weight over the total weight of the classes
+ *  which currently have sends queued (i.e. whose timeline is ahead of the current time).
+ *  So a class sending alone gets the whole bandwidth, while backlogged classes split it by weight.
+ *  TRANSITORY traffic has strict priority instead: it's only paced against itself, at the whole rate, and
+ *  its sends push back the timelines of the classes which have sends queued by the time they take.
  */
 class BandwidthLimiter {
-	/** Guards access to the class parameters */
-	mutable std::mutex mtx;
-
-	/** Our operating thread */
-	std::thread refillThread;
-
-	void refillTask();
-
-	/** Whether we're limiting the bandwidth or not */
-	bool operating = false;
-
-	/** Interval at which refillThread updates (seconds) */
-	const std::chrono::duration<float> updateInterval{ 0.02 };
-
-	/** Token refill rate (in Hz). This is the simulated bandwidth. */
-	float tokenRate = -1;
-
-	/** Burst size (max tokens that can accumulate in the bucket) */
-	int maxTokens = 10000 * cfg::PACKET_SIZE_BYTES + 1;
-
-	/** Tokens currently in the bucket. Each token represents a byte. */
-	int tokens = 0;
-
 public:
-	std::mutex cvMtx;
-	std::condition_variable cv;
+	using Clock = std::chrono::steady_clock;
+
+	BandwidthLimiter();
 
 	/** Sets the max amount of bytes sent per second by all sockets to `limit` (cumulative).
 	 *  Only applies to sends called through endpoint functions, such as `sendPacket`.
 	 */
 	void setSendLimit(float bytesPerSecond);
 
-	// void setMaxQueueingDelay(std::chrono::duration<float> maxQueueingDelay);
+	/** Sets the weight of `trafficClass`: its guaranteed share of the bandwidth is its weight divided by
+	 *  the sum of all weights. TRANSITORY traffic has no weight, as it always goes first.
+	 */
+	void setWeight(TrafficClass trafficClass, float weight);
 
-	/** Sets the max capacity of this limiter. */
-	void setCapacity(std::size_t maxPackets);
+	/** Sets how much time worth of data can be sent back to back after an idle period. */
+	void setMaxBurst(std::chrono::microseconds maxBurst);
 
-	/** Starts the limiter in a new thread. If it was already active, it stops the previous thread. */
+	/** Starts limiting the bandwidth. */
 	void start();
 
-	/** Stops the limiter if active, and joins its thread. */
+	/** Stops limiting the bandwidth. */
 	void stop();
 
-	/** Requests `n` tokens from the bucket. If at least `n` tokens are available,
-	 *  detract them from the bucket and return `true`. Else, do nothing and return `false`.
-	 *  If this limiter is not operating, always return `true`.
+	/** Reserves `n` bytes of class `trafficClass` on the timeline.
+	 *  @return the time at which they should be sent (which may be in the past).
+	 *  If this limiter is not operating, always return the current time.
 	 */
-	bool requestTokens(int n);
-
-	int getTokens() const
-	{
-		std::lock_guard<std::mutex> lock{ mtx };
-		return tokens;
-	}
+	Clock::time_point reserve(std::size_t n, TrafficClass trafficClass = TrafficClass::OTHER);
 
 	bool isActive() const { return operating; }
+
+private:
+	/** Whether we're limiting the bandwidth or not */
+	std::atomic_bool operating{ false };
+
+	/** Time needed to send a byte (in ns). This is the inverse of the simulated bandwidth. */
+	std::atomic<double> nsPerByte{ 0 };
+
+	std::atomic<int64_t> maxBurstNs{ std::chrono::nanoseconds{ std::chrono::milliseconds{ 2 } }.count() };
+
+	static constexpr std::size_t N_CLASSES = static_cast<std::size_t>(TrafficClass::COUNT);
+
+	std::array<std::atomic<float>, N_CLASSES> weights;
+
+	/** End of the latest reservation of each class, in ns since the clock's epoch */
+	std::array<std::atomic<int64_t>, N_CLASSES> nextDeparture;
 };
@@ -20,12 +20,93 @@ constexpr auto MAX_MODEL_INFO_SIZE = megabytes(5);
 constexpr auto MAX_SHADER_SIZE = kilobytes(100);
 
 // constexpr uint32_t PACKET_MAGIC = 0x14101991;
+/** Size of the packets which are assumed to get through any path (IPv4 hosts must accept 576 bytes datagrams).
+ *  Used for TCP messages, client-to-server UDP packets and as the server-to-client UDP packet size
+ *  when no bigger one was found to work.
+ */
 constexpr std::size_t PACKET_SIZE_BYTES = 480;
+/** Upper bound to the server-to-client UDP packet size (the largest UDP payload over IPv4) */
+constexpr std::size_t MAX_UDP_PACKET_SIZE_BYTES = 65507;
+/** How long the server waits for the client to acknowledge its path MTU probes */
+constexpr int SERVER_MTU_PROBE_TIMEOUT_MS = 300;
+/** How many copies of each MTU probe are sent, as some may get lost */
+constexpr unsigned SERVER_MTU_PROBE_COPIES = 3;
 
 constexpr int UDP_SERVER_TO_CLIENT_PORT = 1234;
-constexpr int UDP_CLIENT_TO_SERVER_PORT = 1235;
 constexpr int RELIABLE_PORT = 1236;
 
+/** Relative weights of the traffic classes sharing a limited bandwidth (see BandwidthLimiter).
+ *  Transitory traffic has none, as it has strict priority over the others.
+ */
+constexpr float TRAFFIC_WEIGHT_GEOMETRY = 5;
+constexpr float TRAFFIC_WEIGHT_TEXTURE = 2;
+constexpr float TRAFFIC_WEIGHT_OTHER = 1;
+
+/** When the bandwidth is limited, packets departing within this interval are sent together */
+constexpr int PACING_GRANULARITY_US = 500;
+/** When the bandwidth is limited, bulk TCP transfers (e.g. textures) are paced in chunks of this size */
+constexpr std::size_t BULK_SEND_CHUNK_BYTES = kilobytes(64);
+
+/** Maximum number of clients the server serves concurrently */
+constexpr int SERVER_MAX_CLIENTS = 64;
+
+/** Threads importing each model (0 = one per hardware thread) */
+constexpr unsigned SERVER_MODEL_IMPORT_THREADS = 0;
+
+/** Directory (relative to the server's executable) where cooked textures are cached */
+constexpr auto SERVER_TEXTURE_CACHE_DIR = "texture_cache";
+/** Directory (relative to the server's executable) where cooked models are cached */
+constexpr auto SERVER_MODEL_CACHE_DIR = "model_cache";
+/** Cooked textures are first sent from their largest mip level no bigger than this (per side), so they can be
+ *  used quickly; their larger levels follow one by one.
+ */
+constexpr uint32_t SERVER_TEXTURE_FIRST_MIP_SIZE = 64;
+
+/** Levels of detail built for each model, counting the full detail one */
+constexpr unsigned SERVER_MESH_LODS = 4;
+/** Each level of detail has about 1 / SERVER_MESH_LOD_REDUCTION the triangles of the previous one */
+constexpr unsigned SERVER_MESH_LOD_REDUCTION = 4;
+
+/** Memory reserved by the server for each client session's bookkeeping (update lists, resources sent) */
+constexpr auto SERVER_SESSION_MEMSIZE = megabytes(8);
+/** Unchanged nodes and lights are re-sent to each client once every this many appstage ticks,
+ *  in case their latest update was lost.
+ */
+constexpr unsigned SERVER_STATE_REFRESH_TICKS = 90;
+
+/** Retransmission timeout of unACKed geometry updates before any round trip time is measured */
+constexpr int SERVER_INITIAL_RTO_MS = 500;
+/** Bounds of the retransmission timeout derived from the measured round trip time */
+constexpr int SERVER_MIN_RTO_MS = 30;
+constexpr int SERVER_MAX_RTO_MS = 4000;
+/** How often the server checks for updates whose retransmission timeout expired */
+constexpr int SERVER_RETRANSMIT_CHECK_INTERVAL_MS = 10;
+/** Max time spent sending persistent updates before checking for transitory ones again */
+constexpr int SERVER_PERSISTENT_SLICE_MS = 5;
+
+/** Congestion control parameters (see CongestionController) */
+constexpr unsigned SERVER_CC_INITIAL_WINDOW_PACKETS = 32;
+constexpr unsigned SERVER_CC_MIN_WINDOW_PACKETS = 4;
+constexpr unsigned SERVER_CC_MAX_WINDOW_PACKETS = 1 << 16;
+/** RTT assumed before the first measure */
+constexpr int SERVER_CC_INITIAL_RTT_MS = 100;
+/** The path is considered congested when the RTT exceeds minRTT * this factor + SERVER_CC_QUEUEING_MIN_DELAY_MS */
+constexpr int SERVER_CC_QUEUEING_RTT_FACTOR = 2;
+constexpr int SERVER_CC_QUEUEING_MIN_DELAY_MS = 20;
+constexpr float SERVER_CC_QUEUEING_DECREASE_FACTOR = 0.8f;
+/** Max data which can be sent back to back after an idle period, in milliseconds at the current rate */
+constexpr int SERVER_CC_MAX_BURST_MS = 5;
+
+/** Max number of data packets protected by a single FEC parity packet */
+constexpr unsigned MAX_FEC_GROUP_SIZE = 32;
+
+/** Vertical field of view of the client's camera. The server uses it to guess what the client is seeing. */
+constexpr float CAMERA_FOV_Y_DEGREES = 60.f;
+/** The client draws the coarsest level of detail of each model whose error is at most this many pixels on screen */
+constexpr float CLIENT_LOD_MAX_ERROR_PIXELS = 1.f;
+/** Interval between two camera updates sent by the client */
+constexpr int CLIENT_CAMERA_SEND_INTERVAL_MS = 100;
+
 constexpr int CLIENT_KEEPALIVE_INTERVAL_SECONDS = 50;
 constexpr int CLIENT_KEEPALIVE_MAX_ATTEMPTS = 4;
 
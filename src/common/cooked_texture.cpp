@@ -0,0 +1,32 @@
+#include "cooked_texture.hpp"
+#include <algorithm>
+
+std::size_t cookedLevelOffset(const CookedTextureHeader& header, unsigned level)
+{
+	std::size_t offset = 0;
+	for (unsigned i = header.firstLevel; i < level; ++i) {
+		offset += cookedMipSize(header.format,
+			std::max(1u, header.width >> i),
+			std::max(1u, header.height >> i));
+	}
+	return offset;
+}
+
+const CookedTextureHeader* parseCookedTexture(const void* data, std::size_t size)
+{
+	if (size < sizeof(CookedTextureHeader))
+		return nullptr;
+
+	const auto header = reinterpret_cast<const CookedTextureHeader*>(data);
+	if (header->magic != COOKED_TEXTURE_MAGIC || header->version != COOKED_TEXTURE_VERSION)
+		return nullptr;
+
+	if (header->format >= CookedFormat::UNKNOWN || header->width == 0 || header->height == 0 ||
+		header->mipLevels == 0 || header->mipLevels > 32 || header->firstLevel >= header->mipLevels)
+		return nullptr;
+
+	if (size != sizeof(CookedTextureHeader) + cookedDataSize(*header))
+		return nullptr;
+
+	return header;
+}
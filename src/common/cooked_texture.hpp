@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/** A texture cooked by the server (see server/texture_cooker.hpp): its full mip chain, already compressed
+ *  in the block format the GPU samples, so the client can copy it to the GPU as it is.
+ *  The cooked texture has the following format:
+ *  [CookedTextureHeader]
+ *  [mip level firstLevel blocks] [mip level (firstLevel + 1) blocks] ... [mip level (mipLevels - 1) blocks]
+ *  Each level is half the size of the previous one (rounded down, min 1), and its 4x4 blocks are stored
+ *  row by row. Cooked files hold all the levels (firstLevel = 0); when sent, a texture may only hold its
+ *  smallest levels, the others following one by one (see RSRC_TYPE_TEXTURE_MIP).
+ */
+
+enum class CookedFormat : uint8_t {
+	/** Opaque RGB, 8 bytes per block */
+	BC1,
+	/** RGBA, 16 bytes per block */
+	BC3,
+	/** Single channel, 8 bytes per block */
+	BC4,
+	/** Two channels (the x and y of a normal map), 16 bytes per block */
+	BC5,
+	UNKNOWN
+};
+
+constexpr uint32_t COOKED_TEXTURE_MAGIC = 0x4b4f4f43;   // "COOK"
+/** Changes whenever the cooked data changes, so old cooked textures are not used */
+constexpr uint8_t COOKED_TEXTURE_VERSION = 2;
+
+#pragma pack(push, 1)
+
+struct CookedTextureHeader {
+	uint32_t magic;
+	uint8_t version;
+	CookedFormat format;
+	uint16_t mipLevels;
+	/** The most detailed mip level present */
+	uint16_t firstLevel;
+	/** Size of mip level 0 */
+	uint32_t width;
+	uint32_t height;
+};
+
+#pragma pack(pop)
+
+/** @return the size in bytes of a 4x4 block of `format` */
+constexpr std::size_t cookedBlockSize(CookedFormat format)
+{
+	return format == CookedFormat::BC1 || format == CookedFormat::BC4 ? 8 : 16;
+}
+
+/** @return the size in bytes of a `width` x `height` mip level of `format` */
+constexpr std::size_t cookedMipSize(CookedFormat format, uint32_t width, uint32_t height)
+{
+	return ((width + 3) / 4) * ((height + 3) / 4) * cookedBlockSize(format);
+}
+
+/** @return the offset in bytes of mip level `level` from the first level present in the cooked texture `header`.
+ *  `level` must be between header.firstLevel and header.mipLevels (which gives the size of all the levels).
+ */
+std::size_t cookedLevelOffset(const CookedTextureHeader& header, unsigned level);
+
+/** @return the size in bytes of all the mip levels present in a cooked texture described by `header` */
+inline std::size_t cookedDataSize(const CookedTextureHeader& header)
+{
+	return cookedLevelOffset(header, header.mipLevels);
+}
+
+/** Checks whether the `size` bytes at `data` are a valid cooked texture.
+ *  @return its header, or nullptr if the data is not a cooked texture (e.g. it's an encoded image).
+ */
+const CookedTextureHeader* parseCookedTexture(const void* data, std::size_t size);
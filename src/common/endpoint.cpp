@@ -1,8 +1,10 @@
 #include "endpoint.hpp"
 #include "bandwidth_limiter.hpp"
+#include "config.hpp"
 #include "logging.hpp"
 #include "udp_messages.hpp"
 #include "utils.hpp"
+#include <algorithm>
 #include <chrono>
 #include <cstdlib>
 #include <cstring>
@@ -12,6 +14,7 @@
 #include <mutex>
 #include <stdexcept>
 #include <string>
+#include <thread>
 #include <utility>
 
 using namespace logging;
@@ -61,6 +64,16 @@ Endpoint startEndpoint(const char* ip, int port, Endpoint::Type type, int sockty
 		return ep;
 	}
 
+	if (port == 0) {
+		// The OS picked the port for us: retreive it so it can be communicated to the peer
+		sockaddr_in addr;
+		socklen_t addrLen = sizeof(sockaddr_in);
+		if (::getsockname(socket, reinterpret_cast<sockaddr*>(&addr), &addrLen) == 0)
+			port = ntohs(addr.sin_port);
+		else
+			warn("getsockname failed: ", xplatGetErrorString(), " (", xplatGetError(), ")");
+	}
+
 	info("Endpoint: started ",
 		(type == Endpoint::Type::PASSIVE ? "passive" : "active"),
 		" on ",
@@ -114,6 +127,45 @@ bool receivePacket(socket_t socket, uint8_t* buffer, std::size_t len, int* bytes
 	return true;
 }
 
+bool receiveBulk(socket_t socket, uint8_t* buffer, std::size_t len)
+{
+	std::size_t received = 0;
+	while (received < len) {
+		// MSG_WAITALL makes recv return only once it got all the data (unless interrupted)
+		const auto count =
+			::recv(socket, reinterpret_cast<char*>(buffer + received), len - received, MSG_WAITALL);
+		if (count < 0) {
+			err("Error receiving data: [", count, "] ", xplatGetErrorString(), " (", xplatGetError(), ")");
+			return false;
+		} else if (count == 0) {
+			warn("Received EOF");
+			return false;
+		}
+		received += count;
+	}
+
+	uberverbose("Received ", len, " bytes");
+
+	return true;
+}
+
+std::size_t receivePackets(socket_t socket,
+	uint8_t* buffer,
+	std::size_t packetSize,
+	std::size_t maxPackets,
+	int* sizes)
+{
+	const auto count = xplatReceiveBatch(socket, buffer, packetSize, maxPackets, sizes);
+	if (count < 0) {
+		err("Error receiving messages: ", xplatGetErrorString(), " (", xplatGetError(), ")");
+		return 0;
+	}
+
+	uberverbose("Received ", count, " packets");
+
+	return count;
+}
+
 bool validateUDPPacket(const uint8_t* packetBuf, uint32_t packetGen)
 {
 	const auto packet = reinterpret_cast<const UdpHeader*>(packetBuf);
@@ -140,16 +192,18 @@ static void spam()
 	latestSpam = std::chrono::system_clock::now();
 }
 
-bool sendPacket(socket_t socket, const uint8_t* data, std::size_t len)
+/** Blocks until the bandwidth limiter grants us `len` bytes */
+static void waitForTokens(std::size_t len, TrafficClass trafficClass)
 {
-	while (!gBandwidthLimiter.requestTokens(len)) {
-		std::unique_lock<std::mutex> ulk{ gBandwidthLimiter.cvMtx };
-		verbose("Waiting for BandwidthLimiter (need ", len, ", has ", gBandwidthLimiter.getTokens(), ")");
-		gBandwidthLimiter.cv.wait(ulk, [len]() {
-			return !gBandwidthLimiter.isActive() ||
-			       static_cast<std::size_t>(gBandwidthLimiter.getTokens()) >= len;
-		});
-	}
+	if (!gBandwidthLimiter.isActive())
+		return;
+
+	std::this_thread::sleep_until(gBandwidthLimiter.reserve(len, trafficClass));
+}
+
+bool sendPacket(socket_t socket, const uint8_t* data, std::size_t len, TrafficClass trafficClass)
+{
+	waitForTokens(len, trafficClass);
 
 	if (::send(socket, reinterpret_cast<const char*>(data), len, 0) < 0) {
 		if (!spamming()) {
@@ -165,6 +219,135 @@ bool sendPacket(socket_t socket, const uint8_t* data, std::size_t len)
 	return true;
 }
 
+/** Sends `len` bytes with `sendSome(offset, maxLen)`, which returns the number of bytes actually sent or < 0 on error.
+ *  While the bandwidth is limited, waits for the limiter before each chunk of cfg::BULK_SEND_CHUNK_BYTES.
+ */
+template <typename F>
+static bool sendBulkWith(std::size_t len, TrafficClass trafficClass, F sendSome)
+{
+	std::size_t sent = 0;
+	std::size_t chunkEnd = 0;
+	while (sent < len) {
+		if (sent == chunkEnd) {
+			const bool paced = gBandwidthLimiter.isActive();
+			chunkEnd = paced ? std::min(len, sent + cfg::BULK_SEND_CHUNK_BYTES) : len;
+			waitForTokens(chunkEnd - sent, trafficClass);
+		}
+
+		const auto count = sendSome(sent, chunkEnd - sent);
+		if (count <= 0) {
+			if (!spamming()) {
+				warn("could only write ",
+					sent,
+					" / ",
+					len,
+					" bytes to remote: ",
+					xplatGetErrorString(),
+					" (",
+					xplatGetError(),
+					")");
+				spam();
+			}
+			return false;
+		}
+		sent += count;
+	}
+
+	return true;
+}
+
+bool sendBulk(socket_t socket, const uint8_t* data, std::size_t len, TrafficClass trafficClass)
+{
+	return sendBulkWith(len, trafficClass, [socket, data](std::size_t offset, std::size_t maxLen) {
+		return ::send(socket, reinterpret_cast<const char*>(data + offset), maxLen, 0);
+	});
+}
+
+bool sendFileBulk(socket_t socket, std::FILE* file, std::size_t offset, std::size_t len, TrafficClass trafficClass)
+{
+	return sendBulkWith(len, trafficClass, [socket, file, offset](std::size_t sent, std::size_t maxLen) {
+		return xplatSendFile(socket, file, offset + sent, maxLen);
+	});
+}
+
+static bool sendPacketsNow(socket_t socket, const xplatIoVec* iovs, const std::size_t* iovCounts, std::size_t nPackets)
+{
+	const auto sent = xplatSendBatch(socket, iovs, iovCounts, nPackets);
+	if (sent < static_cast<int>(nPackets)) {
+		if (!spamming()) {
+			warn("could only write ",
+				std::max(sent, 0),
+				" / ",
+				nPackets,
+				" packets to remote: ",
+				xplatGetErrorString(),
+				" (",
+				xplatGetError(),
+				")");
+			spam();
+		}
+		return false;
+	}
+
+	return true;
+}
+
+bool sendPackets(socket_t socket,
+	const xplatIoVec* iovs,
+	const std::size_t* iovCounts,
+	std::size_t nPackets,
+	TrafficClass trafficClass,
+	const OnPacketsSend& onSend)
+{
+	if (nPackets == 0)
+		return true;
+
+	if (!gBandwidthLimiter.isActive()) {
+		if (onSend)
+			onSend(0, nPackets);
+		return sendPacketsNow(socket, iovs, iovCounts, nPackets);
+	}
+
+	const auto packetLen = [iovs](std::size_t firstIov, std::size_t nIovs) {
+		std::size_t len = 0;
+		for (std::size_t i = 0; i < nIovs; ++i)
+			len += iovs[firstIov + i].iov_len;
+		return len;
+	};
+
+	// Give each packet its own departure time, and send together the ones departing within the
+	// pacing granularity, so the batch is spread over the time it takes to send at the allowed rate.
+	const auto granularity = std::chrono::microseconds{ cfg::PACING_GRANULARITY_US };
+	std::size_t first = 0;
+	std::size_t firstIov = 0;
+	auto departure = gBandwidthLimiter.reserve(packetLen(0, iovCounts[0]), trafficClass);
+	while (first < nPackets) {
+		std::this_thread::sleep_until(departure);
+
+		const auto horizon = BandwidthLimiter::Clock::now() + granularity;
+		std::size_t n = 1;
+		std::size_t nIovs = iovCounts[first];
+		while (first + n < nPackets) {
+			departure = gBandwidthLimiter.reserve(packetLen(firstIov + nIovs, iovCounts[first + n]),
+				trafficClass);
+			if (departure > horizon)
+				break;
+			nIovs += iovCounts[first + n];
+			++n;
+		}
+
+		if (onSend)
+			onSend(first, n);
+		if (!sendPacketsNow(socket, iovs + firstIov, iovCounts + first, n))
+			return false;
+
+		first += n;
+		firstIov += nIovs;
+	}
+
+	return true;
+}
+
 /** Receives a message from `socket` into `buffer` and fills the `msgType` variable according to the
  *  type of message received (i.e. the message header)
  */
@@ -1,19 +1,54 @@
 #pragma once
 
+#include "bandwidth_limiter.hpp"
 #include "endpoint_xplatform.hpp"
 #include "tcp_messages.hpp"
 #include <array>
 #include <cstdint>
+#include <functional>
 #include <memory>
 #include <mutex>
 #include <thread>
 
-class BandwidthLimiter;
-
 extern BandwidthLimiter gBandwidthLimiter;
 
 // Common functions
-bool sendPacket(socket_t socket, const uint8_t* data, std::size_t len);
+bool sendPacket(socket_t socket,
+	const uint8_t* data,
+	std::size_t len,
+	TrafficClass trafficClass = TrafficClass::OTHER);
+
+/** Called right before sending packets [`first`, `first` + `n`) of a batch */
+using OnPacketsSend = std::function<void(std::size_t first, std::size_t n)>;
+
+/** Sends `nPackets` packets with as few syscalls as possible. Each packet is described by
+ *  `iovCounts[i]` consecutive memory segments of `iovs` (see `xplatSendBatch`).
+ *  Each packet is paced by the bandwidth limiter as traffic of class `trafficClass`.
+ *  If given, `onSend` is called right before each syscall, with the packets it sends.
+ *  @return true if all packets were sent.
+ */
+bool sendPackets(socket_t socket,
+	const xplatIoVec* iovs,
+	const std::size_t* iovCounts,
+	std::size_t nPackets,
+	TrafficClass trafficClass = TrafficClass::OTHER,
+	const OnPacketsSend& onSend = nullptr);
+
+/** Sends `len` bytes of `data` via the stream socket `socket`, with as few syscalls as possible.
+ *  When the bandwidth limiter is active, the data is paced in chunks of cfg::BULK_SEND_CHUNK_BYTES.
+ *  @return true if all the data was sent.
+ */
+bool sendBulk(socket_t socket,
+	const uint8_t* data,
+	std::size_t len,
+	TrafficClass trafficClass = TrafficClass::OTHER);
+
+/** Like `sendBulk`, but sends `len` bytes of `file` starting at `offset` (see `xplatSendFile`). */
+bool sendFileBulk(socket_t socket,
+	std::FILE* file,
+	std::size_t offset,
+	std::size_t len,
+	TrafficClass trafficClass = TrafficClass::OTHER);
 
 /** Receives a packet from `socket`, storing at most `len` bytes into `buffer`.
  *  Buffer must be at least `len` bytes long. That is *NOT* checked by this function.
@@ -22,6 +57,25 @@ bool sendPacket(socket_t socket, const uint8_t* data, std::size_t len);
  */
 bool receivePacket(socket_t socket, uint8_t* buffer, std::size_t len, int* bytesRead = nullptr);
 
+/** Receives exactly `len` bytes from the stream socket `socket` into `buffer`, blocking until they're all
+ *  received. Uses a single recv when possible.
+ *  @return true if all `len` bytes were received.
+ */
+bool receiveBulk(socket_t socket, uint8_t* buffer, std::size_t len);
+
+/** Receives at most `maxPackets` packets from `socket`, storing them into `buffer` at
+ *  `packetSize` bytes intervals. Blocks until at least a packet is received.
+ *  `buffer` must be at least `maxPackets * packetSize` bytes long and `sizes` at least
+ *  `maxPackets` elements long: these are *NOT* checked by this function.
+ *  `sizes` is filled with the actual number of bytes read for each packet.
+ *  @return The number of packets received (0 on error).
+ */
+std::size_t receivePackets(socket_t socket,
+	uint8_t* buffer,
+	std::size_t packetSize,
+	std::size_t maxPackets,
+	int* sizes);
+
 /** Checks whether the data contained in `packetBuf` conforms to our
  *  UDP protocol or not (i.e. has the proper header)
  */
@@ -49,5 +103,8 @@ struct Endpoint {
 	bool connected = false;
 };
 
+/** Starts a new endpoint. If `port` is 0, the OS chooses it and the actual port
+ *  is saved in the returned Endpoint.
+ */
 Endpoint startEndpoint(const char* ip, int port, Endpoint::Type type, int socktype);
 void closeEndpoint(Endpoint& ep);
@@ -1,10 +1,179 @@
 #include "endpoint_xplatform.hpp"
+#include "io_ring.hpp"
 #include "logging.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <cstring>
 #include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
 #ifndef _WIN32
 #	include <cerrno>
 #endif
+#ifdef __linux__
+#	include <sys/sendfile.h>
+#endif
+
+#ifdef __linux__
+/** Max datagrams sent or received with a single syscall */
+static constexpr std::size_t MAX_MSGS = 64;
+/** The kernel thread polling the send rings sleeps after this long without sends */
+static constexpr unsigned SQ_POLL_IDLE_MS = 100;
+/** How long we check for the sends' completions before sleeping in the kernel until they come */
+static constexpr std::chrono::microseconds COMPLETION_SPIN_TIME{ 50 };
+
+static std::atomic_bool gUseIoUring{ false };
+/** The ring owning the kernel thread which polls all the send rings. It's never used to send. */
+static std::unique_ptr<IoRing> gPollRing;
+
+/** The calling thread's ring used by xplatSendBatch, with `sock` registered as its file 0.
+ *  Note that each sending thread is expected to use a single socket for its whole life.
+ */
+static IoRing* sendRing(socket_t sock)
+{
+	thread_local std::unique_ptr<IoRing> ring;
+	thread_local socket_t registeredSock = -1;
+	if (!ring)
+		ring = std::make_unique<IoRing>(MAX_MSGS, true, SQ_POLL_IDLE_MS, gPollRing->fileDescriptor());
+	if (!ring->valid())
+		return nullptr;
+	if (registeredSock != sock) {
+		registeredSock = ring->registerFile(sock) ? sock : -1;
+		if (registeredSock != sock)
+			return nullptr;
+	}
+	return ring.get();
+}
+
+/** Waits until `n` completions are available on `ring`. Sends to a UDP socket complete almost at once, so this
+ *  first spins on the completion queue, and only enters the kernel if they take longer (or if there's a single
+ *  CPU, where spinning would just keep the polling thread from running).
+ */
+static int waitCompletions(IoRing& ring, unsigned n)
+{
+	static const bool spin = std::thread::hardware_concurrency() > 1;
+	if (spin) {
+		const auto spinEnd = std::chrono::steady_clock::now() + COMPLETION_SPIN_TIME;
+		do {
+			if (ring.completionsReady() >= n)
+				return 0;
+		} while (std::chrono::steady_clock::now() < spinEnd);
+	}
+	const auto ready = ring.completionsReady();
+	return ready >= n ? 0 : ring.submitAndWait(n - ready);
+}
+
+/** Reaps the completions of the `n` sends queued on `ring`, adding the successful ones to `nOk`.
+ *  The sends refer to the caller's msghdrs and buffers, so this never returns before all of them completed,
+ *  even if entering the kernel fails (in which case we keep polling the completion queue, as the sends were
+ *  queued all the same). This also leaves no stale completion to be mistaken for the next batch's ones.
+ *  @return 0, or the first error met.
+ */
+static int reapCompletions(IoRing& ring, unsigned n, std::size_t& nOk)
+{
+	int error = 0;
+	unsigned reaped = 0;
+	while (reaped < n) {
+		const auto res = waitCompletions(ring, n - reaped);
+		if (res < 0) {
+			if (error == 0)
+				error = -res;
+			std::this_thread::yield();
+		}
+		reaped += ring.forEachCompletion(
+			[&](const io_uring_cqe& cqe) {
+				if (cqe.res >= 0)
+					++nOk;
+				else if (error == 0)
+					error = -cqe.res;
+			},
+			n - reaped);
+	}
+	return error;
+}
+
+static int uringSendBatch(IoRing& ring,
+	const xplatIoVec* iovs,
+	const std::size_t* iovCounts,
+	std::size_t nPackets)
+{
+	std::array<msghdr, MAX_MSGS> msgs;
+	std::size_t sent = 0;
+	int error = 0;
+
+	while (sent < nPackets && error == 0) {
+		auto n = std::min(nPackets - sent, MAX_MSGS);
+		for (std::size_t i = 0; i < n; ++i) {
+			auto sqe = ring.getSqe();
+			if (!sqe) {
+				// The queue is full (the kernel lags behind): only send what we queued so far
+				if (i == 0) {
+					error = EBUSY;
+					break;
+				}
+				n = i;
+				break;
+			}
+
+			msgs[i] = {};
+			msgs[i].msg_iov = const_cast<xplatIoVec*>(iovs);
+			msgs[i].msg_iovlen = iovCounts[sent + i];
+			iovs += iovCounts[sent + i];
+
+			sqe->opcode = IORING_OP_SENDMSG;
+			sqe->flags = IOSQE_FIXED_FILE;
+			sqe->fd = 0;
+			sqe->addr = reinterpret_cast<uint64_t>(&msgs[i]);
+			sqe->len = 1;
+		}
+		if (error != 0)
+			break;
+
+		// The messages live on our stack, and the caller reuses its buffers: wait for all of them to be sent,
+		// even if submitting fails, as the kernel may have picked them up anyway.
+		const auto res = ring.submit();
+		if (res < 0)
+			error = -res;
+
+		std::size_t nOk = 0;
+		const auto reapError = reapCompletions(ring, static_cast<unsigned>(n), nOk);
+		if (error == 0)
+			error = reapError;
+		sent += nOk;
+		if (nOk < n) {
+			if (error == 0)
+				error = EIO;
+			break;
+		}
+		// All sent: the kernel picked them up even if waking it up failed
+		error = 0;
+	}
+
+	if (error != 0)
+		errno = error;
+	return sent > 0 ? static_cast<int>(sent) : -1;
+}
+#endif
+
+bool xplatUseIoUring(bool use)
+{
+#ifdef __linux__
+	if (use && !gPollRing) {
+		// Without a polled ring a batch would still cost a syscall, which is what sendmmsg costs already
+		auto pollRing = std::make_unique<IoRing>(1, true, SQ_POLL_IDLE_MS);
+		if (!pollRing->valid())
+			return false;
+		gPollRing = std::move(pollRing);
+	}
+	gUseIoUring = use;
+	return true;
+#else
+	return !use;
+#endif
+}
 
 bool xplatSocketInit()
 {
@@ -50,6 +219,118 @@ int xplatSockClose(socket_t sock)
 	return status;
 }
 
+bool xplatSetDontFragment(socket_t sock, bool dontFragment)
+{
+#if defined(__linux__)
+	// PROBE also ignores the path MTU cached by the kernel, which is what we want to measure
+	const int val = dontFragment ? IP_PMTUDISC_PROBE : IP_PMTUDISC_WANT;
+	return ::setsockopt(sock, IPPROTO_IP, IP_MTU_DISCOVER, &val, sizeof(val)) == 0;
+#elif defined(_WIN32)
+	const DWORD val = dontFragment;
+	return ::setsockopt(sock, IPPROTO_IP, IP_DONTFRAGMENT, reinterpret_cast<const char*>(&val), sizeof(val)) == 0;
+#elif defined(IP_DONTFRAG)
+	const int val = dontFragment;
+	return ::setsockopt(sock, IPPROTO_IP, IP_DONTFRAG, &val, sizeof(val)) == 0;
+#else
+	return false;
+#endif
+}
+
+int xplatSendBatch(socket_t sock, const xplatIoVec* iovs, const std::size_t* iovCounts, std::size_t nPackets)
+{
+	std::size_t sent = 0;
+#if defined(__linux__)
+	if (gUseIoUring) {
+		if (auto ring = sendRing(sock))
+			return uringSendBatch(*ring, iovs, iovCounts, nPackets);
+	}
+
+	std::array<mmsghdr, MAX_MSGS> msgs;
+
+	while (sent < nPackets) {
+		const auto n = std::min(nPackets - sent, MAX_MSGS);
+		for (std::size_t i = 0; i < n; ++i) {
+			msgs[i] = {};
+			msgs[i].msg_hdr.msg_iov = const_cast<xplatIoVec*>(iovs);
+			msgs[i].msg_hdr.msg_iovlen = iovCounts[sent + i];
+			iovs += iovCounts[sent + i];
+		}
+		const auto res = ::sendmmsg(sock, msgs.data(), n, 0);
+		if (res < 0)
+			break;
+		sent += res;
+		if (static_cast<std::size_t>(res) < n)
+			break;
+	}
+#elif defined(_WIN32)
+	std::array<uint8_t, 65536> packet;
+	for (; sent < nPackets; ++sent) {
+		std::size_t len = 0;
+		for (std::size_t i = 0; i < iovCounts[sent]; ++i) {
+			memcpy(packet.data() + len, iovs[i].iov_base, iovs[i].iov_len);
+			len += iovs[i].iov_len;
+		}
+		iovs += iovCounts[sent];
+		if (::send(sock, reinterpret_cast<const char*>(packet.data()), len, 0) < 0)
+			break;
+	}
+#else
+	for (; sent < nPackets; ++sent) {
+		msghdr msg = {};
+		msg.msg_iov = const_cast<xplatIoVec*>(iovs);
+		msg.msg_iovlen = iovCounts[sent];
+		iovs += iovCounts[sent];
+		if (::sendmsg(sock, &msg, 0) < 0)
+			break;
+	}
+#endif
+	return sent > 0 ? static_cast<int>(sent) : -1;
+}
+
+int xplatReceiveBatch(socket_t sock, uint8_t* data, std::size_t packetSize, std::size_t maxPackets, int* sizes)
+{
+#ifdef __linux__
+	std::array<mmsghdr, MAX_MSGS> msgs;
+	std::array<iovec, MAX_MSGS> iovs;
+
+	const auto n = std::min(maxPackets, MAX_MSGS);
+	for (std::size_t i = 0; i < n; ++i) {
+		iovs[i].iov_base = data + i * packetSize;
+		iovs[i].iov_len = packetSize;
+		msgs[i] = {};
+		msgs[i].msg_hdr.msg_iov = &iovs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	const auto res = ::recvmmsg(sock, msgs.data(), n, MSG_WAITFORONE, nullptr);
+	for (int i = 0; i < res; ++i)
+		sizes[i] = msgs[i].msg_len;
+
+	return res;
+#else
+	if (maxPackets == 0)
+		return 0;
+	sizes[0] = ::recv(sock, reinterpret_cast<char*>(data), packetSize, 0);
+	return sizes[0] < 0 ? -1 : 1;
+#endif
+}
+
+int64_t xplatSendFile(socket_t sock, std::FILE* file, std::size_t offset, std::size_t len)
+{
+#ifdef __linux__
+	auto off = static_cast<off_t>(offset);
+	return ::sendfile(sock, fileno(file), &off, len);
+#else
+	std::array<char, 1 << 16> buffer;
+	if (std::fseek(file, static_cast<long>(offset), SEEK_SET) != 0)
+		return -1;
+	const auto nRead = std::fread(buffer.data(), 1, std::min(len, buffer.size()), file);
+	if (nRead == 0)
+		return -1;
+	return ::send(sock, buffer.data(), static_cast<int>(nRead), 0);
+#endif
+}
+
 const char* xplatGetErrorString()
 {
 	return std::strerror(xplatGetError());
@@ -1,6 +1,9 @@
 #pragma once
 
 /** Platform independence layer for sockets */
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
 #include <string>
 #ifdef _WIN32
 #	include <WinSock2.h>
@@ -12,6 +15,17 @@
 #	include <unistd.h>
 #endif
 
+#ifdef _WIN32
+/** A memory segment, used for scatter/gather I/O (same layout as POSIX's iovec) */
+struct xplatIoVec {
+	void* iov_base;
+	std::size_t iov_len;
+};
+#else
+#	include <sys/uio.h>
+using xplatIoVec = iovec;
+#endif
+
 #ifdef _WIN32
 using socket_t = SOCKET;
 using socket_connect_op = int(__stdcall*)(socket_t, const sockaddr*, int);
@@ -49,6 +63,41 @@ bool xplatSocketCleanup();
 /** Closes a socket */
 int xplatSockClose(socket_t sock);
 
+/** Sets whether the IPv4 datagrams sent via `sock` must not be fragmented along the path.
+ *  While set, sending a datagram which doesn't fit the local interface's MTU fails.
+ *  @return true if the option is supported and was set.
+ */
+bool xplatSetDontFragment(socket_t sock, bool dontFragment);
+
+/** Makes `xplatSendBatch` use io_uring (Linux only) if `use` is true.
+ *  Each sending thread then gets its own ring, with its socket registered, and all rings are polled by a
+ *  single kernel thread: while it's awake, sending a batch needs no syscall at all.
+ *  @return false if polled io_uring rings are not available (e.g. old kernel, seccomp, or not enough
+ *  privileges), in which case the normal path keeps being used.
+ */
+bool xplatUseIoUring(bool use);
+
+/** Sends `nPackets` datagrams, each described by a list of memory segments:
+ *  the i-th datagram is made of the `iovCounts[i]` segments following the ones of the previous datagram.
+ *  Uses as few syscalls as possible (on Linux they're all sent with sendmmsg).
+ *  @return The number of packets sent, or -1 if none could be sent.
+ */
+int xplatSendBatch(socket_t sock, const xplatIoVec* iovs, const std::size_t* iovCounts, std::size_t nPackets);
+
+/** Receives up to `maxPackets` datagrams into `data`, each one into its own slot of `packetSize` bytes.
+ *  Blocks until at least one datagram is available, then also takes all the ones already queued
+ *  (on Linux they're all received with a single recvmmsg).
+ *  The size of each datagram received is written into `sizes`, which must hold `maxPackets` elements.
+ *  @return The number of packets received, or -1 on error.
+ */
+int xplatReceiveBatch(socket_t sock, uint8_t* data, std::size_t packetSize, std::size_t maxPackets, int* sizes);
+
+/** Sends up to `len` bytes of `file` via the stream socket `sock`, starting at `offset`.
+ *  On Linux the data goes from the page cache to the socket without being copied to user space (sendfile).
+ *  @return the number of bytes sent (which may be less than `len`), or -1 on error.
+ */
+int64_t xplatSendFile(socket_t sock, std::FILE* file, std::size_t offset, std::size_t len);
+
 /** Returns the latest error string */
 const char* xplatGetErrorString();
 
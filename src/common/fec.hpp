@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/** Forward error correction of the UDP stream.
+ *  When enabled, the server splits the packets it sends into FEC groups of up to N data packets
+ *  and follows each group with a parity packet, whose payload is the XOR of the payloads of the group's
+ *  data packets (zero-padded to the longest one) and whose header's `size` is the XOR of their sizes.
+ *  A client which lost a single data packet of a group can rebuild it by XOR'ing the parity with the
+ *  data packets it received, without waiting for the server to resend it.
+ *  Groups never span more than one send batch, so the last group of a batch may be shorter than N;
+ *  groups of a single packet are sent without parity.
+ */
+
+/** XORs `len` bytes of `src` into `dst`. */
+inline void xorBytes(uint8_t* dst, const uint8_t* src, std::size_t len)
+{
+	std::size_t i = 0;
+	for (; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t)) {
+		uint64_t a, b;
+		memcpy(&a, dst + i, sizeof(uint64_t));
+		memcpy(&b, src + i, sizeof(uint64_t));
+		a ^= b;
+		memcpy(dst + i, &a, sizeof(uint64_t));
+	}
+	for (; i < len; ++i)
+		dst[i] ^= src[i];
+}
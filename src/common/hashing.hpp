@@ -49,6 +49,44 @@ constexpr uint32_t fnv1a_hash(const uint8_t* buffer, std::size_t bufsize)
 	return result;
 }
 
+/** Hashes the `nWords` 32-bit words of `words`. Unlike fnv1a_hash, which consumes a byte at a time in a single
+ *  dependency chain, the words are mixed into independent lanes (which the compiler can vectorize) and only
+ *  folded together at the end, so hashing fixed-size binary keys (e.g. vertices) is several times faster.
+ *  The result is not stable across versions: don't store it.
+ */
+inline uint32_t hashWords(const uint32_t* words, std::size_t nWords)
+{
+	constexpr std::size_t N_LANES = 4;
+	constexpr uint32_t prime1 = 0x85ebca6b;
+	constexpr uint32_t prime2 = 0xc2b2ae35;
+	uint32_t lanes[N_LANES] = { 0x9e3779b1, 0x7f4a7c15, 0x165667b1, 0x27d4eb2f };
+
+	std::size_t i = 0;
+	for (; i + N_LANES <= nWords; i += N_LANES) {
+		for (std::size_t l = 0; l < N_LANES; ++l) {
+			lanes[l] = (lanes[l] ^ words[i + l]) * prime1;
+			lanes[l] ^= lanes[l] >> 15;
+		}
+	}
+	for (std::size_t l = 0; i < nWords; ++i, ++l) {
+		lanes[l] = (lanes[l] ^ words[i]) * prime1;
+		lanes[l] ^= lanes[l] >> 15;
+	}
+
+	uint32_t result = static_cast<uint32_t>(nWords);
+	for (std::size_t l = 0; l < N_LANES; ++l) {
+		result = (result ^ lanes[l]) * prime2;
+		result = (result << 13) | (result >> 19);
+	}
+	// Final avalanche (from MurmurHash3)
+	result ^= result >> 16;
+	result *= prime1;
+	result ^= result >> 13;
+	result *= prime2;
+	result ^= result >> 16;
+	return result;
+}
+
 }   // end namespace hashing
 
 #ifndef NDEBUG
@@ -0,0 +1,103 @@
+#include "index_codec.hpp"
+#include <cassert>
+
+std::size_t encodedIndicesSize(const Index* src, std::size_t nIndices)
+{
+	std::size_t size = 0;
+	Index prev = 0;
+	for (std::size_t i = 0; i < nIndices; ++i) {
+		size += encodedIndexSize(prev, src[i]);
+		prev = src[i];
+	}
+	return size;
+}
+
+std::size_t encodeIndices(const Index* src, std::size_t nIndices, uint8_t* dst, std::size_t dstSize)
+{
+	std::size_t written = 0;
+	Index prev = 0;
+
+	for (std::size_t i = 0; i < nIndices; ++i) {
+		auto zz = zigzagEncode(static_cast<int32_t>(src[i] - prev));
+		prev = src[i];
+
+		while (zz >= 0x80) {
+			if (written == dstSize)
+				return 0;
+			dst[written++] = static_cast<uint8_t>(zz | 0x80);
+			zz >>= 7;
+		}
+		if (written == dstSize)
+			return 0;
+		dst[written++] = static_cast<uint8_t>(zz);
+	}
+
+	return written;
+}
+
+std::size_t decodeIndices(const uint8_t* src, std::size_t srcSize, std::size_t nIndices, Index* dst)
+{
+	std::size_t read = 0;
+	Index prev = 0;
+
+	for (std::size_t i = 0; i < nIndices; ++i) {
+		if (read == srcSize)
+			return 0;
+
+		uint32_t zz = src[read++];
+		// Most deltas fit in a single byte: only loop for the others.
+		if (zz & 0x80) {
+			zz &= 0x7f;
+			unsigned shift = 7;
+			uint8_t byte;
+			do {
+				if (read == srcSize || shift > 28)
+					return 0;
+				byte = src[read++];
+				zz |= static_cast<uint32_t>(byte & 0x7f) << shift;
+				shift += 7;
+			} while (byte & 0x80);
+		}
+
+		prev += static_cast<Index>(zigzagDecode(zz));
+		dst[i] = prev;
+	}
+
+	return read;
+}
+
+void EncodedIndexRun::encode(const Index* src, std::size_t n)
+{
+	nIndices = n;
+	bytes.resize(encodedIndicesSize(src, n));
+	const auto written = encodeIndices(src, n, bytes.data(), bytes.size());
+	assert(written == bytes.size());
+	(void)written;
+
+	// Save where every OFFSET_STRIDE-th index starts: each index ends with its first byte with the high bit unset
+	strideOffsets.clear();
+	strideOffsets.reserve(n / OFFSET_STRIDE + 1);
+	std::size_t off = 0;
+	for (std::size_t i = 0; i < n; ++i) {
+		if (i % OFFSET_STRIDE == 0)
+			strideOffsets.emplace_back(static_cast<uint32_t>(off));
+		while (bytes[off] & 0x80)
+			++off;
+		++off;
+	}
+}
+
+std::size_t EncodedIndexRun::offset(std::size_t i) const
+{
+	assert(i <= nIndices);
+	if (i == nIndices)
+		return bytes.size();
+
+	std::size_t off = strideOffsets[i / OFFSET_STRIDE];
+	// Skip the indices between the saved offset and the one we want: the last byte of each has the high bit unset
+	for (auto n = i % OFFSET_STRIDE; n > 0; ++off) {
+		if ((bytes[off] & 0x80) == 0)
+			--n;
+	}
+	return off;
+}
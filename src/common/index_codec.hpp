@@ -0,0 +1,78 @@
+#pragma once
+
+#include "vertex.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/** Compact encoding of index lists, used to send indices via network.
+ *  Each index is stored as the zigzag-encoded difference from the previous one, written as a varint
+ *  (7 bits per byte, the highest bit tells whether more bytes follow).
+ *  A run of indices is always encoded independently from other runs (the first index is relative to 0),
+ *  so that each chunk can be decoded on its own.
+ */
+
+/** Max bytes an index takes once encoded */
+constexpr std::size_t MAX_ENCODED_INDEX_SIZE = (sizeof(Index) * 8 + 6) / 7;
+
+/** Maps signed integers to unsigned ones so that small magnitudes stay small (0, -1, 1, -2, ... => 0, 1, 2, 3, ...) */
+inline uint32_t zigzagEncode(int32_t x)
+{
+	return (static_cast<uint32_t>(x) << 1) ^ static_cast<uint32_t>(x >> 31);
+}
+
+inline int32_t zigzagDecode(uint32_t x)
+{
+	return static_cast<int32_t>(x >> 1) ^ -static_cast<int32_t>(x & 1);
+}
+
+/** @return the bytes needed to encode `idx` if it follows `prev` in the stream */
+inline std::size_t encodedIndexSize(Index prev, Index idx)
+{
+	auto zz = zigzagEncode(static_cast<int32_t>(idx - prev));
+	std::size_t size = 1;
+	while (zz >= 0x80) {
+		zz >>= 7;
+		++size;
+	}
+	return size;
+}
+
+/** @return the bytes needed to encode `nIndices` indices from `src` */
+std::size_t encodedIndicesSize(const Index* src, std::size_t nIndices);
+
+/** Encodes `nIndices` indices from `src` into `dst`, which must be at least `dstSize` bytes long.
+ *  @return the number of bytes written, or 0 if `dst` is too small.
+ */
+std::size_t encodeIndices(const Index* src, std::size_t nIndices, uint8_t* dst, std::size_t dstSize);
+
+/** Decodes `nIndices` indices from `src`, reading at most `srcSize` bytes, into `dst`.
+ *  @return the number of bytes read, or 0 if `src` does not contain `nIndices` valid indices.
+ */
+std::size_t decodeIndices(const uint8_t* src, std::size_t srcSize, std::size_t nIndices, Index* dst);
+
+/** A list of indices encoded once and for all as a single run.
+ *  Since each index is encoded relative to the previous one, the encoding of any of its sub-runs is the
+ *  encoding of the sub-run's first index (which is relative to 0 in a run of its own) followed by the bytes
+ *  of the indices after it, which can be used as they are.
+ */
+class EncodedIndexRun {
+public:
+	/** Encodes `nIndices` indices from `src`, replacing the ones encoded before (if any). */
+	void encode(const Index* src, std::size_t nIndices);
+
+	/** @return where the bytes of the `i`-th index start, or the run's size if `i` is the number of indices. */
+	std::size_t offset(std::size_t i) const;
+
+	const uint8_t* data() const { return bytes.data(); }
+
+	std::size_t size() const { return bytes.size(); }
+
+private:
+	/** Every `OFFSET_STRIDE`-th index's offset is saved; the others are found by skipping the ones in between */
+	static constexpr std::size_t OFFSET_STRIDE = 32;
+
+	std::vector<uint8_t> bytes;
+	std::vector<uint32_t> strideOffsets;
+	std::size_t nIndices = 0;
+};
@@ -0,0 +1,165 @@
+#ifdef __linux__
+
+#include "io_ring.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+template <typename T>
+static T* ringPtr(void* ring, uint32_t offset)
+{
+	return reinterpret_cast<T*>(reinterpret_cast<uint8_t*>(ring) + offset);
+}
+
+IoRing::IoRing(unsigned entries, bool sqPoll, unsigned sqIdleMs, int attachTo)
+	: sqPoll{ sqPoll }
+{
+	io_uring_params params = {};
+	if (sqPoll) {
+		params.flags |= IORING_SETUP_SQPOLL;
+		params.sq_thread_idle = sqIdleMs;
+		if (attachTo >= 0) {
+			params.flags |= IORING_SETUP_ATTACH_WQ;
+			params.wq_fd = attachTo;
+		}
+	}
+	fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+	if (fd < 0)
+		return;
+
+	sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	// Newer kernels map both rings with a single mmap
+	const bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+	if (singleMmap)
+		sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+
+	sqRing = ::mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (sqRing == MAP_FAILED) {
+		sqRing = nullptr;
+		release();
+		return;
+	}
+	if (singleMmap) {
+		cqRing = sqRing;
+	} else {
+		cqRing = ::mmap(
+			nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+		if (cqRing == MAP_FAILED) {
+			cqRing = nullptr;
+			release();
+			return;
+		}
+	}
+
+	sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+	const auto sqesMem =
+		::mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	if (sqesMem == MAP_FAILED) {
+		release();
+		return;
+	}
+	sqes = reinterpret_cast<io_uring_sqe*>(sqesMem);
+
+	sqHead = ringPtr<unsigned>(sqRing, params.sq_off.head);
+	sqTail = ringPtr<unsigned>(sqRing, params.sq_off.tail);
+	sqMask = *ringPtr<unsigned>(sqRing, params.sq_off.ring_mask);
+	sqEntries = params.sq_entries;
+	sqArray = ringPtr<unsigned>(sqRing, params.sq_off.array);
+	sqFlags = ringPtr<unsigned>(sqRing, params.sq_off.flags);
+	cqHead = ringPtr<unsigned>(cqRing, params.cq_off.head);
+	cqTail = ringPtr<unsigned>(cqRing, params.cq_off.tail);
+	cqMask = *ringPtr<unsigned>(cqRing, params.cq_off.ring_mask);
+	cqes = ringPtr<io_uring_cqe>(cqRing, params.cq_off.cqes);
+
+	sqeTail = *sqTail;
+}
+
+IoRing::~IoRing()
+{
+	release();
+}
+
+void IoRing::release()
+{
+	if (sqes)
+		::munmap(sqes, sqesSize);
+	if (cqRing && cqRing != sqRing)
+		::munmap(cqRing, cqRingSize);
+	if (sqRing)
+		::munmap(sqRing, sqRingSize);
+	sqes = nullptr;
+	sqRing = cqRing = nullptr;
+	if (fd >= 0)
+		::close(fd);
+	fd = -1;
+}
+
+io_uring_sqe* IoRing::getSqe()
+{
+	const auto head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+	if (sqeTail - head >= sqEntries)
+		return nullptr;
+
+	const auto idx = sqeTail & sqMask;
+	auto sqe = &sqes[idx];
+	memset(sqe, 0, sizeof(io_uring_sqe));
+	sqArray[idx] = idx;
+	++sqeTail;
+
+	return sqe;
+}
+
+int IoRing::enter(unsigned toSubmit, unsigned waitNr, unsigned flags)
+{
+	int res;
+	do {
+		res = static_cast<int>(::syscall(__NR_io_uring_enter, fd, toSubmit, waitNr, flags, nullptr, 0));
+	} while (res < 0 && errno == EINTR);
+
+	return res < 0 ? -errno : 0;
+}
+
+int IoRing::submit()
+{
+	const auto toSubmit = sqeTail - *sqTail;
+	__atomic_store_n(sqTail, sqeTail, __ATOMIC_RELEASE);
+
+	if (!sqPoll)
+		return toSubmit > 0 ? enter(toSubmit, 0, 0) : 0;
+
+	// The kernel thread only sets NEED_WAKEUP after checking the tail one last time, so the tail store
+	// must be visible before we read the flags.
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (__atomic_load_n(sqFlags, __ATOMIC_RELAXED) & IORING_SQ_NEED_WAKEUP)
+		return enter(0, 0, IORING_ENTER_SQ_WAKEUP);
+	return 0;
+}
+
+int IoRing::submitAndWait(unsigned waitNr)
+{
+	if (!sqPoll) {
+		// Submit and wait with the same syscall
+		const auto toSubmit = sqeTail - *sqTail;
+		__atomic_store_n(sqTail, sqeTail, __ATOMIC_RELEASE);
+		return enter(toSubmit, waitNr, waitNr > 0 ? IORING_ENTER_GETEVENTS : 0);
+	}
+
+	const auto res = submit();
+	if (res < 0 || waitNr == 0)
+		return res;
+	return enter(0, waitNr, IORING_ENTER_GETEVENTS);
+}
+
+bool IoRing::registerFile(int file)
+{
+	if (hasRegisteredFile)
+		::syscall(__NR_io_uring_register, fd, IORING_UNREGISTER_FILES, nullptr, 0);
+	hasRegisteredFile = ::syscall(__NR_io_uring_register, fd, IORING_REGISTER_FILES, &file, 1) == 0;
+	return hasRegisteredFile;
+}
+
+#endif
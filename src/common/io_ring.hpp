@@ -0,0 +1,107 @@
+#pragma once
+
+#ifdef __linux__
+
+#include <cstddef>
+#include <cstdint>
+#include <linux/io_uring.h>
+#include <sys/uio.h>
+
+/** A minimal io_uring instance, talking to the kernel directly (no liburing needed).
+ *  Entries are queued with `getSqe` and handed to the kernel all together by `submit`.
+ *  With a polled ring (IORING_SETUP_SQPOLL) a kernel thread picks up the submitted entries by itself,
+ *  so submitting and reaping completions need no syscall at all while that thread is awake.
+ *  An IoRing must only be used by one thread at a time.
+ */
+class IoRing {
+public:
+	/** Sets up a ring with (at least) `entries` submission entries. Check `valid()` to know if it succeeded.
+	 *  If `sqPoll` is true the ring is polled by a kernel thread, which sleeps after `sqIdleMs` ms without
+	 *  work; if `attachTo` is the file descriptor of another polled ring, that ring's thread is shared.
+	 */
+	explicit IoRing(unsigned entries, bool sqPoll = false, unsigned sqIdleMs = 0, int attachTo = -1);
+	~IoRing();
+
+	IoRing(const IoRing&) = delete;
+	IoRing& operator=(const IoRing&) = delete;
+
+	bool valid() const { return fd >= 0; }
+
+	int fileDescriptor() const { return fd; }
+
+	/** @return a zeroed submission entry to fill, or nullptr if the submission queue is full. */
+	io_uring_sqe* getSqe();
+
+	/** Submits all the entries queued. A polled ring only enters the kernel if its thread fell asleep.
+	 *  @return 0, or -errno on error.
+	 */
+	int submit();
+
+	/** Submits all the entries queued and waits until at least `waitNr` completions are available.
+	 *  @return 0, or -errno on error.
+	 */
+	int submitAndWait(unsigned waitNr);
+
+	/** @return the number of completions available, without entering the kernel. */
+	unsigned completionsReady() const
+	{
+		return __atomic_load_n(cqTail, __ATOMIC_ACQUIRE) - *cqHead;
+	}
+
+	/** Calls `f(const io_uring_cqe&)` on the available completions (at most `max`), then marks them as seen.
+	 *  @return the number of completions seen.
+	 */
+	template <typename F>
+	unsigned forEachCompletion(F f, unsigned max = ~0u);
+
+	/** Registers `file` (replacing the one registered before, if any), so operations flagged with
+	 *  IOSQE_FIXED_FILE can refer to it as file 0, saving the kernel from looking it up at every operation.
+	 */
+	bool registerFile(int file);
+
+private:
+	int fd = -1;
+	bool sqPoll = false;
+	bool hasRegisteredFile = false;
+
+	void* sqRing = nullptr;
+	void* cqRing = nullptr;
+	std::size_t sqRingSize = 0;
+	std::size_t cqRingSize = 0;
+	io_uring_sqe* sqes = nullptr;
+	std::size_t sqesSize = 0;
+
+	// Pointers into the rings shared with the kernel
+	unsigned* sqHead = nullptr;
+	unsigned* sqTail = nullptr;
+	unsigned sqMask = 0;
+	unsigned sqEntries = 0;
+	unsigned* sqArray = nullptr;
+	unsigned* sqFlags = nullptr;
+	unsigned* cqHead = nullptr;
+	unsigned* cqTail = nullptr;
+	unsigned cqMask = 0;
+	io_uring_cqe* cqes = nullptr;
+
+	/** Tail of the entries queued by us, not yet published to the kernel */
+	unsigned sqeTail = 0;
+
+	/** Unmaps the rings and closes the ring's file descriptor */
+	void release();
+
+	int enter(unsigned toSubmit, unsigned waitNr, unsigned flags);
+};
+
+template <typename F>
+unsigned IoRing::forEachCompletion(F f, unsigned max)
+{
+	auto head = *cqHead;
+	const auto tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+	unsigned n = 0;
+	for (; head != tail && n < max; ++head, ++n)
+		f(cqes[head & cqMask]);
+	__atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+	return n;
+}
+
+#endif
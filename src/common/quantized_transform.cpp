@@ -0,0 +1,174 @@
+#include "quantized_transform.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <glm/gtc/packing.hpp>
+
+enum TransformEncodingFlags : uint8_t {
+	TRANSFORM_HAS_ROTATION = 1 << 0,
+	TRANSFORM_HAS_SCALE = 1 << 1,
+	TRANSFORM_UNIFORM_SCALE = 1 << 2,
+};
+
+static constexpr float POS_SCALE = 256.f;
+static constexpr int32_t POS_MAX = (1 << 23) - 1;
+static constexpr int32_t POS_MIN = -(1 << 23);
+static constexpr float ROT_MAX = 1023.f;
+static constexpr float SQRT2 = 1.41421356f;
+/** flags + position */
+static constexpr std::size_t MIN_ENCODED_SIZE = 1 + 9;
+
+static void writePosCoord(float x, uint8_t* dst)
+{
+	const auto v = std::max(POS_MIN, std::min(POS_MAX, static_cast<int32_t>(std::round(x * POS_SCALE))));
+	const auto u = static_cast<uint32_t>(v);
+	dst[0] = u & 0xff;
+	dst[1] = (u >> 8) & 0xff;
+	dst[2] = (u >> 16) & 0xff;
+}
+
+static float readPosCoord(const uint8_t* src)
+{
+	auto u = static_cast<uint32_t>(src[0]) | static_cast<uint32_t>(src[1]) << 8 |
+		 static_cast<uint32_t>(src[2]) << 16;
+	// Sign-extend to 32 bits
+	if (u & 0x800000)
+		u |= 0xff000000;
+	return static_cast<int32_t>(u) / POS_SCALE;
+}
+
+/** Smallest three encoding: the largest component is dropped (and rebuilt from the others, since
+ *  the quaternion has unit length), while the others are in [-1/sqrt(2), 1/sqrt(2)].
+ */
+static uint32_t encodeRotation(const glm::quat& rotation)
+{
+	const auto q = glm::normalize(rotation);
+	float c[4] = { q.x, q.y, q.z, q.w };
+
+	unsigned largest = 0;
+	for (unsigned i = 1; i < 4; ++i) {
+		if (std::abs(c[i]) > std::abs(c[largest]))
+			largest = i;
+	}
+
+	// q and -q are the same rotation: make the dropped component positive
+	const float sign = c[largest] < 0 ? -1.f : 1.f;
+
+	uint32_t packed = largest;
+	unsigned shift = 2;
+	for (unsigned i = 0; i < 4; ++i) {
+		if (i == largest)
+			continue;
+		const auto n = std::max(0.f, std::min(1.f, (c[i] * sign * SQRT2 + 1.f) * 0.5f));
+		packed |= static_cast<uint32_t>(std::round(n * ROT_MAX)) << shift;
+		shift += 10;
+	}
+
+	return packed;
+}
+
+static glm::quat decodeRotation(uint32_t packed)
+{
+	const unsigned largest = packed & 3;
+	float c[4];
+	float sumSq = 0;
+	unsigned shift = 2;
+	for (unsigned i = 0; i < 4; ++i) {
+		if (i == largest)
+			continue;
+		const auto n = ((packed >> shift) & 0x3ff) / ROT_MAX;
+		c[i] = (n * 2.f - 1.f) / SQRT2;
+		sumSq += c[i] * c[i];
+		shift += 10;
+	}
+	c[largest] = std::sqrt(std::max(0.f, 1.f - sumSq));
+
+	return glm::quat{ c[3], c[0], c[1], c[2] };
+}
+
+std::size_t encodeTransform(const Transform& transform, uint8_t* dst)
+{
+	const auto& rot = transform.rotation;
+	const auto& scale = transform.scale;
+
+	uint8_t flags = 0;
+	if (rot.x != 0 || rot.y != 0 || rot.z != 0)
+		flags |= TRANSFORM_HAS_ROTATION;
+	if (scale != glm::vec3{ 1.f, 1.f, 1.f }) {
+		flags |= TRANSFORM_HAS_SCALE;
+		if (scale.x == scale.y && scale.y == scale.z)
+			flags |= TRANSFORM_UNIFORM_SCALE;
+	}
+
+	std::size_t written = 0;
+	dst[written++] = flags;
+
+	for (unsigned i = 0; i < 3; ++i) {
+		writePosCoord(transform.position[i], dst + written);
+		written += 3;
+	}
+
+	if (flags & TRANSFORM_HAS_ROTATION) {
+		const auto packed = encodeRotation(rot);
+		memcpy(dst + written, &packed, sizeof(uint32_t));
+		written += sizeof(uint32_t);
+	}
+
+	if (flags & TRANSFORM_HAS_SCALE) {
+		const unsigned nScales = (flags & TRANSFORM_UNIFORM_SCALE) ? 1 : 3;
+		for (unsigned i = 0; i < nScales; ++i) {
+			const uint16_t half = glm::packHalf1x16(scale[i]);
+			memcpy(dst + written, &half, sizeof(uint16_t));
+			written += sizeof(uint16_t);
+		}
+	}
+
+	assert(written <= MAX_ENCODED_TRANSFORM_SIZE);
+
+	return written;
+}
+
+std::size_t decodeTransform(const uint8_t* src,
+	std::size_t srcSize,
+	/* out */ glm::vec3& position,
+	/* out */ glm::quat& rotation,
+	/* out */ glm::vec3& scale)
+{
+	if (srcSize < MIN_ENCODED_SIZE)
+		return 0;
+
+	const auto flags = src[0];
+	const std::size_t nScales =
+		(flags & TRANSFORM_HAS_SCALE) ? ((flags & TRANSFORM_UNIFORM_SCALE) ? 1 : 3) : 0;
+	const std::size_t rotSize = (flags & TRANSFORM_HAS_ROTATION) ? sizeof(uint32_t) : 0;
+	if (srcSize < MIN_ENCODED_SIZE + rotSize + nScales * sizeof(uint16_t))
+		return 0;
+
+	std::size_t read = 1;
+	for (unsigned i = 0; i < 3; ++i) {
+		position[i] = readPosCoord(src + read);
+		read += 3;
+	}
+
+	if (flags & TRANSFORM_HAS_ROTATION) {
+		uint32_t packed;
+		memcpy(&packed, src + read, sizeof(uint32_t));
+		rotation = decodeRotation(packed);
+		read += sizeof(uint32_t);
+	} else {
+		rotation = glm::quat{ 1.f, 0.f, 0.f, 0.f };
+	}
+
+	scale = glm::vec3{ 1.f, 1.f, 1.f };
+	for (unsigned i = 0; i < nScales; ++i) {
+		uint16_t half;
+		memcpy(&half, src + read, sizeof(uint16_t));
+		scale[i] = glm::unpackHalf1x16(half);
+		read += sizeof(uint16_t);
+	}
+	if (nScales == 1)
+		scale.y = scale.z = scale.x;
+
+	return read;
+}
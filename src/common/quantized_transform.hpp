@@ -0,0 +1,33 @@
+#pragma once
+
+#include "transform.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+/** Compact encoding of a Transform's position, rotation and scale, used to send transforms via network.
+ *  The encoded transform has the following format:
+ *  [flags (uint8)]
+ *  [position (3 x 24-bit fixed point, 1/256 units precision)]
+ *  [rotation (uint32: index of the largest quaternion component + the other three as 10 bits each)] (optional)
+ *  [scale (1 half float if uniform, else 3)] (optional)
+ *  Rotation and scale are omitted when they're the identity.
+ */
+
+/** Upper bound to the size of an encoded transform */
+constexpr std::size_t MAX_ENCODED_TRANSFORM_SIZE = 1 + 9 + 4 + 6;
+
+/** Encodes `transform` into `dst`, which must be at least MAX_ENCODED_TRANSFORM_SIZE bytes long.
+ *  Positions are clamped to about +-32768 units.
+ *  @return the number of bytes written.
+ */
+std::size_t encodeTransform(const Transform& transform, uint8_t* dst);
+
+/** Decodes a transform from `src`, reading at most `srcSize` bytes.
+ *  @return the number of bytes read, or 0 if `src` does not contain a valid transform.
+ */
+std::size_t decodeTransform(const uint8_t* src,
+	std::size_t srcSize,
+	/* out */ glm::vec3& position,
+	/* out */ glm::quat& rotation,
+	/* out */ glm::vec3& scale);
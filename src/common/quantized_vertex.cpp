@@ -0,0 +1,210 @@
+#include "quantized_vertex.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+static constexpr float UNORM16_MAX = 65535.f;
+static constexpr float SNORM16_MAX = 32767.f;
+
+static int16_t toSnorm16(float x)
+{
+	return static_cast<int16_t>(std::round(std::max(-1.f, std::min(1.f, x)) * SNORM16_MAX));
+}
+
+static float signNotZero(float x)
+{
+	return x >= 0 ? 1.f : -1.f;
+}
+
+/** Projects `v` onto the octahedron and unfolds it onto the [-1, 1]^2 square. */
+static void octEncode(const glm::vec3& v, int16_t& outX, int16_t& outY)
+{
+	const auto l1 = std::abs(v.x) + std::abs(v.y) + std::abs(v.z);
+	if (l1 == 0) {
+		// Degenerate vector (e.g. the model has no tangents): any direction will do.
+		outX = outY = 0;
+		return;
+	}
+
+	auto x = v.x / l1;
+	auto y = v.y / l1;
+	if (v.z < 0) {
+		// Fold the lower hemisphere over the upper one
+		const auto ox = x;
+		x = (1 - std::abs(y)) * signNotZero(ox);
+		y = (1 - std::abs(ox)) * signNotZero(y);
+	}
+
+	outX = toSnorm16(x);
+	outY = toSnorm16(y);
+}
+
+static uint16_t quantizeCoord(float x, float min, float extent)
+{
+	if (extent <= 0)
+		return 0;
+	const auto n = std::max(0.f, std::min(1.f, (x - min) / extent));
+	return static_cast<uint16_t>(std::round(n * UNORM16_MAX));
+}
+
+static glm::vec2 decodeTexCoord(const QuantizedVertex& qv)
+{
+	uint32_t packed;
+	memcpy(&packed, &qv.texCoord, sizeof(packed));
+	return glm::unpackHalf2x16(packed);
+}
+
+QuantizationBounds computeQuantizationBounds(const Vertex* vertices, std::size_t nVertices)
+{
+	QuantizationBounds bounds = {};
+	if (nVertices == 0)
+		return bounds;
+
+	auto min = vertices[0].pos;
+	auto max = vertices[0].pos;
+	for (std::size_t i = 1; i < nVertices; ++i) {
+		min = glm::min(min, vertices[i].pos);
+		max = glm::max(max, vertices[i].pos);
+	}
+
+	bounds.min = min;
+	bounds.extent = max - min;
+
+	return bounds;
+}
+
+void quantizeVertices(const Vertex* src,
+	std::size_t nVertices,
+	const QuantizationBounds& bounds,
+	/* out */ QuantizedVertex* dst)
+{
+	for (std::size_t i = 0; i < nVertices; ++i) {
+		const auto& v = src[i];
+		QuantizedVertex qv;
+
+		qv.pos[0] = quantizeCoord(v.pos.x, bounds.min.x, bounds.extent.x);
+		qv.pos[1] = quantizeCoord(v.pos.y, bounds.min.y, bounds.extent.y);
+		qv.pos[2] = quantizeCoord(v.pos.z, bounds.min.z, bounds.extent.z);
+
+		int16_t nx, ny, tx, ty;
+		octEncode(v.norm, nx, ny);
+		octEncode(v.tangent, tx, ty);
+		qv.norm[0] = nx;
+		qv.norm[1] = ny;
+		qv.tangent[0] = tx;
+		qv.tangent[1] = ty;
+
+		// Only keep the handedness of the tangent frame
+		qv.bitangentSign = glm::dot(glm::cross(v.norm, v.tangent), v.bitangent) < 0 ? -1 : 1;
+
+		const uint32_t uv = glm::packHalf2x16(v.texCoord);
+		memcpy(&qv.texCoord, &uv, sizeof(uv));
+
+		dst[i] = qv;
+	}
+}
+
+#ifdef __SSE2__
+
+void dequantizeVertices(const QuantizedVertex* src,
+	std::size_t nVertices,
+	const QuantizationBounds& bounds,
+	/* out */ Vertex* dst)
+{
+	const auto posScale = _mm_setr_ps(bounds.extent.x / UNORM16_MAX,
+		bounds.extent.y / UNORM16_MAX,
+		bounds.extent.z / UNORM16_MAX,
+		0.f);
+	const auto posBias = _mm_setr_ps(bounds.min.x, bounds.min.y, bounds.min.z, 0.f);
+	const auto snormScale = _mm_set1_ps(1.f / SNORM16_MAX);
+	const auto one = _mm_set1_ps(1.f);
+	const auto minusOne = _mm_set1_ps(-1.f);
+	const auto zero = _mm_setzero_ps();
+	const auto signMask = _mm_set1_ps(-0.f);
+	const auto zeroi = _mm_setzero_si128();
+
+	alignas(16) float p[4], xs[4], ys[4], zs[4];
+
+	for (std::size_t i = 0; i < nVertices; ++i) {
+		const auto base = reinterpret_cast<const uint8_t*>(src + i);
+
+		// [pos.x, pos.y, pos.z, bitangentSign]: positions are unsigned, so zero-extend them.
+		const auto posi = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(base));
+		const auto pos =
+			_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(posi, zeroi)), posScale), posBias);
+		_mm_store_ps(p, pos);
+
+		// [norm.x, norm.y, tangent.x, tangent.y]: these are signed, so sign-extend them.
+		const auto octi =
+			_mm_loadl_epi64(reinterpret_cast<const __m128i*>(base + offsetof(QuantizedVertex, norm)));
+		const auto oct = _mm_max_ps(
+			_mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(octi, octi), 16)), snormScale),
+			minusOne);
+
+		// Decode normal and tangent together: lanes are [norm, tangent, norm, tangent]
+		auto x = _mm_shuffle_ps(oct, oct, _MM_SHUFFLE(2, 0, 2, 0));
+		auto y = _mm_shuffle_ps(oct, oct, _MM_SHUFFLE(3, 1, 3, 1));
+		auto z = _mm_sub_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, x)), _mm_andnot_ps(signMask, y));
+		// Unfold the lower hemisphere: x -= copysign(max(-z, 0), x) (same for y)
+		const auto t = _mm_max_ps(_mm_sub_ps(zero, z), zero);
+		x = _mm_sub_ps(x, _mm_or_ps(t, _mm_and_ps(x, signMask)));
+		y = _mm_sub_ps(y, _mm_or_ps(t, _mm_and_ps(y, signMask)));
+
+		const auto len =
+			_mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+		_mm_store_ps(xs, _mm_div_ps(x, len));
+		_mm_store_ps(ys, _mm_div_ps(y, len));
+		_mm_store_ps(zs, _mm_div_ps(z, len));
+
+		Vertex v;
+		v.pos = glm::vec3{ p[0], p[1], p[2] };
+		v.norm = glm::vec3{ xs[0], ys[0], zs[0] };
+		v.tangent = glm::vec3{ xs[1], ys[1], zs[1] };
+		v.texCoord = decodeTexCoord(src[i]);
+		v.bitangent = glm::cross(v.norm, v.tangent) * static_cast<float>(src[i].bitangentSign);
+
+		dst[i] = v;
+	}
+}
+
+#else
+
+static glm::vec3 octDecode(int16_t ex, int16_t ey)
+{
+	auto x = std::max(-1.f, ex / SNORM16_MAX);
+	auto y = std::max(-1.f, ey / SNORM16_MAX);
+	const auto z = 1 - std::abs(x) - std::abs(y);
+	// Unfold the lower hemisphere
+	const auto t = std::max(-z, 0.f);
+	x += x >= 0 ? -t : t;
+	y += y >= 0 ? -t : t;
+
+	return glm::normalize(glm::vec3{ x, y, z });
+}
+
+void dequantizeVertices(const QuantizedVertex* src,
+	std::size_t nVertices,
+	const QuantizationBounds& bounds,
+	/* out */ Vertex* dst)
+{
+	const auto posScale = bounds.extent / UNORM16_MAX;
+
+	for (std::size_t i = 0; i < nVertices; ++i) {
+		QuantizedVertex qv;
+		memcpy(&qv, src + i, sizeof(QuantizedVertex));
+
+		Vertex v;
+		v.pos = bounds.min + glm::vec3{ float(qv.pos[0]), float(qv.pos[1]), float(qv.pos[2]) } * posScale;
+		v.norm = octDecode(qv.norm[0], qv.norm[1]);
+		v.tangent = octDecode(qv.tangent[0], qv.tangent[1]);
+		v.texCoord = decodeTexCoord(qv);
+		v.bitangent = glm::cross(v.norm, v.tangent) * static_cast<float>(qv.bitangentSign);
+
+		dst[i] = v;
+	}
+}
+
+#endif
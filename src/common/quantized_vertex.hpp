@@ -0,0 +1,50 @@
+#pragma once
+
+#include "vertex.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+#pragma pack(push, 1)
+
+/** Compact version of Vertex, used to send geometry via network (20 bytes instead of 56).
+ *  - positions are quantized to 16 bits per axis, relative to the model's bounding box;
+ *  - normals and tangents are octahedral-encoded into 2 snorm16 each;
+ *  - the bitangent is not sent: it's rebuilt as `bitangentSign * cross(norm, tangent)`;
+ *  - texture coordinates are half floats.
+ */
+struct QuantizedVertex {
+	uint16_t pos[3];
+	/** Either 1 or -1 */
+	int16_t bitangentSign;
+	int16_t norm[2];
+	int16_t tangent[2];
+	uint16_t texCoord[2];
+};
+
+#pragma pack(pop)
+
+static_assert(sizeof(QuantizedVertex) == 20, "QuantizedVertex has an unexpected size!");
+
+/** The box that quantized positions are relative to. */
+struct QuantizationBounds {
+	glm::vec3 min;
+	glm::vec3 extent;
+};
+
+/** @return the bounding box of `vertices`' positions */
+QuantizationBounds computeQuantizationBounds(const Vertex* vertices, std::size_t nVertices);
+
+/** Encodes `nVertices` vertices from `src` into `dst`, using `bounds` to quantize positions. */
+void quantizeVertices(const Vertex* src,
+	std::size_t nVertices,
+	const QuantizationBounds& bounds,
+	/* out */ QuantizedVertex* dst);
+
+/** Decodes `nVertices` vertices from `src` into `dst`. `src` needs not to be aligned.
+ *  Uses SSE2 where available.
+ */
+void dequantizeVertices(const QuantizedVertex* src,
+	std::size_t nVertices,
+	const QuantizationBounds& bounds,
+	/* out */ Vertex* dst);
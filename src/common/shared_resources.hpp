@@ -10,7 +10,8 @@
 
 namespace shared {
 
-enum class TextureFormat : uint8_t { RGBA, GREY, UNKNOWN };
+/** A NORMAL texture is an RGBA normal map, whose x and y are kept when it gets cooked (see cooked_texture.hpp) */
+enum class TextureFormat : uint8_t { RGBA, GREY, NORMAL, UNKNOWN };
 enum class ShaderStage : uint8_t { VERTEX, FRAGMENT, GEOMETRY, UNKNOWN };
 
 /** Texture information. Note that this structure is only used to *store*
@@ -27,6 +28,18 @@ struct Texture {
 	TextureFormat format;
 };
 
+/** A mip level received to refine a cooked texture (see TextureMipInfo) */
+struct TextureMip {
+	StringId name;
+	uint16_t level;
+	uint32_t width;
+	uint32_t height;
+	/** Size of `data` in bytes */
+	uint64_t size = 0;
+	/** The level's blocks */
+	void* data = nullptr;
+};
+
 /** Stores a PointLight's data. This struct is not sent via network:
  *  light initial data are sent with PointLightInfo, and updates are sent as UDP packets.
  */
@@ -34,6 +47,8 @@ struct PointLight {
 	glm::vec3 color{ 1.f, 1.f, 1.f };
 	float attenuation = 0;
 	StringId name;
+	/** Must be incremented every time the light changes, so the change is sent to clients (server only) */
+	uint32_t version = 0;
 
 	bool operator==(const shared::PointLight& other) const { return name == other.name; }
 };
@@ -56,6 +71,18 @@ struct TextureInfo {
 	/** Follows payload: texture data */
 };
 
+/** Refines the cooked texture `name` with the mip level `level`, which becomes its most detailed one.
+ *  Levels are sent one by one, from the smallest to the largest.
+ */
+struct TextureMipInfo {
+	StringId name;
+	uint16_t level;
+	uint32_t width;
+	uint32_t height;
+	uint64_t size;
+	/** Follows payload: the level's blocks */
+};
+
 struct Material {
 	StringId name;
 	StringId diffuseTex;
@@ -75,13 +102,36 @@ struct Mesh {
 	int16_t materialId = -1;
 };
 
+/** A level of detail of a model. Each level has its own meshes (i.e. its own indices), which use the vertices
+ *  of the level itself and of the coarser ones.
+ *  The model's vertices and indices are laid out (and streamed) from the coarsest level to the finest one,
+ *  so each level's data follows the data of the coarser levels.
+ */
+struct ModelLod {
+	/** Range of the vertices first used by this level */
+	uint32_t firstVertex;
+	uint32_t nVertices;
+	/** Range of the indices first used by this level */
+	uint32_t firstIndex;
+	uint32_t nIndices;
+	/** Max distance of this level from the full detail surface, in model space */
+	float error;
+};
+
 struct Model {
 	StringId name;
 	uint32_t nVertices;
 	uint32_t nIndices;
 	uint8_t nMaterials;
 	uint8_t nMeshes;
-	/** Follows payload: [materialIds (StringId) | meshes (shared::Mesh)] */
+	/** Number of levels of detail (at least 1, the full detail one) */
+	uint8_t nLods;
+	/** Bounding box needed to decode the model's quantized vertex positions */
+	glm::vec3 boundsMin;
+	glm::vec3 boundsExtent;
+	/** Follows payload: [materialIds (StringId) | meshes (shared::Mesh) | lods (shared::ModelLod)]
+	 *  There are nMeshes meshes for each level of detail, from the finest level to the coarsest one.
+	 */
 };
 
 struct PointLightInfo {
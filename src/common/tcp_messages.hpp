@@ -22,6 +22,8 @@ enum class TcpMsgType : uint8_t {
 	RSRC_TYPE_MODEL = 0x0B,
 	RSRC_TYPE_POINT_LIGHT = 0x0C,
 	RSRC_TYPE_SHADER = 0x0D,
+	/** A mip level refining a cooked texture previously sent with RSRC_TYPE_TEXTURE */
+	RSRC_TYPE_TEXTURE_MIP = 0x0E,
 	END_RSRC_EXCHANGE = 0x1F,
 	/** Client asks the server to send a specific model.
 	 *  Follows a 2 bytes payload with the "model number"
@@ -71,6 +73,9 @@ inline std::ostream& operator<<(std::ostream& s, TcpMsgType msg)
 	case M::RSRC_TYPE_SHADER:
 		s << "RSRC_TYPE_SHADER";
 		break;
+	case M::RSRC_TYPE_TEXTURE_MIP:
+		s << "RSRC_TYPE_TEXTURE_MIP";
+		break;
 	case M::END_RSRC_EXCHANGE:
 		s << "END_RSRC_EXCHANGE";
 		break;
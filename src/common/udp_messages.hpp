@@ -2,6 +2,7 @@
 
 #include "config.hpp"
 #include "hashing.hpp"
+#include "shared_resources.hpp"
 #include <array>
 #include <cstddef>
 #include <glm/glm.hpp>
@@ -14,8 +15,14 @@ enum class UdpMsgType : uint8_t {
 	POINT_LIGHT_UPDATE = 0x02,
 	/** A TransformUpdatePacket, which modifies a model's transform */
 	TRANSFORM_UPDATE = 0x03,
+	/** A MtuProbeHeader followed by padding, used to find the largest packet which reaches the client */
+	MTU_PROBE = 0x04,
 	/** An ACK to some UDP message. Typically sent by the client. */
 	ACK = 0x20,
+	/** The client's current camera pose, sent periodically */
+	CAMERA = 0x21,
+	/** Tells the server that a MTU_PROBE was received */
+	MTU_PROBE_ACK = 0x22,
 	UNKNOWN
 };
 
@@ -32,9 +39,18 @@ inline std::ostream& operator<<(std::ostream& s, UdpMsgType msg)
 	case M::TRANSFORM_UPDATE:
 		s << "TRANSFORM_UPDATE";
 		break;
+	case M::MTU_PROBE:
+		s << "MTU_PROBE";
+		break;
 	case M::ACK:
 		s << "ACK";
 		break;
+	case M::CAMERA:
+		s << "CAMERA";
+		break;
+	case M::MTU_PROBE_ACK:
+		s << "MTU_PROBE_ACK";
+		break;
 	default:
 		s << "UNKNOWN";
 		break;
@@ -56,7 +72,11 @@ constexpr uint8_t udpmsg2byte(UdpMsgType type)
 enum class GeomDataType : uint8_t {
 	VERTEX = 0,
 	INDEX = 1,
-	INVALID = 2,
+	/** Vertices in QuantizedVertex format */
+	VERTEX_QUANTIZED = 2,
+	/** Indices encoded as in index_codec.hpp. The payload is prefixed by its size in bytes (uint16_t). */
+	INDEX_COMPRESSED = 3,
+	INVALID = 4,
 };
 
 #pragma pack(push, 1)
@@ -66,13 +86,33 @@ struct UdpHeader {
 	uint32_t packetGen;
 
 	/** How many bytes of the payload are actual data (as there may be garbage at the end).
-	 *  Must be equal to the sum of all the chunks' size (type + header + payload).
+	 *  Must be equal to the sum of all the chunks' size (type + header + payload), header extensions excluded.
+	 *  In FEC parity packets, this is the XOR of the sizes of the group's data packets.
 	 */
-	uint32_t size;
+	uint16_t size;
+
+	/** Combination of UdpHeaderFlags, telling which header extensions follow this header */
+	uint16_t flags;
+};
+
+enum UdpHeaderFlags : uint16_t {
+	/** The header is followed by an UdpFecHeader */
+	UDP_HEADER_FEC = 1 << 0,
+};
+
+/** Header extension of the packets sent while FEC is enabled (see fec.hpp) */
+struct UdpFecHeader {
+	/** FEC group this packet belongs to. Only meaningful if `groupSize` > 0. */
+	uint32_t groupId;
+	/** Index of this packet in its FEC group. The group's parity packet has index `groupSize`. */
+	uint8_t index;
+	/** Number of data packets in this packet's FEC group, or 0 if the packet is not protected by FEC */
+	uint8_t groupSize;
 };
 
 /** A single UDP packet. The format is the following:
- *  [udp header] (containing packet generation and total payload size)
+ *  [udp header] (containing packet generation, total payload size and flags)
+ *  [header extensions] (only the ones flagged in the udp header, e.g. the FEC group info)
  *  [chunk0 type] (containing the type of the next chunk header + payload)
  *  [chunk0 header] (the metadata about its payload)
  *  [chunk0 payload] (the actual data)
@@ -80,11 +120,15 @@ struct UdpHeader {
  *  ...
  *  Note that a UdpPacket can contain different types of chunks.
  *  A chunk has a payload only if it's of variable size.
+ *  The packet size is chosen at connection (see mtu_probe.hpp): packets are at most that long,
+ *  so only the beginning of `payload` may be used.
  */
 struct UdpPacket {
 	UdpHeader header;
-	/** Payload contains chunks (each consisting of ChunkHeader + chunk payload) */
-	std::array<uint8_t, cfg::PACKET_SIZE_BYTES - sizeof(UdpHeader)> payload;
+	/** Payload contains the header extensions followed by the chunks (each consisting of ChunkHeader +
+	 *  chunk payload)
+	 */
+	std::array<uint8_t, cfg::MAX_UDP_PACKET_SIZE_BYTES - sizeof(UdpHeader)> payload;
 };
 
 /** Update vertex/index buffers of existing model */
@@ -112,24 +156,67 @@ struct PointLightUpdateHeader {
 	float attenuation;
 };
 
-/** Update transform of an object (currently, only a model).
- *  Note: this chunk is header-only.
- */
+/** Update transform of an object (currently, only a model). */
 struct TransformUpdateHeader {
 	StringId objectId;
-	// TODO: we may compress this information, as some elements of the matrix are always 0.
-	glm::mat4 transform;
+	/** Follows payload: the object's position, rotation and scale, encoded as in quantized_transform.hpp */
+};
+
+/** The only chunk of a MTU probe packet. Follows payload: padding up to `probeSize`. */
+struct MtuProbeHeader {
+	/** Size of the whole probe packet (header included) */
+	uint32_t probeSize;
+};
+
+/** A client-to-server packet acknowledging a MTU probe. It's a standalone struct, not part of UdpPacket. */
+struct MtuProbeAckPacket {
+	/** Must be UdpMsgType::MTU_PROBE_ACK */
+	UdpMsgType msgType;
+	uint32_t probeSize;
 };
 
-/** A client-to-server ACK packet. It's a standalone struct, not part of UdpPacket. */
-struct AckPacket {
+/** The header of a client-to-server ACK packet. It's a standalone struct, not part of UdpPacket. */
+struct AckPacketHeader {
 	/** Must be UdpMsgType::ACK */
 	UdpMsgType msgType;
-	uint32_t nAcks;
-	std::array<uint32_t, (cfg::PACKET_SIZE_BYTES - sizeof(UdpMsgType) - sizeof(uint32_t)) / sizeof(uint32_t)> acks;
+	/** Number of ranges of ACKed serial ids in the payload */
+	uint16_t nRanges;
+	/** Follows payload: the ranges of serial ids, encoded as in ack_codec.hpp */
+};
+
+/** A client-to-server packet telling where the client is looking. It's a standalone struct, not part of UdpPacket. */
+struct CameraPacket {
+	/** Must be UdpMsgType::CAMERA */
+	UdpMsgType msgType;
+	shared::Camera camera;
 };
 
 #pragma pack(pop)
 
-static_assert(sizeof(UdpPacket) == cfg::PACKET_SIZE_BYTES, "sizeof(UdpPacket) != PACKET_SIZE_BYTES!");
-static_assert(sizeof(AckPacket) <= cfg::PACKET_SIZE_BYTES, "sizeof(AckPacket) > PACKET_SIZE_BYTES!");
+static_assert(sizeof(UdpPacket) == cfg::MAX_UDP_PACKET_SIZE_BYTES, "sizeof(UdpPacket) != MAX_UDP_PACKET_SIZE_BYTES!");
+static_assert(cfg::MAX_UDP_PACKET_SIZE_BYTES <= 0xFFFF, "UdpHeader::size is too small!");
+
+/** @return the size of a packet's headers, extensions included, depending on whether FEC is enabled */
+constexpr std::size_t udpHeaderSize(bool fec)
+{
+	return sizeof(UdpHeader) + (fec ? sizeof(UdpFecHeader) : 0);
+}
+
+/** @return the size of `header` and of its extensions, i.e. the offset of its packet's first chunk */
+inline std::size_t udpHeaderSize(const UdpHeader& header)
+{
+	return udpHeaderSize((header.flags & UDP_HEADER_FEC) != 0);
+}
+
+/** @return the FEC extension of `packet`'s header, or nullptr if it has none */
+inline const UdpFecHeader* udpFecHeader(const UdpPacket& packet)
+{
+	return (packet.header.flags & UDP_HEADER_FEC) ? reinterpret_cast<const UdpFecHeader*>(packet.payload.data())
+						       : nullptr;
+}
+
+/** @return the first chunk of `packet`, which follows its header extensions */
+inline const uint8_t* udpChunks(const UdpPacket& packet)
+{
+	return packet.payload.data() + udpHeaderSize(packet.header) - sizeof(UdpHeader);
+}
@@ -2,6 +2,7 @@
 
 #include "hashing.hpp"
 #include <array>
+#include <cstring>
 #include <glm/glm.hpp>
 #include <ostream>
 #include <utility>
@@ -22,14 +23,16 @@ struct Vertex final {
 
 using Index = uint32_t;
 
+static_assert(sizeof(Vertex) % sizeof(uint32_t) == 0, "Vertex is hashed a word at a time!");
+
 namespace std {
 template <>
 struct hash<Vertex> {
 	std::size_t operator()(const Vertex& vertex) const
 	{
-		// XXX: is this a good approach?
-		return static_cast<std::size_t>(
-			hashing::fnv1a_hash(reinterpret_cast<const uint8_t*>(&vertex), sizeof(Vertex)));
+		uint32_t words[sizeof(Vertex) / sizeof(uint32_t)];
+		memcpy(words, &vertex, sizeof(Vertex));
+		return static_cast<std::size_t>(hashing::hashWords(words, sizeof(Vertex) / sizeof(uint32_t)));
 	}
 };
 }   // namespace std
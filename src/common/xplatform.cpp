@@ -7,13 +7,17 @@
 #	include <processthreadsapi.h>
 #else
 #	include <csignal>
+#	include <fcntl.h>
 #	include <unistd.h>
 #	include <libgen.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
 #endif
 
 #include "logging.hpp"
 #include <algorithm>
 #include <cassert>
+#include <cerrno>
 #include <cstring>
 #include <iostream>
 #include <thread>
@@ -160,6 +164,15 @@ std::string xplatPath(std::string&& path)
 	return path;
 }
 
+bool xplatMakeDir(const char* path)
+{
+#ifdef _WIN32
+	return CreateDirectoryA(path, nullptr) || GetLastError() == ERROR_ALREADY_EXISTS;
+#else
+	return mkdir(path, 0755) == 0 || errno == EEXIST;
+#endif
+}
+
 #ifdef _WIN32
 // Helper function for setting thread name.
 // See: https://docs.microsoft.com/en-us/visualstudio/debugger/how-to-set-a-thread-name-in-native-code
@@ -204,3 +217,71 @@ void xplatSetThreadName(std::thread& thread, const char* name)
 	pthread_setname_np(thread.native_handle(), nameRW);
 #endif
 }
+
+int xplatGetPid()
+{
+#ifdef _WIN32
+	return static_cast<int>(GetCurrentProcessId());
+#else
+	return static_cast<int>(getpid());
+#endif
+}
+
+const void* xplatMapFile(const char* path, std::size_t& size)
+{
+#ifdef _WIN32
+	const auto file = CreateFileA(
+		path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return nullptr;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+		CloseHandle(file);
+		return nullptr;
+	}
+
+	const auto mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(file);
+	if (!mapping)
+		return nullptr;
+
+	// The view keeps the mapping alive
+	const auto data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	if (!data)
+		return nullptr;
+
+	size = static_cast<std::size_t>(fileSize.QuadPart);
+	return data;
+#else
+	const int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return nullptr;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		close(fd);
+		return nullptr;
+	}
+
+	// The mapping stays valid after closing the file
+	const auto data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return nullptr;
+
+	size = static_cast<std::size_t>(st.st_size);
+	return data;
+#endif
+}
+
+void xplatUnmapFile(const void* data, std::size_t size)
+{
+#ifdef _WIN32
+	(void)size;
+	UnmapViewOfFile(data);
+#else
+	munmap(const_cast<void*>(data), size);
+#endif
+}
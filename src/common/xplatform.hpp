@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <functional>
 #include <string>
 
@@ -38,4 +39,21 @@ std::string xplatBasename(const char* path);
 
 std::string xplatPath(std::string&& str);
 
+/** Creates the directory `path` (but not its parents).
+ *  @return true if the directory was created or already existed.
+ */
+bool xplatMakeDir(const char* path);
+
 void xplatSetThreadName(std::thread& thread, const char* name);
+
+/** @return the id of the current process */
+int xplatGetPid();
+
+/** Maps the whole file `path` into memory, read-only. The mapping is shared, so all the processes mapping
+ *  the same file use the same physical pages.
+ *  @return the address of the mapped file (and sets `size` to its size), or nullptr on failure.
+ */
+const void* xplatMapFile(const char* path, std::size_t& size);
+
+/** Releases a mapping created by xplatMapFile */
+void xplatUnmapFile(const void* data, std::size_t size);
@@ -0,0 +1,651 @@
+/** A headless client measuring how the server scales with the number of sessions it serves.
+ *  It connects a number of sessions to the server, each one requesting the same models, and receives and
+ *  ACKs their geometry like the real client does, without decoding nor rendering it.
+ *  For each number of sessions it reports the aggregate UDP throughput and how long the sessions took to
+ *  receive their whole geometry. The server's own periodic log line reports its side of the same run
+ *  (aggregate throughput and appstage busy time).
+ */
+#include "ack_codec.hpp"
+#include "config.hpp"
+#include "endpoint.hpp"
+#include "logging.hpp"
+#include "quantized_transform.hpp"
+#include "quantized_vertex.hpp"
+#include "shared_resources.hpp"
+#include "tcp_messages.hpp"
+#include "udp_messages.hpp"
+#include "vertex.hpp"
+#include "xplatform.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+using namespace logging;
+
+/** Max number of packets received with a single syscall */
+static constexpr std::size_t PACKETS_PER_BATCH = 64;
+/** Time given to the server to drop the sessions of a step before starting the next one */
+static constexpr auto STEP_PAUSE = std::chrono::seconds{ 2 };
+
+struct MainArgs {
+	std::string ip = "127.0.0.1";
+	int nSessions = 1;
+	/** If true, run with 1, 2, 4, ... sessions up to `nSessions` */
+	bool step = false;
+	int stepSeconds = 30;
+	std::vector<uint16_t> models;
+};
+
+/** @return the size of the geometry update chunk at `ptr` (chunk type excluded), or 0 if it's invalid
+ *  or longer than `maxSize`. `header` is filled with the chunk's header.
+ */
+static std::size_t geomChunkSize(const uint8_t* ptr, std::size_t maxSize, GeomUpdateHeader& header)
+{
+	if (maxSize < sizeof(GeomUpdateHeader))
+		return 0;
+	memcpy(&header, ptr, sizeof(GeomUpdateHeader));
+
+	std::size_t payloadSize;
+	switch (header.dataType) {
+	case GeomDataType::VERTEX:
+		payloadSize = header.len * sizeof(Vertex);
+		break;
+	case GeomDataType::VERTEX_QUANTIZED:
+		payloadSize = header.len * sizeof(QuantizedVertex);
+		break;
+	case GeomDataType::INDEX:
+		payloadSize = header.len * sizeof(Index);
+		break;
+	case GeomDataType::INDEX_COMPRESSED: {
+		if (maxSize < sizeof(GeomUpdateHeader) + sizeof(uint16_t))
+			return 0;
+		uint16_t size;
+		memcpy(&size, ptr + sizeof(GeomUpdateHeader), sizeof(uint16_t));
+		payloadSize = sizeof(uint16_t) + size;
+	} break;
+	default:
+		return 0;
+	}
+
+	const auto chunkSize = sizeof(GeomUpdateHeader) + payloadSize;
+	return chunkSize <= maxSize ? chunkSize : 0;
+}
+
+/** Receives and throws away `len` bytes from the stream socket `socket` */
+static bool skipBulk(socket_t socket, uint64_t len)
+{
+	std::array<uint8_t, 64 * 1024> buffer;
+	while (len > 0) {
+		const auto n = std::min<uint64_t>(len, buffer.size());
+		if (!receiveBulk(socket, buffer.data(), n))
+			return false;
+		len -= n;
+	}
+	return true;
+}
+
+static bool sendTCPMsgWithPayload(socket_t socket, TcpMsgType type, uint16_t payload)
+{
+#pragma pack(push, 1)
+	struct {
+		TcpMsgType type;
+		uint16_t payload;
+	} msg;
+#pragma pack(pop)
+	msg.type = type;
+	msg.payload = payload;
+
+	return sendPacket(socket, reinterpret_cast<uint8_t*>(&msg), sizeof(msg));
+}
+
+/** A single connection to the server. Geometry is ACKed but not stored: only its amount is kept. */
+class LoadSession {
+public:
+	/** Bytes of UDP packets received */
+	std::atomic<uint64_t> bytesReceived{ 0 };
+	/** Geometry chunks received, and how many of them had already been received before */
+	std::atomic<uint64_t> geomChunks{ 0 };
+	std::atomic<uint64_t> geomChunksDup{ 0 };
+	/** Milliseconds it took to receive the whole geometry of the requested models, or -1 if it wasn't yet */
+	std::atomic<int64_t> geometryTimeMs{ -1 };
+
+	explicit LoadSession(uint32_t id)
+		: id{ id }
+	{}
+
+	~LoadSession() { disconnect(); }
+
+	/** Connects to the server at `ip` and requests `models`.
+	 *  @return false if the connection failed.
+	 */
+	bool connect(const char* ip, const std::vector<uint16_t>& models);
+
+	/** Tells the server we're leaving and stops all threads. */
+	void disconnect();
+
+private:
+	const uint32_t id;
+
+	Endpoint reliable;
+	Endpoint udpActive;
+	Endpoint udpPassive;
+	std::size_t maxPacketSize = cfg::PACKET_SIZE_BYTES;
+
+	std::thread tcpThread;
+	std::thread udpThread;
+	std::thread keepaliveThread;
+	std::mutex keepaliveMtx;
+	std::condition_variable keepaliveCv;
+
+	std::chrono::steady_clock::time_point connectTime;
+	std::size_t nModelsRequested = 0;
+	/** Written by the TCP thread, read by the UDP one */
+	std::atomic<std::size_t> nModelsInfoReceived{ 0 };
+	/** Vertices and indices of the models whose info was received */
+	std::atomic<uint64_t> elementsExpected{ 0 };
+	/** Vertices and indices received, each counted once */
+	uint64_t elementsReceived = 0;
+
+	void tcpTask();
+	void udpTask();
+	void keepaliveTask();
+
+	/** Receives the rest of the resource whose first byte (its type) was already received.
+	 *  @return false if the connection failed.
+	 */
+	bool skipResource(TcpMsgType type);
+	void replyToMtuProbe(const UdpPacket& packet, std::size_t packetSize);
+	void sendAcks(std::vector<uint32_t>& toAck);
+};
+
+bool LoadSession::connect(const char* ip, const std::vector<uint16_t>& models)
+{
+	connectTime = std::chrono::steady_clock::now();
+	nModelsRequested = models.size();
+
+	reliable = startEndpoint(ip, cfg::RELIABLE_PORT, Endpoint::Type::ACTIVE, SOCK_STREAM);
+	if (!xplatIsValidSocket(reliable.socket))
+		return false;
+
+	// Handshake: the server replies with its UDP port and the max size of its packets
+	if (!sendTCPMsgWithPayload(reliable.socket, TcpMsgType::HELO, cfg::MAX_UDP_PACKET_SIZE_BYTES))
+		return false;
+	std::array<uint8_t, 1 + 2 * sizeof(uint16_t)> heloAck;
+	if (!receiveBulk(reliable.socket, heloAck.data(), heloAck.size()) ||
+		byte2tcpmsg(heloAck[0]) != TcpMsgType::HELO_ACK)
+		return false;
+	uint16_t serverUdpPort, packetSize;
+	memcpy(&serverUdpPort, heloAck.data() + 1, sizeof(uint16_t));
+	memcpy(&packetSize, heloAck.data() + 1 + sizeof(uint16_t), sizeof(uint16_t));
+	maxPacketSize = std::max<std::size_t>(packetSize, cfg::PACKET_SIZE_BYTES);
+
+	udpActive = startEndpoint(ip, serverUdpPort, Endpoint::Type::ACTIVE, SOCK_DGRAM);
+	udpPassive = startEndpoint("0.0.0.0", 0, Endpoint::Type::PASSIVE, SOCK_DGRAM);
+	if (!xplatIsValidSocket(udpActive.socket) || !xplatIsValidSocket(udpPassive.socket))
+		return false;
+
+	// The server probes the packet size before answering READY: we must be listening already
+	udpThread = std::thread{ &LoadSession::udpTask, this };
+	xplatSetThreadName(udpThread, "LoadUdp");
+
+	uint8_t ready;
+	if (!sendTCPMsgWithPayload(reliable.socket, TcpMsgType::READY, udpPassive.port) ||
+		!receiveBulk(reliable.socket, &ready, 1) || byte2tcpmsg(ready) != TcpMsgType::READY)
+		return false;
+
+	tcpThread = std::thread{ &LoadSession::tcpTask, this };
+	xplatSetThreadName(tcpThread, "LoadTcp");
+	keepaliveThread = std::thread{ &LoadSession::keepaliveTask, this };
+	xplatSetThreadName(keepaliveThread, "LoadKeepalive");
+
+	for (auto model : models) {
+		if (!sendTCPMsgWithPayload(reliable.socket, TcpMsgType::REQ_MODEL, model))
+			return false;
+	}
+
+	return true;
+}
+
+void LoadSession::disconnect()
+{
+	if (reliable.connected)
+		sendTCPMsg(reliable.socket, TcpMsgType::DISCONNECT);
+
+	closeEndpoint(reliable);
+	closeEndpoint(udpPassive);
+	closeEndpoint(udpActive);
+	{
+		// Don't notify the keepalive thread between its check of `reliable` and its wait
+		std::lock_guard<std::mutex> lock{ keepaliveMtx };
+	}
+	keepaliveCv.notify_all();
+
+	for (auto thread : { &tcpThread, &udpThread, &keepaliveThread }) {
+		if (thread->joinable())
+			thread->join();
+	}
+}
+
+void LoadSession::tcpTask()
+{
+	uint16_t nResources = 0;
+	while (reliable.connected) {
+		uint8_t typeByte;
+		if (!receiveBulk(reliable.socket, &typeByte, 1))
+			break;
+
+		const auto type = byte2tcpmsg(typeByte);
+		switch (type) {
+		case TcpMsgType::DISCONNECT:
+			warn("[load session ", id, "] the server dropped us");
+			closeEndpoint(reliable);
+			break;
+		case TcpMsgType::KEEPALIVE:
+			break;
+		case TcpMsgType::START_RSRC_EXCHANGE:
+			nResources = 0;
+			sendTCPMsgWithPayload(reliable.socket, TcpMsgType::RSRC_EXCHANGE_ACK, 0);
+			break;
+		case TcpMsgType::END_RSRC_EXCHANGE:
+			sendTCPMsgWithPayload(reliable.socket, TcpMsgType::RSRC_EXCHANGE_ACK, nResources);
+			break;
+		default:
+			if (!skipResource(type)) {
+				closeEndpoint(reliable);
+				break;
+			}
+			++nResources;
+			break;
+		}
+	}
+}
+
+bool LoadSession::skipResource(TcpMsgType type)
+{
+	// Receive the rest of the header, which tells the size of the payload (if any)
+	std::array<uint8_t, 64> header;
+	static_assert(sizeof(ResourcePacket<shared::TextureMipInfo>) <= sizeof(header), "Header buffer too small!");
+	header[0] = tcpmsg2byte(type);
+	const auto receiveHeader = [this, &header](std::size_t size) {
+		return receiveBulk(reliable.socket, header.data() + 1, size - 1);
+	};
+
+	switch (type) {
+	case TcpMsgType::RSRC_TYPE_TEXTURE: {
+		ResourcePacket<shared::TextureInfo> packet;
+		if (!receiveHeader(sizeof(packet)))
+			return false;
+		memcpy(&packet, header.data(), sizeof(packet));
+		return skipBulk(reliable.socket, packet.res.size);
+	}
+	case TcpMsgType::RSRC_TYPE_TEXTURE_MIP: {
+		ResourcePacket<shared::TextureMipInfo> packet;
+		if (!receiveHeader(sizeof(packet)))
+			return false;
+		memcpy(&packet, header.data(), sizeof(packet));
+		return skipBulk(reliable.socket, packet.res.size);
+	}
+	case TcpMsgType::RSRC_TYPE_SHADER: {
+		ResourcePacket<shared::SpirvShaderInfo> packet;
+		if (!receiveHeader(sizeof(packet)))
+			return false;
+		memcpy(&packet, header.data(), sizeof(packet));
+		return skipBulk(reliable.socket, packet.res.codeSizeInBytes);
+	}
+	case TcpMsgType::RSRC_TYPE_MATERIAL:
+		return receiveHeader(sizeof(ResourcePacket<shared::Material>));
+	case TcpMsgType::RSRC_TYPE_POINT_LIGHT:
+		return receiveHeader(sizeof(ResourcePacket<shared::PointLightInfo>));
+	case TcpMsgType::RSRC_TYPE_MODEL: {
+		ResourcePacket<shared::Model> packet;
+		if (!receiveHeader(sizeof(packet)))
+			return false;
+		memcpy(&packet, header.data(), sizeof(packet));
+		elementsExpected += uint64_t{ packet.res.nVertices } + packet.res.nIndices;
+		++nModelsInfoReceived;
+		// [materials | meshes of each level of detail | levels of detail]
+		const auto lodSize = packet.res.nMeshes * sizeof(shared::Mesh) + sizeof(shared::ModelLod);
+		return skipBulk(reliable.socket, packet.res.nMaterials * sizeof(StringId) + packet.res.nLods * lodSize);
+	}
+	default:
+		err("[load session ", id, "] unexpected TCP message ", type, " (", unsigned(type), ")");
+		return false;
+	}
+}
+
+void LoadSession::udpTask()
+{
+	std::vector<uint8_t> packetPool(PACKETS_PER_BATCH * maxPacketSize);
+	std::array<int, PACKETS_PER_BATCH> packetSizes;
+	std::unordered_set<uint32_t> serialsReceived;
+	std::vector<uint32_t> toAck;
+
+	while (udpPassive.connected) {
+		const auto nPackets = receivePackets(
+			udpPassive.socket, packetPool.data(), maxPacketSize, PACKETS_PER_BATCH, packetSizes.data());
+
+		for (std::size_t i = 0; i < nPackets; ++i) {
+			if (packetSizes[i] < static_cast<int>(sizeof(UdpHeader)))
+				continue;
+			bytesReceived += packetSizes[i];
+
+			const auto packet = reinterpret_cast<const UdpPacket*>(packetPool.data() + i * maxPacketSize);
+			const auto headerSize = udpHeaderSize(packet->header);
+			if (packetSizes[i] < static_cast<int>(headerSize) ||
+				packet->header.size > packetSizes[i] - headerSize)
+				continue;
+
+			// MTU probes are never FEC-protected, so the first byte of their payload is the chunk type
+			if (packet->header.flags == 0 && packet->header.size > 0 &&
+				byte2udpmsg(packet->payload[0]) == UdpMsgType::MTU_PROBE) {
+				replyToMtuProbe(*packet, packetSizes[i]);
+				continue;
+			}
+
+			// Parity packets carry no chunks. Lost packets are not rebuilt: their chunks will be resent.
+			const auto fecHeader = udpFecHeader(*packet);
+			if (fecHeader && fecHeader->groupSize > 0 && fecHeader->index == fecHeader->groupSize)
+				continue;
+
+			// Walk the chunks, only looking into the geometry ones
+			const auto chunks = udpChunks(*packet);
+			std::size_t offset = 0;
+			while (offset < packet->header.size) {
+				const auto ptr = chunks + offset + sizeof(UdpMsgType);
+				const auto maxSize = packet->header.size - offset - sizeof(UdpMsgType);
+				std::size_t chunkSize = 0;
+				switch (byte2udpmsg(chunks[offset])) {
+				case UdpMsgType::GEOM_UPDATE: {
+					GeomUpdateHeader header;
+					chunkSize = geomChunkSize(ptr, maxSize, header);
+					if (chunkSize == 0)
+						break;
+					++geomChunks;
+					if (serialsReceived.insert(header.serialId).second)
+						elementsReceived += header.len;
+					else
+						++geomChunksDup;
+					toAck.emplace_back(header.serialId);
+				} break;
+				case UdpMsgType::POINT_LIGHT_UPDATE:
+					if (sizeof(PointLightUpdateHeader) <= maxSize)
+						chunkSize = sizeof(PointLightUpdateHeader);
+					break;
+				case UdpMsgType::TRANSFORM_UPDATE: {
+					if (maxSize <= sizeof(TransformUpdateHeader))
+						break;
+					glm::vec3 position, scale;
+					glm::quat rotation;
+					const auto payloadSize = decodeTransform(ptr + sizeof(TransformUpdateHeader),
+						maxSize - sizeof(TransformUpdateHeader),
+						position,
+						rotation,
+						scale);
+					if (payloadSize > 0)
+						chunkSize = sizeof(TransformUpdateHeader) + payloadSize;
+				} break;
+				default:
+					break;
+				}
+				if (chunkSize == 0) {
+					warn("[load session ", id, "] invalid chunk: skipping the rest of the packet");
+					break;
+				}
+				offset += sizeof(UdpMsgType) + chunkSize;
+			}
+		}
+
+		if (toAck.size() > 0)
+			sendAcks(toAck);
+
+		if (geometryTimeMs < 0 && nModelsInfoReceived == nModelsRequested && elementsExpected > 0 &&
+			elementsReceived >= elementsExpected) {
+			geometryTimeMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+				std::chrono::steady_clock::now() - connectTime)
+						 .count();
+		}
+	}
+}
+
+void LoadSession::replyToMtuProbe(const UdpPacket& packet, std::size_t packetSize)
+{
+	if (packetSize < sizeof(UdpHeader) + sizeof(UdpMsgType) + sizeof(MtuProbeHeader))
+		return;
+
+	MtuProbeHeader probe;
+	memcpy(&probe, packet.payload.data() + sizeof(UdpMsgType), sizeof(MtuProbeHeader));
+	if (probe.probeSize != packetSize)
+		return;
+
+	MtuProbeAckPacket ack;
+	ack.msgType = UdpMsgType::MTU_PROBE_ACK;
+	ack.probeSize = probe.probeSize;
+	sendPacket(udpActive.socket, reinterpret_cast<const uint8_t*>(&ack), sizeof(MtuProbeAckPacket));
+}
+
+void LoadSession::sendAcks(std::vector<uint32_t>& toAck)
+{
+	// Serial ids are encoded as ranges, so sort them (and drop the ones ACKed twice)
+	std::sort(toAck.begin(), toAck.end());
+	toAck.erase(std::unique(toAck.begin(), toAck.end()), toAck.end());
+
+	std::array<uint8_t, cfg::PACKET_SIZE_BYTES> packet;
+	AckPacketHeader header;
+	header.msgType = UdpMsgType::ACK;
+
+	std::size_t nAcked = 0;
+	while (nAcked < toAck.size()) {
+		std::size_t nRanges, nEncoded;
+		const auto payloadSize = encodeAckRanges(toAck.data() + nAcked,
+			toAck.size() - nAcked,
+			packet.data() + sizeof(AckPacketHeader),
+			packet.size() - sizeof(AckPacketHeader),
+			std::numeric_limits<decltype(header.nRanges)>::max(),
+			nRanges,
+			nEncoded);
+		header.nRanges = nRanges;
+		memcpy(packet.data(), &header, sizeof(AckPacketHeader));
+
+		sendPacket(udpActive.socket, packet.data(), sizeof(AckPacketHeader) + payloadSize);
+		nAcked += nEncoded;
+	}
+	toAck.clear();
+}
+
+void LoadSession::keepaliveTask()
+{
+	std::unique_lock<std::mutex> ulk{ keepaliveMtx };
+	while (reliable.connected) {
+		const auto interval = std::chrono::seconds{ cfg::CLIENT_KEEPALIVE_INTERVAL_SECONDS };
+		if (!keepaliveCv.wait_for(ulk, interval, [this]() { return !reliable.connected; }))
+			sendTCPMsg(reliable.socket, TcpMsgType::KEEPALIVE);
+	}
+}
+
+/** Runs `nSessions` sessions for `seconds` seconds and, if `report` is true, reports what they received. */
+static void runStep(const MainArgs& args, int nSessions, int seconds, bool report = true)
+{
+	std::vector<std::unique_ptr<LoadSession>> sessions;
+	sessions.reserve(nSessions);
+	for (int i = 0; i < nSessions; ++i) {
+		sessions.emplace_back(std::make_unique<LoadSession>(i));
+		if (!sessions.back()->connect(args.ip.c_str(), args.models)) {
+			err("Failed to connect session ", i, ": running with ", i, " sessions");
+			sessions.pop_back();
+			break;
+		}
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+	std::this_thread::sleep_for(std::chrono::seconds{ seconds });
+	const auto end = std::chrono::steady_clock::now();
+	const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() / 1000.f;
+	if (!report)
+		return;
+
+	uint64_t totBytes = 0, totChunks = 0, totDup = 0;
+	uint64_t minBytes = std::numeric_limits<uint64_t>::max(), maxBytes = 0;
+	int64_t sumGeomMs = 0, maxGeomMs = 0;
+	int nComplete = 0;
+	for (const auto& session : sessions) {
+		const uint64_t bytes = session->bytesReceived;
+		totBytes += bytes;
+		minBytes = std::min(minBytes, bytes);
+		maxBytes = std::max(maxBytes, bytes);
+		totChunks += session->geomChunks;
+		totDup += session->geomChunksDup;
+		const int64_t geomMs = session->geometryTimeMs;
+		if (geomMs >= 0) {
+			++nComplete;
+			sumGeomMs += geomMs;
+			maxGeomMs = std::max(maxGeomMs, geomMs);
+		}
+	}
+	if (sessions.empty())
+		minBytes = 0;
+
+	info("Sessions: ",
+		sessions.size(),
+		" | aggregate: ",
+		totBytes / elapsed / 1024,
+		" KiB/s | per session: ",
+		minBytes / elapsed / 1024,
+		" - ",
+		maxBytes / elapsed / 1024,
+		" KiB/s | duplicate chunks: ",
+		totChunks > 0 ? 100.f * totDup / totChunks : 0.f,
+		"% | geometry complete: ",
+		nComplete,
+		"/",
+		sessions.size(),
+		", avg ",
+		nComplete > 0 ? sumGeomMs / nComplete : 0,
+		" ms, max ",
+		maxGeomMs,
+		" ms");
+
+	sessions.clear();
+}
+
+static void parseArgs(int argc, char** argv, MainArgs& args);
+
+int main(int argc, char** argv)
+{
+	MainArgs args = {};
+	parseArgs(argc, argv, args);
+
+	if (!xplatSocketInit()) {
+		err("Failed to initialize sockets.");
+		return EXIT_FAILURE;
+	}
+
+	if (args.models.empty())
+		args.models.emplace_back(0);
+
+	if (args.step) {
+		// Let the server load the models first, so the first step doesn't pay for it
+		info("Warming up...");
+		runStep(args, 1, args.stepSeconds, false);
+
+		std::vector<int> steps;
+		for (int n = 1; n < args.nSessions; n *= 2)
+			steps.emplace_back(n);
+		steps.emplace_back(args.nSessions);
+		for (auto n : steps) {
+			std::this_thread::sleep_for(STEP_PAUSE);
+			runStep(args, n, args.stepSeconds);
+		}
+	} else {
+		runStep(args, args.nSessions, args.stepSeconds);
+	}
+
+	if (!xplatSocketCleanup())
+		warn("Error cleaning up sockets: ", xplatGetErrorString());
+
+	return EXIT_SUCCESS;
+}
+
+void parseArgs(int argc, char** argv, MainArgs& args)
+{
+	const auto usage = [argv]() {
+		std::cerr << "Usage: " << argv[0] << " [-v[vvv...]] [-n (no colored logs)] [-c (n sessions)]"
+			  << " [-s (step from 1 to n sessions)] [-t (seconds per step)] [-m (model to request)...]"
+			  << " [server ip]\n";
+		std::exit(EXIT_FAILURE);
+	};
+
+	int i = 1;
+	int posArgs = 0;
+	while (i < argc) {
+		if (strlen(argv[i]) < 2) {
+			std::cerr << "Invalid flag -.\n";
+			std::exit(EXIT_FAILURE);
+		}
+		if (argv[i][0] == '-') {
+			switch (argv[i][1]) {
+			case 'v': {
+				int lv = 1;
+				unsigned j = 2;
+				while (j < strlen(argv[i]) && argv[i][j] == 'v') {
+					++lv;
+					++j;
+				}
+				gDebugLv = static_cast<LogLevel>(lv);
+			} break;
+			case 'n':
+				gColoredLogs = false;
+				break;
+			case 'c':
+				if (i == argc - 1)
+					usage();
+				args.nSessions = std::atoi(argv[i + 1]);
+				if (args.nSessions < 1 || args.nSessions > cfg::SERVER_MAX_CLIENTS) {
+					std::cerr << "Sessions must be between 1 and " << cfg::SERVER_MAX_CLIENTS
+						  << "\n";
+					std::exit(EXIT_FAILURE);
+				}
+				++i;
+				break;
+			case 's':
+				args.step = true;
+				break;
+			case 't':
+				if (i == argc - 1)
+					usage();
+				args.stepSeconds = std::max(1, std::atoi(argv[i + 1]));
+				++i;
+				break;
+			case 'm':
+				if (i == argc - 1)
+					usage();
+				args.models.emplace_back(static_cast<uint16_t>(std::atoi(argv[i + 1])));
+				++i;
+				break;
+			default:
+				usage();
+			}
+		} else {
+			// Positional args: [serverIp]
+			switch (posArgs++) {
+			case 0:
+				args.ip = std::string{ argv[i] };
+				break;
+			default:
+				break;
+			}
+		}
+		++i;
+	}
+}
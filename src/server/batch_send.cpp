@@ -4,109 +4,174 @@
 #include "server.hpp"
 #include "server_resources.hpp"
 #include "tcp_serialize.hpp"
+#include "texture_cooker.hpp"
 #include "xplatform.hpp"
+#include <algorithm>
+#include <cassert>
+#include <vector>
 
 using namespace logging;
 
-int64_t batch_sendTexture(socket_t clientSocket, Server& server, const std::string& texName, shared::TextureFormat fmt)
+/** Waits for the client's RSRC_EXCHANGE_ACK, which tells how many resources it received since the exchange started.
+ *  Other messages received meanwhile (i.e. model requests) are left in the queue for the TcpActiveThread.
+ */
+static bool waitForExchangeAck(ClientSession& session, uint16_t expectedCount)
+{
+	std::vector<TcpMsg> others;
+	auto msg = session.msgRecvQueue.pop_or_wait();
+	while (msg.type != TcpMsgType::RSRC_EXCHANGE_ACK) {
+		others.emplace_back(msg);
+		msg = session.msgRecvQueue.pop_or_wait();
+	}
+	for (const auto& other : others)
+		session.msgRecvQueue.push(other);
+
+	if (msg.payload != expectedCount) {
+		warn("Client acknowledged ", msg.payload, " resources out of ", expectedCount);
+		return false;
+	}
+
+	return true;
+}
+
+bool batch_startExchange(ClientSession& session)
+{
+	if (!sendTCPMsg(session.clientSocket, TcpMsgType::START_RSRC_EXCHANGE))
+		return false;
+
+	session.nResourcesSent = 0;
+
+	return waitForExchangeAck(session, 0);
+}
+
+bool batch_endExchange(ClientSession& session)
+{
+	if (!sendTCPMsg(session.clientSocket, TcpMsgType::END_RSRC_EXCHANGE))
+		return false;
+
+	return waitForExchangeAck(session, session.nResourcesSent);
+}
+
+int64_t batch_sendTexture(ClientSession& session, const std::string& texName, shared::TextureFormat fmt)
 {
 	if (texName.length() == 0)
 		return 0;
 
 	const auto texSid = sid(texName);
-	if (server.stuffSent.has(texSid, texSid))
+	if (session.stuffSent.has(texSid, texSid))
 		return 0;
 
 	info("* sending texture ", texName);
 
+	// Send the texture cooked, if possible, so the client can upload it as it is
+	const auto cookedPath = cookTexture(texName, fmt, session.server.cwd + DIRSEP + cfg::SERVER_TEXTURE_CACHE_DIR);
+	CookedTextureHeader header;
 	std::size_t bytesSent;
-	bool ok = sendTexture(clientSocket, server.resources, texName, fmt, &bytesSent);
-	if (!ok) {
-		err("batch_sendTexture: failed");
-		return -1;
+	if (cookedPath.length() > 0 && readCookedTextureHeader(cookedPath, header)) {
+		// Start from the smallest levels, so the texture can be used as soon as possible
+		uint16_t firstLevel = 0;
+		while (firstLevel + 1 < header.mipLevels &&
+		       std::max(header.width >> firstLevel, header.height >> firstLevel) >
+			       cfg::SERVER_TEXTURE_FIRST_MIP_SIZE)
+			++firstLevel;
+
+		if (!sendCookedTexture(session.clientSocket, texName, cookedPath, fmt, firstLevel, &bytesSent)) {
+			err("batch_sendTexture: failed");
+			return -1;
+		}
+
+		if (firstLevel > 0) {
+			const auto refinement = TextureRefinement{ texName, cookedPath, firstLevel };
+			session.toClient.texturesToRefine.emplace_back(refinement);
+		}
+
+	} else {
+		warn("Sending texture ", texName, " uncooked");
+		if (!sendTexture(session.clientSocket, texName, texName, fmt, &bytesSent)) {
+			err("batch_sendTexture: failed");
+			return -1;
+		}
 	}
 
-	ok = expectTCPMsg(server, TcpMsgType::RSRC_EXCHANGE_ACK);
-	if (!ok) {
-		warn("Not received RSRC_EXCHANGE_ACK!");
+	++session.nResourcesSent;
+	session.stuffSent.insert(texSid, texSid);
+
+	return static_cast<int64_t>(bytesSent);
+}
+
+int64_t batch_sendTextureMip(ClientSession& session, TextureRefinement& texture)
+{
+	assert(texture.level > 0);
+
+	const uint16_t level = texture.level - 1;
+	std::size_t bytesSent;
+	if (!sendTextureMip(session.clientSocket, texture.name, texture.cookedPath, level, &bytesSent)) {
+		err("batch_sendTextureMip: failed");
 		return -1;
 	}
 
-	server.stuffSent.insert(texSid, texSid);
+	++session.nResourcesSent;
+	texture.level = level;
 
 	return static_cast<int64_t>(bytesSent);
 }
 
 /** Send material (along with textures used by it) */
-static bool batch_sendMaterial(socket_t clientSocket,
-	Server& server,
+static bool batch_sendMaterial(ClientSession& session,
 	/* inout */ std::unordered_set<std::pair<std::string, shared::TextureFormat>>& texturesToSend,
 	const Material& mat)
 {
 	// Don't send the same material twice
-	if (server.stuffSent.has(mat.name, mat.name))
+	if (session.stuffSent.has(mat.name, mat.name))
 		return true;
 
 	debug("sending new material ", mat.name);
 
-	bool ok = sendMaterial(clientSocket, mat);
-	if (!ok) {
+	if (!sendMaterial(session.clientSocket, mat)) {
 		err("Failed sending material");
 		return false;
 	}
-
-	ok = expectTCPMsg(server, TcpMsgType::RSRC_EXCHANGE_ACK);
-	if (!ok) {
-		warn("Not received RSRC_EXCHANGE_ACK!");
-		return false;
-	}
+	++session.nResourcesSent;
 
 	// Send textures later, after geometry
 	texturesToSend.emplace(mat.diffuseTex, shared::TextureFormat::RGBA);
 	texturesToSend.emplace(mat.specularTex, shared::TextureFormat::GREY);
-	texturesToSend.emplace(mat.normalTex, shared::TextureFormat::RGBA);
+	texturesToSend.emplace(mat.normalTex, shared::TextureFormat::NORMAL);
 
-	server.stuffSent.insert(mat.name, mat.name);
+	session.stuffSent.insert(mat.name, mat.name);
 
 	return true;
 }
 
 /** Send model (along with materials used by it) */
-static bool batch_sendModel(socket_t clientSocket,
-	Server& server,
+static bool batch_sendModel(ClientSession& session,
 	/* inout */ std::unordered_set<std::pair<std::string, shared::TextureFormat>>& texturesToSend,
 	const Model& model)
 {
-	if (server.stuffSent.has(model.name, model.name))
+	if (session.stuffSent.has(model.name, model.name))
 		return true;
 
-	bool ok = sendModel(clientSocket, model);
-	if (!ok) {
+	if (!sendModel(session.clientSocket, model)) {
 		err("Failed sending model");
 		return false;
 	}
-
-	ok = expectTCPMsg(server, TcpMsgType::RSRC_EXCHANGE_ACK);
-	if (!ok) {
-		warn("Not received RSRC_EXCHANGE_ACK!");
-		return false;
-	}
+	++session.nResourcesSent;
 
 	info("model.materials = ", model.data->materials.size());
 	for (const auto& mat : model.data->materials) {
-		if (!batch_sendMaterial(clientSocket, server, texturesToSend, mat))
+		if (!batch_sendMaterial(session, texturesToSend, mat))
 			return false;
 	}
 
-	server.stuffSent.insert(model.name, model.name);
+	session.stuffSent.insert(model.name, model.name);
 
 	return true;
 }
 
-static bool batch_sendShaders(socket_t clientSocket, Server& server, const char* baseName, uint8_t shaderStage)
+static bool batch_sendShaders(ClientSession& session, const char* baseName, uint8_t shaderStage)
 {
-	bool ok = sendShader(clientSocket,
-		server.resources,
+	bool ok = sendShader(session.clientSocket,
+		session.server.resources,
 		(std::string{ baseName } + ".vert.spv").c_str(),
 		shaderStage,
 		shared::ShaderStage::VERTEX);
@@ -114,15 +179,10 @@ static bool batch_sendShaders(socket_t clientSocket, Server& server, const char*
 		err("Failed sending shader");
 		return false;
 	}
+	++session.nResourcesSent;
 
-	ok = expectTCPMsg(server, TcpMsgType::RSRC_EXCHANGE_ACK);
-	if (!ok) {
-		warn("Not received RSRC_EXCHANGE_ACK!");
-		return false;
-	}
-
-	ok = sendShader(clientSocket,
-		server.resources,
+	ok = sendShader(session.clientSocket,
+		session.server.resources,
 		(std::string{ baseName } + ".frag.spv").c_str(),
 		shaderStage,
 		shared::ShaderStage::FRAGMENT);
@@ -130,38 +190,28 @@ static bool batch_sendShaders(socket_t clientSocket, Server& server, const char*
 		err("Failed sending shader");
 		return false;
 	}
-
-	ok = expectTCPMsg(server, TcpMsgType::RSRC_EXCHANGE_ACK);
-	if (!ok) {
-		warn("Not received RSRC_EXCHANGE_ACK!");
-		return false;
-	}
+	++session.nResourcesSent;
 
 	return true;
 }
 
-static bool batch_sendPointLight(socket_t clientSocket, Server& server, const shared::PointLight& light)
+static bool batch_sendPointLight(ClientSession& session, const shared::PointLight& light)
 {
-	if (server.stuffSent.has(light.name, light.name))
+	if (session.stuffSent.has(light.name, light.name))
 		return true;
 
-	bool ok = sendPointLight(clientSocket, light);
-	if (!ok) {
+	if (!sendPointLight(session.clientSocket, light)) {
 		err("Failed sending point light");
 		return false;
 	}
-	ok = expectTCPMsg(server, TcpMsgType::RSRC_EXCHANGE_ACK);
-	if (!ok) {
-		warn("Not received RSRC_EXCHANGE_ACK!");
-		return false;
-	}
+	++session.nResourcesSent;
 
-	server.stuffSent.insert(light.name, light.name);
+	session.stuffSent.insert(light.name, light.name);
 
 	return true;
 }
 
-bool sendResourceBatch(socket_t clientSocket, Server& server, const ResourceBatch& batch, TexturesQueue& texturesQueue)
+bool sendResourceBatch(ClientSession& session, const ResourceBatch& batch, TexturesQueue& texturesQueue)
 {
 	std::unordered_set<std::pair<std::string, shared::TextureFormat>> texturesToSend;
 	std::unordered_set<StringId> materialsSent;
@@ -169,7 +219,7 @@ bool sendResourceBatch(socket_t clientSocket, Server& server, const ResourceBatc
 	info("Sending ", batch.models.size(), " models");
 	for (const auto& model : batch.models) {
 		// This will also send dependent materials
-		if (!batch_sendModel(clientSocket, server, texturesToSend, model))
+		if (!batch_sendModel(session, texturesToSend, model))
 			return false;
 
 		texturesQueue.insert(texturesToSend.begin(), texturesToSend.end());
@@ -177,19 +227,21 @@ bool sendResourceBatch(socket_t clientSocket, Server& server, const ResourceBatc
 		// After sending model base info, schedule its geometry to be streamed and add it
 		// to the scene (so its transform will be sent too)
 		{
-			std::lock_guard<std::mutex> lock{ server.toClient.modelsToSendMtx };
-			server.toClient.modelsToSend.emplace_back(model);
+			std::lock_guard<std::mutex> lock{ session.toClient.modelsToSendMtx };
+			session.toClient.modelsToSend.emplace_back(model);
 		}
 
+		auto& server = session.server;
+		std::lock_guard<std::mutex> lock{ server.sceneMtx };
 		auto node = server.scene.addNode(model.name, NodeType::MODEL, Transform{});
 		// Make Sponza static (FIXME: ugly)
 		if (node->name == sid((server.cwd + xplatPath("/models/sponza/sponza.dae")).c_str()))
-			node->flags |= (1 << NODE_FLAG_STATIC);
+			node->flags |= NODE_FLAG_STATIC;
 	}
 
 	// Send lights
 	for (const auto& light : batch.pointLights) {
-		if (!batch_sendPointLight(clientSocket, server, light))
+		if (!batch_sendPointLight(session, light))
 			return false;
 	}
 
@@ -200,9 +252,6 @@ bool sendResourceBatch(socket_t clientSocket, Server& server, const ResourceBatc
 	// resources, shadersToSend[i], i)) return false;
 	//}
 
-	if (!sendTCPMsg(clientSocket, TcpMsgType::END_RSRC_EXCHANGE))
-		return false;
-
 	info("Done sending data");
 
 	return true;
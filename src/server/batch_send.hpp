@@ -7,7 +7,25 @@
 
 struct ResourceBatch;
 
-/** @return Number of bytes sent, or -1 */
-int64_t batch_sendTexture(socket_t clientSocket, Server& server, const std::string& texName, shared::TextureFormat fmt);
+/** Starts a resource exchange with the client. Resources are then sent back to back (via `batch_sendTexture` and
+ *  `sendResourceBatch`), without waiting for the client to acknowledge each of them.
+ */
+bool batch_startExchange(ClientSession& session);
 
-bool sendResourceBatch(socket_t clientSocket, Server& server, const ResourceBatch& batch, TexturesQueue& texturesQueue);
+/** Ends the resource exchange and waits for the client's cumulative acknowledgement.
+ *  @return false if the client didn't receive all the resources sent.
+ */
+bool batch_endExchange(ClientSession& session);
+
+/** Sends a texture, cooked if possible. Cooked textures are sent with only their smallest mip levels
+ *  and queued in the session's `texturesToRefine`.
+ *  @return Number of bytes sent, or -1
+ */
+int64_t batch_sendTexture(ClientSession& session, const std::string& texName, shared::TextureFormat fmt);
+
+/** Sends the next mip level of `texture`, updating its `level`.
+ *  @return Number of bytes sent, or -1
+ */
+int64_t batch_sendTextureMip(ClientSession& session, TextureRefinement& texture);
+
+bool sendResourceBatch(ClientSession& session, const ResourceBatch& batch, TexturesQueue& texturesQueue);
@@ -0,0 +1,221 @@
+#include "bc_encoder.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/** Maps the position of a pixel along the endpoints' segment (0 = second endpoint, 3 = first one)
+ *  to its BC1 index.
+ */
+static constexpr uint8_t COLOR_INDEX[4] = { 1, 3, 2, 0 };
+
+static uint16_t toRgb565(const int* rgb)
+{
+	return static_cast<uint16_t>(((rgb[0] * 31 + 127) / 255) << 11 | ((rgb[1] * 63 + 127) / 255) << 5 |
+				     ((rgb[2] * 31 + 127) / 255));
+}
+
+static void fromRgb565(uint16_t c, int* rgb)
+{
+	const int r = c >> 11;
+	const int g = (c >> 5) & 0x3f;
+	const int b = c & 0x1f;
+	rgb[0] = (r << 3) | (r >> 2);
+	rgb[1] = (g << 2) | (g >> 4);
+	rgb[2] = (b << 3) | (b >> 2);
+}
+
+/** Picks the two endpoints of the color block `rgba` (16 RGBA pixels) */
+static void findColorEndpoints(const uint8_t* rgba, uint16_t& c0, uint16_t& c1)
+{
+	int mn[3], mx[3];
+#ifdef __SSE2__
+	const auto rows = reinterpret_cast<const __m128i*>(rgba);
+	auto vmin = _mm_min_epu8(_mm_min_epu8(_mm_loadu_si128(rows), _mm_loadu_si128(rows + 1)),
+		_mm_min_epu8(_mm_loadu_si128(rows + 2), _mm_loadu_si128(rows + 3)));
+	auto vmax = _mm_max_epu8(_mm_max_epu8(_mm_loadu_si128(rows), _mm_loadu_si128(rows + 1)),
+		_mm_max_epu8(_mm_loadu_si128(rows + 2), _mm_loadu_si128(rows + 3)));
+	// Reduce the 4 pixels left in each register to one
+	vmin = _mm_min_epu8(vmin, _mm_srli_si128(vmin, 8));
+	vmin = _mm_min_epu8(vmin, _mm_srli_si128(vmin, 4));
+	vmax = _mm_max_epu8(vmax, _mm_srli_si128(vmax, 8));
+	vmax = _mm_max_epu8(vmax, _mm_srli_si128(vmax, 4));
+	const auto packedMin = static_cast<uint32_t>(_mm_cvtsi128_si32(vmin));
+	const auto packedMax = static_cast<uint32_t>(_mm_cvtsi128_si32(vmax));
+	for (unsigned c = 0; c < 3; ++c) {
+		mn[c] = (packedMin >> (8 * c)) & 0xff;
+		mx[c] = (packedMax >> (8 * c)) & 0xff;
+	}
+#else
+	for (unsigned c = 0; c < 3; ++c) {
+		mn[c] = 255;
+		mx[c] = 0;
+		for (unsigned i = 0; i < 16; ++i) {
+			mn[c] = std::min(mn[c], int(rgba[4 * i + c]));
+			mx[c] = std::max(mx[c], int(rgba[4 * i + c]));
+		}
+	}
+#endif
+
+	// The bounding box has 4 diagonals: use the one following the colors' trend, flipping the channels
+	// which decrease while the widest one increases.
+	unsigned widest = 0;
+	for (unsigned c = 1; c < 3; ++c) {
+		if (mx[c] - mn[c] > mx[widest] - mn[widest])
+			widest = c;
+	}
+	int sum[3] = {};
+	for (unsigned i = 0; i < 16; ++i) {
+		for (unsigned c = 0; c < 3; ++c)
+			sum[c] += rgba[4 * i + c];
+	}
+	for (unsigned c = 0; c < 3; ++c) {
+		if (c == widest)
+			continue;
+		int cov = 0;
+		for (unsigned i = 0; i < 16; ++i)
+			cov += (16 * rgba[4 * i + widest] - sum[widest]) * (16 * rgba[4 * i + c] - sum[c]);
+		if (cov < 0)
+			std::swap(mn[c], mx[c]);
+	}
+
+	// Inset the box by 1/16 of its size: the extremes are better represented by the interpolated colors
+	for (unsigned c = 0; c < 3; ++c) {
+		const auto inset = (mx[c] - mn[c]) / 16;
+		mx[c] -= inset;
+		mn[c] += inset;
+	}
+
+	c0 = toRgb565(mx);
+	c1 = toRgb565(mn);
+}
+
+/** Encodes the color part of a BC1/BC3 block from 16 RGBA pixels. The block always uses the 4 colors mode. */
+static void encodeColorBlock(const uint8_t* rgba, uint8_t* dst)
+{
+	uint16_t c0, c1;
+	findColorEndpoints(rgba, c0, c1);
+
+	// BC1 uses 4 colors only if c0 > c1
+	if (c0 < c1)
+		std::swap(c0, c1);
+
+	uint32_t indices = 0;
+	if (c0 != c1) {
+		int p0[3], p1[3];
+		fromRgb565(c0, p0);
+		fromRgb565(c1, p1);
+		const int dir[3] = { p0[0] - p1[0], p0[1] - p1[1], p0[2] - p1[2] };
+		const int dirLen2 = dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2];
+
+		// Project each pixel on the segment between the endpoints and take the nearest of its 4 colors
+#ifdef __SSE2__
+		const auto vdir = _mm_setr_epi16(dir[0], dir[1], dir[2], 0, dir[0], dir[1], dir[2], 0);
+		const auto vbase = _mm_setr_epi16(p1[0], p1[1], p1[2], 0, p1[0], p1[1], p1[2], 0);
+		const auto vscale = _mm_set1_ps(3.f / dirLen2);
+		const auto zero = _mm_setzero_si128();
+		const auto three = _mm_set1_epi16(3);
+		alignas(16) int16_t pos[8];
+		for (unsigned row = 0; row < 4; ++row) {
+			const auto px = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgba + 16 * row));
+			// Alpha gets multiplied by 0, so it doesn't matter that it's not zeroed by the subtraction
+			const auto lo = _mm_madd_epi16(_mm_sub_epi16(_mm_unpacklo_epi8(px, zero), vbase), vdir);
+			const auto hi = _mm_madd_epi16(_mm_sub_epi16(_mm_unpackhi_epi8(px, zero), vbase), vdir);
+			// lo = [r*dr + g*dg, b*db] for pixels 0 and 1, hi the same for pixels 2 and 3: sum the pairs
+			const auto evens = _mm_castps_si128(
+				_mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(2, 0, 2, 0)));
+			const auto odds = _mm_castps_si128(
+				_mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(3, 1, 3, 1)));
+			const auto dots = _mm_add_epi32(evens, odds);
+			const auto rounded = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(dots), vscale));
+			const auto packed = _mm_packs_epi32(rounded, rounded);
+			const auto clamped = _mm_max_epi16(_mm_min_epi16(packed, three), zero);
+			_mm_store_si128(reinterpret_cast<__m128i*>(pos), clamped);
+			for (unsigned i = 0; i < 4; ++i)
+				indices |= uint32_t(COLOR_INDEX[pos[i]]) << (2 * (4 * row + i));
+		}
+#else
+		for (unsigned i = 0; i < 16; ++i) {
+			const auto px = rgba + 4 * i;
+			const int dot = (px[0] - p1[0]) * dir[0] + (px[1] - p1[1]) * dir[1] + (px[2] - p1[2]) * dir[2];
+			const auto pos = std::max(0, std::min(3, int(std::lround(dot * 3.f / dirLen2))));
+			indices |= uint32_t(COLOR_INDEX[pos]) << (2 * i);
+		}
+#endif
+	}
+
+	memcpy(dst, &c0, sizeof(uint16_t));
+	memcpy(dst + 2, &c1, sizeof(uint16_t));
+	memcpy(dst + 4, &indices, sizeof(uint32_t));
+}
+
+/** Encodes a BC4 block (also used for BC3's alpha and for each channel of BC5) from 16 values,
+ *  taken every `stride` bytes from `values`. The block always uses the 8 values mode.
+ */
+static void encodeSingleChannelBlock(const uint8_t* values, std::size_t stride, uint8_t* dst)
+{
+	int mn = 255, mx = 0;
+	for (unsigned i = 0; i < 16; ++i) {
+		mn = std::min(mn, int(values[i * stride]));
+		mx = std::max(mx, int(values[i * stride]));
+	}
+
+	dst[0] = static_cast<uint8_t>(mx);
+	dst[1] = static_cast<uint8_t>(mn);
+
+	uint64_t indices = 0;
+	if (mx > mn) {
+		const auto range = mx - mn;
+		for (unsigned i = 0; i < 16; ++i) {
+			// Position of the value between mn (0) and mx (7), mapped to its index: the interpolated
+			// values go from mx to mn.
+			const auto pos = ((values[i * stride] - mn) * 7 + range / 2) / range;
+			const uint64_t index = pos == 7 ? 0 : pos == 0 ? 1 : 8 - pos;
+			indices |= index << (3 * i);
+		}
+	}
+	for (unsigned i = 0; i < 6; ++i)
+		dst[2 + i] = static_cast<uint8_t>(indices >> (8 * i));
+}
+
+void compressImage(const uint8_t* pixels, uint32_t width, uint32_t height, CookedFormat format, uint8_t* dst)
+{
+	const unsigned channels = format == CookedFormat::BC4 ? 1 : 4;
+	const auto blockSize = cookedBlockSize(format);
+
+	alignas(16) uint8_t block[16 * 4];
+	for (uint32_t by = 0; by < height; by += 4) {
+		for (uint32_t bx = 0; bx < width; bx += 4) {
+			// Gather the block, repeating the last row and column if it crosses the border
+			for (uint32_t y = 0; y < 4; ++y) {
+				const auto row = pixels + std::min(by + y, height - 1) * width * channels;
+				for (uint32_t x = 0; x < 4; ++x) {
+					const auto px = row + std::min(bx + x, width - 1) * channels;
+					memcpy(block + (4 * y + x) * channels, px, channels);
+				}
+			}
+
+			switch (format) {
+			case CookedFormat::BC1:
+				encodeColorBlock(block, dst);
+				break;
+			case CookedFormat::BC3:
+				encodeSingleChannelBlock(block + 3, 4, dst);
+				encodeColorBlock(block, dst + 8);
+				break;
+			case CookedFormat::BC4:
+				encodeSingleChannelBlock(block, 1, dst);
+				break;
+			case CookedFormat::BC5:
+				encodeSingleChannelBlock(block, 4, dst);
+				encodeSingleChannelBlock(block + 1, 4, dst + 8);
+				break;
+			default:
+				break;
+			}
+			dst += blockSize;
+		}
+	}
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "cooked_texture.hpp"
+#include <cstddef>
+#include <cstdint>
+
+/** Compresses a `width` x `height` image into the 4x4 blocks of `format`, written row by row into `dst`
+ *  (which must be at least cookedMipSize(format, width, height) bytes long).
+ *  BC4 reads single channel pixels; the other formats read RGBA pixels (BC5 only uses their red and green).
+ *  Blocks crossing the image's border are padded by repeating its last row and column.
+ *  Endpoints are picked from the block's bounding box (as in "Real-Time DXT Compression", van Waveren 2006),
+ *  which is fast enough to cook textures on demand.
+ */
+void compressImage(const uint8_t* pixels, uint32_t width, uint32_t height, CookedFormat format, uint8_t* dst);
@@ -0,0 +1,95 @@
+#include "congestion_controller.hpp"
+#include "config.hpp"
+#include "logging.hpp"
+#include <algorithm>
+
+using namespace logging;
+using namespace std::chrono;
+
+CongestionController::CongestionController(std::size_t packetSize)
+	: packetSize{ float(packetSize) }
+	, minWindow{ cfg::SERVER_CC_MIN_WINDOW_PACKETS * float(packetSize) }
+	, maxWindow{ cfg::SERVER_CC_MAX_WINDOW_PACKETS * float(packetSize) }
+	, window{ cfg::SERVER_CC_INITIAL_WINDOW_PACKETS * float(packetSize) }
+	, slowStartThreshold{ maxWindow }
+	, latestDecrease{ Clock::now() }
+	, nextSendTime{ Clock::now() }
+	, latestLimited{ Clock::now() }
+{}
+
+float CongestionController::rttSeconds() const
+{
+	// Until we have a measure, assume a RTT which doesn't make the initial window too slow or too aggressive
+	const auto rtt = srtt > Clock::duration::zero() ? srtt : milliseconds{ cfg::SERVER_CC_INITIAL_RTT_MS };
+	return duration_cast<duration<float>>(rtt).count();
+}
+
+void CongestionController::decrease(float factor, Clock::time_point now)
+{
+	// React at most once per RTT, as a single congestion episode usually causes several signals
+	if (now - latestDecrease < srtt)
+		return;
+
+	window = std::max(minWindow, window * factor);
+	slowStartThreshold = window;
+	latestDecrease = now;
+	verbose("CongestionController: window decreased to ", window, " B (", rate() / 1024, " KiB/s)");
+}
+
+void CongestionController::onAck(std::size_t bytes,
+	Clock::duration rtt,
+	Clock::duration smoothedRtt,
+	Clock::time_point now)
+{
+	srtt = smoothedRtt;
+	if (rtt > Clock::duration::zero()) {
+		minRtt = std::min(minRtt, rtt);
+		// Delay-based congestion signal: the path is queueing our packets
+		const auto queueingThreshold = minRtt * cfg::SERVER_CC_QUEUEING_RTT_FACTOR +
+					       milliseconds{ cfg::SERVER_CC_QUEUEING_MIN_DELAY_MS };
+		if (rtt > queueingThreshold) {
+			decrease(cfg::SERVER_CC_QUEUEING_DECREASE_FACTOR, now);
+			return;
+		}
+	}
+
+	// Don't grow the window if we're not using it
+	const auto rttEstimate = duration_cast<Clock::duration>(duration<float>{ rttSeconds() });
+	if (now - latestLimited > 2 * rttEstimate)
+		return;
+
+	if (window < slowStartThreshold)
+		window += bytes;
+	else
+		window += packetSize * float(bytes) / window;
+	window = std::min(window, maxWindow);
+}
+
+void CongestionController::onLoss(Clock::time_point now)
+{
+	decrease(0.5f, now);
+}
+
+std::size_t CongestionController::room(std::size_t inFlight, Clock::time_point now)
+{
+	if (inFlight + packetSize > window) {
+		latestLimited = now;
+		return 0;
+	}
+	return window - inFlight;
+}
+
+CongestionController::Clock::duration CongestionController::pace(std::size_t bytes, Clock::time_point now)
+{
+	// Don't accumulate credit while idle, beyond a small burst
+	const auto maxCredit = duration_cast<Clock::duration>(milliseconds{ cfg::SERVER_CC_MAX_BURST_MS });
+	nextSendTime = std::max(nextSendTime, now - maxCredit);
+
+	const auto wait = nextSendTime > now ? nextSendTime - now : Clock::duration::zero();
+	if (wait > Clock::duration::zero())
+		latestLimited = now;
+
+	nextSendTime += duration_cast<Clock::duration>(duration<float>{ bytes / rate() });
+
+	return wait;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "config.hpp"
+#include <chrono>
+#include <cstddef>
+
+/** An AIMD congestion controller adapting the rate at which a session sends data to the path capacity.
+ *  It keeps a congestion window, which grows exponentially (slow start) until the first congestion
+ *  event and then by one packet per window ACKed. The window is halved when updates are lost (their
+ *  retransmission timeout expired) and reduced when the RTT grows well above the minimum observed,
+ *  which means packets are queueing up along the path. The window is cut at most once per RTT.
+ *  The window caps the bytes in flight (sent and neither ACKed nor lost yet), and is also converted into
+ *  a send rate (window / RTT) used to pace the session's sends.
+ *  Window sizes and increments are measured in packets of `packetSize` bytes, the size of the session's packets.
+ */
+class CongestionController {
+public:
+	using Clock = std::chrono::steady_clock;
+
+	explicit CongestionController(std::size_t packetSize = cfg::PACKET_SIZE_BYTES);
+
+	/** Notifies that `bytes` were ACKed. `rtt` is the latest RTT sample, if any, and `srtt` the smoothed RTT. */
+	void onAck(std::size_t bytes, Clock::duration rtt, Clock::duration srtt, Clock::time_point now);
+
+	/** Notifies that some updates were lost. */
+	void onLoss(Clock::time_point now);
+
+	/** @return how many more bytes can be sent while `inFlight` bytes are outstanding (0 if the window is
+	 *  full, which lets it grow on the next ACKs).
+	 */
+	std::size_t room(std::size_t inFlight, Clock::time_point now);
+
+	/** Reserves `bytes` to be sent.
+	 *  @return the time the caller should wait before sending them to respect the current rate.
+	 */
+	Clock::duration pace(std::size_t bytes, Clock::time_point now);
+
+	/** @return the current send rate, in bytes per second */
+	float rate() const { return window / rttSeconds(); }
+
+	/** @return the current congestion window, in bytes */
+	float windowSize() const { return window; }
+
+private:
+	float packetSize;
+	float minWindow;
+	float maxWindow;
+	float window;
+	float slowStartThreshold;
+	Clock::duration srtt = Clock::duration::zero();
+	Clock::duration minRtt = Clock::duration::max();
+	Clock::time_point latestDecrease;
+	/** When the next reserved bytes may be sent */
+	Clock::time_point nextSendTime;
+	/** Latest time pace() made the caller wait or room() found the window full: the window only grows
+	 *  if the sender is using it all.
+	 */
+	Clock::time_point latestLimited;
+
+	float rttSeconds() const;
+	void decrease(float factor, Clock::time_point now);
+};
@@ -1,62 +1,121 @@
 #include "geom_update.hpp"
+#include "camera.hpp"
+#include "index_codec.hpp"
 #include "logging.hpp"
 #include "model.hpp"
+#include "server.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <unordered_map>
 
 using namespace logging;
 
-// TODO: for now, we just update all vertices and indices
-std::vector<GeomUpdateHeader> buildUpdatePackets(const Model& model)
+extern unsigned gFecGroupSize;
+
+/** @return how many of `model`'s indices in [`start`, `end`) fit into `room` bytes once encoded. */
+static uint32_t fitEncodedIndices(const Model& model, uint32_t start, uint32_t end, std::size_t room)
 {
-	// start from 1, so we know 0 is invalid
-	static uint32_t packetSerialId = 1;
+	std::size_t size = 0;
+	Index prev = 0;
+	uint32_t n = 0;
+	while (start + n < end) {
+		const auto idx = model.indices[start + n];
+		const auto idxSize = encodedIndexSize(prev, idx);
+		if (size + idxSize > room)
+			break;
+		size += idxSize;
+		prev = idx;
+		++n;
+	}
+	return n;
+}
 
+// TODO: for now, we just update all vertices and indices
+std::vector<GeomUpdateHeader> buildUpdatePackets(const Model& model, uint32_t& packetSerialId, std::size_t packetSize)
+{
 	std::vector<GeomUpdateHeader> updates;
 
 	// Figure out how many Chunks we need
-	constexpr auto payloadSize = UdpPacket().payload.size();
-	const auto maxVerticesPerPayload = (payloadSize - sizeof(GeomUpdateHeader)) / sizeof(Vertex);
-	const auto maxIndicesPerPayload = (payloadSize - sizeof(GeomUpdateHeader)) / sizeof(Index);
+	const auto payloadSize = packetSize - udpHeaderSize(gFecGroupSize > 0);
+	constexpr auto chunkOverhead = sizeof(UdpMsgType) + sizeof(GeomUpdateHeader);
+	const auto maxVerticesPerPayload = (payloadSize - chunkOverhead) / sizeof(QuantizedVertex);
+	const auto maxIndicesPerPayload = (payloadSize - chunkOverhead) / sizeof(Index);
 
-	updates.reserve(model.nVertices / maxVerticesPerPayload + model.nIndices / maxIndicesPerPayload + 2);
+	// Send the levels of detail from the coarsest one, which is how they're laid out, and never mix two of them
+	// in the same chunk: this way the client can draw a coarse model as soon as its first few chunks arrive.
+	std::vector<shared::ModelLod> tiers;
+	if (model.data && !model.data->lods.empty())
+		tiers.assign(model.data->lods.rbegin(), model.data->lods.rend());
+	else
+		tiers.emplace_back(shared::ModelLod{ 0, model.nVertices, 0, model.nIndices, 0.f });
+
+	updates.reserve(model.nVertices / maxVerticesPerPayload + model.nIndices / maxIndicesPerPayload +
+			2 * tiers.size());
 
-	unsigned i = 0;
 	GeomUpdateHeader header;
 	header.modelId = model.name;
-	header.dataType = GeomDataType::VERTEX;
-	// Shove in all the vertices
-	while (i < model.nVertices) {
-		header.serialId = packetSerialId++;
-		header.start = i;
-		header.len = std::min(
-			static_cast<decltype(maxVerticesPerPayload)>(model.nVertices - i), maxVerticesPerPayload);
-		updates.emplace_back(header);
-
-		i += header.len;
-	}
+	for (const auto& tier : tiers) {
+		header.dataType = GeomDataType::VERTEX_QUANTIZED;
+		// Shove in all the vertices
+		const auto endVertex = tier.firstVertex + tier.nVertices;
+		auto i = tier.firstVertex;
+		while (i < endVertex) {
+			header.serialId = packetSerialId++;
+			header.start = i;
+			header.len = std::min<std::size_t>(endVertex - i, maxVerticesPerPayload);
+			updates.emplace_back(header);
 
-	header.dataType = GeomDataType::INDEX;
-	// We're likely to have spare space in the last packet: fill it with indices if we can
-	const auto spareBytes = maxVerticesPerPayload - i + maxVerticesPerPayload * (i / maxVerticesPerPayload);
-	if (spareBytes >= sizeof(GeomUpdateHeader) + sizeof(Index)) {
-		header.serialId = packetSerialId++;
-		header.start = 0;
-		header.len = (spareBytes - sizeof(GeomUpdateHeader)) / sizeof(Index);
-		updates.emplace_back(header);
-
-		i = header.len;
-	} else {
-		i = 0;
-	}
+			i += header.len;
+		}
 
-	// Now, send indices until we exhaust them
-	while (i < model.nIndices) {
-		header.serialId = packetSerialId++;
-		header.start = i;
-		header.len =
-			std::min(static_cast<decltype(maxIndicesPerPayload)>(model.nIndices - i), maxIndicesPerPayload);
-		updates.emplace_back(header);
+		header.dataType = GeomDataType::INDEX_COMPRESSED;
+		// Compressed index chunks are variable-sized: they're filled with as many indices as they can hold.
+		constexpr auto indexChunkOverhead = chunkOverhead + sizeof(uint16_t);
+		// We're likely to have spare space in the last packet: fill it with indices if we can
+		const auto endIndex = tier.firstIndex + tier.nIndices;
+		const auto lastVertices = tier.nVertices % maxVerticesPerPayload;
+		const auto spareBytes =
+			lastVertices == 0 ? 0 : payloadSize - chunkOverhead - lastVertices * sizeof(QuantizedVertex);
+		i = tier.firstIndex;
+		if (spareBytes > indexChunkOverhead) {
+			header.len = fitEncodedIndices(model, i, endIndex, spareBytes - indexChunkOverhead);
+			if (header.len > 0) {
+				header.serialId = packetSerialId++;
+				header.start = i;
+				updates.emplace_back(header);
 
-		i += header.len;
+				i += header.len;
+			}
+		}
+
+		// Now, send indices until we exhaust them
+		while (i < endIndex) {
+			header.serialId = packetSerialId++;
+			header.start = i;
+			header.len = fitEncodedIndices(model, i, endIndex, payloadSize - indexChunkOverhead);
+			assert(header.len > 0);
+			updates.emplace_back(header);
+
+			i += header.len;
+		}
+	}
+
+	if (gDebugLv >= LOGLV_DEBUG) {
+		std::size_t encodedSize = 0;
+		for (const auto& update : updates) {
+			if (update.dataType == GeomDataType::INDEX_COMPRESSED)
+				encodedSize += encodedIndicesSize(model.indices + update.start, update.len);
+		}
+		debug("Indices of model ",
+			model.name,
+			": ",
+			model.nIndices * sizeof(Index),
+			" B raw, ",
+			encodedSize,
+			" B encoded (ratio: ",
+			encodedSize > 0 ? float(model.nIndices * sizeof(Index)) / encodedSize : 0.f,
+			")");
 	}
 
 	verbose("Updates size for model ",
@@ -64,7 +123,174 @@ std::vector<GeomUpdateHeader> buildUpdatePackets(const Model& model)
 		": ",
 		updates.size(),
 		", guessed: ",
-		model.nVertices / maxVerticesPerPayload + model.nIndices / maxIndicesPerPayload + 2);
+		model.nVertices / maxVerticesPerPayload + model.nIndices / maxIndicesPerPayload + 2 * tiers.size());
 
 	return updates;
 }
+
+/** Importance multiplier for meshes outside the client's field of view: they're still sent,
+ *  just after the visible ones.
+ */
+static constexpr float OUT_OF_VIEW_FACTOR = 0.1f;
+/** Aspect ratio assumed for the client's viewport */
+static constexpr float CLIENT_ASPECT = 16.f / 9.f;
+
+/** @return the segment of `data` the data referenced by `header` belong to. */
+static const MeshSegment& findSegment(const ModelColdData& data, const GeomUpdateHeader& header)
+{
+	std::size_t idx = 0;
+	switch (header.dataType) {
+	case GeomDataType::VERTEX:
+	case GeomDataType::VERTEX_QUANTIZED: {
+		const auto it = std::upper_bound(data.segments.begin(),
+			data.segments.end(),
+			header.start,
+			[](uint32_t start, const MeshSegment& segment) { return start < segment.firstVertex; });
+		idx = it - data.segments.begin();
+	} break;
+	default: {
+		const auto it = std::upper_bound(data.segments.begin(),
+			data.segments.end(),
+			header.start,
+			[](uint32_t start, const MeshSegment& segment) { return start < segment.firstIndex; });
+		idx = it - data.segments.begin();
+	} break;
+	}
+	return data.segments[idx > 0 ? idx - 1 : 0];
+}
+
+/** @return the world transform of node `name`, or the identity if there's no such node. */
+static glm::mat4 worldMatrix(const Scene& scene, StringId name)
+{
+	glm::mat4 mat{ 1.f };
+	for (auto node = scene.getNode(name); node; node = node->parent)
+		mat = node->transform.mat * mat;
+	return mat;
+}
+
+/** @return the importance of each mesh of `model` when seen by `camera`. */
+static std::vector<float> computeMeshImportance(const Model& model,
+	const glm::mat4& modelMat,
+	const Camera& camera,
+	float halfFov)
+{
+	const auto& meshBounds = model.data->meshBounds;
+	std::vector<float> importance(meshBounds.size());
+
+	const auto maxScale = std::max(glm::length(glm::vec3{ modelMat[0] }),
+		std::max(glm::length(glm::vec3{ modelMat[1] }), glm::length(glm::vec3{ modelMat[2] })));
+
+	for (std::size_t i = 0; i < meshBounds.size(); ++i) {
+		const auto& bounds = meshBounds[i];
+		const auto center = glm::vec3{ modelMat * glm::vec4{ (bounds.min + bounds.max) * 0.5f, 1.f } };
+		const auto radius = glm::length(bounds.max - bounds.min) * 0.5f * maxScale;
+		const auto toMesh = center - camera.position;
+		const auto dist = glm::length(toMesh);
+
+		if (dist <= radius) {
+			// Camera is inside the mesh's bounding sphere
+			importance[i] = 1.f;
+			continue;
+		}
+
+		// Roughly proportional to the mesh's size on screen
+		importance[i] = radius / dist;
+
+		// Angle between the view direction and the mesh, minus the angle the mesh spans
+		const auto angle = std::acos(std::max(-1.f, std::min(1.f, glm::dot(toMesh / dist, camera.front))));
+		if (angle - std::asin(radius / dist) > halfFov)
+			importance[i] *= OUT_OF_VIEW_FACTOR;
+	}
+
+	return importance;
+}
+
+void sortGeomUpdatesByImportance(std::vector<QueuedUpdate>& updates,
+	const Server& server,
+	const shared::Camera& clientCamera)
+{
+	Camera camera;
+	camera.position = glm::vec3{ clientCamera.x, clientCamera.y, clientCamera.z };
+	camera.yaw = clientCamera.yaw;
+	camera.pitch = clientCamera.pitch;
+	camera.updateVectors();
+
+	// Half angle of the cone containing the view frustum
+	const auto halfFov =
+		std::atan(std::tan(glm::radians(cfg::CAMERA_FOV_Y_DEGREES) * 0.5f) *
+			  std::sqrt(1.f + CLIENT_ASPECT * CLIENT_ASPECT));
+
+	// Resolve each distinct model once: its data and the importance of each of its meshes
+	struct ModelInfo {
+		Model model;
+		std::vector<float> meshImportance;
+	};
+	std::unordered_map<StringId, ModelInfo> models;
+	for (const auto& update : updates) {
+		if (update.type == QueuedUpdate::Type::GEOM)
+			models.emplace(update.data.geom.data.modelId, ModelInfo{});
+	}
+	{
+		std::shared_lock<std::shared_timed_mutex> lock{ server.resources.modelsMtx };
+		for (auto& pair : models)
+			server.resources.models.lookup(pair.first, pair.first, pair.second.model);
+	}
+	for (auto& pair : models) {
+		const auto& model = pair.second.model;
+		if (!model.data || model.data->segments.empty())
+			continue;
+		glm::mat4 modelMat;
+		{
+			std::lock_guard<std::mutex> lock{ server.sceneMtx };
+			modelMat = worldMatrix(server.scene, pair.first);
+		}
+		pair.second.meshImportance = computeMeshImportance(model, modelMat, camera, halfFov);
+	}
+
+	struct SortKey {
+		/** How many levels of detail the update is away from its model's coarsest one */
+		uint8_t lodRank;
+		float importance;
+		bool isVertex;
+		uint32_t serialId;
+		/** Index of the update in `updates` */
+		uint32_t index;
+	};
+	std::vector<SortKey> keys(updates.size());
+	for (uint32_t i = 0; i < keys.size(); ++i) {
+		auto& key = keys[i];
+		key = SortKey{ 0, 0.f, false, 0, i };
+		const auto& update = updates[i];
+		if (update.type != QueuedUpdate::Type::GEOM)
+			continue;
+
+		const auto& header = update.data.geom.data;
+		key.isVertex =
+			header.dataType == GeomDataType::VERTEX || header.dataType == GeomDataType::VERTEX_QUANTIZED;
+		key.serialId = header.serialId;
+
+		const auto& info = models[header.modelId];
+		if (info.meshImportance.empty())
+			continue;
+		const auto& segment = findSegment(*info.model.data, header);
+		key.importance = info.meshImportance[segment.mesh];
+		key.lodRank = info.model.data->lods.size() - 1 - segment.lod;
+	}
+
+	// Sort the keys rather than the updates themselves, so the comparisons stay cheap
+	std::sort(keys.begin(), keys.end(), [](const SortKey& a, const SortKey& b) {
+		if (a.lodRank != b.lodRank)
+			return a.lodRank < b.lodRank;
+		if (a.importance != b.importance)
+			return a.importance > b.importance;
+		if (a.isVertex != b.isVertex)
+			return a.isVertex;
+		return a.serialId < b.serialId;
+	});
+
+	std::vector<QueuedUpdate> sorted;
+	sorted.reserve(updates.size());
+	for (const auto& key : keys)
+		sorted.emplace_back(updates[key.index]);
+	updates.swap(sorted);
+}
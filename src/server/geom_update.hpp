@@ -5,9 +5,28 @@
 
 struct Model;
 struct GeomUpdateHeader;
+struct QueuedUpdate;
+struct Server;
+namespace shared {
+struct Camera;
+}
 
 /** Given a model, returns a list of QueuedUpdates describing the portions of that model
- *  to be updated. The chunks are built taking the max packet size into account, so they
- *  will all fit an UpdatePacket.
+ *  to be updated. The chunks are built taking the packet size into account, so they
+ *  will all fit an UpdatePacket of `packetSize` bytes.
+ *  The model's levels of detail are split into chunks separately, from the coarsest one.
+ *  Serial ids are assigned starting from `packetSerialId`, which is advanced accordingly.
  */
-std::vector<GeomUpdateHeader> buildUpdatePackets(const Model& model);
+std::vector<GeomUpdateHeader>
+	buildUpdatePackets(const Model& model, uint32_t& packetSerialId, std::size_t packetSize);
+
+/** Sorts the geometry updates in `updates` so that the ones that matter most to a client viewing the
+ *  scene from `camera` come first.
+ *  Coarser levels of detail always come first, so every model gets a rough shape before any one gets refined;
+ *  then, the importance of a chunk is the one of the mesh it belongs to, which grows with its apparent size
+ *  and is lowered if the mesh is outside the client's field of view.
+ *  Chunks with the same importance keep vertices before indices and their serial id order.
+ */
+void sortGeomUpdatesByImportance(std::vector<QueuedUpdate>& updates,
+	const Server& server,
+	const shared::Camera& camera);
@@ -0,0 +1,281 @@
+#include "mesh_optimize.hpp"
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+using shared::Mesh;
+
+/** Size of the FIFO post-transform vertex cache we optimize for: most GPUs have at least this */
+constexpr uint32_t VERTEX_CACHE_SIZE = 16;
+/** How much worse than the cache optimized order the ACMR of the overdraw optimized order may get */
+constexpr float OVERDRAW_ACMR_THRESHOLD = 1.05f;
+
+constexpr auto NO_VERTEX = std::numeric_limits<Index>::max();
+
+/** A FIFO vertex cache simulated with timestamps: a vertex is cached while fewer than VERTEX_CACHE_SIZE
+ *  vertices entered the cache after it.
+ */
+class VertexCache {
+	std::vector<uint32_t> entryTime;
+	uint32_t time = VERTEX_CACHE_SIZE + 1;
+
+public:
+	explicit VertexCache(uint32_t nVertices)
+		: entryTime(nVertices, 0)
+	{}
+
+	bool contains(Index v) const { return time - entryTime[v] <= VERTEX_CACHE_SIZE; }
+
+	/** How long ago `v` entered the cache */
+	uint32_t age(Index v) const { return time - entryTime[v]; }
+
+	/** Uses `v`, making it enter the cache if it's not in it. @return whether it was a cache miss */
+	bool use(Index v)
+	{
+		if (contains(v))
+			return false;
+		entryTime[v] = time++;
+		return true;
+	}
+
+	void flush() { time += VERTEX_CACHE_SIZE + 1; }
+};
+
+/** Reorders the triangles `indices` into `out` for the vertex cache (the "Tipsify" algorithm): it fans
+ *  around a vertex, emitting all its triangles, then moves to the vertex of the last fan which will still be
+ *  cached when all its triangles are emitted, if any, else to the most recently used vertex with triangles left.
+ *  `clusters` is set to the triangles starting each run of such fans, where the cache is not reused.
+ */
+static void tipsify(const Index* indices,
+	std::size_t nIndices,
+	uint32_t nVertices,
+	Index* out,
+	std::vector<uint32_t>& clusters)
+{
+	const auto nTriangles = nIndices / 3;
+
+	// The triangles using vertex v are adjacent[adjacentOffset[v] .. adjacentOffset[v + 1])
+	std::vector<uint32_t> liveTriangles(nVertices, 0);
+	for (std::size_t i = 0; i < nIndices; ++i)
+		++liveTriangles[indices[i]];
+	std::vector<uint32_t> adjacentOffset(nVertices + 1, 0);
+	for (uint32_t v = 0; v < nVertices; ++v)
+		adjacentOffset[v + 1] = adjacentOffset[v] + liveTriangles[v];
+	std::vector<uint32_t> adjacent(nIndices);
+	{
+		auto next = adjacentOffset;
+		for (std::size_t i = 0; i < nIndices; ++i)
+			adjacent[next[indices[i]]++] = i / 3;
+	}
+
+	VertexCache cache{ nVertices };
+	std::vector<bool> emitted(nTriangles, false);
+	std::vector<Index> deadEnds;
+	std::vector<Index> candidates;
+	Index scanCursor = 0;
+	std::size_t nOut = 0;
+
+	// Falls back to the most recently used vertex with triangles left, or else to the first one
+	const auto skipDeadEnd = [&]() {
+		while (!deadEnds.empty()) {
+			const auto v = deadEnds.back();
+			deadEnds.pop_back();
+			if (liveTriangles[v] > 0)
+				return v;
+		}
+		for (; scanCursor < nVertices; ++scanCursor) {
+			if (liveTriangles[scanCursor] > 0)
+				return scanCursor;
+		}
+		return NO_VERTEX;
+	};
+
+	clusters.assign(1, 0);
+	auto fanning = skipDeadEnd();
+	while (fanning != NO_VERTEX) {
+		candidates.clear();
+		for (auto a = adjacentOffset[fanning]; a < adjacentOffset[fanning + 1]; ++a) {
+			const auto t = adjacent[a];
+			if (emitted[t])
+				continue;
+			emitted[t] = true;
+			for (unsigned k = 0; k < 3; ++k) {
+				const auto v = indices[3 * t + k];
+				out[nOut++] = v;
+				deadEnds.emplace_back(v);
+				candidates.emplace_back(v);
+				--liveTriangles[v];
+				cache.use(v);
+			}
+		}
+
+		// Prefer the oldest candidate which stays in the cache while fanning around it
+		Index next = NO_VERTEX;
+		uint32_t bestPriority = 0;
+		for (auto v : candidates) {
+			if (liveTriangles[v] == 0)
+				continue;
+			const auto age = cache.age(v);
+			const auto priority = age + 2 * liveTriangles[v] <= VERTEX_CACHE_SIZE ? age : 0;
+			if (priority > bestPriority) {
+				bestPriority = priority;
+				next = v;
+			}
+		}
+		if (next == NO_VERTEX) {
+			next = skipDeadEnd();
+			if (next != NO_VERTEX)
+				clusters.emplace_back(nOut / 3);
+		}
+		fanning = next;
+	}
+}
+
+/** Reorders the clusters of triangles of `indices` (ordered by tipsify, which found `hardClusters`) into
+ *  `out`, so those facing out of the mesh come first and can occlude the others.
+ *  The clusters are first split further wherever that costs little to the vertex cache.
+ */
+static void optimizeOverdraw(const Index* indices,
+	std::size_t nIndices,
+	const std::vector<glm::vec3>& positions,
+	const std::vector<uint32_t>& hardClusters,
+	Index* out)
+{
+	const auto nTriangles = static_cast<uint32_t>(nIndices / 3);
+	VertexCache cache{ static_cast<uint32_t>(positions.size()) };
+	const auto triangleMisses = [&](uint32_t t) {
+		return cache.use(indices[3 * t]) + cache.use(indices[3 * t + 1]) + cache.use(indices[3 * t + 2]);
+	};
+
+	// Split each cluster where the ACMR of its triangles so far, starting from a cold cache (as
+	// clusters will be reordered), is within the threshold of the ACMR of the whole cluster
+	std::vector<uint32_t> clusters;
+	for (std::size_t c = 0; c < hardClusters.size(); ++c) {
+		const auto start = hardClusters[c];
+		const auto end = c + 1 < hardClusters.size() ? hardClusters[c + 1] : nTriangles;
+
+		cache.flush();
+		uint32_t clusterMisses = 0;
+		for (auto t = start; t < end; ++t)
+			clusterMisses += triangleMisses(t);
+		const auto maxAcmr = OVERDRAW_ACMR_THRESHOLD * clusterMisses / (end - start);
+
+		cache.flush();
+		clusters.emplace_back(start);
+		uint32_t misses = 0;
+		for (auto t = start; t < end; ++t) {
+			misses += triangleMisses(t);
+			if (t + 1 < end && misses <= maxAcmr * (t + 1 - clusters.back())) {
+				clusters.emplace_back(t + 1);
+				misses = 0;
+				cache.flush();
+			}
+		}
+	}
+	const auto nClusters = clusters.size();
+	clusters.emplace_back(nTriangles);
+
+	// Sort the clusters by how much they face out of the mesh: the dot product of their (area weighted)
+	// normal with the direction from the mesh's centroid to theirs.
+	std::vector<glm::vec3> centroids(nClusters, glm::vec3{ 0.f });
+	std::vector<glm::vec3> normals(nClusters, glm::vec3{ 0.f });
+	std::vector<float> areas(nClusters, 0.f);
+	glm::vec3 meshCentroid{ 0.f };
+	float meshArea = 0;
+	for (std::size_t c = 0; c < nClusters; ++c) {
+		for (auto t = clusters[c]; t < clusters[c + 1]; ++t) {
+			const auto& p0 = positions[indices[3 * t]];
+			const auto& p1 = positions[indices[3 * t + 1]];
+			const auto& p2 = positions[indices[3 * t + 2]];
+			const auto normal = glm::cross(p1 - p0, p2 - p0);
+			const auto area = glm::length(normal);
+			centroids[c] += (p0 + p1 + p2) * (area / 3.f);
+			normals[c] += normal;
+			areas[c] += area;
+		}
+		meshCentroid += centroids[c];
+		meshArea += areas[c];
+	}
+	if (meshArea > 0)
+		meshCentroid = meshCentroid / meshArea;
+
+	std::vector<float> sortKeys(nClusters, 0.f);
+	for (std::size_t c = 0; c < nClusters; ++c) {
+		const auto normalLen = glm::length(normals[c]);
+		if (areas[c] > 0 && normalLen > 0)
+			sortKeys[c] = glm::dot(centroids[c] / areas[c] - meshCentroid, normals[c] / normalLen);
+	}
+
+	std::vector<uint32_t> order(nClusters);
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(
+		order.begin(), order.end(), [&sortKeys](uint32_t a, uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+	for (auto c : order) {
+		const auto first = indices + 3 * clusters[c];
+		out = std::copy(first, indices + 3 * clusters[c + 1], out);
+	}
+}
+
+VertexCacheStats analyzeVertexCache(const Index* indices, std::size_t nIndices, uint32_t nVertices)
+{
+	VertexCacheStats stats;
+	if (nIndices < 3)
+		return stats;
+
+	VertexCache cache{ nVertices };
+	std::vector<bool> used(nVertices, false);
+	uint32_t misses = 0, nUsed = 0;
+	for (std::size_t i = 0; i < nIndices; ++i) {
+		misses += cache.use(indices[i]);
+		if (!used[indices[i]]) {
+			used[indices[i]] = true;
+			++nUsed;
+		}
+	}
+	stats.acmr = static_cast<float>(misses) / (nIndices / 3);
+	stats.atvr = static_cast<float>(misses) / nUsed;
+
+	return stats;
+}
+
+void optimizeMeshes(std::vector<Index>& indices,
+	const std::vector<Mesh>& meshes,
+	const Vertex* vertices,
+	uint32_t nVertices)
+{
+	// Each mesh is optimized with its own vertices only, numbered locally, so the work is proportional to its
+	// size rather than to the model's.
+	std::vector<Index> localIndex(nVertices, NO_VERTEX);
+	std::vector<Index> modelIndex;
+	std::vector<glm::vec3> positions;
+	std::vector<Index> local, tipsified, optimized;
+	std::vector<uint32_t> clusters;
+	for (const auto& mesh : meshes) {
+		if (mesh.len < 6)
+			continue;
+
+		modelIndex.clear();
+		positions.clear();
+		local.resize(mesh.len);
+		for (uint32_t i = 0; i < mesh.len; ++i) {
+			const auto v = indices[mesh.offset + i];
+			if (localIndex[v] == NO_VERTEX) {
+				localIndex[v] = modelIndex.size();
+				modelIndex.emplace_back(v);
+				positions.emplace_back(vertices[v].pos);
+			}
+			local[i] = localIndex[v];
+		}
+
+		tipsified.resize(mesh.len);
+		tipsify(local.data(), mesh.len, modelIndex.size(), tipsified.data(), clusters);
+		optimized.resize(mesh.len);
+		optimizeOverdraw(tipsified.data(), mesh.len, positions, clusters, optimized.data());
+
+		for (uint32_t i = 0; i < mesh.len; ++i)
+			indices[mesh.offset + i] = modelIndex[optimized[i]];
+		for (auto v : modelIndex)
+			localIndex[v] = NO_VERTEX;
+	}
+}
@@ -0,0 +1,415 @@
+#include "mesh_simplify.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+/** How a vertex can be collapsed, depending on the topology around it */
+enum class VertexKind : uint8_t {
+	/** Surrounded by triangles: can be collapsed onto any neighbour */
+	MANIFOLD,
+	/** On a border of the mesh: can only be collapsed along the border */
+	BORDER,
+	/** On a UV seam, i.e. sharing its position with another (twin) vertex on the other side of the seam.
+	 *  Can only be collapsed along the seam, together with its twin.
+	 */
+	SEAM,
+	/** Can't be collapsed (e.g. it's where several seams meet) */
+	LOCKED,
+};
+
+static constexpr Index NO_VERTEX = std::numeric_limits<Index>::max();
+
+/** Weight of the planes keeping borders and seams in place, relative to the triangles' ones */
+static constexpr float BORDER_WEIGHT = 10.f;
+/** Max passes of edge collapses */
+static constexpr unsigned MAX_PASSES = 100;
+
+/** Sum of the squared distances from a set of planes, stored as the symmetric matrix [A b; b' c]
+ *  (the error of point p being p'Ap + 2b'p + c), along with the total weight of the planes.
+ */
+struct Quadric {
+	float a00 = 0, a11 = 0, a22 = 0, a01 = 0, a02 = 0, a12 = 0;
+	float b0 = 0, b1 = 0, b2 = 0;
+	float c = 0;
+	float w = 0;
+};
+
+/** Triangles around each vertex: the ones around vertex v are triangles[offsets[v]] to
+ *  triangles[offsets[v + 1] - 1], each one stored as the index of its first corner.
+ */
+struct Adjacency {
+	std::vector<uint32_t> offsets;
+	std::vector<uint32_t> triangles;
+};
+
+struct Collapse {
+	Index from;
+	Index to;
+	float error;
+};
+
+/** @return the quadric of the plane n.p + d = 0, with weight `w` */
+static Quadric planeQuadric(const glm::vec3& n, float d, float w)
+{
+	Quadric q;
+	q.a00 = w * n.x * n.x;
+	q.a11 = w * n.y * n.y;
+	q.a22 = w * n.z * n.z;
+	q.a01 = w * n.x * n.y;
+	q.a02 = w * n.x * n.z;
+	q.a12 = w * n.y * n.z;
+	q.b0 = w * n.x * d;
+	q.b1 = w * n.y * d;
+	q.b2 = w * n.z * d;
+	q.c = w * d * d;
+	q.w = w;
+	return q;
+}
+
+static void addQuadric(Quadric& q, const Quadric& other)
+{
+	q.a00 += other.a00;
+	q.a11 += other.a11;
+	q.a22 += other.a22;
+	q.a01 += other.a01;
+	q.a02 += other.a02;
+	q.a12 += other.a12;
+	q.b0 += other.b0;
+	q.b1 += other.b1;
+	q.b2 += other.b2;
+	q.c += other.c;
+	q.w += other.w;
+}
+
+/** @return the weighted mean of the squared distances of `p` from the planes of `q` */
+static float quadricError(const Quadric& q, const glm::vec3& p)
+{
+	// p'Ap + 2b'p + c = p'(Ap + b) + b'p + c
+	const auto rx = q.a00 * p.x + q.a01 * p.y + q.a02 * p.z + q.b0;
+	const auto ry = q.a01 * p.x + q.a11 * p.y + q.a12 * p.z + q.b1;
+	const auto rz = q.a02 * p.x + q.a12 * p.y + q.a22 * p.z + q.b2;
+	const auto error = rx * p.x + ry * p.y + rz * p.z + q.b0 * p.x + q.b1 * p.y + q.b2 * p.z + q.c;
+	return q.w > 0 ? std::abs(error) / q.w : 0.f;
+}
+
+static void buildAdjacency(const std::vector<Index>& indices, uint32_t nVertices, Adjacency& adj)
+{
+	adj.offsets.assign(nVertices + 1, 0);
+	for (auto idx : indices)
+		++adj.offsets[idx + 1];
+	for (uint32_t v = 0; v < nVertices; ++v)
+		adj.offsets[v + 1] += adj.offsets[v];
+
+	adj.triangles.resize(indices.size());
+	std::vector<uint32_t> next{ adj.offsets.begin(), adj.offsets.end() - 1 };
+	for (uint32_t i = 0; i < indices.size(); i += 3) {
+		for (unsigned k = 0; k < 3; ++k)
+			adj.triangles[next[indices[i + k]]++] = i;
+	}
+}
+
+/** @return whether some triangle has an edge going from `a` to `b` */
+static bool hasEdge(const Adjacency& adj, const std::vector<Index>& indices, Index a, Index b)
+{
+	for (auto t = adj.offsets[a]; t < adj.offsets[a + 1]; ++t) {
+		const auto tri = &indices[adj.triangles[t]];
+		if ((tri[0] == a && tri[1] == b) || (tri[1] == a && tri[2] == b) || (tri[2] == a && tri[0] == b))
+			return true;
+	}
+	return false;
+}
+
+/** Groups the vertices with the same position: `rep[v]` is the same for all of them, and `twin[v]` is the next
+ *  one in a circular list (v itself if its position is unique).
+ */
+static void findTwins(const std::vector<glm::vec3>& positions, std::vector<Index>& rep, std::vector<Index>& twin)
+{
+	const auto n = static_cast<Index>(positions.size());
+	std::vector<Index> order(n);
+	std::iota(order.begin(), order.end(), 0);
+	const auto lessPos = [&positions](Index a, Index b) {
+		const auto &pa = positions[a], &pb = positions[b];
+		return pa.x != pb.x ? pa.x < pb.x : pa.y != pb.y ? pa.y < pb.y : pa.z < pb.z;
+	};
+	std::sort(order.begin(), order.end(), lessPos);
+
+	rep.resize(n);
+	twin.resize(n);
+	for (Index i = 0; i < n;) {
+		auto j = i + 1;
+		while (j < n && positions[order[j]] == positions[order[i]])
+			++j;
+		for (auto k = i; k < j; ++k) {
+			rep[order[k]] = order[i];
+			twin[order[k]] = order[k + 1 < j ? k + 1 : i];
+		}
+		i = j;
+	}
+}
+
+/** @return whether moving vertex `a` onto vertex `b` would flip any of the triangles around `a` */
+static bool flipsTriangles(const Adjacency& adj,
+	const std::vector<Index>& indices,
+	const std::vector<glm::vec3>& positions,
+	Index a,
+	Index b)
+{
+	for (auto t = adj.offsets[a]; t < adj.offsets[a + 1]; ++t) {
+		const auto tri = &indices[adj.triangles[t]];
+		const unsigned k = tri[0] == a ? 0 : tri[1] == a ? 1 : 2;
+		const auto v1 = tri[(k + 1) % 3];
+		const auto v2 = tri[(k + 2) % 3];
+		// This triangle collapses
+		if (v1 == b || v2 == b)
+			continue;
+
+		const auto& p1 = positions[v1];
+		const auto& p2 = positions[v2];
+		const auto oldNormal = glm::cross(p1 - positions[a], p2 - positions[a]);
+		const auto newNormal = glm::cross(p1 - positions[b], p2 - positions[b]);
+		if (glm::dot(oldNormal, newNormal) <= 0)
+			return true;
+	}
+	return false;
+}
+
+/** @return how many triangles around `a` also use `b`, i.e. are removed by collapsing `a` onto `b` */
+static unsigned countSharedTriangles(const Adjacency& adj, const std::vector<Index>& indices, Index a, Index b)
+{
+	unsigned count = 0;
+	for (auto t = adj.offsets[a]; t < adj.offsets[a + 1]; ++t) {
+		const auto tri = &indices[adj.triangles[t]];
+		count += tri[0] == b || tri[1] == b || tri[2] == b;
+	}
+	return count;
+}
+
+std::vector<Index> simplifyMesh(const Vertex* vertices,
+	uint32_t nVertices,
+	const std::vector<Index>& indices,
+	std::size_t targetIndexCount,
+	float& outError)
+{
+	std::vector<Index> remap(nVertices);
+	std::iota(remap.begin(), remap.end(), 0);
+	outError = 0;
+	if (nVertices == 0 || indices.size() <= targetIndexCount)
+		return remap;
+
+	// Work on positions scaled to the unit cube, so the quadrics' precision doesn't depend on the model's size
+	glm::vec3 min{ std::numeric_limits<float>::max() };
+	glm::vec3 max{ std::numeric_limits<float>::lowest() };
+	for (uint32_t v = 0; v < nVertices; ++v) {
+		min = glm::min(min, vertices[v].pos);
+		max = glm::max(max, vertices[v].pos);
+	}
+	const auto extent = std::max(max.x - min.x, std::max(max.y - min.y, max.z - min.z));
+	const auto scale = extent > 0 ? 1.f / extent : 1.f;
+	std::vector<glm::vec3> positions(nVertices);
+	for (uint32_t v = 0; v < nVertices; ++v)
+		positions[v] = (vertices[v].pos - min) * scale;
+
+	std::vector<Index> current = indices;
+	Adjacency adj;
+	buildAdjacency(current, nVertices, adj);
+
+	std::vector<Index> rep, twin;
+	findTwins(positions, rep, twin);
+
+	// Find the open edges (those without a twin edge going the other way), i.e. borders and seams.
+	// A border or seam vertex must have exactly one going out of it and one coming into it.
+	std::vector<Index> openOut(nVertices, NO_VERTEX), openIn(nVertices, NO_VERTEX);
+	std::vector<uint8_t> nOpenOut(nVertices, 0), nOpenIn(nVertices, 0);
+	for (std::size_t i = 0; i < current.size(); ++i) {
+		const auto a = current[i];
+		const auto b = current[i % 3 == 2 ? i - 2 : i + 1];
+		if (!hasEdge(adj, current, b, a)) {
+			openOut[a] = b;
+			openIn[b] = a;
+			nOpenOut[a] = std::min(nOpenOut[a] + 1, 2);
+			nOpenIn[b] = std::min(nOpenIn[b] + 1, 2);
+		}
+	}
+
+	std::vector<VertexKind> kind(nVertices, VertexKind::LOCKED);
+	for (Index v = 0; v < nVertices; ++v) {
+		const bool open = nOpenOut[v] > 0 || nOpenIn[v] > 0;
+		const bool simpleOpen = nOpenOut[v] == 1 && nOpenIn[v] == 1;
+		const auto t = twin[v];
+		if (t == v) {
+			kind[v] = !open ? VertexKind::MANIFOLD : simpleOpen ? VertexKind::BORDER : VertexKind::LOCKED;
+		} else if (twin[t] == v && simpleOpen && nOpenOut[t] == 1 && nOpenIn[t] == 1 &&
+			   rep[openOut[v]] == rep[openIn[t]] && rep[openIn[v]] == rep[openOut[t]]) {
+			// The two sides of the seam run along the same edges, in opposite directions
+			kind[v] = VertexKind::SEAM;
+		}
+	}
+
+	// Each vertex's quadric holds the planes of the triangles around it, plus the planes perpendicular to them
+	// through their open edges, which keep borders and seams from moving. Twins share the same quadric.
+	std::vector<Quadric> quadrics(nVertices);
+	for (std::size_t i = 0; i < current.size(); i += 3) {
+		const auto& p0 = positions[current[i]];
+		const auto cross = glm::cross(positions[current[i + 1]] - p0, positions[current[i + 2]] - p0);
+		const auto doubleArea = glm::length(cross);
+		if (doubleArea == 0)
+			continue;
+
+		const auto normal = cross / doubleArea;
+		const auto plane = planeQuadric(normal, -glm::dot(normal, p0), doubleArea * 0.5f);
+		for (unsigned k = 0; k < 3; ++k)
+			addQuadric(quadrics[rep[current[i + k]]], plane);
+
+		for (unsigned k = 0; k < 3; ++k) {
+			const auto a = current[i + k];
+			const auto b = current[i + (k + 1) % 3];
+			if (hasEdge(adj, current, b, a))
+				continue;
+			const auto edge = positions[b] - positions[a];
+			const auto edgeLen = glm::length(edge);
+			if (edgeLen == 0)
+				continue;
+			const auto edgeNormal = glm::normalize(glm::cross(edge, normal));
+			const auto edgePlane = planeQuadric(edgeNormal,
+				-glm::dot(edgeNormal, positions[a]),
+				edgeLen * edgeLen * BORDER_WEIGHT);
+			addQuadric(quadrics[rep[a]], edgePlane);
+			addQuadric(quadrics[rep[b]], edgePlane);
+		}
+	}
+
+	const auto canCollapse = [&](Index a, Index b) {
+		switch (kind[a]) {
+		case VertexKind::MANIFOLD:
+			return true;
+		case VertexKind::BORDER:
+		case VertexKind::SEAM:
+			return b == openOut[a] || b == openIn[a];
+		default:
+			return false;
+		}
+	};
+
+	float maxError = 0;
+	std::vector<Collapse> collapses;
+	std::vector<Index> passRemap(nVertices);
+	std::vector<uint8_t> touched(nVertices);
+	for (unsigned pass = 0; pass < MAX_PASSES && current.size() > targetIndexCount; ++pass) {
+		if (pass > 0)
+			buildAdjacency(current, nVertices, adj);
+
+		// Find the cheapest way to collapse each edge
+		collapses.clear();
+		for (std::size_t i = 0; i < current.size(); ++i) {
+			const auto a = current[i];
+			const auto b = current[i % 3 == 2 ? i - 2 : i + 1];
+			// Edges between two triangles show up twice: only consider them once
+			if (a > b && hasEdge(adj, current, b, a))
+				continue;
+
+			Collapse collapse{ a, b, std::numeric_limits<float>::max() };
+			if (canCollapse(a, b))
+				collapse.error = quadricError(quadrics[rep[a]], positions[b]);
+			if (canCollapse(b, a)) {
+				const auto error = quadricError(quadrics[rep[b]], positions[a]);
+				if (error < collapse.error)
+					collapse = Collapse{ b, a, error };
+			}
+			if (collapse.error < std::numeric_limits<float>::max())
+				collapses.emplace_back(collapse);
+		}
+		if (collapses.empty())
+			break;
+
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) {
+			return a.error < b.error;
+		});
+
+		// Each collapse removes about 2 triangles. Only go a bit past the error of the collapses needed to
+		// reach the target (not counting the rejected ones): the next ones are left to the next passes,
+		// where their quadrics are up to date.
+		const auto trianglesToRemove = (current.size() - targetIndexCount) / 3;
+		const auto collapsesNeeded = std::max<std::size_t>(trianglesToRemove / 2, 1);
+
+		std::iota(passRemap.begin(), passRemap.end(), 0);
+		std::fill(touched.begin(), touched.end(), 0);
+		std::size_t trianglesRemoved = 0;
+		std::size_t nCollapsed = 0;
+		std::size_t nRejected = 0;
+		for (const auto& collapse : collapses) {
+			const auto goalIdx = std::min(collapsesNeeded + nRejected, collapses.size() - 1);
+			if (collapse.error > 1.5f * collapses[goalIdx].error || trianglesRemoved >= trianglesToRemove)
+				break;
+
+			// Only collapse each vertex (and its twin) once per pass: the quadrics and adjacency of the
+			// others are still valid.
+			const auto a = collapse.from;
+			const auto b = collapse.to;
+			if (touched[rep[a]] || touched[rep[b]])
+				continue;
+
+			// A seam vertex brings its twin along, onto the twin of its target
+			const bool isSeam = kind[a] == VertexKind::SEAM;
+			const auto ta = twin[a];
+			const auto tb = b == openOut[a] ? openIn[ta] : openOut[ta];
+
+			if (flipsTriangles(adj, current, positions, a, b) ||
+				(isSeam && flipsTriangles(adj, current, positions, ta, tb))) {
+				++nRejected;
+				continue;
+			}
+
+			trianglesRemoved += countSharedTriangles(adj, current, a, b);
+			passRemap[a] = b;
+			if (kind[a] != VertexKind::MANIFOLD) {
+				// b takes a's place along the border
+				if (b == openOut[a])
+					openIn[b] = openIn[a];
+				else
+					openOut[b] = openOut[a];
+			}
+			if (isSeam) {
+				trianglesRemoved += countSharedTriangles(adj, current, ta, tb);
+				passRemap[ta] = tb;
+				if (tb == openOut[ta])
+					openIn[tb] = openIn[ta];
+				else
+					openOut[tb] = openOut[ta];
+			}
+
+			addQuadric(quadrics[rep[b]], quadrics[rep[a]]);
+			touched[rep[a]] = touched[rep[b]] = 1;
+			maxError = std::max(maxError, collapse.error);
+			++nCollapsed;
+		}
+		if (nCollapsed == 0)
+			break;
+
+		// Apply the collapses and drop the triangles which became degenerate
+		std::size_t nIndices = 0;
+		for (std::size_t i = 0; i < current.size(); i += 3) {
+			const auto v0 = passRemap[current[i]];
+			const auto v1 = passRemap[current[i + 1]];
+			const auto v2 = passRemap[current[i + 2]];
+			if (v0 == v1 || v1 == v2 || v2 == v0)
+				continue;
+			current[nIndices++] = v0;
+			current[nIndices++] = v1;
+			current[nIndices++] = v2;
+		}
+		current.resize(nIndices);
+
+		for (Index v = 0; v < nVertices; ++v) {
+			remap[v] = passRemap[remap[v]];
+			if (openOut[v] != NO_VERTEX)
+				openOut[v] = passRemap[openOut[v]];
+			if (openIn[v] != NO_VERTEX)
+				openIn[v] = passRemap[openIn[v]];
+		}
+	}
+
+	outError = std::sqrt(maxError) / scale;
+
+	return remap;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "vertex.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/** Simplifies the triangle list `indices` (into `vertices`) by collapsing its edges, cheapest first according to
+ *  their quadric error ("Surface Simplification Using Quadric Error Metrics", Garland and Heckbert 1997), until
+ *  no more than `targetIndexCount` indices are left or no edge can be collapsed anymore.
+ *  Vertices are only collapsed onto existing ones, so the simplified triangles use a subset of `vertices`.
+ *  Borders and UV seams only collapse along themselves, so they keep their shape and don't crack, and collapses
+ *  which would flip a triangle are discarded.
+ *  @return the table mapping each vertex to the one it was collapsed onto (or to itself): remapping `indices`
+ *  through it and dropping the triangles which became degenerate yields the simplified triangles.
+ *  `outError` is set to the approximate distance between the simplified surface and the original one.
+ */
+std::vector<Index> simplifyMesh(const Vertex* vertices,
+	uint32_t nVertices,
+	const std::vector<Index>& indices,
+	std::size_t targetIndexCount,
+	float& outError);
@@ -1,14 +1,20 @@
 #include "model.hpp"
 #include "cf_hashmap.hpp"
+#include "config.hpp"
 #include "defer.hpp"
 #include "logging.hpp"
+#include "mesh_optimize.hpp"
+#include "mesh_simplify.hpp"
+#include "parallel_for.hpp"
 #include "profile.hpp"
 #include "xplatform.hpp"
 #include <assimp/Importer.hpp>
 #include <assimp/postprocess.h>
 #include <assimp/scene.h>
+#include <algorithm>
 #include <chrono>
 #include <iostream>
+#include <limits>
 #include <memory>
 
 using namespace logging;
@@ -29,7 +35,26 @@ using shared::Mesh;
 		}                                                                                                     \
 	} while (false)
 
+/** The vertices of a single mesh, deduplicated on their own */
+struct MeshVertices {
+	/** The mesh's unique vertices, in order of first appearance */
+	std::vector<Vertex> unique;
+	/** The hashes of `unique` */
+	std::vector<uint32_t> hashes;
+	/** The mesh's indices, into `unique` */
+	std::vector<Index> indices;
+	/** Maps each of `unique` to the model's vertex it became */
+	std::vector<Index> remap;
+	MeshBounds bounds;
+};
+
+static void dedupMeshVertices(const aiMesh* shape, MeshVertices& out);
 static Material saveMaterial(const char* modelPath, const aiMaterial* mat);
+static void buildLods(Vertex* vertices,
+	uint32_t nVertices,
+	const std::vector<Index>& indices,
+	ModelColdData& data,
+	std::vector<Index>& outIndices);
 
 Model loadModel(const char* modelPath, void* buffer, ModelColdData* coldData, std::size_t bufsize)
 {
@@ -40,9 +65,9 @@ Model loadModel(const char* modelPath, void* buffer, ModelColdData* coldData, st
 	const aiScene* scene;
 
 	measure_ms((std::string{ "Load model " } + modelPathBase).c_str(), LOGLV_INFO, [&]() {
+		// buildLods orders the triangles for the vertex cache, so aiProcess_ImproveCacheLocality is not needed
 		scene = importer.ReadFile(modelPath,
-			aiProcess_PreTransformVertices | aiProcess_Triangulate | aiProcess_CalcTangentSpace |
-				aiProcess_ImproveCacheLocality);
+			aiProcess_PreTransformVertices | aiProcess_Triangulate | aiProcess_CalcTangentSpace);
 	});
 
 	if (!scene) {
@@ -50,83 +75,51 @@ Model loadModel(const char* modelPath, void* buffer, ModelColdData* coldData, st
 		return model;
 	}
 
-	// Use a map big enough to contain all vertices in the scene
+	// Deduplicate the vertices of each mesh in parallel, then merge the meshes in order: each vertex keeps the
+	// index of its first appearance in the model, so the result is the same as deduplicating them serially.
+	START_PROFILE(process);
+	std::vector<MeshVertices> meshVertices(scene->mNumMeshes);
+	parallelFor(scene->mNumMeshes, cfg::SERVER_MODEL_IMPORT_THREADS, [&](std::size_t i) {
+		dedupMeshVertices(scene->mMeshes[i], meshVertices[i]);
+	});
+
 	uint64_t nTotVertices = 0;
-	for (unsigned i = 0; i < scene->mNumMeshes; ++i)
-		nTotVertices += scene->mMeshes[i]->mNumVertices;
-	const auto uniqueVerticesSize = CF_HASHMAP_GET_BUFFER_SIZE(Vertex, uint32_t, nTotVertices);
+	std::size_t nTotIndices = 0;
+	for (const auto& mv : meshVertices) {
+		nTotVertices += mv.unique.size();
+		nTotIndices += mv.indices.size();
+	}
+	// Keep the map half empty, so its probe sequences stay short
+	const auto uniqueVerticesSize = CF_HASHMAP_GET_BUFFER_SIZE(Vertex, uint32_t, 2 * nTotVertices);
 	debug("Allocating ", uniqueVerticesSize, " bytes for uniqueVertices hashmap");
 	void* uniqueVerticesMem = malloc(uniqueVerticesSize);
 	DEFER([uniqueVerticesMem]() { free(uniqueVerticesMem); });
 
 	auto uniqueVertices = cf::hashmap<Vertex, uint32_t>::create(uniqueVerticesSize, uniqueVerticesMem);
-	std::vector<Index> indices;
+	std::vector<Index> indices(nTotIndices);
 
 	model.data = coldData;
 	model.data->meshes.reserve(scene->mNumMeshes);
+	model.data->meshBounds.reserve(scene->mNumMeshes);
 	model.nIndices = 0;
-	START_PROFILE(process);
+	uint32_t offset = 0;
 	for (unsigned i = 0; i < scene->mNumMeshes; ++i) {
-
-		auto shape = scene->mMeshes[i];
+		auto& mv = meshVertices[i];
 
 		Mesh mesh = {};
+		mesh.materialId = scene->mMeshes[i]->mMaterialIndex;
+		mesh.offset = offset;
+		mesh.len = mv.indices.size();
+		offset += mesh.len;
 
-		// Material
-		mesh.materialId = shape->mMaterialIndex;
-
-		mesh.offset = indices.size();
-		for (unsigned j = 0; j < shape->mNumVertices; ++j) {
-			Vertex vertex = {};
-			const auto v = shape->mVertices[j];
-			vertex.pos = {
-				v.x,
-				v.y,
-				v.z,
-			};
-			if (shape->HasNormals()) {
-				const auto n = shape->mNormals[j];
-				vertex.norm = {
-					n.x,
-					n.y,
-					n.z,
-				};
-			} else {
-				vertex.norm = {};
-			}
-			if (shape->HasTextureCoords(0)) {
-				const auto t = shape->mTextureCoords[0][j];
-				vertex.texCoord = {
-					t.x,
-					1.f - t.y,
-				};
-			} else {
-				vertex.texCoord = {};
-			}
-			if (shape->HasTangentsAndBitangents()) {
-				const auto t = shape->mTangents[j];
-				const auto b = shape->mBitangents[j];
-				vertex.tangent = {
-					t.x,
-					t.y,
-					t.z,
-				};
-				vertex.bitangent = {
-					b.x,
-					b.y,
-					b.z,
-				};
-			} else {
-				vertex.tangent = {};
-				vertex.bitangent = {};
-			}
-
+		mv.remap.resize(mv.unique.size());
+		for (std::size_t j = 0; j < mv.unique.size(); ++j) {
+			const auto& vertex = mv.unique[j];
 			uint32_t val;
-			const auto h = std::hash<Vertex>{}(vertex);
-			if (!uniqueVertices.lookup(h, vertex, val)) {
+			if (!uniqueVertices.lookup(mv.hashes[j], vertex, val)) {
 				// This vertex is new: insert new index
 				val = model.nVertices;
-				uniqueVertices.set(h, vertex, val);
+				uniqueVertices.set(mv.hashes[j], vertex, val);
 				if (sizeof(Vertex) * model.nVertices >= bufsize) {
 					err("loadModel(", modelPath, "): out of memory!");
 					return model;
@@ -134,15 +127,30 @@ Model loadModel(const char* modelPath, void* buffer, ModelColdData* coldData, st
 				reinterpret_cast<Vertex*>(buffer)[model.nVertices] = vertex;
 				model.nVertices++;
 			}
-
-			indices.emplace_back(val);
+			mv.remap[j] = val;
 		}
 
-		mesh.len = indices.size() - mesh.offset;
 		model.data->meshes.emplace_back(mesh);
+		model.data->meshBounds.emplace_back(mv.bounds);
 	}
 
-	if (sizeof(Vertex) * model.nVertices + sizeof(Index) * indices.size() >= bufsize) {
+	// Make the meshes' indices point to the model's vertices
+	parallelFor(scene->mNumMeshes, cfg::SERVER_MODEL_IMPORT_THREADS, [&](std::size_t i) {
+		const auto& mv = meshVertices[i];
+		auto dst = indices.data() + model.data->meshes[i].offset;
+		for (auto idx : mv.indices)
+			*dst++ = mv.remap[idx];
+	});
+
+	// Build the levels of detail, which reorders the vertices and triangles and gives each level its own indices
+	std::vector<Index> lodIndices;
+	measure_ms((std::string{ "Build LODs " } + modelPathBase).c_str(), LOGLV_INFO, [&]() {
+		buildLods(reinterpret_cast<Vertex*>(buffer), model.nVertices, indices, *model.data, lodIndices);
+	});
+	indices = std::move(lodIndices);
+
+	if ((sizeof(Vertex) + sizeof(QuantizedVertex)) * model.nVertices + sizeof(Index) * indices.size() >=
+		bufsize) {
 		err("loadModel(", modelPath, "): out of memory!");
 		return model;
 	}
@@ -160,16 +168,99 @@ Model loadModel(const char* modelPath, void* buffer, ModelColdData* coldData, st
 	// Copy indices into buffer
 	memcpy(model.indices, indices.data(), sizeof(Index) * indices.size());
 
+	// Prepare the vertices to send once and for all, so they can be sent straight from here
+	model.quantizedVertices = reinterpret_cast<QuantizedVertex*>(
+		reinterpret_cast<uint8_t*>(model.indices) + sizeof(Index) * model.nIndices);
+	model.bounds = computeQuantizationBounds(model.vertices, model.nVertices);
+	quantizeVertices(model.vertices, model.nVertices, model.bounds, model.quantizedVertices);
+
 	END_PROFILE(process, (std::string{ "Process model " } + modelPathBase).c_str(), LOGLV_INFO);
 
 	debug(model.toString());
-	debug("max idx = ", *std::max_element(indices.begin(), indices.end()));
+	if (!indices.empty())
+		debug("max idx = ", *std::max_element(indices.begin(), indices.end()));
 
-	info("Loaded model ", modelPathBase, " (", model.name, ")");
+	info("Loaded model ", modelPathBase, " (", model.name, ") with ", model.data->lods.size(), " levels of detail");
 
 	return model;
 }
 
+void dedupMeshVertices(const aiMesh* shape, MeshVertices& out)
+{
+	out.bounds.min = glm::vec3{ std::numeric_limits<float>::max() };
+	out.bounds.max = glm::vec3{ std::numeric_limits<float>::lowest() };
+	if (shape->mNumVertices == 0) {
+		out.bounds.min = out.bounds.max = glm::vec3{ 0.f };
+		return;
+	}
+
+	// Keep the map half empty, so its probe sequences stay short
+	std::vector<uint8_t> uniqueVerticesMem(CF_HASHMAP_GET_BUFFER_SIZE(Vertex, uint32_t, 2 * shape->mNumVertices));
+	auto uniqueVertices =
+		cf::hashmap<Vertex, uint32_t>::create(uniqueVerticesMem.size(), uniqueVerticesMem.data());
+	out.indices.reserve(shape->mNumVertices);
+
+	for (unsigned j = 0; j < shape->mNumVertices; ++j) {
+		Vertex vertex = {};
+		const auto v = shape->mVertices[j];
+		vertex.pos = {
+			v.x,
+			v.y,
+			v.z,
+		};
+		if (shape->HasNormals()) {
+			const auto n = shape->mNormals[j];
+			vertex.norm = {
+				n.x,
+				n.y,
+				n.z,
+			};
+		} else {
+			vertex.norm = {};
+		}
+		if (shape->HasTextureCoords(0)) {
+			const auto t = shape->mTextureCoords[0][j];
+			vertex.texCoord = {
+				t.x,
+				1.f - t.y,
+			};
+		} else {
+			vertex.texCoord = {};
+		}
+		if (shape->HasTangentsAndBitangents()) {
+			const auto t = shape->mTangents[j];
+			const auto b = shape->mBitangents[j];
+			vertex.tangent = {
+				t.x,
+				t.y,
+				t.z,
+			};
+			vertex.bitangent = {
+				b.x,
+				b.y,
+				b.z,
+			};
+		} else {
+			vertex.tangent = {};
+			vertex.bitangent = {};
+		}
+
+		out.bounds.min = glm::min(out.bounds.min, vertex.pos);
+		out.bounds.max = glm::max(out.bounds.max, vertex.pos);
+
+		uint32_t val;
+		const auto h = static_cast<uint32_t>(std::hash<Vertex>{}(vertex));
+		if (!uniqueVertices.lookup(h, vertex, val)) {
+			val = out.unique.size();
+			uniqueVertices.set(h, vertex, val);
+			out.unique.emplace_back(vertex);
+			out.hashes.emplace_back(h);
+		}
+
+		out.indices.emplace_back(val);
+	}
+}
+
 Material saveMaterial(const char* modelPath, const aiMaterial* mat)
 {
 	const std::string basePath = xplatDirname(modelPath) + DIRSEP;
@@ -205,3 +296,148 @@ Material saveMaterial(const char* modelPath, const aiMaterial* mat)
 
 	return material;
 }
+
+/** @return whether `a` (a mesh of `aIndices`) has the same indices as `b` (a mesh of `bIndices`) */
+static bool sameIndices(const std::vector<Index>& aIndices,
+	const Mesh& a,
+	const std::vector<Index>& bIndices,
+	const Mesh& b)
+{
+	return a.len == b.len && std::equal(aIndices.begin() + a.offset,
+					 aIndices.begin() + a.offset + a.len,
+					 bIndices.begin() + b.offset);
+}
+
+/** Builds the coarser levels of detail of the model made of `vertices` and of `data.meshes`, whose indices
+ *  are `indices`, optimizes the triangle order of each level, then lays out all levels from the coarsest to
+ *  the finest one: the vertices are reordered in place, the indices of all levels are written into
+ *  `outIndices` and `data`'s meshes, lodMeshes, lods and segments are filled accordingly.
+ */
+void buildLods(Vertex* vertices,
+	uint32_t nVertices,
+	const std::vector<Index>& indices,
+	ModelColdData& data,
+	std::vector<Index>& outIndices)
+{
+	const auto nMeshes = data.meshes.size();
+
+	// Simplify the whole model at once, each level from the previous one, so the meshes' borders stay
+	// stitched together. levels[l] holds the indices of level l, with its meshes at levelMeshes[l].
+	std::vector<std::vector<Index>> levels{ indices };
+	std::vector<std::vector<Mesh>> levelMeshes{ data.meshes };
+	std::vector<float> errors{ 0.f };
+	while (levels.size() < cfg::SERVER_MESH_LODS) {
+		const auto& prev = levels.back();
+		const auto& prevMeshes = levelMeshes.back();
+		const auto target = prev.size() / cfg::SERVER_MESH_LOD_REDUCTION / 3 * 3;
+		float error;
+		const auto remap = simplifyMesh(vertices, nVertices, prev, target, error);
+
+		std::vector<Index> level;
+		level.reserve(prev.size());
+		auto meshes = prevMeshes;
+		for (std::size_t m = 0; m < nMeshes; ++m) {
+			meshes[m].offset = level.size();
+			for (auto i = prevMeshes[m].offset; i < prevMeshes[m].offset + prevMeshes[m].len; i += 3) {
+				const auto v0 = remap[prev[i]];
+				const auto v1 = remap[prev[i + 1]];
+				const auto v2 = remap[prev[i + 2]];
+				if (v0 == v1 || v1 == v2 || v2 == v0)
+					continue;
+				level.emplace_back(v0);
+				level.emplace_back(v1);
+				level.emplace_back(v2);
+			}
+			meshes[m].len = level.size() - meshes[m].offset;
+		}
+
+		// Stop when the model can't be simplified much further
+		if (4 * level.size() > 3 * prev.size())
+			break;
+
+		errors.emplace_back(errors.back() + error);
+		levels.emplace_back(std::move(level));
+		levelMeshes.emplace_back(std::move(meshes));
+	}
+	const auto nLods = levels.size();
+
+	// Reorder each level's triangles for the vertex cache and overdraw. An unsimplified mesh gets the same
+	// order in both levels, so it can still be shared.
+	const auto cacheBefore = analyzeVertexCache(levels[0].data(), levels[0].size(), nVertices);
+	for (std::size_t l = 0; l < nLods; ++l)
+		optimizeMeshes(levels[l], levelMeshes[l], vertices, nVertices);
+	const auto cacheAfter = analyzeVertexCache(levels[0].data(), levels[0].size(), nVertices);
+	info("Vertex cache: ACMR ",
+		cacheBefore.acmr,
+		" -> ",
+		cacheAfter.acmr,
+		", ATVR ",
+		cacheBefore.atvr,
+		" -> ",
+		cacheAfter.atvr);
+
+	// Lay out the levels coarsest first, mesh by mesh, so each level only needs the data of the coarser ones.
+	// The vertices are renumbered in order of first use, i.e. in the order the GPU fetches them, which also
+	// keeps those used together close.
+	constexpr auto NOT_USED = std::numeric_limits<Index>::max();
+	std::vector<Index> newIndex(nVertices, NOT_USED);
+	Index nextVertex = 0;
+	std::vector<std::vector<Mesh>> laidOutMeshes(nLods);
+	outIndices.clear();
+	data.lods.resize(nLods);
+	data.segments.clear();
+	for (auto l = nLods; l-- > 0;) {
+		auto& lod = data.lods[l];
+		lod.firstVertex = nextVertex;
+		lod.firstIndex = outIndices.size();
+		lod.error = errors[l];
+		laidOutMeshes[l] = levelMeshes[l];
+		for (std::size_t m = 0; m < nMeshes; ++m) {
+			// A mesh which wasn't simplified by the next level reuses its indices
+			const auto& src = levelMeshes[l][m];
+			if (l + 1 < nLods && sameIndices(levels[l], src, levels[l + 1], levelMeshes[l + 1][m])) {
+				laidOutMeshes[l][m] = laidOutMeshes[l + 1][m];
+				continue;
+			}
+
+			data.segments.emplace_back(MeshSegment{ nextVertex,
+				static_cast<uint32_t>(outIndices.size()),
+				static_cast<uint16_t>(m),
+				static_cast<uint8_t>(l) });
+			laidOutMeshes[l][m].offset = outIndices.size();
+			for (auto i = src.offset; i < src.offset + src.len; ++i) {
+				auto& v = newIndex[levels[l][i]];
+				if (v == NOT_USED)
+					v = nextVertex++;
+				outIndices.emplace_back(v);
+			}
+		}
+		lod.nVertices = nextVertex - lod.firstVertex;
+		lod.nIndices = outIndices.size() - lod.firstIndex;
+	}
+
+	// Vertices not used by any triangle go last, with the full detail level
+	for (auto& v : newIndex) {
+		if (v == NOT_USED)
+			v = nextVertex++;
+	}
+	data.lods[0].nVertices = nextVertex - data.lods[0].firstVertex;
+
+	const std::vector<Vertex> oldVertices{ vertices, vertices + nVertices };
+	for (uint32_t v = 0; v < nVertices; ++v)
+		vertices[newIndex[v]] = oldVertices[v];
+
+	data.meshes = std::move(laidOutMeshes[0]);
+	data.lodMeshes.assign(laidOutMeshes.begin() + 1, laidOutMeshes.end());
+
+	for (std::size_t l = 0; l < nLods; ++l) {
+		debug("LOD ",
+			l,
+			": ",
+			levels[l].size() / 3,
+			" triangles (",
+			data.lods[l].nVertices,
+			" new vertices), error ",
+			data.lods[l].error);
+	}
+}
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "hashing.hpp"
+#include "index_codec.hpp"
+#include "quantized_vertex.hpp"
 #include "shared_resources.hpp"
 #include "vertex.hpp"
 #include <sstream>
@@ -15,13 +17,42 @@ struct Material {
 	std::string normalTex;
 };
 
+/** Spatial information about a mesh, used to decide what to send first */
+struct MeshBounds {
+	/** Bounding box of the mesh, in model space */
+	glm::vec3 min;
+	glm::vec3 max;
+};
+
+/** A run of the model's vertices and indices which belong to the same mesh and level of detail */
+struct MeshSegment {
+	uint32_t firstVertex;
+	uint32_t firstIndex;
+	/** Index into `meshes` */
+	uint16_t mesh;
+	uint8_t lod;
+};
+
 /** These data are stored outside the Model struct
  *  to avoid Model::operator= and similar to do a deep expensive copy
  *  of all these data.
  */
 struct ModelColdData {
+	/** Meshes of the full detail level */
 	std::vector<shared::Mesh> meshes;
 	std::vector<Material> materials;
+	/** Same order as `meshes` */
+	std::vector<MeshBounds> meshBounds;
+	/** Levels of detail of the model, finest first (there's always at least the full detail one) */
+	std::vector<shared::ModelLod> lods;
+	/** Meshes of the coarser levels of detail: lodMeshes[i - 1] holds those of level i, same order as `meshes` */
+	std::vector<std::vector<shared::Mesh>> lodMeshes;
+	/** The model's data split by mesh and level of detail, in the order it's laid out
+	 *  (both their firstVertex and firstIndex never decrease).
+	 */
+	std::vector<MeshSegment> segments;
+	/** The model's indices in the format they're sent with, so their chunks can be sent straight from here */
+	EncodedIndexRun encodedIndices;
 };
 
 /* Model information.
@@ -41,6 +72,10 @@ struct Model {
 	Vertex* vertices = nullptr;
 	/** Unowning pointer to the model's indices */
 	Index* indices = nullptr;
+	/** Unowning pointer to the model's vertices in the format they're sent with */
+	QuantizedVertex* quantizedVertices = nullptr;
+	/** Bounding box used to quantize the vertices' positions */
+	QuantizationBounds bounds = {};
 	/** Unowning pointer to the model's cold data */
 	ModelColdData* data = nullptr;
 
@@ -49,7 +84,10 @@ struct Model {
 
 	bool operator==(const Model& other) const { return name == other.name; }
 
-	std::size_t size() const { return nVertices * sizeof(Vertex) + nIndices * sizeof(Index); }
+	std::size_t size() const
+	{
+		return nVertices * (sizeof(Vertex) + sizeof(QuantizedVertex)) + nIndices * sizeof(Index);
+	}
 
 	std::string toString() const
 	{
@@ -67,6 +105,12 @@ struct Model {
 				ss << "mesh { off = " << mesh.offset << ", len = " << mesh.len
 				   << ", mat = " << mesh.materialId << " }\n";
 			}
+			ss << "# lods: " << data->lods.size() << "\n";
+			for (const auto& lod : data->lods) {
+				ss << "lod { vertices = " << lod.firstVertex << "+" << lod.nVertices
+				   << ", indices = " << lod.firstIndex << "+" << lod.nIndices
+				   << ", error = " << lod.error << " }\n";
+			}
 		}
 		return ss.str();
 	}
@@ -79,10 +123,12 @@ struct hash<Model> {
 };
 }   // namespace std
 
-/** Loads a model's vertices and indices into `buffer`.
+/** Loads a model's vertices and indices into `buffer`, building its coarser levels of detail.
  *  `buffer` and `coldData` must be pointers to initialized memory.
- *  Upon success, `buffer` gets filled with [vertices|indices] (indices start at
+ *  Upon success, `buffer` gets filled with [vertices|indices|quantized vertices] (indices start at
  *  offset `sizeof(Vertex) * nVertices`) and `coldData` is filled with a pointer to the model's cold data.
+ *  The vertices and indices of all levels of detail are laid out from the coarsest level to the finest one
+ *  (see shared::ModelLod).
  *  @return a valid model, or one with nullptr `vertices` and `indices` if there were errors.
  */
 Model loadModel(const char* modelPath,
@@ -0,0 +1,284 @@
+#include "model_cache.hpp"
+#include "config.hpp"
+#include "hashing.hpp"
+#include "logging.hpp"
+#include "model.hpp"
+#include "xplatform.hpp"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <type_traits>
+#include <vector>
+
+using namespace logging;
+
+constexpr uint32_t COOKED_MODEL_MAGIC = 0x4c444d43;   // "CMDL"
+/** Bump this every time the format (or the content, e.g. the levels of detail) of cooked models changes */
+constexpr uint16_t COOKED_MODEL_VERSION = 2;
+/** Alignment of the model's data inside the file */
+constexpr std::size_t COOKED_MODEL_DATA_ALIGN = 64;
+
+/** A cooked model file is made of:
+ *  [header | padding | vertices | indices | quantized vertices | cold data]
+ *  where the cold data are:
+ *  [meshes | mesh bounds | lods | meshes of the coarser lods | segments | materials]
+ *  and each material is its name followed by its texture paths (relative to the model's directory), each one
+ *  prefixed by its length (uint16).
+ */
+struct CookedModelHeader {
+	uint32_t magic;
+	uint16_t version;
+	/** Guards against a cache written by a build with a different Vertex */
+	uint16_t vertexSize;
+	uint32_t nVertices;
+	uint32_t nIndices;
+	QuantizationBounds bounds;
+	uint32_t nMaterials;
+	uint32_t nMeshes;
+	uint32_t nLods;
+	uint32_t nSegments;
+	uint64_t dataOffset;
+	uint64_t coldDataOffset;
+	uint64_t fileSize;
+};
+static_assert(std::is_trivially_copyable<CookedModelHeader>::value, "CookedModelHeader must be POD!");
+
+/** Reads the cold data of a cooked model, never past its end */
+class ColdDataReader {
+	const uint8_t* ptr;
+	const uint8_t* end;
+
+public:
+	explicit ColdDataReader(const uint8_t* begin, const uint8_t* end)
+		: ptr{ begin }
+		, end{ end }
+	{}
+
+	template <typename T>
+	bool read(std::vector<T>& vec, std::size_t n)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "Can only read POD types!");
+		if (static_cast<std::size_t>(end - ptr) < n * sizeof(T))
+			return false;
+		vec.resize(n);
+		// The data may be unaligned
+		memcpy(vec.data(), ptr, n * sizeof(T));
+		ptr += n * sizeof(T);
+		return true;
+	}
+
+	bool read(std::string& str)
+	{
+		uint16_t len;
+		if (static_cast<std::size_t>(end - ptr) < sizeof(len))
+			return false;
+		memcpy(&len, ptr, sizeof(len));
+		ptr += sizeof(len);
+		if (static_cast<std::size_t>(end - ptr) < len)
+			return false;
+		str.assign(reinterpret_cast<const char*>(ptr), len);
+		ptr += len;
+		return true;
+	}
+
+	bool done() const { return ptr == end; }
+};
+
+template <typename T>
+static void writeVector(std::ostream& out, const std::vector<T>& vec)
+{
+	out.write(reinterpret_cast<const char*>(vec.data()), vec.size() * sizeof(T));
+}
+
+static void writeString(std::ostream& out, const std::string& str)
+{
+	const auto len = static_cast<uint16_t>(str.length());
+	out.write(reinterpret_cast<const char*>(&len), sizeof(len));
+	out.write(str.data(), len);
+}
+
+/** @return `texPath` relative to `basePath`, if it's inside it */
+static std::string relativeTexPath(const std::string& texPath, const std::string& basePath)
+{
+	if (texPath.compare(0, basePath.length(), basePath) == 0)
+		return texPath.substr(basePath.length());
+	return texPath;
+}
+
+std::string cookedModelPath(const std::string& path, const std::string& cacheDir)
+{
+	std::ifstream file{ path, std::ios::binary };
+	if (!file)
+		return "";
+	const std::vector<uint8_t> src{ std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{} };
+
+	// Also key the cooked model by the settings it's cooked with
+	char cookedName[64];
+	snprintf(cookedName,
+		sizeof(cookedName),
+		"%08x-%zx-%u-%u%u.cmdl",
+		hashing::fnv1a_hash(src.data(), src.size()),
+		src.size(),
+		static_cast<unsigned>(COOKED_MODEL_VERSION),
+		cfg::SERVER_MESH_LODS,
+		cfg::SERVER_MESH_LOD_REDUCTION);
+
+	return cacheDir + DIRSEP + cookedName;
+}
+
+bool writeCookedModel(const std::string& cookedPath, const char* modelPath, const Model& model)
+{
+	const auto& data = *model.data;
+
+	CookedModelHeader header = {};
+	header.magic = COOKED_MODEL_MAGIC;
+	header.version = COOKED_MODEL_VERSION;
+	header.vertexSize = sizeof(Vertex);
+	header.nVertices = model.nVertices;
+	header.nIndices = model.nIndices;
+	header.bounds = model.bounds;
+	header.nMaterials = data.materials.size();
+	header.nMeshes = data.meshes.size();
+	header.nLods = data.lods.size();
+	header.nSegments = data.segments.size();
+	header.dataOffset = (sizeof(CookedModelHeader) + COOKED_MODEL_DATA_ALIGN - 1) / COOKED_MODEL_DATA_ALIGN *
+			    COOKED_MODEL_DATA_ALIGN;
+	header.coldDataOffset = header.dataOffset + model.size();
+
+	const auto cacheDir = xplatDirname(cookedPath.c_str());
+	if (!xplatMakeDir(cacheDir.c_str())) {
+		warn("Can't create the model cache ", cacheDir);
+		return false;
+	}
+
+	// Write to a temporary file first, so an interrupted write never leaves a truncated model in the cache.
+	// Its name is unique to this process, as other servers may be cooking the same model.
+	const auto tmpPath = cookedPath + ".tmp" + std::to_string(xplatGetPid());
+	{
+		std::ofstream out{ tmpPath, std::ios::binary };
+		out.write(reinterpret_cast<const char*>(&header), sizeof(CookedModelHeader));
+		const std::vector<char> padding(header.dataOffset - sizeof(CookedModelHeader), 0);
+		writeVector(out, padding);
+
+		// The vertices, indices and quantized vertices are contiguous
+		out.write(reinterpret_cast<const char*>(model.vertices), model.size());
+
+		writeVector(out, data.meshes);
+		writeVector(out, data.meshBounds);
+		writeVector(out, data.lods);
+		for (const auto& meshes : data.lodMeshes)
+			writeVector(out, meshes);
+		writeVector(out, data.segments);
+		const auto basePath = xplatDirname(modelPath) + DIRSEP;
+		for (const auto& mat : data.materials) {
+			out.write(reinterpret_cast<const char*>(&mat.name), sizeof(StringId));
+			writeString(out, relativeTexPath(mat.diffuseTex, basePath));
+			writeString(out, relativeTexPath(mat.specularTex, basePath));
+			writeString(out, relativeTexPath(mat.normalTex, basePath));
+		}
+
+		// Now we know the file size
+		header.fileSize = out.tellp();
+		out.seekp(offsetof(CookedModelHeader, fileSize));
+		out.write(reinterpret_cast<const char*>(&header.fileSize), sizeof(header.fileSize));
+		if (!out) {
+			warn("Failed to write cooked model ", tmpPath);
+			std::remove(tmpPath.c_str());
+			return false;
+		}
+	}
+	if (std::rename(tmpPath.c_str(), cookedPath.c_str()) != 0) {
+		warn("Failed to move cooked model to ", cookedPath);
+		std::remove(tmpPath.c_str());
+		return false;
+	}
+
+	info("Cooked model ", modelPath, " into ", cookedPath, " (", header.fileSize / 1024, " KiB)");
+
+	return true;
+}
+
+/** Fills `coldData` with the cold data of the cooked model `header`, which are at `begin`, until `end`. */
+static bool readColdData(const CookedModelHeader& header,
+	const uint8_t* begin,
+	const uint8_t* end,
+	const char* modelPath,
+	ModelColdData& coldData)
+{
+	ColdDataReader reader{ begin, end };
+	if (!reader.read(coldData.meshes, header.nMeshes) || !reader.read(coldData.meshBounds, header.nMeshes) ||
+		!reader.read(coldData.lods, header.nLods))
+		return false;
+
+	coldData.lodMeshes.resize(header.nLods > 0 ? header.nLods - 1 : 0);
+	for (auto& meshes : coldData.lodMeshes) {
+		if (!reader.read(meshes, header.nMeshes))
+			return false;
+	}
+
+	if (!reader.read(coldData.segments, header.nSegments))
+		return false;
+
+	const auto basePath = xplatDirname(modelPath) + DIRSEP;
+	coldData.materials.resize(header.nMaterials);
+	for (auto& mat : coldData.materials) {
+		std::vector<StringId> name;
+		if (!reader.read(name, 1) || !reader.read(mat.diffuseTex) || !reader.read(mat.specularTex) ||
+			!reader.read(mat.normalTex))
+			return false;
+		mat.name = name[0];
+		for (auto tex : { &mat.diffuseTex, &mat.specularTex, &mat.normalTex }) {
+			if (!tex->empty())
+				*tex = basePath + *tex;
+		}
+	}
+
+	return reader.done();
+}
+
+CookedModelMapping
+	mapCookedModel(const std::string& cookedPath, const char* modelPath, Model& model, ModelColdData& coldData)
+{
+	CookedModelMapping mapping;
+	mapping.data = xplatMapFile(cookedPath.c_str(), mapping.size);
+	if (!mapping.data)
+		return mapping;
+
+	const auto base = reinterpret_cast<const uint8_t*>(mapping.data);
+	if (mapping.size < sizeof(CookedModelHeader)) {
+		warn("Cooked model ", cookedPath, " is truncated: ignoring it");
+		xplatUnmapFile(mapping.data, mapping.size);
+		return CookedModelMapping{};
+	}
+	const auto& header = *reinterpret_cast<const CookedModelHeader*>(base);
+
+	Model mapped;
+	mapped.nVertices = header.nVertices;
+	mapped.nIndices = header.nIndices;
+	const bool valid = header.magic == COOKED_MODEL_MAGIC && header.version == COOKED_MODEL_VERSION &&
+			   header.vertexSize == sizeof(Vertex) && header.fileSize == mapping.size &&
+			   header.dataOffset >= sizeof(CookedModelHeader) &&
+			   header.dataOffset % COOKED_MODEL_DATA_ALIGN == 0 &&
+			   header.coldDataOffset == header.dataOffset + mapped.size() &&
+			   header.coldDataOffset <= mapping.size &&
+			   readColdData(header, base + header.coldDataOffset, base + mapping.size, modelPath, coldData);
+	if (!valid) {
+		warn("Cooked model ", cookedPath, " is invalid: ignoring it");
+		xplatUnmapFile(mapping.data, mapping.size);
+		return CookedModelMapping{};
+	}
+
+	// The model's data is only ever read, so it can point straight into the read-only mapping
+	auto data = const_cast<uint8_t*>(base + header.dataOffset);
+	mapped.vertices = reinterpret_cast<Vertex*>(data);
+	data += sizeof(Vertex) * mapped.nVertices;
+	mapped.indices = reinterpret_cast<Index*>(data);
+	data += sizeof(Index) * mapped.nIndices;
+	mapped.quantizedVertices = reinterpret_cast<QuantizedVertex*>(data);
+	mapped.bounds = header.bounds;
+	mapped.data = &coldData;
+	model = mapped;
+
+	return mapping;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+struct Model;
+struct ModelColdData;
+
+/** A cooked model file mapped into memory */
+struct CookedModelMapping {
+	const void* data = nullptr;
+	std::size_t size = 0;
+};
+
+/** @return the path of the cooked version of the model file `path` inside `cacheDir`, keyed by the content of
+ *  `path` (so it never goes stale), or an empty string if `path` can't be read.
+ *  The file may not exist yet.
+ */
+std::string cookedModelPath(const std::string& path, const std::string& cacheDir);
+
+/** Writes the data and cold data of `model`, loaded from `modelPath`, into the cooked model file `cookedPath`.
+ *  The data keeps the layout it has in memory ([vertices|indices|quantized vertices]), so the cooked model
+ *  can be mapped and used as is by mapCookedModel.
+ *  @return false if the file could not be written.
+ */
+bool writeCookedModel(const std::string& cookedPath, const char* modelPath, const Model& model);
+
+/** Maps the cooked model file `cookedPath` (cooked from `modelPath`) into memory and makes `model` point to
+ *  its data, filling `coldData` and setting `model.data` to it. `model.name` is not set.
+ *  The mapping is read-only and shared by all the processes mapping the same file.
+ *  @return the mapping, which must be released with xplatUnmapFile, or one with null data if the file is
+ *  missing or not a valid cooked model.
+ */
+CookedModelMapping
+	mapCookedModel(const std::string& cookedPath, const char* modelPath, Model& model, ModelColdData& coldData);
@@ -0,0 +1,94 @@
+#include "mtu_probe.hpp"
+#include "config.hpp"
+#include "logging.hpp"
+#include "server.hpp"
+#include "udp_messages.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <vector>
+
+using namespace logging;
+
+/** Packet sizes worth probing, i.e. the UDP payload fitting the most common MTUs */
+static constexpr std::size_t COMMON_PACKET_SIZES[] = {
+	// Loopback (64 KiB MTU)
+	cfg::MAX_UDP_PACKET_SIZE_BYTES,
+	// Jumbo frames (9000 B MTU)
+	8972,
+	// Ethernet (1500 B MTU)
+	1472,
+	// PPPoE (1492 B MTU)
+	1464,
+	// Tunnels and IPv6 minimum MTU (1280 B)
+	1232,
+};
+
+std::size_t probePacketSize(ClientSession& session, std::size_t maxPacketSize)
+{
+	auto& fromClient = session.fromClient;
+	const auto socket = session.endpoints.udpActive.socket;
+
+	// Probe the max size, then all the common ones below it, from the largest down
+	std::vector<std::size_t> sizes;
+	sizes.emplace_back(maxPacketSize);
+	for (auto size : COMMON_PACKET_SIZES) {
+		if (size < maxPacketSize && size > cfg::PACKET_SIZE_BYTES)
+			sizes.emplace_back(size);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock{ fromClient.mtuProbes.mtx };
+		fromClient.mtuProbes.largestAcked = 0;
+	}
+
+	if (!xplatSetDontFragment(socket, true))
+		warn("Can't forbid fragmentation: MTU probes may get through as fragments.");
+
+	std::vector<uint8_t> probe(maxPacketSize, 0);
+	const auto type = udpmsg2byte(UdpMsgType::MTU_PROBE);
+	memcpy(probe.data() + sizeof(UdpHeader), &type, sizeof(UdpMsgType));
+	const auto probeHeaderOffset = sizeof(UdpHeader) + sizeof(UdpMsgType);
+
+	// Probes which can't even leave this host (bigger than the interface's MTU) are not waited for
+	std::size_t largestSent = 0;
+	for (unsigned i = 0; i < cfg::SERVER_MTU_PROBE_COPIES; ++i) {
+		for (auto size : sizes) {
+			UdpHeader header = {};
+			header.size = size - sizeof(UdpHeader);
+			memcpy(probe.data(), &header, sizeof(UdpHeader));
+			MtuProbeHeader probeHeader;
+			probeHeader.probeSize = size;
+			memcpy(probe.data() + probeHeaderOffset, &probeHeader, sizeof(MtuProbeHeader));
+
+			if (sendPacket(socket, probe.data(), size))
+				largestSent = std::max(largestSent, size);
+		}
+	}
+
+	std::size_t largestAcked;
+	{
+		std::unique_lock<std::mutex> ulk{ fromClient.mtuProbes.mtx };
+		fromClient.mtuProbes.cv.wait_for(ulk,
+			std::chrono::milliseconds{ cfg::SERVER_MTU_PROBE_TIMEOUT_MS },
+			[&]() { return fromClient.mtuProbes.largestAcked >= largestSent; });
+		largestAcked = fromClient.mtuProbes.largestAcked;
+	}
+
+	xplatSetDontFragment(socket, false);
+
+	const auto packetSize = std::max(largestAcked, cfg::PACKET_SIZE_BYTES);
+	info("[session ",
+		session.id,
+		"] UDP packet size: ",
+		packetSize,
+		" B (max allowed: ",
+		maxPacketSize,
+		", largest probe sent: ",
+		largestSent,
+		", largest probe ACKed: ",
+		largestAcked,
+		")");
+
+	return packetSize;
+}
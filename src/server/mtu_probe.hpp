@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+
+struct ClientSession;
+
+/** Path MTU discovery for the server-to-client UDP stream, done once at connection time
+ *  (a simplified version of RFC 8899's packetization layer PMTUD).
+ *  The server sends MTU_PROBE packets of decreasing sizes, which must not be fragmented along the path,
+ *  and the client answers each one it receives with a MTU_PROBE_ACK: the largest probe ACKed gives
+ *  the session's packet size.
+ */
+
+/** Probes the path towards `session`'s client with packets up to `maxPacketSize` bytes long.
+ *  The session's UDP endpoints and UdpPassiveThread must already be running.
+ *  @return the largest packet size which reached the client, or cfg::PACKET_SIZE_BYTES if no probe did.
+ */
+std::size_t probePacketSize(ClientSession& session, std::size_t maxPacketSize);
@@ -0,0 +1,217 @@
+#include "packet_batch.hpp"
+#include "endpoint.hpp"
+#include "fec.hpp"
+#include "udp_messages.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+PacketBatch::PacketBatch(std::size_t maxPacketSize, unsigned fecGroupSize)
+	: maxPacketSize{ maxPacketSize }
+	, hdrSize{ udpHeaderSize(fecGroupSize > 0) }
+	, scratch(MAX_PACKETS * maxPacketSize)
+	, fecGroupSize{ fecGroupSize }
+	, fecParity(maxPacketSize - hdrSize, 0)
+{
+	static_assert(cfg::MAX_FEC_GROUP_SIZE < MAX_PACKETS, "A FEC group must fit a batch!");
+	assert(fecGroupSize <= cfg::MAX_FEC_GROUP_SIZE);
+	assert(maxPacketSize > hdrSize && maxPacketSize <= cfg::MAX_UDP_PACKET_SIZE_BYTES);
+
+	// Worst case is a packet alternating copied and referenced segments every few bytes
+	segments.reserve(MAX_PACKETS * 32);
+}
+
+void PacketBatch::beginPacket(uint32_t packetGen)
+{
+	assert(!full());
+
+	// Discard whatever was written into the current packet
+	segments.resize(firstSegment);
+	packetSize = 0;
+	scratchUsed = 0;
+
+	UdpHeader header = {};
+	header.packetGen = packetGen;
+	if (fecGroupSize > 0)
+		header.flags |= UDP_HEADER_FEC;
+	write(&header, sizeof(UdpHeader));
+
+	// The FEC group info is only known when the group is closed
+	if (fecGroupSize > 0) {
+		const UdpFecHeader fecHeader = {};
+		write(&fecHeader, sizeof(UdpFecHeader));
+	}
+}
+
+bool PacketBatch::packetEmpty() const
+{
+	return packetSize <= hdrSize;
+}
+
+void PacketBatch::endPacket()
+{
+	if (packetEmpty())
+		return;
+
+	reinterpret_cast<UdpHeader*>(slot())->size = packetSize - hdrSize;
+
+	segmentsPerPacket[nPackets] = segments.size() - firstSegment;
+	isParity[nPackets] = false;
+	totBytes += packetSize;
+	++nPackets;
+
+	if (fecGroupSize > 0)
+		addToFecGroup();
+
+	firstSegment = segments.size();
+	packetSize = 0;
+	scratchUsed = 0;
+
+	if (fecGroupSize > 0 && fecCount == fecGroupSize)
+		closeFecGroup();
+}
+
+void PacketBatch::write(const void* data, std::size_t len)
+{
+	assert(len <= room());
+
+	const auto dst = slot() + scratchUsed;
+	memcpy(dst, data, len);
+
+	// Extend the latest segment if it ends exactly where this data was written
+	if (segments.size() > firstSegment) {
+		auto& last = segments.back();
+		if (reinterpret_cast<uint8_t*>(last.iov_base) + last.iov_len == dst) {
+			last.iov_len += len;
+			scratchUsed += len;
+			packetSize += len;
+			return;
+		}
+	}
+
+	xplatIoVec seg;
+	seg.iov_base = dst;
+	seg.iov_len = len;
+	segments.emplace_back(seg);
+	scratchUsed += len;
+	packetSize += len;
+}
+
+void PacketBatch::reference(const void* data, std::size_t len)
+{
+	assert(len <= room());
+
+	xplatIoVec seg;
+	seg.iov_base = const_cast<void*>(data);
+	seg.iov_len = len;
+	segments.emplace_back(seg);
+	packetSize += len;
+}
+
+void PacketBatch::addToFecGroup()
+{
+	if (fecCount == 0)
+		fecFirstPacket = nPackets - 1;
+
+	// XOR all the packet's segments, skipping the headers
+	std::size_t offset = 0;
+	for (std::size_t i = firstSegment; i < segments.size(); ++i) {
+		auto data = reinterpret_cast<const uint8_t*>(segments[i].iov_base);
+		auto len = segments[i].iov_len;
+		if (offset < hdrSize) {
+			const auto skip = std::min(len, hdrSize - offset);
+			data += skip;
+			len -= skip;
+			offset += skip;
+		}
+		xorBytes(fecParity.data() + offset - hdrSize, data, len);
+		offset += len;
+	}
+
+	const auto size = offset - hdrSize;
+	fecSizeXor ^= size;
+	fecMaxSize = std::max(fecMaxSize, size);
+	++fecCount;
+}
+
+void PacketBatch::closeFecGroup()
+{
+	if (fecCount > 1) {
+		assert(nPackets < MAX_PACKETS);
+
+		const auto groupId = nextFecGroupId++;
+		for (std::size_t i = 0; i < fecCount; ++i) {
+			auto fecHeader = reinterpret_cast<UdpFecHeader*>(slot(fecFirstPacket + i) + sizeof(UdpHeader));
+			fecHeader->groupId = groupId;
+			fecHeader->index = i;
+			fecHeader->groupSize = fecCount;
+		}
+
+		// Write the parity packet into its own slot
+		const auto dst = slot();
+		UdpHeader header = {};
+		header.packetGen = reinterpret_cast<const UdpHeader*>(slot(nPackets - 1))->packetGen;
+		header.size = fecSizeXor;
+		header.flags = UDP_HEADER_FEC;
+		UdpFecHeader fecHeader = {};
+		fecHeader.groupId = groupId;
+		fecHeader.index = fecCount;
+		fecHeader.groupSize = fecCount;
+		memcpy(dst, &header, sizeof(UdpHeader));
+		memcpy(dst + sizeof(UdpHeader), &fecHeader, sizeof(UdpFecHeader));
+		memcpy(dst + hdrSize, fecParity.data(), fecMaxSize);
+
+		xplatIoVec seg;
+		seg.iov_base = dst;
+		seg.iov_len = hdrSize + fecMaxSize;
+		segments.emplace_back(seg);
+		segmentsPerPacket[nPackets] = 1;
+		isParity[nPackets] = true;
+		totBytes += seg.iov_len;
+		++nPackets;
+		firstSegment = segments.size();
+	}
+
+	std::fill(fecParity.begin(), fecParity.begin() + fecMaxSize, 0);
+	fecCount = 0;
+	fecMaxSize = 0;
+	fecSizeXor = 0;
+}
+
+bool PacketBatch::flush(socket_t socket, TrafficClass trafficClass, const OnPacketsSend& onSend)
+{
+	// Discard the current packet, if any, and protect the latest packets
+	segments.resize(firstSegment);
+	scratchUsed = 0;
+	packetSize = 0;
+	if (fecGroupSize > 0)
+		closeFecGroup();
+
+	// Translate the packets being sent into data packets
+	std::size_t nDataSent = 0;
+	const auto onDataSend = [this, &onSend, &nDataSent](std::size_t first, std::size_t n) {
+		const auto nData = std::count(isParity.begin() + first, isParity.begin() + first + n, false);
+		if (nData > 0)
+			onSend(nDataSent, nData);
+		nDataSent += nData;
+	};
+
+	bool ok = true;
+	if (nPackets > 0) {
+		ok = sendPackets(socket,
+			segments.data(),
+			segmentsPerPacket.data(),
+			nPackets,
+			trafficClass,
+			onSend ? OnPacketsSend{ onDataSend } : nullptr);
+	}
+
+	segments.clear();
+	nPackets = 0;
+	totBytes = 0;
+	firstSegment = 0;
+	packetSize = 0;
+	scratchUsed = 0;
+
+	return ok;
+}
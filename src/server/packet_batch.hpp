@@ -0,0 +1,110 @@
+#pragma once
+
+#include "bandwidth_limiter.hpp"
+#include "config.hpp"
+#include "endpoint.hpp"
+#include "endpoint_xplatform.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/** A PacketBatch accumulates UDP packets to be sent all together with a single syscall.
+ *  Each packet is described by a list of memory segments: small data (like headers) is copied
+ *  into the batch's own memory, while bulk data (like geometry) is only referenced, so it's
+ *  handed to the kernel straight from where it lives.
+ *  Every packet starts with an UdpHeader, whose size is filled when the packet is closed.
+ *  If FEC is enabled, the batch also appends a parity packet after each group of packets (see fec.hpp),
+ *  and every packet's header is followed by an UdpFecHeader.
+ */
+class PacketBatch {
+public:
+	static constexpr std::size_t MAX_PACKETS = 64;
+
+	/** Constructs a PacketBatch of packets up to `maxPacketSize` bytes long, which protects every
+	 *  `fecGroupSize` packets with a parity packet (0 disables FEC).
+	 */
+	explicit PacketBatch(std::size_t maxPacketSize, unsigned fecGroupSize = 0);
+
+	/** Starts writing a new packet of generation `packetGen`. */
+	void beginPacket(uint32_t packetGen);
+
+	/** Closes the current packet, if it contains any chunk. */
+	void endPacket();
+
+	/** Copies `len` bytes from `data` into the current packet. */
+	void write(const void* data, std::size_t len);
+
+	/** Appends `len` bytes at `data` to the current packet without copying them.
+	 *  The memory they point to must stay valid until the batch is flushed.
+	 */
+	void reference(const void* data, std::size_t len);
+
+	/** @return The number of bytes that can still be added to the current packet. */
+	std::size_t room() const { return maxPacketSize - packetSize; }
+
+	/** @return true if nothing was written into the current packet after its header */
+	bool packetEmpty() const;
+	/** @return The size of each packet's header, extensions included */
+	std::size_t headerSize() const { return hdrSize; }
+	/** @return The max size of a packet, header included */
+	std::size_t maxSize() const { return maxPacketSize; }
+
+	/** @return The number of closed packets */
+	std::size_t size() const { return nPackets; }
+
+	/** @return true if no more packets can be added before flushing (room for a parity packet is kept) */
+	bool full() const { return nPackets + (fecGroupSize > 0 ? 1 : 0) >= MAX_PACKETS; }
+
+	/** @return The total bytes of the closed packets (including parity packets) */
+	std::size_t bytes() const { return totBytes; }
+
+	/** Sends all the closed packets via `socket`, as traffic of class `trafficClass`, and empties the batch.
+	 *  The current packet, if not closed, is discarded.
+	 *  If given, `onSend` is called right before each send syscall with the range of data packets it sends:
+	 *  data packets are numbered from 0 in the order they were closed, and parity packets are not counted.
+	 *  @return true if all packets were sent.
+	 */
+	bool flush(socket_t socket, TrafficClass trafficClass, const OnPacketsSend& onSend = nullptr);
+
+private:
+	const std::size_t maxPacketSize;
+	/** Size of the UdpHeader plus its extensions */
+	const std::size_t hdrSize;
+
+	/** Memory for the copied data: the i-th packet uses the i-th `maxPacketSize` slot */
+	std::vector<uint8_t> scratch;
+	std::vector<xplatIoVec> segments;
+	std::array<std::size_t, MAX_PACKETS> segmentsPerPacket;
+	/** Whether each packet is a FEC parity packet */
+	std::array<bool, MAX_PACKETS> isParity;
+
+	std::size_t nPackets = 0;
+	std::size_t totBytes = 0;
+
+	// Current packet info
+	std::size_t firstSegment = 0;
+	std::size_t packetSize = 0;
+	std::size_t scratchUsed = 0;
+
+	// Current FEC group info
+	unsigned fecGroupSize;
+	uint32_t nextFecGroupId = 1;
+	std::size_t fecFirstPacket = 0;
+	std::size_t fecCount = 0;
+	std::size_t fecMaxSize = 0;
+	uint32_t fecSizeXor = 0;
+	/** XOR of the payloads of the current group's packets */
+	std::vector<uint8_t> fecParity;
+
+	uint8_t* slot() { return scratch.data() + nPackets * maxPacketSize; }
+	uint8_t* slot(std::size_t i) { return scratch.data() + i * maxPacketSize; }
+
+	/** XORs the payload of the latest closed packet into the FEC parity. */
+	void addToFecGroup();
+
+	/** Appends the parity packet of the current FEC group and starts a new group.
+	 *  Must not be called while a packet is being written.
+	 */
+	void closeFecGroup();
+};
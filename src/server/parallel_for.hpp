@@ -0,0 +1,32 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+/** Calls `fn(i)` for each i in [0, count) on `nThreads` threads (0 = one per hardware thread), the calling one
+ *  included. Each thread takes the next i as soon as it's done with its previous one, so uneven work is
+ *  balanced. Returns when all calls are done.
+ */
+template <typename F>
+void parallelFor(std::size_t count, unsigned nThreads, F&& fn)
+{
+	if (nThreads == 0)
+		nThreads = std::max(1u, std::thread::hardware_concurrency());
+	nThreads = static_cast<unsigned>(std::min<std::size_t>(nThreads, count));
+
+	std::atomic<std::size_t> next{ 0 };
+	const auto work = [&]() {
+		for (auto i = next++; i < count; i = next++)
+			fn(i);
+	};
+
+	std::vector<std::thread> workers;
+	for (unsigned i = 1; i < nThreads; ++i)
+		workers.emplace_back(work);
+	work();
+	for (auto& worker : workers)
+		worker.join();
+}
@@ -0,0 +1,27 @@
+#include "rtt_estimator.hpp"
+#include "config.hpp"
+#include <algorithm>
+
+using namespace std::chrono;
+
+RttEstimator::RttEstimator()
+	: timeout{ duration_cast<Duration>(milliseconds{ cfg::SERVER_INITIAL_RTO_MS }) }
+{}
+
+void RttEstimator::addSample(Duration rtt)
+{
+	if (hasSamples) {
+		// rttvar = 3/4 rttvar + 1/4 |srtt - rtt|, srtt = 7/8 srtt + 1/8 rtt
+		const auto diff = smoothed > rtt ? smoothed - rtt : rtt - smoothed;
+		variation = (variation * 3 + diff) / 4;
+		smoothed = (smoothed * 7 + rtt) / 8;
+	} else {
+		smoothed = rtt;
+		variation = rtt / 2;
+		hasSamples = true;
+	}
+
+	const auto minRto = duration_cast<Duration>(milliseconds{ cfg::SERVER_MIN_RTO_MS });
+	const auto maxRto = duration_cast<Duration>(milliseconds{ cfg::SERVER_MAX_RTO_MS });
+	timeout = std::max(minRto, std::min(maxRto, smoothed + variation * 4));
+}
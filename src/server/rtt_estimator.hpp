@@ -0,0 +1,30 @@
+#pragma once
+
+#include <chrono>
+
+/** Estimates the round trip time of a connection from ACK samples and derives the retransmission
+ *  timeout (RTO) from it, following RFC 6298.
+ *  Samples should only be taken from messages which were sent once (Karn's algorithm), as the
+ *  ACK of a retransmitted message cannot be matched to a specific send.
+ */
+class RttEstimator {
+public:
+	using Duration = std::chrono::microseconds;
+
+	RttEstimator();
+
+	/** Adds a round trip time sample and updates the RTO accordingly. */
+	void addSample(Duration rtt);
+
+	/** @return the current retransmission timeout */
+	Duration rto() const { return timeout; }
+
+	/** @return the smoothed round trip time, or 0 if no samples were taken yet */
+	Duration srtt() const { return smoothed; }
+
+private:
+	Duration smoothed{ 0 };
+	Duration variation{ 0 };
+	Duration timeout;
+	bool hasSamples = false;
+};
@@ -1,16 +1,18 @@
 #include "server.hpp"
 #include "cf_hashmap.hpp"
+#include "config.hpp"
 #include "logging.hpp"
 #include "xplatform.hpp"
+#include <algorithm>
 #include <fstream>
+#include <iterator>
 
 using namespace logging;
 
 /* Memory is used like this:
- * [66%] resources
+ * [90%] resources
  * [10%] scene
- * [20%] stuffSent
- * [04%] toClient.updates.persistent hashmap
+ * Per-client data lives in each ClientSession's own memory.
  */
 Server::Server(std::size_t memsize)
 	: memory(memsize)
@@ -18,20 +20,14 @@ Server::Server(std::size_t memsize)
 	// Use a stack allocator to handle memory
 	allocator.init(memory.data(), memsize);
 
-	toClient.updates.transitory.reserve(1024);
-
-	auto memptr = (uint8_t*)allocator.alloc(memsize * 2 / 3);
-	resources.init(memptr, memsize * 2 / 3);
-
-	memptr = (uint8_t*)allocator.alloc(memsize / 10);
-	scene.init(memptr, memsize / 10);
-
-	memptr = (uint8_t*)allocator.alloc(memsize / 5);
-	stuffSent = cf::hashset<StringId>::create(memsize / 5, memptr);
+	auto memptr = (uint8_t*)allocator.alloc(memsize * 9 / 10);
+	resources.init(memptr, memsize * 9 / 10);
 
 	std::size_t bytes;
 	memptr = (uint8_t*)allocator.allocAll(&bytes);
-	toClient.updates.persistent = cf::hashmap<uint32_t, QueuedUpdate>::create(bytes, memptr);
+	scene.init(memptr, bytes);
+
+	sessions.reserve(cfg::SERVER_MAX_CLIENTS);
 
 	info("Server memory:\n",
 		"- resources: ",
@@ -40,12 +36,6 @@ Server::Server(std::size_t memsize)
 		"- scene: ",
 		scene.getMemsize() / 1024,
 		" KiB\n",
-		"- stuff sent: ",
-		memsize / 10 / 1024,
-		" KiB\n",
-		"- persistent updates: ",
-		bytes / 1024,
-		" KiB\n",
 		"- remaining: ",
 		allocator.remaining() / 1024 / 1024,
 		" MiB");
@@ -57,21 +47,95 @@ Server::~Server()
 	closeNetwork();
 }
 
+void Server::destroyTerminatedSessions()
+{
+	// Destroying a session joins its threads: don't block the appstage on sessionsMtx meanwhile
+	std::vector<std::unique_ptr<ClientSession>> terminated;
+	{
+		std::lock_guard<std::mutex> lock{ sessionsMtx };
+		const auto firstTerminated = std::stable_partition(sessions.begin(),
+			sessions.end(),
+			[](const std::unique_ptr<ClientSession>& session) { return !session->terminated; });
+		std::move(firstTerminated, sessions.end(), std::back_inserter(terminated));
+		sessions.erase(firstTerminated, sessions.end());
+	}
+
+	for (auto& session : terminated) {
+		info("Destroying session ", session->id);
+		session.reset(nullptr);
+	}
+}
+
 void Server::closeNetwork()
 {
 	info("Closing network");
 	closeEndpoint(endpoints.reliable);
-	if (networkThreads.tcpActive) {
-		networkThreads.tcpActive->cv.notify_all();
-		networkThreads.tcpActive.reset(nullptr);
+	{
+		std::lock_guard<std::mutex> lock{ sessionsMtx };
+		for (auto& session : sessions) {
+			if (session->networkThreads.tcpActive)
+				session->networkThreads.tcpActive->cv.notify_all();
+		}
+		sessions.clear();
 	}
+	networkThreads.tcpListen.reset(nullptr);
+}
+
+/* Session memory is used like this:
+ * [06%] stuffSent
+ * [94%] toClient.updates.persistent hashmap
+ */
+ClientSession::ClientSession(Server& server,
+	uint32_t id,
+	std::size_t memsize,
+	socket_t clientSocket,
+	const char* clientAddr)
+	: server{ server }
+	, id{ id }
+	, memory(memsize)
+	, clientSocket{ clientSocket }
+	, clientAddr{ clientAddr }
+	, latestPing{ std::chrono::steady_clock::now() }
+{
+	allocator.init(memory.data(), memsize);
+
+	toClient.updates.transitory.reserve(1024);
+	msgRecvQueue.reserve(256);
+
+	auto memptr = (uint8_t*)allocator.alloc(memsize / 16);
+	stuffSent = cf::hashset<StringId>::create(memsize / 16, memptr);
+
+	std::size_t bytes;
+	memptr = (uint8_t*)allocator.allocAll(&bytes);
+	toClient.updates.persistent = cf::hashmap<uint32_t, QueuedUpdate>::create(bytes, memptr);
+
+	debug("Session ",
+		id,
+		" memory:\n",
+		"- stuff sent: ",
+		memsize / 16 / 1024,
+		" KiB\n",
+		"- persistent updates: ",
+		bytes / 1024,
+		" KiB");
+}
+
+ClientSession::~ClientSession()
+{
+	debug("~ClientSession(", id, ")");
+	// This thread drops the client when it's done, tearing down the other threads
+	networkThreads.tcpActive.reset(nullptr);
 }
 
 bool loadSingleModel(Server& server, std::string name, Model* outModel)
 {
 	const auto path = server.cwd + xplatPath(name.c_str());
 
-	auto model = server.resources.loadModel(path.c_str());
+	Model model;
+	{
+		std::lock_guard<std::mutex> lock{ server.resourcesMtx };
+		model = server.resources.loadModel(path.c_str(), server.cwd + DIRSEP + cfg::SERVER_MODEL_CACHE_DIR);
+	}
 
 	if (model.vertices == nullptr || model.data == nullptr) {
 		err("Failed to load model.");
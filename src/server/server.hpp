@@ -3,21 +3,41 @@
 #include "blocking_queue.hpp"
 #include "cf_hashmap.hpp"
 #include "cf_hashset.hpp"
+#include "config.hpp"
+#include "congestion_controller.hpp"
 #include "queued_update.hpp"
+#include "rtt_estimator.hpp"
 #include "server_resources.hpp"
 #include "server_tcp.hpp"
 #include "server_udp.hpp"
 #include "spatial.hpp"
 #include "udp_messages.hpp"
 #include <array>
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <functional>
 #include <memory>
 #include <mutex>
+#include <queue>
+#include <unordered_map>
 #include <vector>
 
 struct ClientToServerData {
 	std::vector<uint32_t> acksReceived;
 	std::mutex acksReceivedMtx;
+
+	/** Latest camera pose received from the client (only meaningful if `cameraValid` is true) */
+	shared::Camera camera;
+	bool cameraValid = false;
+	std::mutex cameraMtx;
+
+	/** Replies to the MTU probes sent at connection (see mtu_probe.hpp) */
+	struct {
+		std::size_t largestAcked = 0;
+		std::mutex mtx;
+		std::condition_variable cv;
+	} mtuProbes;
 };
 
 struct UpdateList {
@@ -25,6 +45,8 @@ struct UpdateList {
 	std::vector<QueuedUpdate> transitory;
 	/** Updates in this list must be ACKed by the client before they get deleted. */
 	cf::hashmap<uint32_t, QueuedUpdate> persistent;
+	/** Serial ids of the updates added to `persistent` which were never sent yet, oldest first */
+	std::vector<uint32_t> unsent;
 
 	/** Mutex guarding updates */
 	std::mutex mtx;
@@ -47,10 +69,58 @@ struct hash<std::pair<std::string, shared::TextureFormat>> {
 
 using TexturesQueue = std::unordered_set<std::pair<std::string, shared::TextureFormat>>;
 
+/** A cooked texture sent to the client with only its smallest mip levels, whose larger ones are still to send */
+struct TextureRefinement {
+	std::string name;
+	/** The cooked texture file the levels are read from */
+	std::string cookedPath;
+	/** The most detailed level the client has: the next one to send is `level - 1` */
+	uint16_t level;
+};
+
+/** Send time of a persistent update which wasn't ACKed yet */
+struct InFlightUpdate {
+	std::chrono::steady_clock::time_point sendTime;
+	/** When the update is considered lost if not ACKed (its retransmission timeout) */
+	std::chrono::steady_clock::time_point deadline;
+	/** How many times the update was sent */
+	uint32_t nSends = 0;
+	/** Size of the update's chunk */
+	uint32_t bytes = 0;
+	/** Set when the ACK arrives (the update is then removed by the UdpActiveThread) */
+	bool acked = false;
+	/** Whether `bytes` are counted in the bytes in flight, i.e. the update was sent and neither ACKed
+	 *  nor considered lost since.
+	 */
+	bool outstanding = false;
+};
+
 struct ServerToClientData {
 	/** List of queued UDP updates to send to the client */
 	UpdateList updates;
-	bool sendingGeometry = false;
+
+	/** Persistent updates sent and not ACKed yet, used to only resend the ones whose
+	 *  retransmission timeout expired and to adapt the send rate to the path.
+	 */
+	struct {
+		/** Map { serialId => send info } */
+		std::unordered_map<uint32_t, InFlightUpdate> inFlight;
+		/** Min-heap of (deadline, serialId) of the updates in flight, so only the expired ones are visited.
+		 *  Entries are not removed on ACK or resend: they're discarded when popped if `inFlight` has no
+		 *  matching deadline anymore.
+		 */
+		std::priority_queue<std::pair<std::chrono::steady_clock::time_point, uint32_t>,
+			std::vector<std::pair<std::chrono::steady_clock::time_point, uint32_t>>,
+			std::greater<std::pair<std::chrono::steady_clock::time_point, uint32_t>>>
+			timeouts;
+		/** Sum of the bytes of the outstanding updates, capped by the congestion window */
+		std::size_t bytesInFlight = 0;
+		/** Fed with the ACKs of updates which were only sent once */
+		RttEstimator rtt;
+		/** Fed with ACKs and losses: paces all the UDP sends to this client */
+		CongestionController congestion;
+		std::mutex mtx;
+	} retransmit;
 
 	/** List of models whose geometry still needs to be sent to client */
 	std::vector<Model> modelsToSend;
@@ -60,25 +130,38 @@ struct ServerToClientData {
 	 *  model geometry has been received by the client.
 	 */
 	TexturesQueue texturesQueue;
+
+	/** Textures sent to the client which still need to be refined with their larger mip levels */
+	std::vector<TextureRefinement> texturesToRefine;
 };
 
 struct TcpMsg {
 	TcpMsgType type;
-	/** Currently only used by REQ_MODEL */
+	/** Currently only used by REQ_MODEL, READY, HELO and RSRC_EXCHANGE_ACK */
 	uint16_t payload;
 };
 
-/** The Server wraps the endpoints and provides a mean to sharing data between the server threads.
- *  It also functions as a convenient common entrypoint for starting and terminating threads.
+struct Server;
+
+/** A ClientSession holds all the server-side state tied to a single client: its network
+ *  endpoints and threads, the updates queued for it and the resources it already received.
+ *  Resources and scene are shared between all sessions and live in the Server.
  */
-struct Server {
+struct ClientSession {
+	Server& server;
+
+	/** Unique identifier of this session (only used for logging) */
+	const uint32_t id;
+
 	std::vector<uint8_t> memory;
 	StackAllocator allocator;
 
+	const socket_t clientSocket;
+	const std::string clientAddr;
+
 	struct {
 		Endpoint udpActive;
 		Endpoint udpPassive;
-		Endpoint reliable;
 	} endpoints;
 
 	struct {
@@ -89,30 +172,91 @@ struct Server {
 		std::unique_ptr<TcpReceiveThread> tcpRecv;
 	} networkThreads;
 
-	std::string cwd;
-
 	ClientToServerData fromClient;
 	ServerToClientData toClient;
 
-	ServerResources resources;
-	Scene scene;
+	/** Max size of the UDP packets sent to the client, chosen at connection */
+	std::size_t udpPacketSize = cfg::PACKET_SIZE_BYTES;
+
 	/** Keeps track of resources sent to the client */
 	cf::hashset<StringId> stuffSent;
+	/** Number of resources sent in the current resource exchange (see batch_startExchange) */
+	uint16_t nResourcesSent = 0;
 
 	BlockingQueue<TcpMsg> msgRecvQueue;
 
+	/** Serial id to assign to the next geometry update. Starts from 1, so we know 0 is invalid. */
+	uint32_t nextGeomSerialId = 1;
+
+	/** Latest version of each node and light enqueued for this client (only used by the appstage) */
+	struct {
+		std::unordered_map<StringId, uint32_t> nodes;
+		std::unordered_map<StringId, uint32_t> pointLights;
+	} versionsSent;
+
+	/** Geometry updates which didn't fit the persistent updates map yet, in sending order: they're enqueued
+	 *  as the client ACKs the ones before them (only used by the appstage).
+	 */
+	std::vector<QueuedUpdate> deferredGeomUpdates;
+
+	std::chrono::time_point<std::chrono::steady_clock> latestPing;
+
+	/** Set when the client was dropped: the session can then be destroyed. */
+	std::atomic_bool terminated{ false };
+
+	/** Constructs a ClientSession with `memsize` internal memory. */
+	explicit ClientSession(Server& server,
+		uint32_t id,
+		std::size_t memsize,
+		socket_t clientSocket,
+		const char* clientAddr);
+	~ClientSession();
+};
+
+/** The Server wraps the endpoints and provides a mean to sharing data between the server threads.
+ *  It also functions as a convenient common entrypoint for starting and terminating threads.
+ */
+struct Server {
+	std::vector<uint8_t> memory;
+	StackAllocator allocator;
+
+	struct {
+		Endpoint reliable;
+	} endpoints;
+
+	struct {
+		std::unique_ptr<TcpListenThread> tcpListen;
+	} networkThreads;
+
+	std::string cwd;
+
+	/** Resources are shared by all sessions */
+	ServerResources resources;
+	/** Serializes loading and unloading of resources, as they all share `resources.allocator`. */
+	std::mutex resourcesMtx;
+
+	Scene scene;
+	/** Guards `scene`'s structure and nodes' transforms */
+	mutable std::mutex sceneMtx;
+
+	/** Currently connected clients */
+	std::vector<std::unique_ptr<ClientSession>> sessions;
+	std::mutex sessionsMtx;
+
+	/** Total UDP bytes sent by all sessions (used for statistics) */
+	std::atomic<uint64_t> udpBytesSent{ 0 };
+	/** Part of `udpBytesSent` which was geometry retransmitted after a timeout */
+	std::atomic<uint64_t> udpBytesRetransmitted{ 0 };
+
 	/** Constructs a Server with `memsize` internal memory. */
 	explicit Server(std::size_t memsize);
 	~Server();
 
+	/** Destroys all the sessions whose client was dropped. */
+	void destroyTerminatedSessions();
+
 	void closeNetwork();
 };
 
 /** Loads model `name` into `server`'s resources. */
 bool loadSingleModel(Server& server, std::string name, Model* outModel = nullptr);
-
-inline bool expectTCPMsg(Server& server, TcpMsgType type)
-{
-	return server.msgRecvQueue.pop_or_wait().type == type;
-}
-
@@ -25,11 +25,13 @@ struct Sphere {
 	float radius;
 };
 
-static std::vector<QueuedUpdate> enqueueModelsGeomUpdates(const std::vector<Model>& modelsToSend)
+static std::vector<QueuedUpdate> enqueueModelsGeomUpdates(const std::vector<Model>& modelsToSend,
+	uint32_t& nextSerialId,
+	std::size_t packetSize)
 {
 	std::vector<QueuedUpdate> updates;
 	for (const auto& model : modelsToSend) {
-		const auto updatePackets = buildUpdatePackets(model);
+		const auto updatePackets = buildUpdatePackets(model, nextSerialId, packetSize);
 		for (const auto& up : updatePackets) {
 			updates.emplace_back(newQueuedUpdateGeom(up));
 		}
@@ -37,6 +39,133 @@ static std::vector<QueuedUpdate> enqueueModelsGeomUpdates(const std::vector<Mode
 	return updates;
 }
 
+/** @return true if the object with given name and version must be (re)sent this tick.
+ *  `sent` holds the versions already enqueued and is updated accordingly.
+ */
+static bool needsUpdate(std::unordered_map<StringId, uint32_t>& sent,
+	StringId name,
+	uint32_t version,
+	std::size_t idx,
+	uint64_t tick)
+{
+	auto it = sent.find(name);
+	if (it == sent.end()) {
+		sent.emplace(name, version);
+		return true;
+	}
+	if (it->second != version) {
+		it->second = version;
+		return true;
+	}
+	// Periodically refresh a few unchanged objects per tick, in case their latest update was lost
+	return idx % cfg::SERVER_STATE_REFRESH_TICKS == tick % cfg::SERVER_STATE_REFRESH_TICKS;
+}
+
+/** @return The transitory updates `session` needs this tick, i.e. those of the nodes and lights
+ *  which changed since they were last enqueued for it (plus a slice of the unchanged ones).
+ */
+static std::vector<QueuedUpdate> collectTransitoryUpdates(Server& server, ClientSession& session, uint64_t tick)
+{
+	std::vector<QueuedUpdate> updates;
+
+	const auto& lights = server.resources.pointLights;
+	for (std::size_t i = 0; i < lights.size(); ++i) {
+		if (needsUpdate(session.versionsSent.pointLights, lights[i].name, lights[i].version, i, tick))
+			updates.emplace_back(newQueuedUpdatePointLight(lights[i].name));
+	}
+
+	std::lock_guard<std::mutex> lock{ server.sceneMtx };
+	const auto& nodes = server.scene.nodes;
+	for (std::size_t i = 0; i < nodes.size(); ++i) {
+		if (nodes[i]->type == NodeType::EMPTY)
+			continue;
+		if (needsUpdate(session.versionsSent.nodes, nodes[i]->name, nodes[i]->version, i, tick))
+			updates.emplace_back(newQueuedUpdateTransform(nodes[i]->name));
+	}
+
+	return updates;
+}
+
+static bool isSameTransitoryUpdate(const QueuedUpdate& a, const QueuedUpdate& b)
+{
+	if (a.type != b.type)
+		return false;
+	switch (a.type) {
+	case QueuedUpdate::Type::POINT_LIGHT:
+		return a.data.pointLight.lightId == b.data.pointLight.lightId;
+	case QueuedUpdate::Type::TRANSFORM:
+		return a.data.transform.objectId == b.data.transform.objectId;
+	default:
+		return false;
+	}
+}
+
+/** Fills `session`'s update lists with this frame's updates.
+ *  The geometry updates which don't fit the session's persistent updates map are kept in order and retried
+ *  at the next calls.
+ *  @return false if the persistent updates map just filled up, i.e. if this call started deferring updates.
+ */
+static bool updateSession(ClientSession& session, const std::vector<QueuedUpdate>& tUpdates)
+{
+	auto& deferred = session.deferredGeomUpdates;
+	const bool wasDeferring = deferred.size() > 0;
+
+	if (session.toClient.modelsToSend.size() > 0) {
+		std::lock_guard<std::mutex> lock{ session.toClient.modelsToSendMtx };
+		const auto pUpdates = enqueueModelsGeomUpdates(
+			session.toClient.modelsToSend, session.nextGeomSerialId, session.udpPacketSize);
+		session.toClient.modelsToSend.clear();
+		deferred.insert(deferred.end(), pUpdates.begin(), pUpdates.end());
+	}
+
+	// Persistent updates added this frame
+	std::size_t nAdded = 0;
+	{
+		std::lock_guard<std::mutex> lock{ session.toClient.updates.mtx };
+		// Transitory updates are only enqueued once per change, so keep the ones which weren't sent yet.
+		// Since they're built with the latest data when sent, there's no point in enqueuing duplicates.
+		auto& transitory = session.toClient.updates.transitory;
+		if (transitory.empty()) {
+			transitory.assign(tUpdates.begin(), tUpdates.end());
+		} else {
+			for (const auto& u : tUpdates) {
+				const auto it = std::find_if(transitory.begin(),
+					transitory.end(),
+					[&u](const auto& other) { return isSameTransitoryUpdate(u, other); });
+				if (it == transitory.end())
+					transitory.emplace_back(u);
+			}
+		}
+
+		for (const auto& u : deferred) {
+			// Leave the rest for later: the map is emptied as the client ACKs the updates
+			if (session.toClient.updates.persistent.load_factor() > 0.95)
+				break;
+			switch (u.type) {
+			case QueuedUpdate::Type::GEOM: {
+				const auto serialId = u.data.geom.data.serialId;
+				QueuedUpdate existing;
+				if (!session.toClient.updates.persistent.lookup(serialId, serialId, existing))
+					session.toClient.updates.unsent.emplace_back(serialId);
+				session.toClient.updates.persistent.set(serialId, serialId, u);
+			} break;
+			default:
+				err("Invalid persistent update type: ", int(u.type));
+				break;
+			}
+			++nAdded;
+		}
+	}
+	deferred.erase(deferred.begin(), deferred.begin() + nAdded);
+	if (nAdded > 0)
+		verbose("adding ", nAdded, " pUpdates to session ", session.id);
+
+	if (tUpdates.size() > 0 || nAdded > 0)
+		session.toClient.updates.cv.notify_one();
+
+	return wasDeferring || deferred.empty();
+}
+
 void appstageLoop(Server& server)
 {
 	using namespace std::literals::chrono_literals;
@@ -48,47 +177,49 @@ void appstageLoop(Server& server)
 	FPSCounter fps{ "Appstage" };
 	fps.reportPeriod = 5;
 
+	auto statsTime = std::chrono::high_resolution_clock::now();
+	std::size_t transitoryEnqueued = 0;
+	// Time spent working (i.e. not waiting for the next frame) and frames since the latest stats
+	auto busyTime = std::chrono::high_resolution_clock::duration::zero();
+	std::size_t statsFrames = 0;
+
+	uint64_t tick = 0;
+
 	while (true) {
 		const LimitFrameTime lft{ 33ms };
+		const auto frameStart = std::chrono::high_resolution_clock::now();
 
-		// Persistent updates to add this frame
-		std::vector<QueuedUpdate> pUpdates;
-		// Transitory updates to add this frame
-		std::vector<QueuedUpdate> tUpdates;
-
-		if (server.toClient.modelsToSend.size() > 0) {
-			std::lock_guard<std::mutex> lock{ server.toClient.modelsToSendMtx };
-			const auto geomUpdates = enqueueModelsGeomUpdates(server.toClient.modelsToSend);
-			pUpdates.insert(pUpdates.end(), geomUpdates.begin(), geomUpdates.end());
-			server.toClient.modelsToSend.clear();
-		}
+		server.destroyTerminatedSessions();
 
 		// Change point lights
 		int i = 0;
-		bool notify = false;
 
 		if (gChangeLights) {
 			i = 0;
 			for (auto& light : server.resources.pointLights) {
-				light.color = glm::vec3{ 0.5 + 0.5 * std::sin(t + i * 0.3),
+				const auto color = glm::vec3{ 0.5 + 0.5 * std::sin(t + i * 0.3),
 					0.5 + 0.5 * std::sin(t * 0.33 + i * 0.4),
 					0.5 + 0.5 * std::cos(t * 0.66 + i * 0.56) };
-				light.attenuation = 0.02 + std::abs(0.01 * std::sin(t * 0.75 + i * 0.23));
-				tUpdates.emplace_back(newQueuedUpdatePointLight(light.name));
+				const float attenuation = 0.02 + std::abs(0.01 * std::sin(t * 0.75 + i * 0.23));
+				if (color != light.color || attenuation != light.attenuation) {
+					light.color = color;
+					light.attenuation = attenuation;
+					++light.version;
+				}
 				++i;
 			}
-			notify = true;
 		}
 
 		// Move objects
 		if (gMoveObjects) {
+			std::lock_guard<std::mutex> lock{ server.sceneMtx };
 			i = 0;
 			for (auto node : server.scene.nodes) {
 				if (node->type == NodeType::EMPTY)
 					continue;
 
 				// node->transform.position = glm::vec3{ 0, 0, i * 5 };
-				if (((node->flags >> NODE_FLAG_STATIC) & 1) == 0) {
+				if ((node->flags & NODE_FLAG_STATIC) == 0) {
 					if (node->type == NodeType::MODEL) {
 						node->transform.position =
 							glm::vec3{ (5 + 0 * 4 * i) * std::sin(0.5 * t + i * 0.4),
@@ -106,39 +237,56 @@ void appstageLoop(Server& server)
 								(2 + 1 * i) * std::cos(0.5 * t + i * 0.3) };
 					}
 					node->transform._update();
+					++node->version;
 				}
-				tUpdates.emplace_back(newQueuedUpdateTransform(node->name));
 				++i;
 			}
-			notify = true;
 		}
 
+		// Send each client what changed since its latest update
+		std::size_t nSessions;
+		std::size_t nUpdates = 0;
 		{
-			std::lock_guard<std::mutex> lock{ server.toClient.updates.mtx };
-			server.toClient.updates.transitory.assign(tUpdates.begin(), tUpdates.end());
-			if (pUpdates.size() > 0)
-				verbose("adding ", pUpdates.size(), " pUpdates");
-
-			for (const auto& u : pUpdates) {
-				switch (u.type) {
-				case QueuedUpdate::Type::GEOM:
-					if (server.toClient.updates.persistent.load_factor() > 0.95) {
-						err("Map's load factor is too high! Please give more memory ",
-							"to persistent updates's hashmap!");
-						return;
-					}
-					server.toClient.updates.persistent.set(
-						u.data.geom.data.serialId, u.data.geom.data.serialId, u);
-					break;
-				default:
-					err("Invalid persistent update type: ", int(u.type));
-					break;
+			std::lock_guard<std::mutex> lock{ server.sessionsMtx };
+			nSessions = server.sessions.size();
+			for (auto& session : server.sessions) {
+				const auto tUpdates = collectTransitoryUpdates(server, *session, tick);
+				nUpdates += tUpdates.size();
+				if (!updateSession(*session, tUpdates)) {
+					warn("[session ",
+						session->id,
+						"] persistent updates map is full: deferring geometry updates ",
+						"until the client ACKs the previous ones.");
 				}
 			}
 		}
+		transitoryEnqueued += nUpdates;
+		++tick;
 
-		if (notify)
-			server.toClient.updates.cv.notify_one();
+		const auto now = std::chrono::high_resolution_clock::now();
+		busyTime += now - frameStart;
+		++statsFrames;
+		if (std::chrono::duration_cast<std::chrono::seconds>(now - statsTime).count() >= 5) {
+			const auto elapsed =
+				std::chrono::duration_cast<std::chrono::milliseconds>(now - statsTime).count() / 1000.f;
+			const auto busyMs =
+				std::chrono::duration_cast<std::chrono::microseconds>(busyTime).count() / 1000.f;
+			info("Clients: ",
+				nSessions,
+				", aggregate UDP throughput: ",
+				server.udpBytesSent.exchange(0) / elapsed / 1024,
+				" KiB/s (retransmitted: ",
+				server.udpBytesRetransmitted.exchange(0) / elapsed / 1024,
+				" KiB/s), transitory updates enqueued: ",
+				transitoryEnqueued / elapsed,
+				" /s, appstage busy: ",
+				busyMs / statsFrames,
+				" ms/frame");
+			transitoryEnqueued = 0;
+			busyTime = std::chrono::high_resolution_clock::duration::zero();
+			statsFrames = 0;
+			statsTime = now;
+		}
 
 		// Update clock
 		t += clock.deltaTime();
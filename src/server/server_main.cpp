@@ -1,5 +1,6 @@
 #include "bandwidth_limiter.hpp"
 #include "config.hpp"
+#include "endpoint_xplatform.hpp"
 #include "geom_update.hpp"
 #include "hashing.hpp"
 #include "logging.hpp"
@@ -26,11 +27,16 @@ static constexpr auto CLIENT_UPDATE_TIME = std::chrono::milliseconds{ 33 };
 
 bool gMoveObjects = true;
 bool gChangeLights = true;
+/** Number of packets protected by each FEC parity packet (0 = no FEC) */
+unsigned gFecGroupSize = 0;
+/** Max size of the UDP packets sent to clients (the actual size is probed for each client) */
+std::size_t gMaxUdpPacketSize = cfg::MAX_UDP_PACKET_SIZE_BYTES;
 
 struct MainArgs {
 	std::string ip = "127.0.0.1";
 	float limitBytesPerSecond = -1;
 	int nLights = 10;
+	bool useIoUring = false;
 };
 
 static void parseArgs(int argc, char** argv, MainArgs& args);
@@ -55,18 +61,20 @@ int main(int argc, char** argv)
 		gBandwidthLimiter.start();
 	}
 
+	if (args.useIoUring) {
+		if (xplatUseIoUring(true))
+			info("Using io_uring (SQPOLL) for the UDP sends");
+		else
+			warn("Polled io_uring is not available: using the regular socket calls");
+	}
+
+	if (gFecGroupSize > 0)
+		info("Sending a FEC parity packet every ", gFecGroupSize, " packets");
+
 	Server server{ MEMSIZE };
 	server.cwd = xplatGetCwd();
 
 	const auto atExit = [&server]() {
-		// debug("Sockets:\nudpActive: ",
-		// server.endpoints.udpActive.socket,
-		//"\nudpPassive: ",
-		// server.endpoints.udpPassive.socket,
-		//"\nreliable: ",
-		// server.endpoints.reliable.socket,
-		//"\nclient: ",
-		// server.networkThreads.keepalive->clientSocket);
 		// "Ensure" we close the sockets even if we terminate abruptly
 		gBandwidthLimiter.stop();
 		server.closeNetwork();
@@ -100,7 +108,7 @@ int main(int argc, char** argv)
 		err("Failed to listen on ", args.ip, ":", cfg::RELIABLE_PORT, ": quitting.");
 		return 1;
 	}
-	server.networkThreads.tcpActive = std::make_unique<TcpActiveThread>(server, server.endpoints.reliable);
+	server.networkThreads.tcpListen = std::make_unique<TcpListenThread>(server, server.endpoints.reliable);
 
 	info("Started appstage");
 	appstageLoop(server);
@@ -111,7 +119,9 @@ void parseArgs(int argc, char** argv, MainArgs& args)
 {
 	const auto usage = [argv]() {
 		std::cerr << "Usage: " << argv[0] << " [-v[vvv...]] [-n (no colored logs)] [-b (max bytes per second)]"
-			  << " [-m (don't move objects)] [-l (don't change lights)] [-k (n dyn lights)]\n";
+			  << " [-m (don't move objects)] [-l (don't change lights)] [-k (n dyn lights)]"
+			  << " [-f (packets per FEC parity packet)] [-p (max UDP packet size)]"
+			  << " [-u (use io_uring)]\n";
 		std::exit(EXIT_FAILURE);
 	};
 
@@ -159,6 +169,36 @@ void parseArgs(int argc, char** argv, MainArgs& args)
 				args.nLights = std::atoi(argv[i + 1]);
 				++i;
 				break;
+			case 'f': {
+				if (i == argc - 1) {
+					usage();
+				}
+				const auto groupSize = std::atoi(argv[i + 1]);
+				if (groupSize < 0 || groupSize > static_cast<int>(cfg::MAX_FEC_GROUP_SIZE)) {
+					std::cerr << "FEC group size must be between 0 and " << cfg::MAX_FEC_GROUP_SIZE
+						  << "\n";
+					std::exit(EXIT_FAILURE);
+				}
+				gFecGroupSize = groupSize;
+				++i;
+			} break;
+			case 'p': {
+				if (i == argc - 1) {
+					usage();
+				}
+				const auto packetSize = std::atoi(argv[i + 1]);
+				if (packetSize < static_cast<int>(cfg::PACKET_SIZE_BYTES) ||
+					packetSize > static_cast<int>(cfg::MAX_UDP_PACKET_SIZE_BYTES)) {
+					std::cerr << "Max UDP packet size must be between " << cfg::PACKET_SIZE_BYTES
+						  << " and " << cfg::MAX_UDP_PACKET_SIZE_BYTES << "\n";
+					std::exit(EXIT_FAILURE);
+				}
+				gMaxUdpPacketSize = packetSize;
+				++i;
+			} break;
+			case 'u':
+				args.useIoUring = true;
+				break;
 			default:
 				usage();
 			}
@@ -1,4 +1,5 @@
 #include "server_resources.hpp"
+#include "xplatform.hpp"
 
 using namespace logging;
 
@@ -6,31 +7,54 @@ ServerResources::~ServerResources()
 {
 	for (auto cd : modelsColdData)
 		delete cd;
+	for (const auto& mapping : mappedModels)
+		xplatUnmapFile(mapping.data, mapping.size);
 }
 
-Model ServerResources::loadModel(const char* file)
+Model ServerResources::loadModel(const char* file, const std::string& cacheDir)
 {
 	const auto fileSid = sid(file);
 	Model model;
 	if (models.lookup(fileSid, fileSid, model)) {
-		warn("Tried to load model ", file, " which is already loaded!");
+		debug("Model ", file, " is already loaded.");
 		return model;
 	}
 
-	// Reserve the whole remaining memory for loading the resource, then shrink to fit.
-	std::size_t bufsize;
-	auto buffer = allocator.allocAll(&bufsize);
-
 	// Model cold data is stored in a separate chunk of memory
 	auto coldData = new ModelColdData;
-	model = ::loadModel(file, buffer, coldData, bufsize);
-	assert(model.vertices && "Failed to load model!");
 
-	models.set(fileSid, fileSid, model);
-	modelsColdData.emplace_back(coldData);
+	// Prefer the cooked model: mapping it costs (almost) nothing, and its pages are shared with all the other
+	// servers using the same model.
+	const auto cookedPath = cookedModelPath(file, cacheDir);
+	const auto mapping =
+		cookedPath.empty() ? CookedModelMapping{} : mapCookedModel(cookedPath, file, model, *coldData);
+	if (mapping.data) {
+		mappedModels.emplace_back(mapping);
+		model.name = fileSid;
+		info("Mapped cooked model ", cookedPath, " for ", file, " (", mapping.size / 1024, " KiB)");
+	} else {
+		// Reserve the whole remaining memory for loading the resource, then shrink to fit.
+		std::size_t bufsize;
+		auto buffer = allocator.allocAll(&bufsize);
+
+		model = ::loadModel(file, buffer, coldData, bufsize);
+		assert(model.vertices && "Failed to load model!");
+
+		allocator.deallocLatest();
+		allocator.alloc(model.size());
+
+		if (model.vertices && !cookedPath.empty())
+			writeCookedModel(cookedPath, file, model);
+	}
 
-	allocator.deallocLatest();
-	allocator.alloc(model.size());
+	// Encode the indices once and for all, like the vertices are quantized (this isn't cooked, as it's cheap)
+	coldData->encodedIndices.encode(model.indices, model.nIndices);
+
+	{
+		std::lock_guard<std::shared_timed_mutex> lock{ modelsMtx };
+		models.set(fileSid, fileSid, model);
+	}
+	modelsColdData.emplace_back(coldData);
 
 	return model;
 }
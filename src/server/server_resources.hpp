@@ -5,10 +5,12 @@
 #include "hashing.hpp"
 #include "logging.hpp"
 #include "model.hpp"
+#include "model_cache.hpp"
 #include "shared_resources.hpp"
 #include "stack_allocator.hpp"
 #include "utils.hpp"
 #include <cassert>
+#include <shared_mutex>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -29,16 +31,22 @@ struct ServerResources final : public ExternalMemoryUser {
 	 *  is inside `allocator`.
 	 */
 	cf::hashmap<StringId, Model> models;
+	/** Guards `models`, which is read concurrently by all the client sessions. */
+	mutable std::shared_timed_mutex modelsMtx;
 	std::vector<ModelColdData*> modelsColdData;
+	/** Cooked models mapped into memory: their data is not inside `allocator` */
+	std::vector<CookedModelMapping> mappedModels;
 	std::unordered_map<StringId, shared::Texture> textures;
 	std::unordered_map<StringId, shared::SpirvShader> shaders;
 	/** These have no data inside `allocator`, they're stored "inline" in the map */
 	std::vector<shared::PointLight> pointLights;
 
-	/** Loads a model from `file` into `allocator` and stores its info in `models`.
+	/** Loads a model from `file` and stores its info in `models`.
+	 *  If `cacheDir` contains the cooked version of `file`, it's mapped into memory and used as is; otherwise
+	 *  the model is imported into `allocator` and cooked into `cacheDir` for the next time.
 	 *  @return The loaded Model information.
 	 */
-	Model loadModel(const char* file);
+	Model loadModel(const char* file, const std::string& cacheDir);
 
 	/** Loads a texture from `file` into `allocator` and stores its info in `textures`.
 	 *  Does NOT set the texture format (in fact, it sets it to UNKNOWN)
@@ -1,38 +1,32 @@
 #include "server_tcp.hpp"
 #include "batch_send.hpp"
 #include "blocking_queue.hpp"
+#include "config.hpp"
 #include "logging.hpp"
+#include "mtu_probe.hpp"
 #include "server.hpp"
 #include "server_resources.hpp"
 #include "tcp_messages.hpp"
 #include "tcp_serialize.hpp"
 #include "xplatform.hpp"
+#include <algorithm>
 #include <array>
 #include <chrono>
 
 using namespace logging;
 
-static std::chrono::time_point<std::chrono::steady_clock> gLatestPing;
+extern std::size_t gMaxUdpPacketSize;
 
-static void genUpdateLists(Server& server)
+static void genUpdateLists(Server& server, ResourceBatch& toSend)
 {
-	// Regenerate lists of stuff to send
-	{
-		std::lock_guard<std::mutex> lock{ server.toClient.updates.mtx };
-		server.toClient.updates.persistent.clear();
-	}
-	auto& toSend = server.networkThreads.tcpActive->resourcesToSend;
-
-	{
-		std::lock_guard<std::mutex> lock{ server.networkThreads.tcpActive->mtx };
-		for (const auto& light : server.resources.pointLights) {
-			toSend.pointLights.emplace(light);
-			server.scene.addNode(light.name, NodeType::POINT_LIGHT, Transform{});
-		}
+	for (const auto& light : server.resources.pointLights) {
+		toSend.pointLights.emplace(light);
+		std::lock_guard<std::mutex> lock{ server.sceneMtx };
+		server.scene.addNode(light.name, NodeType::POINT_LIGHT, Transform{});
 	}
 }
 
-static void loadAndEnqueueModel(Server& server, unsigned n)
+static void loadAndEnqueueModel(ClientSession& session, ResourceBatch& toSend, unsigned n)
 {
 	static const std::array<std::string, 7> modelList = { "/models/sponza/sponza.dae",
 		"/models/nanosuit/nanosuit.obj",
@@ -42,7 +36,7 @@ static void loadAndEnqueueModel(Server& server, unsigned n)
 		"/models/rz0/RZ-0.obj",
 		"/models/table/table.obj" };
 
-	info("loadAndSendModel(", n, ")");
+	info("[session ", session.id, "] loadAndSendModel(", n, ")");
 
 	if (n >= modelList.size()) {
 		warn("Received a REQ_MODEL (", n, "), but models are only ", modelList.size(), "!");
@@ -50,61 +44,41 @@ static void loadAndEnqueueModel(Server& server, unsigned n)
 	}
 
 	const auto& path = modelList[n];
-	const auto modelSid = sid((server.cwd + xplatPath(path.c_str()).c_str()));
-	if (server.stuffSent.has(modelSid, modelSid))
+	const auto modelSid = sid((session.server.cwd + xplatPath(path.c_str()).c_str()));
+	if (session.stuffSent.has(modelSid, modelSid))
 		return;
 
 	Model model;
-	if (!loadSingleModel(server, path, &model))
+	if (!loadSingleModel(session.server, path, &model))
 		return;
 
 	// Note: tcpActive->mtx is already locked by us
-	server.networkThreads.tcpActive->resourcesToSend.models.emplace(model);
-	server.toClient.sendingGeometry = true;
-}
-
-static bool tcp_connectionPrelude(socket_t clientSocket, Server& server)
-{
-	// Connection prelude (one-time stuff)
-
-	// Perform handshake
-	if (!expectTCPMsg(server, TcpMsgType::HELO))
-		return false;
-
-	if (!sendTCPMsg(clientSocket, TcpMsgType::HELO_ACK))
-		return false;
-
-	// Wait for ready signal from client
-	if (!expectTCPMsg(server, TcpMsgType::READY))
-		return false;
-
-	return true;
+	toSend.models.emplace(model);
 }
 
 ///////////////////
 
-TcpActiveThread::TcpActiveThread(Server& server, Endpoint& ep)
+TcpListenThread::TcpListenThread(Server& server, Endpoint& ep)
 	: server{ server }
 	, ep{ ep }
 {
-	thread = std::thread{ &TcpActiveThread::tcpActiveTask, this };
-	xplatSetThreadName(thread, "TcpActive");
+	thread = std::thread{ &TcpListenThread::tcpListenTask, this };
+	xplatSetThreadName(thread, "TcpListen");
 }
 
-TcpActiveThread::~TcpActiveThread()
+TcpListenThread::~TcpListenThread()
 {
 	if (thread.joinable()) {
-		info("Joining Tcp Active thread...");
+		info("Joining Tcp Listen thread...");
 		thread.join();
-		info("Joined Tcp Active thread.");
+		info("Joined Tcp Listen thread.");
 	}
 }
 
-void TcpActiveThread::tcpActiveTask()
+void TcpListenThread::tcpListenTask()
 {
 	info("Listening...");
-	// One client at a time
-	if (::listen(ep.socket, 1) != 0) {
+	if (::listen(ep.socket, cfg::SERVER_MAX_CLIENTS) != 0) {
 		err("Error listening: ", xplatGetErrorString(), " (", xplatGetError(), ")");
 		return;
 	}
@@ -124,62 +98,168 @@ void TcpActiveThread::tcpActiveTask()
 			continue;
 		}
 
-		info("Accepted connection from ", inet_ntoa(clientAddr.sin_addr));
+		const char* readableAddr = inet_ntoa(clientAddr.sin_addr);
+		info("Accepted connection from ", readableAddr);
+
+		server.destroyTerminatedSessions();
+
+		std::lock_guard<std::mutex> lock{ server.sessionsMtx };
+		if (server.sessions.size() >= static_cast<std::size_t>(cfg::SERVER_MAX_CLIENTS)) {
+			warn("Too many clients connected (", server.sessions.size(), "): refusing ", readableAddr);
+			sendTCPMsg(clientSocket, TcpMsgType::DISCONNECT);
+			xplatSockClose(clientSocket);
+			continue;
+		}
+
+		auto session = std::make_unique<ClientSession>(
+			server, nextSessionId++, cfg::SERVER_SESSION_MEMSIZE, clientSocket, readableAddr);
+		session->networkThreads.tcpActive = std::make_unique<TcpActiveThread>(*session, ep);
+		session->networkThreads.tcpActive->start();
+		server.sessions.emplace_back(std::move(session));
 
-		// Start receiving thread
-		server.networkThreads.tcpRecv =
-			std::make_unique<TcpReceiveThread>(server, server.endpoints.reliable, clientSocket);
+		info("Clients connected: ", server.sessions.size());
+	}
 
-		genUpdateLists(server);
+	info("tcpListenTask: ended.");
+}
 
-		if (!tcp_connectionPrelude(clientSocket, server))
-			dropClient(clientSocket);
+///////////////////
 
-		const char* readableAddr = inet_ntoa(clientAddr.sin_addr);
+TcpActiveThread::TcpActiveThread(ClientSession& session, Endpoint& ep)
+	: session{ session }
+	, ep{ ep }
+{}
 
-		connectToClient(clientSocket, readableAddr);
+void TcpActiveThread::start()
+{
+	thread = std::thread{ &TcpActiveThread::tcpActiveTask, this };
+	xplatSetThreadName(thread, "TcpActive");
+}
 
-		if (!sendTCPMsg(clientSocket, TcpMsgType::READY)) {
-			info("TCP: Dropping client ", readableAddr);
-			dropClient(clientSocket);
-		}
+TcpActiveThread::~TcpActiveThread()
+{
+	if (thread.joinable()) {
+		info("Joining Tcp Active thread...");
+		thread.join();
+		info("Joined Tcp Active thread.");
+	}
+}
 
-		if (!msgLoop(clientSocket)) {
-			info("TCP: Dropping client ", readableAddr);
-			dropClient(clientSocket);
-		}
+void TcpActiveThread::tcpActiveTask()
+{
+	// Start receiving thread
+	session.networkThreads.tcpRecv = std::make_unique<TcpReceiveThread>(session, ep, session.clientSocket);
+
+	{
+		std::lock_guard<std::mutex> lock{ mtx };
+		genUpdateLists(session.server, resourcesToSend);
+	}
+
+	if (!connectionPrelude() || !msgLoop()) {
+		info("TCP: Dropping client ", session.clientAddr);
+		dropClient();
 	}
 
+	session.terminated = true;
+
 	info("tcpActiveTask: ended.");
 }
 
-void TcpActiveThread::connectToClient(socket_t clientSocket, const char* clientAddr)
+bool TcpActiveThread::connectionPrelude()
+{
+	// Connection prelude (one-time stuff)
+
+	// Perform handshake: HELO carries the biggest UDP packet the client can receive
+	const auto helo = session.msgRecvQueue.pop_or_wait();
+	if (helo.type != TcpMsgType::HELO)
+		return false;
+	const auto maxPacketSize =
+		std::max(cfg::PACKET_SIZE_BYTES, std::min<std::size_t>(helo.payload, gMaxUdpPacketSize));
+
+	// Start the UDP endpoint receiving the client's ACKs on a port chosen by the OS,
+	// so each session gets its own.
+	session.endpoints.udpPassive = startEndpoint(ep.ip.c_str(), 0, Endpoint::Type::PASSIVE, SOCK_DGRAM);
+	if (!xplatIsValidSocket(session.endpoints.udpPassive.socket))
+		return false;
+
+	// Reply with our UDP port and the max packet size we'll send (the actual one is probed later)
+#pragma pack(push, 1)
+	struct {
+		TcpMsgType type;
+		uint16_t port;
+		uint16_t maxPacketSize;
+	} msg;
+#pragma pack(pop)
+	msg.type = TcpMsgType::HELO_ACK;
+	msg.port = static_cast<uint16_t>(session.endpoints.udpPassive.port);
+	msg.maxPacketSize = static_cast<uint16_t>(maxPacketSize);
+
+	if (!sendPacket(session.clientSocket, reinterpret_cast<uint8_t*>(&msg), sizeof(msg)))
+		return false;
+
+	// Wait for ready signal from client, which tells us its UDP port
+	const auto ready = session.msgRecvQueue.pop_or_wait();
+	if (ready.type != TcpMsgType::READY)
+		return false;
+
+	if (!connectToClient(ready.payload, maxPacketSize))
+		return false;
+
+	return sendTCPMsg(session.clientSocket, TcpMsgType::READY);
+}
+
+bool TcpActiveThread::connectToClient(uint16_t clientUdpPort, std::size_t maxPacketSize)
 {
 	// Start keepalive listening thread
-	server.networkThreads.keepalive =
-		std::make_unique<KeepaliveListenThread>(server, server.endpoints.reliable, clientSocket);
-
-	// Starts UDP loops and send ready to client
-	server.endpoints.udpActive =
-		startEndpoint(clientAddr, cfg::UDP_SERVER_TO_CLIENT_PORT, Endpoint::Type::ACTIVE, SOCK_DGRAM);
-	server.networkThreads.udpActive = std::make_unique<UdpActiveThread>(server, server.endpoints.udpActive);
-	server.endpoints.udpPassive =
-		startEndpoint(ep.ip.c_str(), cfg::UDP_CLIENT_TO_SERVER_PORT, Endpoint::Type::PASSIVE, SOCK_DGRAM);
-	server.networkThreads.udpPassive = std::make_unique<UdpPassiveThread>(server, server.endpoints.udpPassive);
+	session.networkThreads.keepalive =
+		std::make_unique<KeepaliveListenThread>(session, ep, session.clientSocket);
+
+	// Starts UDP loops
+	session.endpoints.udpActive =
+		startEndpoint(session.clientAddr.c_str(), clientUdpPort, Endpoint::Type::ACTIVE, SOCK_DGRAM);
+	if (!xplatIsValidSocket(session.endpoints.udpActive.socket))
+		return false;
+
+	session.networkThreads.udpPassive =
+		std::make_unique<UdpPassiveThread>(session, session.endpoints.udpPassive);
+
+	// Find the packet size before starting to send: geometry chunks are cut to fit it.
+	session.udpPacketSize = probePacketSize(session, maxPacketSize);
+	{
+		std::lock_guard<std::mutex> lock{ session.toClient.retransmit.mtx };
+		session.toClient.retransmit.congestion = CongestionController{ session.udpPacketSize };
+	}
+
+	session.networkThreads.udpActive = std::make_unique<UdpActiveThread>(session, session.endpoints.udpActive);
+
+	info("[session ",
+		session.id,
+		"] UDP: sending to ",
+		session.clientAddr,
+		":",
+		clientUdpPort,
+		", receiving on port ",
+		session.endpoints.udpPassive.port);
+
+	return true;
 }
 
-bool TcpActiveThread::msgLoop(socket_t clientSocket)
+bool TcpActiveThread::msgLoop()
 {
 	const auto disconnected = [this]() {
-		return !ep.connected || !server.networkThreads.keepalive->clientConnected ||
-		       !server.networkThreads.tcpRecv->clientConnected;
+		return !ep.connected || !session.networkThreads.keepalive->clientConnected ||
+		       !session.networkThreads.tcpRecv->clientConnected;
+	};
+
+	const auto texturesToSend = [this]() {
+		return session.toClient.texturesQueue.size() > 0 || session.toClient.texturesToRefine.size() > 0;
 	};
 
 	while (ep.connected) {
 		std::unique_lock<std::mutex> ulk{ mtx };
-		cv.wait(ulk, [this, &disconnected]() {
-			return disconnected() || resourcesToSend.size() > 0 || server.msgRecvQueue.size() > 0 ||
-			       (!server.toClient.sendingGeometry && server.toClient.texturesQueue.size() > 0);
+		cv.wait(ulk, [this, &disconnected, &texturesToSend]() {
+			return disconnected() || resourcesToSend.size() > 0 || session.msgRecvQueue.size() > 0 ||
+			       texturesToSend();
 		});
 
 		if (disconnected()) {
@@ -190,67 +270,79 @@ bool TcpActiveThread::msgLoop(socket_t clientSocket)
 		{
 			// Check for REQ_MODEL
 			TcpMsg msg;
-			while (server.msgRecvQueue.try_pop(msg)) {
+			while (session.msgRecvQueue.try_pop(msg)) {
 				if (msg.type != TcpMsgType::REQ_MODEL)
 					continue;
 
-				loadAndEnqueueModel(server, msg.payload);
+				loadAndEnqueueModel(session, resourcesToSend, msg.payload);
 			}
 		}
 
 		if (resourcesToSend.size() > 0) {
-			if (!sendTCPMsg(clientSocket, TcpMsgType::START_RSRC_EXCHANGE)) {
-				warn("Failed to send START_RSRC_EXCHANGE");
+			if (!batch_startExchange(session)) {
+				warn("Failed to start the resource exchange");
 				return false;
 			}
 
-			if (!expectTCPMsg(server, TcpMsgType::RSRC_EXCHANGE_ACK)) {
-				warn("Failed to receive RSRC_EXCHANGE_ACK");
+			info("Send ResourceBatch");
+			if (!sendResourceBatch(session, resourcesToSend, session.toClient.texturesQueue)) {
+				err("Failed to send ResourceBatch");
 				return false;
 			}
 
-			info("Send ResourceBatch");
-			if (!sendResourceBatch(clientSocket, server, resourcesToSend, server.toClient.texturesQueue)) {
-				err("Failed to send ResourceBatch");
+			if (!batch_endExchange(session)) {
+				warn("Failed to end the resource exchange");
 				return false;
 			}
 
 			resourcesToSend.clear();
 		}
 
-		while (!disconnected() && !server.toClient.sendingGeometry &&
-			server.toClient.texturesQueue.size() > 0) {
-
-			int64_t totBytesSent = 0;
-			constexpr int64_t MIN_BYTES_PER_BATCH = megabytes(1);
+		// Textures share the bandwidth with geometry via the bandwidth limiter, so they're sent along
+		// with it. Stop as soon as a new model is requested, not to delay it.
+		if (!disconnected() && texturesToSend()) {
 
-			if (!sendTCPMsg(clientSocket, TcpMsgType::START_RSRC_EXCHANGE)) {
-				warn("Failed to send START_RSRC_EXCHANGE for sending textures");
+			if (!batch_startExchange(session)) {
+				warn("Failed to start the resource exchange for sending textures");
 				return false;
 			}
 
-			if (!expectTCPMsg(server, TcpMsgType::RSRC_EXCHANGE_ACK)) {
-				warn("Failed to receive RSRC_EXCHANGE_ACK while sending textures");
-				return false;
-			}
-
-			for (auto tex_it = server.toClient.texturesQueue.begin();
-				tex_it != server.toClient.texturesQueue.end();) {
-				totBytesSent += batch_sendTexture(clientSocket, server, tex_it->first, tex_it->second);
-
-				if (totBytesSent < 0) {
-					warn("While sending textures: totBytesSent < 0?!");
+			const bool sendingNewTextures = session.toClient.texturesQueue.size() > 0;
+			for (auto tex_it = session.toClient.texturesQueue.begin();
+				tex_it != session.toClient.texturesQueue.end();) {
+				if (batch_sendTexture(session, tex_it->first, tex_it->second) < 0) {
+					warn("Failed to send texture ", tex_it->first);
 					return false;
 				}
 
-				tex_it = server.toClient.texturesQueue.erase(tex_it);
+				tex_it = session.toClient.texturesQueue.erase(tex_it);
 
-				if (totBytesSent > MIN_BYTES_PER_BATCH)
+				if (session.msgRecvQueue.size() > 0)
 					break;
 			}
 
-			if (!sendTCPMsg(clientSocket, TcpMsgType::END_RSRC_EXCHANGE)) {
-				warn("Failed to send END_RSRC_EXCHANGE while sending textures");
+			// New textures are sent with their smallest mip levels only. Once all of them are usable,
+			// refine them one level per exchange, so the client shows each round as soon as it's complete.
+			auto& texturesToRefine = session.toClient.texturesToRefine;
+			if (!sendingNewTextures) {
+				for (auto ref_it = texturesToRefine.begin(); ref_it != texturesToRefine.end();) {
+					if (batch_sendTextureMip(session, *ref_it) < 0) {
+						warn("Failed to send mip level of texture ", ref_it->name);
+						return false;
+					}
+
+					if (ref_it->level == 0)
+						ref_it = texturesToRefine.erase(ref_it);
+					else
+						++ref_it;
+
+					if (session.msgRecvQueue.size() > 0)
+						break;
+				}
+			}
+
+			if (!batch_endExchange(session)) {
+				warn("Failed to end the resource exchange while sending textures");
 				return false;
 			}
 		}
@@ -260,36 +352,38 @@ bool TcpActiveThread::msgLoop(socket_t clientSocket)
 	return false;
 }
 
-void TcpActiveThread::dropClient(socket_t clientSocket)
+void TcpActiveThread::dropClient()
 {
-	info("Dropping client");
+	info("Dropping client ", session.id);
 
 	// Send disconnect message
-	sendTCPMsg(clientSocket, TcpMsgType::DISCONNECT);
+	sendTCPMsg(session.clientSocket, TcpMsgType::DISCONNECT);
 
 	info("Closing passiveEP");
-	closeEndpoint(server.endpoints.udpPassive);
-	server.networkThreads.udpPassive.reset(nullptr);
+	closeEndpoint(session.endpoints.udpPassive);
+	session.networkThreads.udpPassive.reset(nullptr);
 
 	info("Closing activeEP");
-	closeEndpoint(server.endpoints.udpActive);
-	server.networkThreads.udpActive.reset(nullptr);
+	closeEndpoint(session.endpoints.udpActive);
+	session.networkThreads.udpActive.reset(nullptr);
 
-	server.networkThreads.tcpRecv->clientConnected = false;
-	server.networkThreads.keepalive.reset(nullptr);
+	if (session.networkThreads.tcpRecv)
+		session.networkThreads.tcpRecv->clientConnected = false;
+	session.networkThreads.keepalive.reset(nullptr);
 
-	xplatSockClose(clientSocket);
-	server.networkThreads.tcpRecv->clientConnected = false;
-	server.networkThreads.tcpRecv.reset(nullptr);
+	xplatSockClose(session.clientSocket);
+	if (session.networkThreads.tcpRecv)
+		session.networkThreads.tcpRecv->clientConnected = false;
+	session.networkThreads.tcpRecv.reset(nullptr);
 
-	server.scene.clear();
-	server.stuffSent.clear();
-	server.toClient.texturesQueue.clear();
+	session.stuffSent.clear();
+	session.toClient.texturesQueue.clear();
+	session.toClient.texturesToRefine.clear();
 }
 ///////////
 
-KeepaliveListenThread::KeepaliveListenThread(Server& server, const Endpoint& ep, socket_t clientSocket)
-	: ServerSlaveThread{ server, ep, clientSocket }
+KeepaliveListenThread::KeepaliveListenThread(ClientSession& session, const Endpoint& ep, socket_t clientSocket)
+	: ServerSlaveThread{ session, ep, clientSocket }
 {
 	thread = std::thread{ &KeepaliveListenThread::keepaliveListenTask, this };
 	xplatSetThreadName(thread, "KeepaliveListen");
@@ -319,20 +413,20 @@ void KeepaliveListenThread::keepaliveListenTask()
 
 		// Verify the client has pinged us within our sleep time
 		const auto now = std::chrono::steady_clock::now();
-		if (std::chrono::duration_cast<std::chrono::seconds>(now - gLatestPing) > interval) {
+		if (std::chrono::duration_cast<std::chrono::seconds>(now - session.latestPing) > interval) {
 			// drop the client
 			err("Keepalive timeout.");
 			break;
 		}
 	}
 	clientConnected = false;
-	if (server.networkThreads.tcpActive)
-		server.networkThreads.tcpActive->cv.notify_one();
+	if (session.networkThreads.tcpActive)
+		session.networkThreads.tcpActive->cv.notify_one();
 }
 
 ///////////////
-TcpReceiveThread::TcpReceiveThread(Server& server, const Endpoint& ep, socket_t clientSocket)
-	: ServerSlaveThread{ server, ep, clientSocket }
+TcpReceiveThread::TcpReceiveThread(ClientSession& session, const Endpoint& ep, socket_t clientSocket)
+	: ServerSlaveThread{ session, ep, clientSocket }
 {
 	thread = std::thread{ &TcpReceiveThread::receiveTask, this };
 	xplatSetThreadName(thread, "TcpReceive");
@@ -347,15 +441,17 @@ TcpReceiveThread::~TcpReceiveThread()
 	}
 }
 
+/** @return whether the client messages of type `type` carry a uint16 payload */
+static bool hasPayload(TcpMsgType type)
+{
+	return type == TcpMsgType::REQ_MODEL || type == TcpMsgType::READY || type == TcpMsgType::HELO ||
+	       type == TcpMsgType::RSRC_EXCHANGE_ACK;
+}
+
 void TcpReceiveThread::receiveTask()
 {
 	info("Started receiveTask");
 
-	if (server.msgRecvQueue.capacity() == 0)
-		server.msgRecvQueue.reserve(256);
-	else
-		server.msgRecvQueue.clear();
-
 	int failCount = 0;
 	constexpr int MAX_FAIL_COUNT = 10;
 
@@ -363,25 +459,26 @@ void TcpReceiveThread::receiveTask()
 		std::array<uint8_t, 3> packet;
 		packet.fill(0);
 		TcpMsgType type;
-		if (receiveTCPMsg(clientSocket, packet.data(), packet.size(), type)) {
+		// Messages may arrive back to back: read the type first, then only the payload it has (if any).
+		if (receiveTCPMsg(clientSocket, packet.data(), 1, type) &&
+			(!hasPayload(type) || receiveBulk(clientSocket, packet.data() + 1, sizeof(uint16_t)))) {
 			failCount = 0;
 			switch (type) {
 			case TcpMsgType::DISCONNECT:
 				info("Received DISCONNECT from client.");
 				goto exit;
 			case TcpMsgType::KEEPALIVE:
-				gLatestPing = std::chrono::steady_clock::now();
+				session.latestPing = std::chrono::steady_clock::now();
 				break;
 			default: {
 				debug("pushing msg ", type);
 				TcpMsg msg;
 				msg.type = type;
-				if (type == TcpMsgType::REQ_MODEL) {
+				if (hasPayload(type))
 					msg.payload = *reinterpret_cast<uint16_t*>(packet.data() + 1);
-				}
-				server.msgRecvQueue.push(msg);
-				if (server.networkThreads.tcpActive)
-					server.networkThreads.tcpActive->cv.notify_one();
+				session.msgRecvQueue.push(msg);
+				if (session.networkThreads.tcpActive)
+					session.networkThreads.tcpActive->cv.notify_one();
 			} break;
 			}
 		} else {
@@ -391,7 +488,7 @@ void TcpReceiveThread::receiveTask()
 	}
 exit:
 	clientConnected = false;
-	if (server.networkThreads.tcpActive)
-		server.networkThreads.tcpActive->cv.notify_one();
+	if (session.networkThreads.tcpActive)
+		session.networkThreads.tcpActive->cv.notify_one();
 }
 
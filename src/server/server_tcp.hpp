@@ -7,28 +7,48 @@
 #include <thread>
 
 struct Server;
+struct ClientSession;
+
+/** This class implements the server's listening endpoint: it accepts incoming connections
+ *  and creates a new ClientSession for each of them.
+ */
+class TcpListenThread {
+
+	std::thread thread;
+
+	Server& server;
+	Endpoint& ep;
+
+	uint32_t nextSessionId = 0;
+
+	void tcpListenTask();
+
+public:
+	explicit TcpListenThread(Server& server, Endpoint& ep);
+	~TcpListenThread();
+};
 
 /** This class implements a reliable connection server endpoint which handles the server-side
- *  reliable communication channel.
+ *  reliable communication channel towards a single client.
  *  It's used to perform initial handshake and to send reliable messages to the client.
  */
 class TcpActiveThread {
 
 	std::thread thread;
 
-	Server& server;
+	ClientSession& session;
 	Endpoint& ep;
 
-	/** Starts the UDP + keepalive endpoints towards client */
-	void connectToClient(socket_t clientSocket, const char* clientAddr);
+	/** Starts the UDP + keepalive endpoints towards client, sending UDP packets up to `maxPacketSize` bytes */
+	bool connectToClient(uint16_t clientUdpPort, std::size_t maxPacketSize);
 
-	/** The TCP main loop */
-	bool msgLoop(socket_t clientSocket);
+	/** Performs the handshake and exchanges the UDP ports with the client. */
+	bool connectionPrelude();
 
-	/** Sends all the one-time data the client needs. */
-	bool sendOneTimeData(socket_t clientSocket);
+	/** The TCP main loop */
+	bool msgLoop();
 
-	void dropClient(socket_t clientSocket);
+	void dropClient();
 
 	void tcpActiveTask();
 
@@ -37,8 +57,13 @@ public:
 	std::mutex mtx;
 	std::condition_variable cv;
 
-	explicit TcpActiveThread(Server& server, Endpoint& ep);
+	explicit TcpActiveThread(ClientSession& session, Endpoint& ep);
 	~TcpActiveThread();
+
+	/** Starts the thread. Must be called after storing this object into `session.networkThreads.tcpActive`,
+	 *  since the threads it spawns access it from there.
+	 */
+	void start();
 };
 
 /** Utility mixin class */
@@ -46,11 +71,11 @@ class ServerSlaveThread {
 protected:
 	std::thread thread;
 
-	Server& server;
+	ClientSession& session;
 	const Endpoint& ep;
 
-	explicit ServerSlaveThread(Server& server, const Endpoint& ep, socket_t clientSocket)
-		: server{ server }
+	explicit ServerSlaveThread(ClientSession& session, const Endpoint& ep, socket_t clientSocket)
+		: session{ session }
 		, ep{ ep }
 		, clientSocket{ clientSocket }
 	{}
@@ -70,7 +95,7 @@ class KeepaliveListenThread : public ServerSlaveThread {
 	void keepaliveListenTask();
 
 public:
-	explicit KeepaliveListenThread(Server& server, const Endpoint& ep, socket_t clientSocket);
+	explicit KeepaliveListenThread(ClientSession& session, const Endpoint& ep, socket_t clientSocket);
 	~KeepaliveListenThread();
 };
 
@@ -82,6 +107,6 @@ class TcpReceiveThread : public ServerSlaveThread {
 	void receiveTask();
 
 public:
-	explicit TcpReceiveThread(Server& server, const Endpoint& ep, socket_t clientSocket);
+	explicit TcpReceiveThread(ClientSession& session, const Endpoint& ep, socket_t clientSocket);
 	~TcpReceiveThread();
 };
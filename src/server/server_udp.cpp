@@ -1,4 +1,5 @@
 #include "server_udp.hpp"
+#include "ack_codec.hpp"
 #include "camera.hpp"
 #include "clock.hpp"
 #include "config.hpp"
@@ -8,11 +9,13 @@
 #include "geom_update.hpp"
 #include "logging.hpp"
 #include "model.hpp"
+#include "packet_batch.hpp"
 #include "profile.hpp"
 #include "server.hpp"
 #include "server_appstage.hpp"
 #include "udp_messages.hpp"
 #include "udp_serialize.hpp"
+#include "units.hpp"
 #include "utils.hpp"
 #include "xplatform.hpp"
 #include <algorithm>
@@ -27,17 +30,93 @@
 using namespace logging;
 using namespace std::chrono_literals;
 
+extern unsigned gFecGroupSize;
+
 // Delete ACKed messages from update queue
-static void deleteAckedUpdates(std::vector<uint32_t>& acks, cf::hashmap<uint32_t, QueuedUpdate>& updates)
+static void deleteAckedUpdates(std::vector<uint32_t>& acks,
+	cf::hashmap<uint32_t, QueuedUpdate>& updates,
+	decltype(ServerToClientData::retransmit)& retransmit)
 {
-	for (auto ack : acks)
+	std::lock_guard<std::mutex> lock{ retransmit.mtx };
+	for (auto ack : acks) {
 		updates.remove(ack, ack);
+		const auto it = retransmit.inFlight.find(ack);
+		if (it == retransmit.inFlight.end())
+			continue;
+		if (it->second.outstanding)
+			retransmit.bytesInFlight -= it->second.bytes;
+		retransmit.inFlight.erase(it);
+	}
 
 	acks.clear();
 }
 
-UdpActiveThread::UdpActiveThread(Server& server, Endpoint& ep)
-	: server{ server }
+/** Pops from the timeouts heap the updates whose retransmission timeout expired by `now` and appends
+ *  their serial ids to `expired`. Those updates are considered lost.
+ */
+static void popExpiredUpdates(std::vector<uint32_t>& expired,
+	decltype(ServerToClientData::retransmit)& retransmit,
+	std::chrono::steady_clock::time_point now)
+{
+	std::lock_guard<std::mutex> lock{ retransmit.mtx };
+	auto& timeouts = retransmit.timeouts;
+
+	std::size_t nLost = 0;
+	while (!timeouts.empty() && timeouts.top().first <= now) {
+		const auto entry = timeouts.top();
+		timeouts.pop();
+		// Skip stale entries: the update was ACKed or resent (with a new deadline) after this was pushed
+		const auto it = retransmit.inFlight.find(entry.second);
+		if (it == retransmit.inFlight.end() || it->second.acked || it->second.deadline != entry.first)
+			continue;
+		// A lost update doesn't occupy the congestion window anymore
+		if (it->second.outstanding) {
+			retransmit.bytesInFlight -= it->second.bytes;
+			it->second.outstanding = false;
+		}
+		expired.emplace_back(entry.second);
+		++nLost;
+	}
+
+	if (nLost > 0)
+		retransmit.congestion.onLoss(now);
+}
+
+/** Records that the `n` updates in `sent` (serial id, bytes) are being sent at `time` and schedules their
+ *  retransmission timeout.
+ *  @return the bytes of the updates which had already been sent before.
+ */
+static std::size_t markSent(const std::pair<uint32_t, std::size_t>* sent,
+	std::size_t n,
+	decltype(ServerToClientData::retransmit)& retransmit,
+	std::chrono::steady_clock::time_point time)
+{
+	std::size_t retransmitted = 0;
+	std::lock_guard<std::mutex> lock{ retransmit.mtx };
+	const auto rto = retransmit.rtt.rto();
+	const auto maxRto = std::chrono::milliseconds{ cfg::SERVER_MAX_RTO_MS };
+	for (std::size_t i = 0; i < n; ++i) {
+		const auto& pair = sent[i];
+		auto& info = retransmit.inFlight[pair.first];
+		if (info.nSends > 0)
+			retransmitted += pair.second;
+		if (info.outstanding)
+			retransmit.bytesInFlight -= info.bytes;
+		info.sendTime = time;
+		info.bytes = pair.second;
+		info.outstanding = true;
+		retransmit.bytesInFlight += info.bytes;
+		++info.nSends;
+		// Back off exponentially if the update keeps getting lost
+		const auto backoff = std::min(info.nSends - 1, 5u);
+		info.deadline = time + std::min<std::chrono::steady_clock::duration>(rto * (1 << backoff), maxRto);
+		retransmit.timeouts.emplace(info.deadline, pair.first);
+	}
+	return retransmitted;
+}
+
+UdpActiveThread::UdpActiveThread(ClientSession& session, Endpoint& ep)
+	: session{ session }
 	, ep{ ep }
 {
 	thread = std::thread{ &UdpActiveThread::udpActiveTask, this };
@@ -46,7 +125,7 @@ UdpActiveThread::UdpActiveThread(Server& server, Endpoint& ep)
 
 UdpActiveThread::~UdpActiveThread()
 {
-	server.toClient.updates.cv.notify_all();
+	session.toClient.updates.cv.notify_all();
 	if (thread.joinable()) {
 		info("Joining UdpActive thread...");
 		thread.join();
@@ -58,27 +137,101 @@ void UdpActiveThread::udpActiveTask()
 {
 	uint32_t packetGen = 0;
 
-	std::array<uint8_t, cfg::PACKET_SIZE_BYTES> buffer = {};
+	// Packets are accumulated here and sent together with a single syscall
+	PacketBatch batch{ session.udpPacketSize, gFecGroupSize };
 
-	auto& updates = server.toClient.updates;
+	auto& server = session.server;
+	auto& updates = session.toClient.updates;
 
-	FPSCounter fps{ "ActiveEP" };
+	FPSCounter fps{ "ActiveEP " + std::to_string(session.id) };
 	fps.start();
 	fps.reportPeriod = 5;
 
 	auto t = std::chrono::high_resolution_clock::now();
 	std::size_t bytesPerSecond = 0;
-
-	auto latestPersistentSendTime = std::chrono::high_resolution_clock::now();
+	std::size_t syscallsPerSecond = 0;
+	std::size_t retransmittedBytesPerSecond = 0;
+
+	// Persistent chunks (serial id, bytes) written into the current batch, and how many of them were
+	// written by the end of each of its data packets. They're marked as in flight the moment their
+	// packets are handed to the kernel, so their send time is exact and their ACKs always find them.
+	std::vector<std::pair<uint32_t, std::size_t>> batchChunks;
+	std::vector<std::size_t> packetChunksEnd;
+	const auto markFlushed = [&](std::size_t firstPacket, std::size_t nPackets) {
+		const auto begin = firstPacket > 0 ? packetChunksEnd[firstPacket - 1] : 0;
+		const auto end = packetChunksEnd[firstPacket + nPackets - 1];
+		if (end > begin) {
+			retransmittedBytesPerSecond += markSent(batchChunks.data() + begin,
+				end - begin,
+				session.toClient.retransmit,
+				std::chrono::steady_clock::now());
+		}
+	};
+
+	// Sends all the batched packets, at the rate allowed by the congestion controller.
+	// Transitory updates are charged to the congestion controller too, but never wait for it:
+	// they're small and must reach the client within a frame or two.
+	const auto flush = [&](TrafficClass trafficClass) {
+		if (batch.size() == 0)
+			return true;
+		std::chrono::steady_clock::duration wait;
+		{
+			auto& retransmit = session.toClient.retransmit;
+			std::lock_guard<std::mutex> lock{ retransmit.mtx };
+			wait = retransmit.congestion.pace(batch.bytes(), std::chrono::steady_clock::now());
+		}
+		if (trafficClass != TrafficClass::TRANSITORY && wait > std::chrono::steady_clock::duration::zero())
+			std::this_thread::sleep_for(wait);
+		bytesPerSecond += batch.bytes();
+		++syscallsPerSecond;
+		const auto ok = batch.flush(ep.socket, trafficClass, markFlushed);
+		batchChunks.clear();
+		packetChunksEnd.clear();
+		return ok;
+	};
+
+	// Closes the current packet, remembering which persistent chunks it contains
+	const auto endPacket = [&]() {
+		if (!batch.packetEmpty())
+			packetChunksEnd.emplace_back(batchChunks.size());
+		batch.endPacket();
+	};
+
+	// Closes the current packet and starts writing a new one, flushing the batch if full
+	const auto nextPacket = [&](TrafficClass trafficClass) {
+		endPacket();
+		bool ok = true;
+		if (batch.full())
+			ok = flush(trafficClass);
+
+		batch.beginPacket(packetGen);
+		return ok;
+	};
+
+	const auto retransmitCheckInterval = std::chrono::milliseconds{ cfg::SERVER_RETRANSMIT_CHECK_INTERVAL_MS };
+	auto latestPersistentSendTime = std::chrono::steady_clock::now();
+	// Persistent updates which are due but didn't fit in the previous rounds, in sending order
+	std::vector<QueuedUpdate> pending;
+	// Persistent updates are sent in slices, so transitory ones never wait long behind them
+	const auto persistentSlice = std::chrono::milliseconds{ cfg::SERVER_PERSISTENT_SLICE_MS };
+	// Set when the latest slice ran out of time with updates still allowed to be sent
+	bool persistentSliceCut = false;
 
 	// Send datagrams to the client
 	while (ep.connected) {
-		if (updates.size() == 0) {
-			// Wait for updates
+		{
 			std::unique_lock<std::mutex> ulk{ updates.mtx };
-			updates.cv.wait(ulk, [this, &updates = server.toClient.updates]() {
-				return !ep.connected || updates.size() > 0;
-			});
+			if (updates.size() == 0) {
+				// Wait for updates
+				updates.cv.wait(ulk, [this, &updates]() {
+					return !ep.connected || updates.size() > 0;
+				});
+			} else if (updates.transitory.size() == 0 && !persistentSliceCut) {
+				// Only persistent updates are pending: no need to check them more often than this
+				updates.cv.wait_for(ulk, retransmitCheckInterval, [this, &updates]() {
+					return !ep.connected || updates.transitory.size() > 0;
+				});
+			}
 			if (!ep.connected)
 				break;
 		}
@@ -88,7 +241,7 @@ void UdpActiveThread::udpActiveTask()
 		updates.transitory.clear();
 		ulk.unlock();
 
-		auto offset = writeUdpHeader(buffer.data(), buffer.size(), packetGen);
+		batch.beginPacket(packetGen);
 		uberverbose("updates.size now = ", updates.size());
 
 		// Send transitory updates
@@ -97,87 +250,147 @@ void UdpActiveThread::udpActiveTask()
 				return;
 
 			const auto& update = *it;
-			const auto written = addUpdate(buffer.data(), buffer.size(), offset, update, server);
+			const auto written = addUpdate(batch, update, server);
 
 			if (written > 0) {
 				// Packet was written into the buffer, erase it and go ahead
-				offset += written;
+				++it;
+			} else if (batch.packetEmpty()) {
+				// It doesn't fit even an empty packet: it cannot be sent at all
+				warn("Dropping a transitory update which cannot be serialized");
 				++it;
 			} else {
-				// Not enough room: send the packet
-				sendPacket(ep.socket, buffer.data(), buffer.size());
-				bytesPerSecond += buffer.size();
-
-				// Start with a new packet
-				writeUdpHeader(buffer.data(), buffer.size(), packetGen);
-				offset = sizeof(UdpHeader);
+				// Not enough room: start with a new packet
+				nextPacket(TrafficClass::TRANSITORY);
 
 				// Don't erase this element yet: retry in next iteration
 			}
 		}
 
-		if (std::chrono::duration_cast<std::chrono::milliseconds>(
-			    std::chrono::high_resolution_clock::now() - latestPersistentSendTime)
-				.count() > 500) {
-			// ulk.lock();
-			if (updates.persistent.size() > 0) {
-				{
-					// Remove all persistent updates which were acked by the client
-					std::lock_guard<std::mutex> lock{ server.fromClient.acksReceivedMtx };
-					deleteAckedUpdates(server.fromClient.acksReceived, updates.persistent);
-				}
-
+		// Send the transitory updates right away, so they don't queue behind geometry
+		endPacket();
+		flush(TrafficClass::TRANSITORY);
+		batch.beginPacket(packetGen);
+
+		const auto now = std::chrono::steady_clock::now();
+		if (persistentSliceCut || now - latestPersistentSendTime >= retransmitCheckInterval) {
+			persistentSliceCut = false;
+			// Only look at the updates which were never sent or whose retransmission timeout expired
+			std::vector<uint32_t> newSerials;
+			std::vector<uint32_t> expiredSerials;
+			std::vector<QueuedUpdate> fresh;
+			{
+				std::lock_guard<std::mutex> lock{ updates.mtx };
 				if (updates.persistent.size() > 0) {
-					verbose("sending ", updates.persistent.size(), " persistent updates");
+					{
+						// Remove all persistent updates which were acked by the client
+						auto& fromClient = session.fromClient;
+						std::lock_guard<std::mutex> acksLock{ fromClient.acksReceivedMtx };
+						deleteAckedUpdates(fromClient.acksReceived,
+							updates.persistent,
+							session.toClient.retransmit);
+					}
 
-					// Send persistent updates
-					auto it = updates.persistent.iter_start();
-					uint32_t ignoreKey;
+					newSerials.swap(updates.unsent);
+					popExpiredUpdates(expiredSerials, session.toClient.retransmit, now);
+
+					// Retransmissions go first, as the client is already waiting for them
+					fresh.reserve(expiredSerials.size() + newSerials.size());
 					QueuedUpdate update;
-					bool loop = updates.persistent.iter_next(it, ignoreKey, update);
-					while (loop) {
-						if (!ep.connected)
-							return;
-
-						// GEOM updates are currently the only ACKed ones
-						assert(update.type == QueuedUpdate::Type::GEOM);
-						const auto written =
-							addUpdate(buffer.data(), buffer.size(), offset, update, server);
-
-						if (written > 0) {
-							offset += written;
-							loop = updates.persistent.iter_next(it, ignoreKey, update);
-						} else {
-							// Not enough room: send the packet
-							if (!sendPacket(ep.socket, buffer.data(), buffer.size()))
-								break;
-							bytesPerSecond += buffer.size();
-							// info("pers: ", updates.persistent.size());
-
-							writeUdpHeader(buffer.data(), buffer.size(), packetGen);
-							offset = sizeof(UdpHeader);
-						}
+					for (auto serialId : expiredSerials) {
+						if (updates.persistent.lookup(serialId, serialId, update))
+							fresh.emplace_back(update);
+					}
+					for (auto serialId : newSerials) {
+						if (updates.persistent.lookup(serialId, serialId, update))
+							fresh.emplace_back(update);
 					}
+
+					// Drop the leftovers which were ACKed in the meantime
+					const auto wasAcked = [&updates](const QueuedUpdate& u) {
+						const auto id = u.data.geom.data.serialId;
+						QueuedUpdate ignore;
+						return !updates.persistent.lookup(id, id, ignore);
+					};
+					const auto acked = std::remove_if(pending.begin(), pending.end(), wasAcked);
+					pending.erase(acked, pending.end());
 				} else {
-					// Just finished sending geometry: notify tcp thread
-					{
-						std::lock_guard<std::mutex> lock{
-							server.networkThreads.tcpActive->mtx
-						};
-						server.toClient.sendingGeometry = false;
+					updates.unsent.clear();
+					pending.clear();
+				}
+			}
+
+			if (fresh.size() > 0) {
+				// Send first what the client is looking at, if we know it
+				shared::Camera camera;
+				bool cameraValid;
+				{
+					std::lock_guard<std::mutex> lock{ session.fromClient.cameraMtx };
+					camera = session.fromClient.camera;
+					cameraValid = session.fromClient.cameraValid;
+				}
+				if (cameraValid)
+					sortGeomUpdatesByImportance(fresh, server, camera);
+
+				// The leftovers of the previous rounds are already sorted: queue them after these
+				fresh.insert(fresh.end(), pending.begin(), pending.end());
+				pending.swap(fresh);
+			}
+
+			if (pending.size() > 0) {
+				verbose("sending ", pending.size(), " persistent updates");
+
+				// Don't have more bytes in flight than the congestion window allows
+				std::size_t allowance;
+				{
+					auto& retransmit = session.toClient.retransmit;
+					std::lock_guard<std::mutex> lock{ retransmit.mtx };
+					allowance = retransmit.congestion.room(retransmit.bytesInFlight, now);
+				}
+				std::size_t roundBytes = 0;
+				const auto sliceEnd = now + persistentSlice;
+
+				// Send persistent updates
+				auto it = pending.begin();
+				while (it != pending.end() && roundBytes < allowance) {
+					if (!ep.connected)
+						return;
+
+					// Let the transitory updates enqueued meanwhile go first, then resume
+					if (roundBytes > 0 && std::chrono::steady_clock::now() >= sliceEnd) {
+						persistentSliceCut = true;
+						break;
+					}
+
+					// GEOM updates are currently the only ACKed ones
+					assert(it->type == QueuedUpdate::Type::GEOM);
+					const auto written = addUpdate(batch, *it, server);
+
+					if (written > 0) {
+						batchChunks.emplace_back(it->data.geom.data.serialId, written);
+						roundBytes += written;
+						++it;
+					} else if (batch.packetEmpty()) {
+						// It doesn't fit even an empty packet: it cannot be sent at all
+						warn("Skipping geometry update ", it->data.geom.data.serialId);
+						++it;
+					} else {
+						// Not enough room: start with a new packet
+						if (!nextPacket(TrafficClass::GEOMETRY))
+							break;
 					}
-					server.networkThreads.tcpActive->cv.notify_one();
 				}
+
+				// Whatever exceeded the slice or the congestion window (or wasn't sent as a send
+				// failed) is retried next round
+				pending.erase(pending.begin(), it);
 			}
-			// ulk.unlock();
-			latestPersistentSendTime = std::chrono::high_resolution_clock::now();
+			latestPersistentSendTime = now;
 		}
 
-		if (offset > sizeof(UdpHeader)) {
-			// Need to send the last packet
-			sendPacket(ep.socket, buffer.data(), buffer.size());
-			bytesPerSecond += buffer.size();
-		}
+		// Need to send the last packet
+		endPacket();
+		flush(TrafficClass::GEOMETRY);
 
 		fps.addFrame();
 		fps.report();
@@ -185,8 +398,42 @@ void UdpActiveThread::udpActiveTask()
 		auto tt = std::chrono::high_resolution_clock::now();
 		if (std::chrono::duration_cast<std::chrono::seconds>(tt - t).count() >= 1) {
 			t = tt;
-			info("UDP bytes sent this second: ", bytesPerSecond);
+			info("[session ",
+				session.id,
+				"] UDP bytes sent this second: ",
+				bytesPerSecond,
+				" (",
+				syscallsPerSecond,
+				" send syscalls, ",
+				bytesPerSecond > 0 ? syscallsPerSecond * megabytes(1) / bytesPerSecond : 0,
+				" per MiB)");
+			if (retransmittedBytesPerSecond > 0 || gDebugLv >= LOGLV_VERBOSE) {
+				RttEstimator rtt;
+				float sendRate;
+				{
+					std::lock_guard<std::mutex> lock{ session.toClient.retransmit.mtx };
+					rtt = session.toClient.retransmit.rtt;
+					sendRate = session.toClient.retransmit.congestion.rate();
+				}
+				info("[session ",
+					session.id,
+					"] geometry bytes retransmitted this second: ",
+					retransmittedBytesPerSecond,
+					" (duplicate ratio: ",
+					bytesPerSecond > 0 ? float(retransmittedBytesPerSecond) / bytesPerSecond : 0.f,
+					", srtt: ",
+					rtt.srtt().count() / 1000.f,
+					" ms, rto: ",
+					rtt.rto().count() / 1000.f,
+					" ms, send rate: ",
+					sendRate / 1024,
+					" KiB/s)");
+			}
+			server.udpBytesSent += bytesPerSecond;
+			server.udpBytesRetransmitted += retransmittedBytesPerSecond;
 			bytesPerSecond = 0;
+			syscallsPerSecond = 0;
+			retransmittedBytesPerSecond = 0;
 		}
 
 		++packetGen;
@@ -195,8 +442,8 @@ void UdpActiveThread::udpActiveTask()
 
 ////////////////////////////////////////
 
-UdpPassiveThread::UdpPassiveThread(Server& server, Endpoint& ep)
-	: server{ server }
+UdpPassiveThread::UdpPassiveThread(ClientSession& session, Endpoint& ep)
+	: session{ session }
 	, ep{ ep }
 {
 	thread = std::thread{ &UdpPassiveThread::udpPassiveTask, this };
@@ -214,7 +461,10 @@ UdpPassiveThread::~UdpPassiveThread()
 
 void UdpPassiveThread::udpPassiveTask()
 {
-	// Receive client ACKs to (some of) our UDP messages
+	// Receive client ACKs to (some of) our UDP messages and the client camera
+
+	// ACKs decoded from the latest packet
+	std::vector<uint32_t> acks;
 
 	while (ep.connected) {
 		std::array<uint8_t, cfg::PACKET_SIZE_BYTES> packetBuf = {};
@@ -223,34 +473,97 @@ void UdpPassiveThread::udpPassiveTask()
 		if (!receivePacket(ep.socket, packetBuf.data(), packetBuf.size(), &bytesRead))
 			continue;
 
-		if (bytesRead != sizeof(AckPacket)) {
-			warn("Read bogus packet from client (",
-				bytesRead,
-				" bytes instead of expected ",
-				sizeof(AckPacket),
-				")");
+		const auto msgType = byte2udpmsg(packetBuf[0]);
+		switch (msgType) {
+		case UdpMsgType::ACK: {
+			if (bytesRead < static_cast<int>(sizeof(AckPacketHeader))) {
+				warn("Read bogus ACK packet from client (", bytesRead, " bytes)");
+				continue;
+			}
+			AckPacketHeader header;
+			memcpy(&header, packetBuf.data(), sizeof(AckPacketHeader));
+			acks.clear();
+			const auto payload = packetBuf.data() + sizeof(AckPacketHeader);
+			const auto payloadSize = bytesRead - sizeof(AckPacketHeader);
+			const bool valid =
+				header.nRanges == 0 || decodeAckRanges(payload, payloadSize, header.nRanges, acks) > 0;
+			if (!valid) {
+				warn("Read bogus ACK packet from client (",
+					header.nRanges,
+					" ranges in ",
+					payloadSize,
+					" bytes)");
+				continue;
+			}
+		} break;
+		case UdpMsgType::CAMERA:
+			if (bytesRead != sizeof(CameraPacket)) {
+				warn("Read bogus CAMERA packet from client (",
+					bytesRead,
+					" bytes instead of expected ",
+					sizeof(CameraPacket),
+					")");
+				continue;
+			}
+			{
+				const auto packet = reinterpret_cast<const CameraPacket*>(packetBuf.data());
+				std::lock_guard<std::mutex> lock{ session.fromClient.cameraMtx };
+				session.fromClient.camera = packet->camera;
+				session.fromClient.cameraValid = true;
+			}
+			continue;
+		case UdpMsgType::MTU_PROBE_ACK:
+			if (bytesRead != sizeof(MtuProbeAckPacket)) {
+				warn("Read bogus MTU_PROBE_ACK packet from client (", bytesRead, " bytes)");
+				continue;
+			}
+			{
+				MtuProbeAckPacket packet;
+				memcpy(&packet, packetBuf.data(), sizeof(MtuProbeAckPacket));
+				const std::size_t probeSize = packet.probeSize;
+				auto& mtuProbes = session.fromClient.mtuProbes;
+				std::lock_guard<std::mutex> lock{ mtuProbes.mtx };
+				mtuProbes.largestAcked = std::max(mtuProbes.largestAcked, probeSize);
+			}
+			session.fromClient.mtuProbes.cv.notify_one();
+			continue;
+		default:
+			warn("Read bogus packet from client (type is ", msgType, ")");
 			continue;
 		}
 
-		const auto packet = reinterpret_cast<const AckPacket*>(packetBuf.data());
-		if (packet->msgType != UdpMsgType::ACK) {
-			warn("Read bogus packet from client (type is ",
-				packet->msgType,
-				" instead of ",
-				UdpMsgType::ACK,
-				")");
-			continue;
+		{
+			// Measure the round trip time of the updates which were sent only once
+			// and let the congestion controller know how much data got through.
+			const auto now = std::chrono::steady_clock::now();
+			auto& retransmit = session.toClient.retransmit;
+			std::lock_guard<std::mutex> lock{ retransmit.mtx };
+			std::size_t ackedBytes = 0;
+			auto latestRtt = std::chrono::steady_clock::duration::zero();
+			for (auto ack : acks) {
+				const auto it = retransmit.inFlight.find(ack);
+				if (it == retransmit.inFlight.end() || it->second.acked)
+					continue;
+				it->second.acked = true;
+				ackedBytes += it->second.bytes;
+				if (it->second.outstanding) {
+					retransmit.bytesInFlight -= it->second.bytes;
+					it->second.outstanding = false;
+				}
+				if (it->second.nSends != 1)
+					continue;
+				latestRtt = now - it->second.sendTime;
+				retransmit.rtt.addSample(std::chrono::duration_cast<RttEstimator::Duration>(latestRtt));
+			}
+			if (ackedBytes > 0)
+				retransmit.congestion.onAck(ackedBytes, latestRtt, retransmit.rtt.srtt(), now);
 		}
 
-		if (server.fromClient.acksReceivedMtx.try_lock()) {
-			constexpr unsigned MAX_ACKS = cfg::PACKET_SIZE_BYTES / sizeof(uint32_t);
-			const unsigned nAcks = std::min(packet->nAcks, MAX_ACKS);
-			for (unsigned i = 0; i < nAcks; ++i)
-				server.fromClient.acksReceived.emplace_back(packet->acks[i]);
-			server.fromClient.acksReceivedMtx.unlock();
+		{
+			std::lock_guard<std::mutex> lock{ session.fromClient.acksReceivedMtx };
+			auto& acksReceived = session.fromClient.acksReceived;
+			acksReceived.insert(acksReceived.end(), acks.begin(), acks.end());
 		}
-		// XXX: maybe save ACKs inside the UDPPassiveThread class
-		// instead of discarding them if try_lock() fails?
 	}
 }
 
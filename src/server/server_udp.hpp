@@ -9,22 +9,21 @@
 #include <condition_variable>
 #include <mutex>
 
-struct Server;
-struct ServerSharedData;
+struct ClientSession;
 
 /** This class implements the active server thread which sends messages to client via an UDP socket. */
 class UdpActiveThread {
 
 	std::thread thread;
 
-	Server& server;
+	ClientSession& session;
 	Endpoint& ep;
 
 	void udpActiveTask();
 
 public:
-	/** Constructs a ServerActiveEndpoint owned by `server`. */
-	explicit UdpActiveThread(Server& server, Endpoint& ep);
+	/** Constructs a ServerActiveEndpoint owned by `session`. */
+	explicit UdpActiveThread(ClientSession& session, Endpoint& ep);
 	~UdpActiveThread();
 };
 
@@ -33,13 +32,13 @@ class UdpPassiveThread {
 
 	std::thread thread;
 
-	Server& server;
+	ClientSession& session;
 	Endpoint& ep;
 
 	void udpPassiveTask();
 
 public:
-	explicit UdpPassiveThread(Server& server, Endpoint& ep);
+	explicit UdpPassiveThread(ClientSession& session, Endpoint& ep);
 	~UdpPassiveThread();
 };
 
@@ -6,6 +6,10 @@ using namespace logging;
 // TODO: currently all nodes are children of root.
 Node* Scene::addNode(StringId name, NodeType type, Transform transform)
 {
+	auto existing = getNode(name);
+	if (existing)
+		return existing;
+
 	auto node = allocator.alloc();
 	node->name = name;
 	node->type = type;
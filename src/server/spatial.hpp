@@ -26,6 +26,8 @@ struct Node {
 	NodeType type;
 	Transform transform;
 	uint8_t flags = 0;
+	/** Must be incremented every time `transform` changes, so the change is sent to clients */
+	uint32_t version = 0;
 
 	Node* parent = nullptr;
 };
@@ -41,7 +43,9 @@ struct Scene : public ExternalMemoryUser {
 
 	Node* root = nullptr;
 
-	/** Adds node `name` of type `type` */
+	/** Adds node `name` of type `type`.
+	 *  If a node with that name already exists, it is returned unchanged instead.
+	 */
 	Node* addNode(StringId name, NodeType type, Transform transform);
 
 	/** Deallocates node `name` and removes it from the scene. */
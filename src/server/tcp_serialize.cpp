@@ -1,11 +1,14 @@
 #include "tcp_serialize.hpp"
 #include "config.hpp"
+#include "cooked_texture.hpp"
 #include "defer.hpp"
 #include "logging.hpp"
 #include "model.hpp"
 #include "server_resources.hpp"
 #include "tcp_messages.hpp"
-#include <array>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
 #include <vector>
 
 using namespace logging;
@@ -78,8 +81,6 @@ bool sendModel(socket_t clientSocket, const Model& model)
 {
 	info("Sending model ", model.name, " (", sidToString(model.name), ")");
 
-	std::array<uint8_t, cfg::PACKET_SIZE_BYTES> packet;
-
 	// Prepare header
 	ResourcePacket<shared::Model> header;
 	header.type = TcpMsgType::RSRC_TYPE_MODEL;
@@ -89,8 +90,10 @@ bool sendModel(socket_t clientSocket, const Model& model)
 	assert(model.data);
 	header.res.nMaterials = model.data->materials.size();
 	header.res.nMeshes = model.data->meshes.size();
+	header.res.nLods = model.data->lods.size();
+	header.res.boundsMin = model.bounds.min;
+	header.res.boundsExtent = model.bounds.extent;
 
-	// Put header into packet
 	debug("header: { type = ",
 		header.type,
 		", name = ",
@@ -103,69 +106,69 @@ bool sendModel(socket_t clientSocket, const Model& model)
 		int(header.res.nMaterials),
 		", nMeshes = ",
 		int(header.res.nMeshes),
+		", nLods = ",
+		int(header.res.nLods),
 		" }");
 	constexpr auto sizeOfHeader = sizeof(ResourcePacket<shared::Model>);
-	memcpy(packet.data(), reinterpret_cast<const uint8_t*>(&header), sizeOfHeader);
 
 	const auto matSize = header.res.nMaterials * sizeof(StringId);
-	const auto meshSize = header.res.nMeshes * sizeof(shared::Mesh);
-	const auto size = matSize + meshSize;
+	const auto lodMeshSize = header.res.nMeshes * sizeof(shared::Mesh);
+	const auto lodSize = header.res.nLods * sizeof(shared::ModelLod);
 
-	// Fill remaining space with payload (materials | meshes)
-	std::vector<uint8_t> payload(size);
+	// Send header and payload (materials | meshes | lods) together
+	std::vector<uint8_t> message(sizeOfHeader + matSize + header.res.nLods * lodMeshSize + lodSize);
+	memcpy(message.data(), reinterpret_cast<const uint8_t*>(&header), sizeOfHeader);
+	auto payload = message.data() + sizeOfHeader;
 	for (unsigned i = 0; i < model.data->materials.size(); ++i) {
 		// For materials we just copy the name
-		reinterpret_cast<StringId*>(payload.data())[i] = model.data->materials[i].name;
+		reinterpret_cast<StringId*>(payload)[i] = model.data->materials[i].name;
 	}
-	memcpy(payload.data() + matSize, model.data->meshes.data(), meshSize);
-
-	auto len = std::min(size, packet.size() - sizeOfHeader);
-	memcpy(packet.data() + sizeOfHeader, payload.data(), len);
-
-	if (!sendPacket(clientSocket, packet.data(), len + sizeOfHeader))
-		return false;
-
-	std::size_t bytesSent = len;
-	// Send more packets with remaining payload if needed
-	while (bytesSent < size) {
-		auto len = std::min(size - bytesSent, cfg::PACKET_SIZE_BYTES);
-		if (!sendPacket(clientSocket, reinterpret_cast<const uint8_t*>(payload.data()) + bytesSent, len))
-			return false;
-		bytesSent += len;
+	payload += matSize;
+	memcpy(payload, model.data->meshes.data(), lodMeshSize);
+	payload += lodMeshSize;
+	for (const auto& meshes : model.data->lodMeshes) {
+		memcpy(payload, meshes.data(), lodMeshSize);
+		payload += lodMeshSize;
 	}
+	memcpy(payload, model.data->lods.data(), lodSize);
 
-	return true;
+	return sendBulk(clientSocket, message.data(), message.size());
 }
 
 bool sendTexture(socket_t clientSocket,
-	ServerResources& resources,
 	const std::string& texName,
+	const std::string& filePath,
 	shared::TextureFormat format,
 	std::size_t* outBytesSent)
 {
 	using shared::TextureInfo;
 
-	std::array<uint8_t, cfg::PACKET_SIZE_BYTES> packet;
+	// The texture is streamed straight from its file, without loading it
+	auto file = std::fopen(filePath.c_str(), "rb");
+	if (!file) {
+		err("Failed to open texture ", filePath);
+		return false;
+	}
+	DEFER([file]() { std::fclose(file); });
 
-	// Load the texture, and unload it as we finished using it
-	resources.loadTexture(texName.c_str());
-	DEFER([&resources]() {
-		resources.textures.clear();
-		resources.allocator.deallocLatest();
-	});
+	std::fseek(file, 0, SEEK_END);
+	const auto fileSize = std::ftell(file);
+	if (fileSize <= 0) {
+		err("Failed to read the size of texture ", filePath);
+		return false;
+	}
+	const auto texSize = static_cast<std::size_t>(fileSize);
 
 	// Prepare header
 	const auto texNameSid = sid(texName);
-	const auto& texture = resources.textures[texNameSid];
 	ResourcePacket<TextureInfo> header;
 	header.type = TcpMsgType::RSRC_TYPE_TEXTURE;
 	header.res.name = texNameSid;
 	header.res.format = format;
-	header.res.size = texture.size;
+	header.res.size = texSize;
 
 	info("Sending texture ", texName, " (", texNameSid, ")");
 
-	// Put header into packet
 	debug("texheader: { type = ",
 		header.type,
 		", size = ",
@@ -175,27 +178,127 @@ bool sendTexture(socket_t clientSocket,
 		", format = ",
 		int(header.res.format),
 		" }");
-	constexpr auto sizeOfHeader = sizeof(ResourcePacket<TextureInfo>);
-	memcpy(packet.data(), reinterpret_cast<const uint8_t*>(&header), sizeOfHeader);
+	if (!sendPacket(clientSocket,
+		    reinterpret_cast<const uint8_t*>(&header),
+		    sizeof(ResourcePacket<TextureInfo>),
+		    TrafficClass::TEXTURE))
+		return false;
 
-	// Fill remaining space with payload
-	auto len = std::min(texture.size, packet.size() - sizeOfHeader);
-	memcpy(packet.data() + sizeOfHeader, texture.data, len);
+	// Send the texture data as a single stream
+	if (!sendFileBulk(clientSocket, file, 0, texSize, TrafficClass::TEXTURE))
+		return false;
 
-	if (!sendPacket(clientSocket, packet.data(), len + sizeOfHeader))
+	if (outBytesSent)
+		*outBytesSent = texSize;
+
+	return true;
+}
+
+/** Opens the cooked texture file `cookedPath` and reads its header.
+ *  @return the file, positioned after the header, or nullptr on failure.
+ */
+static std::FILE* openCookedTexture(const std::string& cookedPath, CookedTextureHeader& header)
+{
+	auto file = std::fopen(cookedPath.c_str(), "rb");
+	if (!file) {
+		err("Failed to open cooked texture ", cookedPath);
+		return nullptr;
+	}
+
+	if (std::fread(&header, sizeof(CookedTextureHeader), 1, file) != 1 || header.magic != COOKED_TEXTURE_MAGIC) {
+		err("Invalid cooked texture ", cookedPath);
+		std::fclose(file);
+		return nullptr;
+	}
+
+	return file;
+}
+
+bool sendCookedTexture(socket_t clientSocket,
+	const std::string& texName,
+	const std::string& cookedPath,
+	shared::TextureFormat format,
+	uint16_t firstLevel,
+	std::size_t* outBytesSent)
+{
+	using shared::TextureInfo;
+
+	CookedTextureHeader header;
+	auto file = openCookedTexture(cookedPath, header);
+	if (!file)
+		return false;
+	DEFER([file]() { std::fclose(file); });
+
+	// Only the levels from `firstLevel` on are sent: the header still tells the client the texture's full size.
+	const auto dataOffset = sizeof(CookedTextureHeader) + cookedLevelOffset(header, firstLevel);
+	header.firstLevel = firstLevel;
+	const auto dataSize = cookedDataSize(header);
+
+	ResourcePacket<TextureInfo> packet;
+	packet.type = TcpMsgType::RSRC_TYPE_TEXTURE;
+	packet.res.name = sid(texName);
+	packet.res.format = format;
+	packet.res.size = sizeof(CookedTextureHeader) + dataSize;
+
+	info("Sending cooked texture ", texName, " (", packet.res.name, ") from mip level ", firstLevel);
+
+	// Send the message header along with the (modified) cooked texture header, then stream the levels
+	uint8_t headers[sizeof(ResourcePacket<TextureInfo>) + sizeof(CookedTextureHeader)];
+	memcpy(headers, &packet, sizeof(ResourcePacket<TextureInfo>));
+	memcpy(headers + sizeof(ResourcePacket<TextureInfo>), &header, sizeof(CookedTextureHeader));
+	if (!sendPacket(clientSocket, headers, sizeof(headers), TrafficClass::TEXTURE))
+		return false;
+
+	if (!sendFileBulk(clientSocket, file, dataOffset, dataSize, TrafficClass::TEXTURE))
+		return false;
+
+	if (outBytesSent)
+		*outBytesSent = sizeof(headers) + dataSize;
+
+	return true;
+}
+
+bool sendTextureMip(socket_t clientSocket,
+	const std::string& texName,
+	const std::string& cookedPath,
+	uint16_t level,
+	std::size_t* outBytesSent)
+{
+	using shared::TextureMipInfo;
+
+	CookedTextureHeader header;
+	auto file = openCookedTexture(cookedPath, header);
+	if (!file)
 		return false;
+	DEFER([file]() { std::fclose(file); });
 
-	std::size_t bytesSent = len;
-	// Send more packets with remaining payload if needed
-	while (bytesSent < texture.size) {
-		auto len = std::min(texture.size - bytesSent, cfg::PACKET_SIZE_BYTES);
-		if (!sendPacket(clientSocket, reinterpret_cast<const uint8_t*>(texture.data) + bytesSent, len))
-			return false;
-		bytesSent += len;
+	if (level >= header.mipLevels) {
+		err("Texture ", texName, " has no mip level ", level);
+		return false;
 	}
 
+	ResourcePacket<TextureMipInfo> packet;
+	packet.type = TcpMsgType::RSRC_TYPE_TEXTURE_MIP;
+	packet.res.name = sid(texName);
+	packet.res.level = level;
+	packet.res.width = std::max(1u, header.width >> level);
+	packet.res.height = std::max(1u, header.height >> level);
+	packet.res.size = cookedMipSize(header.format, packet.res.width, packet.res.height);
+
+	debug("Sending mip level ", level, " of texture ", texName, " (", packet.res.size, " B)");
+
+	if (!sendPacket(clientSocket,
+		    reinterpret_cast<const uint8_t*>(&packet),
+		    sizeof(ResourcePacket<TextureMipInfo>),
+		    TrafficClass::TEXTURE))
+		return false;
+
+	const auto levelOffset = sizeof(CookedTextureHeader) + cookedLevelOffset(header, level);
+	if (!sendFileBulk(clientSocket, file, levelOffset, packet.res.size, TrafficClass::TEXTURE))
+		return false;
+
 	if (outBytesSent)
-		*outBytesSent = bytesSent;
+		*outBytesSent = sizeof(ResourcePacket<TextureMipInfo>) + packet.res.size;
 
 	return true;
 }
@@ -208,8 +311,6 @@ bool sendShader(socket_t clientSocket,
 {
 	using shared::SpirvShaderInfo;
 
-	std::array<uint8_t, cfg::PACKET_SIZE_BYTES> packet;
-
 	// Load the shader, and unload it as we finished using it
 	resources.loadShader(shadName);
 	DEFER([&resources]() {
@@ -229,7 +330,6 @@ bool sendShader(socket_t clientSocket,
 
 	info("Sending shader ", shadName, " (", shadNameSid, ")");
 
-	// Put header into packet
 	debug("shadheader: { type = ",
 		header.type,
 		", size = ",
@@ -241,24 +341,11 @@ bool sendShader(socket_t clientSocket,
 		", stage = ",
 		int(header.res.stage),
 		" }");
-	constexpr auto sizeOfHeader = sizeof(ResourcePacket<SpirvShaderInfo>);
-	memcpy(packet.data(), reinterpret_cast<const uint8_t*>(&header), sizeOfHeader);
-
-	// Fill remaining space with payload
-	auto len = std::min(shader.codeSizeInBytes, packet.size() - sizeOfHeader);
-	memcpy(packet.data() + sizeOfHeader, shader.code, len);
-
-	if (!sendPacket(clientSocket, packet.data(), len + sizeOfHeader))
+	if (!sendPacket(clientSocket,
+		    reinterpret_cast<const uint8_t*>(&header),
+		    sizeof(ResourcePacket<SpirvShaderInfo>)))
 		return false;
 
-	std::size_t bytesSent = len;
-	// Send more packets with remaining payload if needed
-	while (bytesSent < shader.codeSizeInBytes) {
-		auto len = std::min(shader.codeSizeInBytes - bytesSent, cfg::PACKET_SIZE_BYTES);
-		if (!sendPacket(clientSocket, reinterpret_cast<const uint8_t*>(shader.code) + bytesSent, len))
-			return false;
-		bytesSent += len;
-	}
-
-	return true;
+	// Send the code as a single stream
+	return sendBulk(clientSocket, reinterpret_cast<const uint8_t*>(shader.code), shader.codeSizeInBytes);
 }
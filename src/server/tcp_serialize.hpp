@@ -13,16 +13,33 @@ bool sendPointLight(socket_t clientSocket, const shared::PointLight& light);
 
 bool sendModel(socket_t clientSocket, const Model& model);
 
-/** Sends a single texture via `clientSocket`.
- *  The first packet sent contains a header with the metadata and the beginning of the
- *  actual texture data.
- *  Then, if the complete data doesn't fit one packet, more packets are sent until all
- *  bytes are sent. These extra packets have no header.
+/** Sends the texture `texName` via `clientSocket`, reading it straight from the file `filePath`
+ *  (which is either `texName` itself or the texture cooked from it).
+ *  A header with the metadata is sent first, then the texture data is streamed with no header.
  */
 bool sendTexture(socket_t clientSocket,
-	ServerResources& resources,
 	const std::string& texName,
+	const std::string& filePath,
+	shared::TextureFormat format,
+	std::size_t* bytesSent = nullptr);
+
+/** Sends the texture `texName`, cooked in the file `cookedPath`, with only its mip levels from `firstLevel` on.
+ *  The larger levels can then be sent with `sendTextureMip`.
+ */
+bool sendCookedTexture(socket_t clientSocket,
+	const std::string& texName,
+	const std::string& cookedPath,
 	shared::TextureFormat format,
+	uint16_t firstLevel,
+	std::size_t* bytesSent = nullptr);
+
+/** Sends the mip level `level` of the texture `texName`, cooked in the file `cookedPath`,
+ *  to refine the texture on the client. The client must already have all the levels after `level`.
+ */
+bool sendTextureMip(socket_t clientSocket,
+	const std::string& texName,
+	const std::string& cookedPath,
+	uint16_t level,
 	std::size_t* bytesSent = nullptr);
 
 bool sendShader(socket_t clientSocket,
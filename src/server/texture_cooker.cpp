@@ -0,0 +1,217 @@
+#include "texture_cooker.hpp"
+#include "bc_encoder.hpp"
+#include "cooked_texture.hpp"
+#include "defer.hpp"
+#include "hashing.hpp"
+#include "logging.hpp"
+#include "profile.hpp"
+#include "xplatform.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_NO_GIF
+#include "third_party/stb_image.h"
+
+using namespace logging;
+using shared::TextureFormat;
+
+/** Serializes the cooking, so two sessions never cook (and write) the same texture at the same time */
+static std::mutex gCookMtx;
+
+/** Halves the `width` x `height` image `src` into `dst`, averaging each 2x2 box of pixels.
+ *  The normals of normal maps are renormalized after being averaged.
+ */
+static void downsample(const std::vector<uint8_t>& src,
+	uint32_t width,
+	uint32_t height,
+	unsigned channels,
+	bool isNormalMap,
+	std::vector<uint8_t>& dst)
+{
+	const auto dstWidth = std::max(1u, width / 2);
+	const auto dstHeight = std::max(1u, height / 2);
+	dst.resize(dstWidth * dstHeight * channels);
+
+	for (uint32_t y = 0; y < dstHeight; ++y) {
+		const auto row0 = src.data() + std::min(2 * y, height - 1) * width * channels;
+		const auto row1 = src.data() + std::min(2 * y + 1, height - 1) * width * channels;
+		for (uint32_t x = 0; x < dstWidth; ++x) {
+			const auto x0 = std::min(2 * x, width - 1) * channels;
+			const auto x1 = std::min(2 * x + 1, width - 1) * channels;
+			auto px = dst.data() + (y * dstWidth + x) * channels;
+			for (unsigned c = 0; c < channels; ++c) {
+				const auto sum = row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c];
+				px[c] = static_cast<uint8_t>((sum + 2) / 4);
+			}
+
+			if (isNormalMap) {
+				float n[3];
+				for (unsigned c = 0; c < 3; ++c)
+					n[c] = px[c] / 127.5f - 1.f;
+				const auto len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+				if (len > 0) {
+					for (unsigned c = 0; c < 3; ++c)
+						px[c] = static_cast<uint8_t>(std::lround((n[c] / len + 1.f) * 127.5f));
+				}
+			}
+		}
+	}
+}
+
+static CookedFormat chooseCookedFormat(TextureFormat format, const uint8_t* pixels, std::size_t nPixels)
+{
+	switch (format) {
+	case TextureFormat::GREY:
+		return CookedFormat::BC4;
+	case TextureFormat::NORMAL:
+		return CookedFormat::BC5;
+	default:
+		break;
+	}
+
+	// Only pay for the alpha block if some pixel is actually transparent
+	for (std::size_t i = 0; i < nPixels; ++i) {
+		if (pixels[4 * i + 3] < 255)
+			return CookedFormat::BC3;
+	}
+	return CookedFormat::BC1;
+}
+
+/** Cooks the encoded image `src` into `cooked`. */
+static bool cook(const std::vector<uint8_t>& src, TextureFormat format, std::vector<uint8_t>& cooked)
+{
+	const unsigned channels = format == TextureFormat::GREY ? 1 : 4;
+	int width, height, srcChannels;
+	auto pixels = stbi_load_from_memory(src.data(),
+		static_cast<int>(src.size()),
+		&width,
+		&height,
+		&srcChannels,
+		channels == 1 ? STBI_grey : STBI_rgb_alpha);
+	if (!pixels)
+		return false;
+	DEFER([pixels]() { stbi_image_free(pixels); });
+
+	CookedTextureHeader header;
+	header.magic = COOKED_TEXTURE_MAGIC;
+	header.version = COOKED_TEXTURE_VERSION;
+	header.format = chooseCookedFormat(format, pixels, static_cast<std::size_t>(width) * height);
+	header.width = width;
+	header.height = height;
+	header.mipLevels = 1 + static_cast<uint16_t>(std::floor(std::log2(std::max(width, height))));
+	header.firstLevel = 0;
+
+	cooked.resize(sizeof(CookedTextureHeader) + cookedDataSize(header));
+	memcpy(cooked.data(), &header, sizeof(CookedTextureHeader));
+
+	std::vector<uint8_t> level{ pixels, pixels + static_cast<std::size_t>(width) * height * channels };
+	std::vector<uint8_t> nextLevel;
+	auto dst = cooked.data() + sizeof(CookedTextureHeader);
+	uint32_t levelWidth = header.width, levelHeight = header.height;
+	for (unsigned i = 0; i < header.mipLevels; ++i) {
+		compressImage(level.data(), levelWidth, levelHeight, header.format, dst);
+		dst += cookedMipSize(header.format, levelWidth, levelHeight);
+
+		if (i + 1 < header.mipLevels) {
+			const auto isNormalMap = format == TextureFormat::NORMAL;
+			downsample(level, levelWidth, levelHeight, channels, isNormalMap, nextLevel);
+			std::swap(level, nextLevel);
+			levelWidth = std::max(1u, levelWidth / 2);
+			levelHeight = std::max(1u, levelHeight / 2);
+		}
+	}
+
+	return true;
+}
+
+std::string cookTexture(const std::string& path, TextureFormat format, const std::string& cacheDir)
+{
+	std::ifstream file{ path, std::ios::binary };
+	if (!file) {
+		warn("Can't cook texture ", path, ": failed to open it");
+		return "";
+	}
+	const std::vector<uint8_t> src{ std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{} };
+
+	// Key the cooked texture by its source's content and by what it's cooked for, so the cache never
+	// goes stale when the source file changes.
+	char cookedName[64];
+	snprintf(cookedName,
+		sizeof(cookedName),
+		"%08x-%zx-%u-%u.ctex",
+		hashing::fnv1a_hash(src.data(), src.size()),
+		src.size(),
+		static_cast<unsigned>(format),
+		static_cast<unsigned>(COOKED_TEXTURE_VERSION));
+	const auto cookedPath = cacheDir + DIRSEP + cookedName;
+
+	std::lock_guard<std::mutex> lock{ gCookMtx };
+
+	if (std::ifstream{ cookedPath, std::ios::binary }.good()) {
+		debug("Using cached texture ", cookedPath, " for ", path);
+		return cookedPath;
+	}
+
+	std::vector<uint8_t> cooked;
+	bool ok = false;
+	measure_ms("Cook Texture", LOGLV_DEBUG, [&]() { ok = cook(src, format, cooked); });
+	if (!ok) {
+		warn("Can't cook texture ", path, ": failed to decode it");
+		return "";
+	}
+
+	if (!xplatMakeDir(cacheDir.c_str())) {
+		warn("Can't create the texture cache ", cacheDir);
+		return "";
+	}
+
+	// Write to a temporary file first, so an interrupted write never leaves a truncated texture in the cache
+	const auto tmpPath = cookedPath + ".tmp";
+	{
+		std::ofstream out{ tmpPath, std::ios::binary };
+		out.write(reinterpret_cast<const char*>(cooked.data()), cooked.size());
+		if (!out) {
+			warn("Failed to write cooked texture ", tmpPath);
+			return "";
+		}
+	}
+	if (std::rename(tmpPath.c_str(), cookedPath.c_str()) != 0) {
+		warn("Failed to move cooked texture to ", cookedPath);
+		std::remove(tmpPath.c_str());
+		return "";
+	}
+
+	info("Cooked texture ",
+		path,
+		" (",
+		src.size() / 1024,
+		" KiB) into ",
+		cookedPath,
+		" (",
+		cooked.size() / 1024,
+		" KiB)");
+
+	return cookedPath;
+}
+
+bool readCookedTextureHeader(const std::string& cookedPath, CookedTextureHeader& header)
+{
+	std::ifstream file{ cookedPath, std::ios::binary | std::ios::ate };
+	if (!file)
+		return false;
+
+	const auto size = static_cast<std::size_t>(file.tellg());
+	file.seekg(0);
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(CookedTextureHeader)))
+		return false;
+
+	return header.magic == COOKED_TEXTURE_MAGIC && header.version == COOKED_TEXTURE_VERSION &&
+	       header.firstLevel == 0 && size == sizeof(CookedTextureHeader) + cookedDataSize(header);
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "cooked_texture.hpp"
+#include "shared_resources.hpp"
+#include <string>
+
+/** Cooks the texture file `path` to be used as `format`: decodes it, builds its full mip chain and compresses each
+ *  level into the block format sampled by the GPU (BC1, or BC3 if it has transparent pixels, for RGBA; BC4 for GREY;
+ *  BC5 for NORMAL). See cooked_texture.hpp for the resulting format.
+ *  Cooked textures are cached in `cacheDir`, keyed by the content of the source file, so each texture is only
+ *  cooked the first time it's needed.
+ *  @return the path of the cooked texture, or an empty string if `path` could not be cooked.
+ */
+std::string cookTexture(const std::string& path, shared::TextureFormat format, const std::string& cacheDir);
+
+/** Reads the header of the cooked texture file `cookedPath` into `header`.
+ *  @return false if the file is not a complete cooked texture.
+ */
+bool readCookedTextureHeader(const std::string& cookedPath, CookedTextureHeader& header);
@@ -1,44 +1,88 @@
 #include "udp_serialize.hpp"
+#include "config.hpp"
+#include "index_codec.hpp"
+#include "packet_batch.hpp"
+#include "quantized_transform.hpp"
 #include "queued_update.hpp"
 #include "server.hpp"
 #include "shared_resources.hpp"
 #include "spatial.hpp"
 #include "udp_messages.hpp"
 #include <algorithm>
+#include <array>
 #include <cassert>
 #include <glm/glm.hpp>
 #include <glm/gtx/string_cast.hpp>
+#include <mutex>
+#include <shared_mutex>
 
 using namespace logging;
 
-std::size_t writeUdpHeader(uint8_t* buffer, std::size_t bufsize, uint32_t packetGen)
+/** Writes a chunk containing `model`'s indices described by `geomUpdate`.
+ *  Only its first index is encoded here: the others are referenced from the model's encoded indices.
+ */
+static std::size_t addCompressedIndexUpdate(PacketBatch& batch, const GeomUpdateHeader& geomUpdate, const Model& model)
 {
-	assert(bufsize >= sizeof(UdpHeader));
+	assert(geomUpdate.start + geomUpdate.len <= model.nIndices);
+	assert(geomUpdate.len > 0);
+
+	// The first index is relative to 0 in the chunk, not to the one before it
+	std::array<uint8_t, MAX_ENCODED_INDEX_SIZE> first;
+	const auto firstSize = encodeIndices(model.indices + geomUpdate.start, 1, first.data(), first.size());
+	const auto& encoded = model.data->encodedIndices;
+	const auto restBegin = encoded.offset(geomUpdate.start + 1);
+	const auto restSize = encoded.offset(geomUpdate.start + geomUpdate.len) - restBegin;
+	const auto encodedSize = firstSize + restSize;
+	// Prevent infinite loops
+	assert(firstSize > 0);
+	assert(batch.headerSize() + sizeof(UdpMsgType) + sizeof(GeomUpdateHeader) + sizeof(uint16_t) + encodedSize <=
+	       batch.maxSize());
 
-	UdpHeader header;
-	header.packetGen = packetGen;
-	header.size = 0;
+	const auto chunkSize = sizeof(UdpMsgType) + sizeof(GeomUpdateHeader) + sizeof(uint16_t) + encodedSize;
+	if (chunkSize > batch.room()) {
+		verbose("Not enough room!");
+		return 0;
+	}
 
-	memcpy(buffer, reinterpret_cast<void*>(&header), sizeof(UdpHeader));
+	// Write chunk type
+	static_assert(sizeof(UdpMsgType) == 1, "Need to change this code!");
+	const auto type = udpmsg2byte(UdpMsgType::GEOM_UPDATE);
+	batch.write(&type, sizeof(UdpMsgType));
 
-	return sizeof(UdpHeader);
+	// Write chunk header
+	batch.write(&geomUpdate, sizeof(GeomUpdateHeader));
+
+	// Write chunk payload
+	const auto payloadSize = static_cast<uint16_t>(encodedSize);
+	batch.write(&payloadSize, sizeof(uint16_t));
+	batch.write(first.data(), firstSize);
+	if (restSize > 0)
+		batch.reference(encoded.data() + restBegin, restSize);
+
+	return chunkSize;
 }
 
-static std::size_t addGeomUpdate(uint8_t* buffer,
-	std::size_t bufsize,
-	std::size_t offset,
-	const GeomUpdateHeader& geomUpdate,
-	const ServerResources& resources)
+static std::size_t
+	addGeomUpdate(PacketBatch& batch, const GeomUpdateHeader& geomUpdate, const ServerResources& resources)
 {
-	uberverbose("addGeomUpdate(buf=", buffer, ", bufsiz=", bufsize, ", off=", offset, ")");
-	// assert(offset < bufsize);
+	uberverbose("addGeomUpdate(room=", batch.room(), ")");
 	assert(geomUpdate.modelId != SID_NONE);
 	assert(geomUpdate.dataType < GeomDataType::INVALID);
 
-	// Retreive data from the model
-	Model model;
-	if (!resources.models.lookup(geomUpdate.modelId, geomUpdate.modelId, model))
-		err("inexisting model ", int(geomUpdate.modelId));
+	// Retreive data from the model. Chunks of the same model are usually sent one after another,
+	// so cache the latest one (models are never modified once loaded).
+	static thread_local Model model;
+	if (model.name != geomUpdate.modelId) {
+		std::shared_lock<std::shared_timed_mutex> lock{ resources.modelsMtx };
+		if (!resources.models.lookup(geomUpdate.modelId, geomUpdate.modelId, model)) {
+			err("inexisting model ", int(geomUpdate.modelId));
+			model = Model{};
+			return 0;
+		}
+	}
+
+	if (geomUpdate.dataType == GeomDataType::INDEX_COMPRESSED)
+		return addCompressedIndexUpdate(batch, geomUpdate, model);
 
 	void* dataPtr;
 	std::size_t dataSize;
@@ -47,6 +91,10 @@ static std::size_t addGeomUpdate(uint8_t* buffer,
 		dataPtr = model.vertices;
 		dataSize = sizeof(Vertex);
 		break;
+	case GeomDataType::VERTEX_QUANTIZED:
+		dataPtr = model.quantizedVertices;
+		dataSize = sizeof(QuantizedVertex);
+		break;
 	case GeomDataType::INDEX:
 		dataPtr = model.indices;
 		dataSize = sizeof(Index);
@@ -58,63 +106,47 @@ static std::size_t addGeomUpdate(uint8_t* buffer,
 
 	const auto payloadSize = dataSize * geomUpdate.len;
 	verbose("start: ", geomUpdate.start, ", len: ", geomUpdate.len);
-	verbose("offset: ", offset, ", payload size: ", payloadSize, ", bufsize: ", bufsize);
+	verbose("payload size: ", payloadSize, ", room: ", batch.room());
 	// Prevent infinite loops
-	assert(sizeof(UdpMsgType) + sizeof(GeomUpdateHeader) + payloadSize < bufsize);
+	assert(batch.headerSize() + sizeof(UdpMsgType) + sizeof(GeomUpdateHeader) + payloadSize <= batch.maxSize());
 
-	if (offset + sizeof(UdpMsgType) + sizeof(GeomUpdateHeader) + payloadSize > bufsize) {
+	if (sizeof(UdpMsgType) + sizeof(GeomUpdateHeader) + payloadSize > batch.room()) {
 		verbose("Not enough room!");
 		return 0;
 	}
 
-	std::size_t written = 0;
-
 	// Write chunk type
 	static_assert(sizeof(UdpMsgType) == 1, "Need to change this code!");
-	buffer[offset] = udpmsg2byte(UdpMsgType::GEOM_UPDATE);
-	written += sizeof(UdpMsgType);
+	const auto type = udpmsg2byte(UdpMsgType::GEOM_UPDATE);
+	batch.write(&type, sizeof(UdpMsgType));
 
 	// Write chunk header
-	memcpy(buffer + offset + written, &geomUpdate, sizeof(GeomUpdateHeader));
-	written += sizeof(GeomUpdateHeader);
-
-	// Write chunk payload
-	memcpy(buffer + offset + written,
-		reinterpret_cast<uint8_t*>(dataPtr) + dataSize * geomUpdate.start,
-		payloadSize);
-	written += payloadSize;
+	batch.write(&geomUpdate, sizeof(GeomUpdateHeader));
 
-	// Update size in header
-	reinterpret_cast<UdpHeader*>(buffer)->size += written;
-	verbose("Packet size is now ", reinterpret_cast<UdpHeader*>(buffer)->size);
+	// Reference chunk payload directly from the model
+	batch.reference(reinterpret_cast<uint8_t*>(dataPtr) + dataSize * geomUpdate.start, payloadSize);
 
-	return written;
+	return sizeof(UdpMsgType) + sizeof(GeomUpdateHeader) + payloadSize;
 }
 
 /** Updates a PointLight's color and/or attenuation. To keep it simple, all properties are always sent anyway. */
-static std::size_t addPointLightUpdate(uint8_t* buffer,
-	std::size_t bufsize,
-	std::size_t offset,
-	const shared::PointLight& pointLight)
+static std::size_t addPointLightUpdate(PacketBatch& batch, const shared::PointLight& pointLight)
 {
-	// assert(offset < bufsize);
-
 	const std::size_t payloadSize = sizeof(glm::vec3) + sizeof(float);
 
 	// Prevent infinite loops
-	assert(sizeof(UdpMsgType) + sizeof(PointLightUpdateHeader) + payloadSize < bufsize);
+	assert(batch.headerSize() + sizeof(UdpMsgType) + sizeof(PointLightUpdateHeader) + payloadSize <=
+	       cfg::PACKET_SIZE_BYTES);
 
-	if (offset + sizeof(UdpMsgType) + sizeof(PointLightUpdateHeader) + payloadSize > bufsize) {
+	if (sizeof(UdpMsgType) + sizeof(PointLightUpdateHeader) + payloadSize > batch.room()) {
 		verbose("Not enough room!");
 		return 0;
 	}
 
-	std::size_t written = 0;
-
 	// Write chunk type
 	static_assert(sizeof(UdpMsgType) == 1, "Need to change this code!");
-	buffer[offset] = udpmsg2byte(UdpMsgType::POINT_LIGHT_UPDATE);
-	written += sizeof(UdpMsgType);
+	const auto type = udpmsg2byte(UdpMsgType::POINT_LIGHT_UPDATE);
+	batch.write(&type, sizeof(UdpMsgType));
 
 	// Write header
 	PointLightUpdateHeader header;
@@ -122,67 +154,48 @@ static std::size_t addPointLightUpdate(uint8_t* buffer,
 	header.color = pointLight.color;
 	header.attenuation = pointLight.attenuation;
 
-	memcpy(buffer + offset + written, &header, sizeof(PointLightUpdateHeader));
-	written += sizeof(PointLightUpdateHeader);
+	batch.write(&header, sizeof(PointLightUpdateHeader));
 
-	// Update size in header
-	reinterpret_cast<UdpHeader*>(buffer)->size += written;
-	verbose("Packet size is now ", reinterpret_cast<UdpHeader*>(buffer)->size);
-
-	dumpFullPacket(buffer, bufsize, LOGLV_VERBOSE);
-
-	return written;
+	return sizeof(UdpMsgType) + sizeof(PointLightUpdateHeader);
 }
 
-static std::size_t addTransformUpdate(uint8_t* buffer, std::size_t bufsize, std::size_t offset, const Node& node)
+static std::size_t addTransformUpdate(PacketBatch& batch, const Node& node)
 {
-	// assert(offset < bufsize);
-
-	// Header-only type of chunk
-	const std::size_t payloadSize = 0;
+	std::array<uint8_t, MAX_ENCODED_TRANSFORM_SIZE> payload;
+	const auto payloadSize = encodeTransform(node.transform, payload.data());
 
 	// Prevent infinite loops
-	assert(sizeof(UdpMsgType) + sizeof(TransformUpdateHeader) + payloadSize < bufsize);
+	assert(batch.headerSize() + sizeof(UdpMsgType) + sizeof(TransformUpdateHeader) + payloadSize <=
+	       cfg::PACKET_SIZE_BYTES);
 
-	if (offset + sizeof(UdpMsgType) + sizeof(TransformUpdateHeader) + payloadSize > bufsize) {
+	if (sizeof(UdpMsgType) + sizeof(TransformUpdateHeader) + payloadSize > batch.room()) {
 		verbose("Not enough room!");
 		return 0;
 	}
 
-	std::size_t written = 0;
-
 	// Write chunk type
 	static_assert(sizeof(UdpMsgType) == 1, "Need to change this code!");
-	buffer[offset] = udpmsg2byte(UdpMsgType::TRANSFORM_UPDATE);
-	written += sizeof(UdpMsgType);
+	const auto type = udpmsg2byte(UdpMsgType::TRANSFORM_UPDATE);
+	batch.write(&type, sizeof(UdpMsgType));
 
 	// Write header
 	TransformUpdateHeader header;
 	header.objectId = node.name;
-	header.transform = node.transform.getMatrix();
-
-	memcpy(buffer + offset + written, &header, sizeof(TransformUpdateHeader));
-	written += sizeof(TransformUpdateHeader);
 
-	// Update size in header
-	reinterpret_cast<UdpHeader*>(buffer)->size += written;
-	verbose("Packet size is now ", reinterpret_cast<UdpHeader*>(buffer)->size);
+	batch.write(&header, sizeof(TransformUpdateHeader));
 
-	dumpFullPacket(buffer, bufsize, LOGLV_VERBOSE);
+	// Write payload
+	batch.write(payload.data(), payloadSize);
 
-	return written;
+	return sizeof(UdpMsgType) + sizeof(TransformUpdateHeader) + payloadSize;
 }
 
-std::size_t addUpdate(uint8_t* buffer,
-	std::size_t bufsize,
-	std::size_t offset,
-	const QueuedUpdate& update,
-	const Server& server)
+std::size_t addUpdate(PacketBatch& batch, const QueuedUpdate& update, const Server& server)
 {
 	switch (update.type) {
 		using T = QueuedUpdate::Type;
 	case T::GEOM:
-		return addGeomUpdate(buffer, bufsize, offset, update.data.geom.data, server.resources);
+		return addGeomUpdate(batch, update.data.geom.data, server.resources);
 
 	case T::POINT_LIGHT: {
 		const auto lightId = update.data.pointLight.lightId;
@@ -193,17 +206,18 @@ std::size_t addUpdate(uint8_t* buffer,
 			throw std::runtime_error("addUpdate: tried to send update for inexisting point light " +
 						 std::to_string(lightId) + "!");
 		}
-		return addPointLightUpdate(buffer, bufsize, offset, *it);
+		return addPointLightUpdate(batch, *it);
 	}
 
 	case T::TRANSFORM: {
 		const auto objId = update.data.transform.objectId;
+		std::lock_guard<std::mutex> lock{ server.sceneMtx };
 		const auto node = server.scene.getNode(objId);
 		if (!node) {
 			throw std::runtime_error(
 				"addUpdate: tried to send update for inexisting object " + std::to_string(objId) + "!");
 		}
-		return addTransformUpdate(buffer, bufsize, offset, *node);
+		return addTransformUpdate(batch, *node);
 	}
 
 	default:
@@ -220,15 +234,19 @@ void dumpFullPacket(const uint8_t* buffer, std::size_t bufsize, LogLevel loglv)
 	log(loglv, true, "header.packetGen:");
 	dumpBytes(&header->packetGen, sizeof(uint64_t), 50, loglv);
 	log(loglv, true, "header.size:");
-	dumpBytes(&header->size, sizeof(uint32_t), 50, loglv);
+	dumpBytes(&header->size, sizeof(uint16_t), 50, loglv);
+	log(loglv, true, "header.flags:");
+	dumpBytes(&header->flags, sizeof(uint16_t), 50, loglv);
+
+	// Skip the header extensions
+	const auto chunks = buffer + udpHeaderSize(*header);
 
-	const auto type = byte2udpmsg(buffer[sizeof(UdpHeader)]);
-	log(loglv, true, "chunk type: 0x", std::hex, int(buffer[sizeof(UdpHeader)]), std::dec, "  (", type, ")");
+	const auto type = byte2udpmsg(chunks[0]);
+	log(loglv, true, "chunk type: 0x", std::hex, int(chunks[0]), std::dec, "  (", type, ")");
 
 	switch (type) {
 	case UdpMsgType::GEOM_UPDATE: {
-		const auto chunkHead =
-			reinterpret_cast<const GeomUpdateHeader*>(buffer + sizeof(UdpHeader) + sizeof(UdpMsgType));
+		const auto chunkHead = reinterpret_cast<const GeomUpdateHeader*>(chunks + sizeof(UdpMsgType));
 		log(loglv, true, "chunkHead.modelId:");
 		dumpBytes(&chunkHead->modelId, sizeof(uint32_t), 50, loglv);
 		log(loglv, true, "chunkHead.dataType:");
@@ -238,11 +256,10 @@ void dumpFullPacket(const uint8_t* buffer, std::size_t bufsize, LogLevel loglv)
 		log(loglv, true, "chunkHead.len:");
 		dumpBytes(&chunkHead->len, sizeof(uint32_t), 50, loglv);
 		log(loglv, true, "payload:");
-		dumpBytes(buffer + sizeof(UdpHeader) + sizeof(GeomUpdateHeader), bufsize, 100, loglv);
+		dumpBytes(chunks + sizeof(GeomUpdateHeader), bufsize, 100, loglv);
 	} break;
 	case UdpMsgType::POINT_LIGHT_UPDATE: {
-		const auto chunkHead = reinterpret_cast<const PointLightUpdateHeader*>(
-			buffer + sizeof(UdpHeader) + sizeof(UdpMsgType));
+		const auto chunkHead = reinterpret_cast<const PointLightUpdateHeader*>(chunks + sizeof(UdpMsgType));
 		log(loglv, true, "chunkHead.lightId:");
 		dumpBytes(&chunkHead->lightId, sizeof(uint32_t), 50, loglv);
 		log(loglv, true, "chunkHead.color:");
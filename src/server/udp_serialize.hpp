@@ -4,6 +4,7 @@
 #include <cstddef>
 #include <cstdint>
 
+class PacketBatch;
 struct GeomUpdateHeader;
 struct Server;
 struct QueuedUpdate;
@@ -11,18 +12,11 @@ namespace shared {
 struct PointLight;
 }
 
-/** Writes an UDP header into `buffer`.
- *  @return The amount of bytes written.
+/** Transforms a generic queued update into an udp update chunk and appends it to `batch`'s current packet.
+ *  Geometry payloads are not copied, but referenced directly from the server resources.
+ *  @return the number of bytes written, or 0 if the packet hadn't enough room or the update cannot be
+ *  serialized (e.g. its model doesn't exist): in the latter case, it never fits even an empty packet.
  */
-std::size_t writeUdpHeader(uint8_t* buffer, std::size_t bufsize, uint32_t packetGen);
-
-/** Transforms a generic queued update into an udp update chunk and writes it into `buffer`, starting at `offset`.
- *  @return the number of bytes written, or 0 if the buffer hadn't enough room.
- */
-std::size_t addUpdate(uint8_t* buffer,
-	std::size_t bufsize,
-	std::size_t offset,
-	const QueuedUpdate& update,
-	const Server& server);
+std::size_t addUpdate(PacketBatch& batch, const QueuedUpdate& update, const Server& server);
 
 void dumpFullPacket(const uint8_t* buffer, std::size_t bufsize, LogLevel loglv);